@@ -0,0 +1,98 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include "thor_runtime.h"
+
+#define THOR_ARENA_MASK ((uint64_t)THOR_ARENA_ALIGNMENT - 1)
+
+// The first aligned byte after the header of the block.
+uintptr_t thor_arena_block_start(ThorArenaBlock *block) {
+    return ((uintptr_t)(block + 1) + THOR_ARENA_MASK) & ~THOR_ARENA_MASK;
+}
+
+ThorArenaBlock *thor_arena_block(size_t size) {
+    ThorArenaBlock *block =
+        malloc(sizeof(ThorArenaBlock) + THOR_ARENA_ALIGNMENT + size);
+    if (block != NULL) {
+        *block = (ThorArenaBlock){.size = size};
+    }
+    return block;
+}
+
+// The first block is only allocated by the first allocation, so an unused
+// arena costs nothing but itself.
+ThorArena *thor_arena_create(uint64_t block_size) {
+    if (block_size == 0) {
+        block_size = THOR_ARENA_BLOCK_SIZE;
+    }
+    if (block_size > SIZE_MAX / 2) {
+        return NULL;
+    }
+
+    ThorArena *arena = malloc(sizeof(ThorArena));
+    if (arena != NULL) {
+        *arena = (ThorArena){
+            .block_size = (block_size + THOR_ARENA_MASK) & ~THOR_ARENA_MASK,
+        };
+    }
+    return arena;
+}
+
+// Allocations larger than a block get a block of their own. It is put behind
+// the current block, so the rest of the current block is still used.
+void *thor_arena_alloc_slow(ThorArena *arena, uint64_t size) {
+    if (arena == NULL || size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    size_t aligned = (size + THOR_ARENA_MASK) & ~THOR_ARENA_MASK;
+    bool   large   = aligned > arena->block_size;
+
+    ThorArenaBlock *block = thor_arena_block(large ? aligned : arena->block_size);
+    if (block == NULL) {
+        return NULL;
+    }
+    uintptr_t start = thor_arena_block_start(block);
+    if (large && arena->blocks != NULL) {
+        block->previous         = arena->blocks->previous;
+        arena->blocks->previous = block;
+        return (void *)start;
+    }
+
+    block->previous = arena->blocks;
+    arena->blocks   = block;
+    arena->cur      = start + aligned;
+    arena->end      = start + block->size;
+    return (void *)start;
+}
+
+ThorArena *thor_arena_reset(ThorArena *arena) {
+    if (arena == NULL || arena->blocks == NULL) {
+        return arena;
+    }
+
+    ThorArenaBlock *current = arena->blocks;
+
+    ThorArenaBlock *block = current->previous;
+    while (block != NULL) {
+        ThorArenaBlock *previous = block->previous;
+        free(block);
+        block = previous;
+    }
+    current->previous = NULL;
+    arena->cur        = thor_arena_block_start(current);
+    arena->end        = arena->cur + current->size;
+    return arena;
+}
+
+ThorArena *thor_arena_release(ThorArena *arena) {
+    if (arena == NULL) {
+        return NULL;
+    }
+    ThorArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ThorArenaBlock *previous = block->previous;
+        free(block);
+        block = previous;
+    }
+    free(arena);
+    return NULL;
+}
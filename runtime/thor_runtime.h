@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================
+// -- thor runtime --
+// The functions generated code calls, linked into every thor program. Thor
+// code uses them through the builtins arena, alloc, reset and release, an
+// arena is passed around as an u64 handle and an allocation as its u64
+// address.
+//
+// The names start with thor_, which is no valid thor identifier, so they never
+// collide with a function of the program.
+// ================
+
+// Every allocation is aligned to this.
+#define THOR_ARENA_ALIGNMENT  16
+// The size of the blocks if the arena was created with size 0.
+#define THOR_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct ThorArenaBlock ThorArenaBlock;
+struct ThorArenaBlock {
+    ThorArenaBlock *previous;
+    size_t          size;
+};
+
+// Allocations bump cur until it reaches end, then a new block is allocated.
+// Codegen inlines this fast path, so cur and end have to stay the first two
+// fields. Both are aligned to THOR_ARENA_ALIGNMENT, and both are 0 until the
+// first block is allocated.
+typedef struct ThorArena ThorArena;
+struct ThorArena {
+    uintptr_t       cur;
+    uintptr_t       end;
+    // The current block, it links to the older blocks
+    ThorArenaBlock *blocks;
+    size_t          block_size;
+};
+
+// The runtime functions, for the JIT which defines them for thor code.
+#define THOR_RUNTIME_FUNCTIONS \
+    X(thor_arena_create)       \
+    X(thor_arena_alloc_slow)   \
+    X(thor_arena_reset)        \
+    X(thor_arena_release)
+
+// An arena whose blocks have block_size bytes. Returns NULL if out of memory.
+ThorArena *thor_arena_create(uint64_t block_size);
+// The slow path of thor_arena_alloc, allocates a new block that fits size.
+// Returns NULL if out of memory or arena is NULL.
+void      *thor_arena_alloc_slow(ThorArena *arena, uint64_t size);
+// Frees every allocation at once, keeps the current block for reuse. Returns
+// the arena, NULL stays NULL.
+ThorArena *thor_arena_reset(ThorArena *arena);
+// Frees the arena and every allocation. Returns NULL.
+ThorArena *thor_arena_release(ThorArena *arena);
+
+// The same fast path as the generated code: as end - cur is a multiple of the
+// alignment, size fits if the aligned size fits. An arena without a block
+// takes the slow path, even for size 0, so no allocation returns NULL.
+static inline void *thor_arena_alloc(ThorArena *arena, uint64_t size) {
+    if (arena != NULL && arena->cur != 0 && size <= arena->end - arena->cur) {
+        void *result = (void *)arena->cur;
+        arena->cur += (size + THOR_ARENA_ALIGNMENT - 1) &
+                      ~(uint64_t)(THOR_ARENA_ALIGNMENT - 1);
+        return result;
+    }
+    return thor_arena_alloc_slow(arena, size);
+}
@@ -0,0 +1,12 @@
+#include "ast.h"
+
+char const *node_type_str(NodeType type) {
+    switch (type) {
+#define X(upper, lower) \
+    case NODE_TYPE_##upper: \
+        return #lower;
+        NODES
+#undef X
+    }
+    return "invalid node type";
+}
@@ -6,6 +6,8 @@
 enum NodeExtraDataType {
     NODE_EXTRA_DATA_FUNCTION_PROTOTYPE,
     NODE_EXTRA_DATA_BLOCK,
+    NODE_EXTRA_DATA_CALL,
+    NODE_EXTRA_DATA_LOOP,
 };
 typedef enum NodeExtraDataType  NodeExtraDataType;
 
@@ -21,11 +23,20 @@ struct FunctionArguments {
     FunctionArgument *items;
 };
 
+// The tokens of the attribute names, without the @.
+typedef struct FunctionAttributeTokens FunctionAttributeTokens;
+struct FunctionAttributeTokens {
+    usz    count;
+    usz    capacity;
+    Index *items;
+};
+
 typedef struct FunctionPrototypeData FunctionPrototypeData;
 struct FunctionPrototypeData {
     // Token Index
-    Index             return_type;
-    FunctionArguments args;
+    Index                   return_type;
+    FunctionArguments       args;
+    FunctionAttributeTokens attributes;
 };
 
 // Contains a list of Indexes to diffrent top level nodes.
@@ -36,12 +47,48 @@ struct BlockData {
     Index *items;
 };
 
+// Contains a list of Indexes to the argument nodes of a call, in source order.
+typedef struct CallData CallData;
+struct CallData {
+    usz    count;
+    usz    capacity;
+    Index *items;
+};
+
+// #name(argument), the tokens of the name and the integer argument. argument
+// is 0 if the hint has none.
+typedef struct LoopHintToken LoopHintToken;
+struct LoopHintToken {
+    Index name;
+    Index argument;
+};
+
+typedef struct LoopHintTokens LoopHintTokens;
+struct LoopHintTokens {
+    usz            count;
+    usz            capacity;
+    LoopHintToken *items;
+};
+
+// The operand nodes and hints of a for or while loop.
+typedef struct LoopData LoopData;
+struct LoopData {
+    // while: the condition, for: the start of the range
+    Index          lhs;
+    // for: the end of the range, it is not part of the range. Unused for
+    // while.
+    Index          rhs;
+    LoopHintTokens hints;
+};
+
 typedef struct NodeExtraData NodeExtraData;
 struct NodeExtraData {
     NodeExtraDataType type;
     union {
         FunctionPrototypeData function_prototype;
         BlockData             block;
+        CallData              call;
+        LoopData              loop;
     } data;
 };
 
@@ -50,26 +97,87 @@ struct NodeExtraData {
 
 #define NODE(name) NODE_TYPE_##name
 
+// Node X macro list
+#define NODES                                                       \
+    /* lhs Index to the BlockData in ExtraData                      \
+       rhs is unused */                                             \
+    X(BLOCK, block)                                                 \
+    /* lhs is a Index into the extra data                           \
+       rhs is the Index to a Block Node */                          \
+    X(FUNCTION_DEFINITION, function_definition)                     \
+    /* lhs and rhs are not used                                     \
+       the main_token is the integer */                             \
+    X(INTEGER_LITERAL, integer_literal)                             \
+    /* lhs and rhs are not used                                     \
+       the main_token is the float */                               \
+    X(FLOAT_LITERAL, float_literal)                                 \
+    /* lhs and rhs are not used                                     \
+       the main_token is the identifier */                          \
+    X(IDENTIFIER, identifier)                                       \
+    /* lhs op rhs                                                   \
+       main_token is the operator, + - or *                         \
+       lhs and rhs are the Indexes to the operand nodes */          \
+    X(BINARY_OPERATION, binary_operation)                           \
+    /* name(args...)                                                \
+       main_token is `name`                                         \
+       lhs Index to the CallData in ExtraData                       \
+       rhs is unused */                                             \
+    X(CALL, call)                                                   \
+    /* name : (optional type) = rhs                                 \
+       main_token is `name`                                         \
+       lhs is the optional type.                                    \
+       rhs is the expression */                                     \
+    X(VARIABLE_DECLARATION, variable_declaration)                   \
+    /* comptime name : (optional type) = rhs                        \
+       Only at the top level, rhs is evaluated during the analyse   \
+       main_token is `name`                                         \
+       lhs is the optional type.                                    \
+       rhs is the expression */                                     \
+    X(COMPTIME_DECLARATION, comptime_declaration)                   \
+    /* name = rhs                                                   \
+       main_token is `name`                                         \
+       lhs is unused                                                \
+       rhs is the expression */                                     \
+    X(ASSIGNMENT, assignment)                                       \
+    /* #hints while condition { ... }                               \
+       main_token is `while`                                        \
+       lhs Index to the LoopData in ExtraData                       \
+       rhs is the Index to a Block Node */                          \
+    X(WHILE, while)                                                 \
+    /* #hints for name in start..end { ... }                        \
+       main_token is `name`                                         \
+       lhs Index to the LoopData in ExtraData                       \
+       rhs is the Index to a Block Node */                          \
+    X(FOR, for)                                                     \
+    /* return rhs                                                   \
+       main_token is `return`                                       \
+       lhs is unused                                                \
+       rhs is the expression */                                     \
+    X(RETURN, return)                                               \
+    /* import name                                                  \
+       Only at the top level, declares the @export functions of     \
+       the module name from its interface                           \
+       main_token is `name`                                         \
+       lhs and rhs are unused */                                    \
+    X(IMPORT, import)                                               \
+    /* End of file                                                  \
+       main_token is the eof token */                               \
+    X(EOF, eof)
+
 enum NodeType {
-    // lhs Index to the BlockData in ExtraData
-    // rhs is unused
-    NODE(BLOCK),
-    // lhs is a Index into the extra data
-    // rhs is the Index to a Block Node
-    NODE(FUNCTION_DEFINITION),
-    // lhs and rhs are not used
-    // the main_token is the integer
-    NODE(INTEGER_LITERAL),
-    // name : (optional type) = rhs
-    // main_token is `name`
-    // lhs is the optional type.
-    // rhs is the expression
-    NODE(VARIABLE_DECLARATION),
-    // End of file
-    // main_token is the eof token
-    NODE(EOF),
-};
-typedef enum NodeType   NodeType;
+#define X(name, unused) NODE_TYPE_##name,
+    NODES
+#undef X
+};
+typedef enum NodeType NodeType;
+
+enum {
+#define X(name, unused) +1
+    NODE_TYPE_COUNT = 0 NODES
+#undef X
+};
+
+char const *node_type_str(NodeType type);
 
 typedef struct NodeData NodeData;
 struct NodeData {
@@ -84,8 +192,18 @@ struct Node {
     NodeData data;
 };
 
+// Ordering invariants of Module.nodes, guaranteed by the parser:
+//
+// 1. Children are inserted before their parent, so every child has a smaller
+//    Index than its parent. A forward sweep over the nodes sees all children
+//    of a node before the node itself.
+// 2. The subtree of a node is contiguous and ends with the node itself, the
+//    nodes are stored in post order. See flat_subtree_begin.
+// 3. The children of a block are in source order, the same is true for the
+//    top level nodes.
 typedef struct Module Module;
 struct Module {
+    // Given by `module name` at the start of the file, main without it
     str name;
     struct {
         usz   capacity;
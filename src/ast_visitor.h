@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include "ast.h"
+#include "ast_walker.h"
+#include "common.h"
+
+// ================
+// -- ast visitor --
+// Generates a visitor that only dispatches on the node types it handles. The
+// node types are given as a list in the same format as NODES, with an extra
+// context argument:
+//
+//     #define COUNT_NODES(X, ctx) X(ctx, BLOCK, block) X(ctx, EOF, eof)
+//     AST_VISITOR(count, CountData, COUNT_NODES)
+//
+// For every listed node type a handler named <name>_<lower> has to exist:
+//
+//     bool count_block(CountData *data, Module *m, Index node_index,
+//                      Node *node);
+//
+// The handlers return if the children of the node should be visited. They
+// are called directly, so they can be inlined, and unlisted node types don't
+// generate any code. AST_VISITOR defines:
+//
+//     // Dispatches a single node.
+//     bool <name>_visit(data_type *data, Module *m, Index node_index);
+//     // Visits all top level nodes and their children in pre order.
+//     void <name>_walk(data_type *data, Module *m, Arena *arena);
+// ================
+
+#define AST_VISITOR_CASE(name, upper, lower) \
+    case NODE_TYPE_##upper:                  \
+        return name##_##lower(data, m, node_index, node);
+
+#define AST_VISITOR(name, data_type, list)                                   \
+    static inline bool name##_visit(data_type *data, Module *m,              \
+                                    Index node_index) {                      \
+        Node *node = &m->nodes.items[node_index];                            \
+        switch (node->type) {                                                \
+            list(AST_VISITOR_CASE, name)                                     \
+            default:                                                         \
+                return true;                                                 \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    static inline void name##_walk(data_type *data, Module *m,               \
+                                   Arena *arena) {                           \
+        AstIterator it;                                                      \
+        AstVisit    visit;                                                   \
+        ast_iterator_init(&it, m, arena, AST_VISIT_PRE);                     \
+        ast_iterator_push_top_level(&it);                                    \
+        while (ast_iterator_next(&it, &visit)) {                             \
+            if (!name##_visit(data, m, visit.node)) {                        \
+                ast_iterator_skip_children(&it);                             \
+            }                                                                \
+        }                                                                    \
+    }
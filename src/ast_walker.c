@@ -1,89 +1,336 @@
 #include "ast_walker.h"
+#include <assert.h>
+#include <string.h>
 #include "ast.h"
+#include "common.h"
 #include "lexer.h"
 
 #define SAFE_CALLBACK_CALL(function, ...) \
     ((function) != NULL) ? (function)(__VA_ARGS__) : true
 
-void ast_walker_walk_block(AstWalker *aw, Node *node) {
-    Index      ed_idx = node->data.lhs;
-    BlockData *bd     = &aw->m->extra_data.items[ed_idx].data.block;
-    Block      block  = {.main_token = node->main_token, .bd = bd};
-    bool continue_    = SAFE_CALLBACK_CALL(aw->block, aw->user_data, aw, block);
+void ast_iterator_init(AstIterator *it, Module *m, Arena *arena, u32 orders) {
+    *it = (AstIterator){
+        .m      = m,
+        .arena  = arena,
+        .orders = orders,
+        .stack  = {0},
+    };
+}
 
-    if (!continue_) {
-        return;
+void ast_iterator_stack_push(AstIterator *it, Index node) {
+    if (it->stack.count == it->stack.capacity) {
+        usz capacity = it->stack.capacity == 0 ? 64 : it->stack.capacity * 2;
+        AstIteratorEntry *items =
+            arena_alloc(it->arena, capacity * sizeof(AstIteratorEntry));
+        if (it->stack.count > 0) {
+            memcpy(items, it->stack.items,
+                   it->stack.count * sizeof(AstIteratorEntry));
+        }
+        it->stack.items    = items;
+        it->stack.capacity = capacity;
     }
 
-    for (usz i = 0; i < bd->count; i++) {
-        Node *block_node = &aw->m->nodes.items[bd->items[i]];
-        ast_walker_walk_node(aw, block_node);
+    it->stack.items[it->stack.count++] =
+        (AstIteratorEntry){.node = node, .state = AST_ITERATOR_ENTRY_NEW};
+}
+
+void ast_iterator_push(AstIterator *it, Index node) {
+    ast_iterator_stack_push(it, node);
+}
+
+void ast_iterator_push_top_level(AstIterator *it) {
+    for (usz i = it->m->top_level_nodes.count; i > 0; i--) {
+        ast_iterator_stack_push(it, it->m->top_level_nodes.items[i - 1]);
     }
 }
-void ast_walker_walk_function_definition(AstWalker *aw, Node *node) {
+
+// Pushes the children in reverse, so they are popped in source order.
+void ast_iterator_push_children(AstIterator *it, Node *node) {
+    switch (node->type) {
+        case NODE_TYPE_BLOCK: {
+            BlockData *bd = &it->m->extra_data.items[node->data.lhs].data.block;
+            for (usz i = bd->count; i > 0; i--) {
+                ast_iterator_stack_push(it, bd->items[i - 1]);
+            }
+            return;
+        }
+        case NODE_TYPE_BINARY_OPERATION:
+            ast_iterator_stack_push(it, node->data.rhs);
+            ast_iterator_stack_push(it, node->data.lhs);
+            return;
+        case NODE_TYPE_CALL: {
+            CallData *cd = &it->m->extra_data.items[node->data.lhs].data.call;
+            for (usz i = cd->count; i > 0; i--) {
+                ast_iterator_stack_push(it, cd->items[i - 1]);
+            }
+            return;
+        }
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR: {
+            LoopData *ld = &it->m->extra_data.items[node->data.lhs].data.loop;
+            ast_iterator_stack_push(it, node->data.rhs);
+            if (node->type == NODE_TYPE_FOR) {
+                ast_iterator_stack_push(it, ld->rhs);
+            }
+            ast_iterator_stack_push(it, ld->lhs);
+            return;
+        }
+        case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_RETURN:
+            ast_iterator_stack_push(it, node->data.rhs);
+            return;
+        case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_IMPORT:
+        case NODE_TYPE_EOF:
+            return;
+    }
+}
+
+bool ast_iterator_next(AstIterator *it, AstVisit *out) {
+    while (it->stack.count > 0) {
+        AstIteratorEntry *entry = &it->stack.items[it->stack.count - 1];
+
+        switch (entry->state) {
+            case AST_ITERATOR_ENTRY_NEW:
+                entry->state = AST_ITERATOR_ENTRY_VISITED;
+                if (it->orders & AST_VISIT_PRE) {
+                    *out = (AstVisit){.node  = entry->node,
+                                      .order = AST_VISIT_PRE};
+                    return true;
+                }
+                break;
+            case AST_ITERATOR_ENTRY_VISITED:
+                entry->state = AST_ITERATOR_ENTRY_EXPANDED;
+                // Pushing may move the stack, entry is invalid afterwards.
+                ast_iterator_push_children(it,
+                                           &it->m->nodes.items[entry->node]);
+                break;
+            case AST_ITERATOR_ENTRY_EXPANDED:
+                it->stack.count -= 1;
+                if (it->orders & AST_VISIT_POST) {
+                    *out = (AstVisit){.node  = entry->node,
+                                      .order = AST_VISIT_POST};
+                    return true;
+                }
+                break;
+        }
+    }
+
+    return false;
+}
+
+void ast_iterator_skip_children(AstIterator *it) {
+    assert(it->stack.count > 0);
+    assert(it->stack.items[it->stack.count - 1].state ==
+           AST_ITERATOR_ENTRY_VISITED);
+    it->stack.count -= 1;
+}
+
+AstNodeBatches ast_node_batches(Module *m, Arena *arena) {
+    AstNodeBatches batches = {0};
+
+    for (usz i = 0; i < m->nodes.count; i++) {
+        batches.counts[m->nodes.items[i].type] += 1;
+    }
+
+    usz filled[NODE_TYPE_COUNT] = {0};
+    for (usz type = 0; type < NODE_TYPE_COUNT; type++) {
+        batches.nodes[type] =
+            arena_alloc(arena, batches.counts[type] * sizeof(Index));
+    }
+
+    for (usz i = 0; i < m->nodes.count; i++) {
+        NodeType type                       = m->nodes.items[i].type;
+        batches.nodes[type][filled[type]++] = i;
+    }
+
+    return batches;
+}
+
+bool ast_walker_visit_block(AstWalker *aw, Node *node) {
+    Index      ed_idx = node->data.lhs;
+    BlockData *bd     = &aw->m->extra_data.items[ed_idx].data.block;
+    Block      block  = {.main_token = node->main_token, .bd = bd};
+    return SAFE_CALLBACK_CALL(aw->block, aw->user_data, aw, block);
+}
+bool ast_walker_visit_function_definition(AstWalker *aw, Node *node) {
     Index                  ed_idx = node->data.lhs;
     FunctionPrototypeData *fpd =
         &aw->m->extra_data.items[ed_idx].data.function_prototype;
     FunctionDefinition fd = {
         .block = node->data.rhs, .main_token = node->main_token, .fpd = fpd};
-    bool continue_ =
-        SAFE_CALLBACK_CALL(aw->function_definition, aw->user_data, aw, fd);
-
-    if (!continue_) {
-        return;
-    }
+    return SAFE_CALLBACK_CALL(aw->function_definition, aw->user_data, aw, fd);
+}
+bool ast_walker_visit_integer_literal(AstWalker *aw, Node *node) {
+    u64 literal =
+        extra_data_integer(aw->t, aw->t->tokens[node->main_token].extra_data);
+    IntegerLiteral il = {.integer = literal, .main_token = node->main_token};
 
-    Node *block_node = &aw->m->nodes.items[node->data.rhs];
-    ast_walker_walk_block(aw, block_node);
+    return SAFE_CALLBACK_CALL(aw->integer_literal, aw->user_data, aw, il);
 }
-void ast_walker_walk_integer(AstWalker *aw, Node *node) {
-    TokenExtraData *ted     = &aw->t->extra_data.data[node->main_token];
-    int             literal = ted->data.integer;
-    IntegerLiteral  il = {.integer = literal, .main_token = node->main_token};
+bool ast_walker_visit_float_literal(AstWalker *aw, Node *node) {
+    f64 literal =
+        extra_data_float(aw->t, aw->t->tokens[node->main_token].extra_data);
+    FloatLiteral fl = {.floating = literal, .main_token = node->main_token};
 
-    SAFE_CALLBACK_CALL(aw->integer_literal, aw->user_data, aw, il);
+    return SAFE_CALLBACK_CALL(aw->float_literal, aw->user_data, aw, fl);
 }
-void ast_walker_walk_variable_declaration(AstWalker *aw, Node *node) {
+bool ast_walker_visit_identifier(AstWalker *aw, Node *node) {
+    Identifier identifier = {.main_token = node->main_token};
+    return SAFE_CALLBACK_CALL(aw->identifier, aw->user_data, aw, identifier);
+}
+bool ast_walker_visit_binary_operation(AstWalker *aw, Node *node) {
+    BinaryOperation bo = {.main_token = node->main_token,
+                          .lhs        = node->data.lhs,
+                          .rhs        = node->data.rhs};
+    return SAFE_CALLBACK_CALL(aw->binary_operation, aw->user_data, aw, bo);
+}
+bool ast_walker_visit_call(AstWalker *aw, Node *node) {
+    Call call = {.main_token = node->main_token,
+                 .cd = &aw->m->extra_data.items[node->data.lhs].data.call};
+    return SAFE_CALLBACK_CALL(aw->call, aw->user_data, aw, call);
+}
+bool ast_walker_visit_variable_declaration(AstWalker *aw, Node *node) {
     VariableDeclaration vd = {.main_token = node->main_token,
                               .type       = node->data.lhs,
                               .expr       = node->data.rhs};
-    bool                continue_ =
-        SAFE_CALLBACK_CALL(aw->variable_declaration, aw->user_data, aw, vd);
-
-    if (!continue_) {
-        return;
-    }
-
-    Node *expr_node = &aw->m->nodes.items[node->data.rhs];
-    ast_walker_walk_node(aw, expr_node);
+    return SAFE_CALLBACK_CALL(aw->variable_declaration, aw->user_data, aw, vd);
 }
-void ast_walker_walk_eof(AstWalker *aw, Node *node) {
+bool ast_walker_visit_comptime_declaration(AstWalker *aw, Node *node) {
+    ComptimeDeclaration cd = {.main_token = node->main_token,
+                              .type       = node->data.lhs,
+                              .expr       = node->data.rhs};
+    return SAFE_CALLBACK_CALL(aw->comptime_declaration, aw->user_data, aw, cd);
+}
+bool ast_walker_visit_assignment(AstWalker *aw, Node *node) {
+    Assignment assignment = {.main_token = node->main_token,
+                             .expr       = node->data.rhs};
+    return SAFE_CALLBACK_CALL(aw->assignment, aw->user_data, aw, assignment);
+}
+bool ast_walker_visit_while(AstWalker *aw, Node *node) {
+    While while_ = {.main_token = node->main_token,
+                    .ld    = &aw->m->extra_data.items[node->data.lhs].data.loop,
+                    .block = node->data.rhs};
+    return SAFE_CALLBACK_CALL(aw->while_, aw->user_data, aw, while_);
+}
+bool ast_walker_visit_for(AstWalker *aw, Node *node) {
+    For for_ = {.main_token = node->main_token,
+                .ld         = &aw->m->extra_data.items[node->data.lhs].data.loop,
+                .block      = node->data.rhs};
+    return SAFE_CALLBACK_CALL(aw->for_, aw->user_data, aw, for_);
+}
+bool ast_walker_visit_return(AstWalker *aw, Node *node) {
+    Return ret = {.main_token = node->main_token, .expr = node->data.rhs};
+    return SAFE_CALLBACK_CALL(aw->return_, aw->user_data, aw, ret);
+}
+bool ast_walker_visit_import(AstWalker *aw, Node *node) {
+    Import import = {.main_token = node->main_token};
+    return SAFE_CALLBACK_CALL(aw->import, aw->user_data, aw, import);
+}
+bool ast_walker_visit_eof(AstWalker *aw, Node *node) {
     Eof eof = {.main_token = node->main_token};
 
-    SAFE_CALLBACK_CALL(aw->eof, aw->user_data, aw, eof);
+    return SAFE_CALLBACK_CALL(aw->eof, aw->user_data, aw, eof);
 }
 
-void ast_walker_walk_node(AstWalker *aw, Node *node) {
+// Calls the callback of the node, returns if the children should be walked.
+bool ast_walker_visit(AstWalker *aw, Node *node) {
     switch (node->type) {
+#define X(upper, lower) \
+    case NODE_TYPE_##upper: \
+        return ast_walker_visit_##lower(aw, node);
+        NODES
+#undef X
+    }
+    return true;
+}
 
-        case NODE_TYPE_BLOCK:
-            ast_walker_walk_block(aw, node);
-            return;
-        case NODE_TYPE_FUNCTION_DEFINITION:
-            ast_walker_walk_function_definition(aw, node);
-            return;
-        case NODE_TYPE_INTEGER_LITERAL:
-            ast_walker_walk_integer(aw, node);
-            break;
-        case NODE_TYPE_VARIABLE_DECLARATION:
-            ast_walker_walk_variable_declaration(aw, node);
-            break;
-        case NODE_TYPE_EOF:
-            ast_walker_walk_eof(aw, node);
-            break;
+void ast_walker_walk_iterator(AstWalker *aw, AstIterator *it) {
+    AstVisit visit;
+    while (ast_iterator_next(it, &visit)) {
+        if (!ast_walker_visit(aw, &aw->m->nodes.items[visit.node])) {
+            ast_iterator_skip_children(it);
+        }
     }
 }
 
+void ast_walker_walk_node(AstWalker *aw, Node *node) {
+    Arena       arena = {0};
+    AstIterator it;
+    ast_iterator_init(&it, aw->m, &arena, AST_VISIT_PRE);
+    ast_iterator_push(&it, node - aw->m->nodes.items);
+
+    ast_walker_walk_iterator(aw, &it);
+
+    arena_destroy(&arena);
+}
+
+void ast_walker_walk_block(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_BLOCK);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_function_definition(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_FUNCTION_DEFINITION);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_integer(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_INTEGER_LITERAL);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_float(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_FLOAT_LITERAL);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_identifier(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_IDENTIFIER);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_binary_operation(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_BINARY_OPERATION);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_call(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_CALL);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_variable_declaration(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_VARIABLE_DECLARATION);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_comptime_declaration(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_COMPTIME_DECLARATION);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_assignment(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_ASSIGNMENT);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_while(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_WHILE);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_for(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_FOR);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_return(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_RETURN);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_import(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_IMPORT);
+    ast_walker_walk_node(aw, node);
+}
+void ast_walker_walk_eof(AstWalker *aw, Node *node) {
+    assert(node->type == NODE_TYPE_EOF);
+    ast_walker_walk_node(aw, node);
+}
+
 void ast_walker_walk_top_level_node(AstWalker *aw, usz top_level_node) {
     Index node_idx = aw->m->top_level_nodes.items[top_level_node];
     Node *node     = &aw->m->nodes.items[node_idx];
@@ -92,7 +339,12 @@ void ast_walker_walk_top_level_node(AstWalker *aw, usz top_level_node) {
 }
 
 void ast_walker_walk(AstWalker *aw) {
-    for (usz i = 0; i < aw->m->top_level_nodes.count; i++) {
-        ast_walker_walk_top_level_node(aw, i);
-    }
+    Arena       arena = {0};
+    AstIterator it;
+    ast_iterator_init(&it, aw->m, &arena, AST_VISIT_PRE);
+    ast_iterator_push_top_level(&it);
+
+    ast_walker_walk_iterator(aw, &it);
+
+    arena_destroy(&arena);
 }
@@ -29,13 +29,54 @@ typedef bool (*ast_walker_function_definiton_callback)(void              *data,
 typedef struct IntegerLiteral IntegerLiteral;
 struct IntegerLiteral {
     Index main_token;
-    int   integer;
+    u64   integer;
 };
 
 typedef bool (*ast_walker_integer_literal_callback)(void             *data,
                                                     struct AstWalker *awd,
                                                     IntegerLiteral    il);
 
+typedef struct FloatLiteral FloatLiteral;
+struct FloatLiteral {
+    Index main_token;
+    f64   floating;
+};
+
+typedef bool (*ast_walker_float_literal_callback)(void             *data,
+                                                  struct AstWalker *awd,
+                                                  FloatLiteral      fl);
+
+typedef struct Identifier Identifier;
+struct Identifier {
+    Index main_token;
+};
+
+typedef bool (*ast_walker_identifier_callback)(void             *data,
+                                               struct AstWalker *awd,
+                                               Identifier        identifier);
+
+typedef struct BinaryOperation BinaryOperation;
+struct BinaryOperation {
+    // The operator
+    Index main_token;
+    Index lhs;
+    Index rhs;
+};
+
+typedef bool (*ast_walker_binary_operation_callback)(void             *data,
+                                                     struct AstWalker *awd,
+                                                     BinaryOperation   bo);
+
+typedef struct Call Call;
+struct Call {
+    // The name of the function
+    Index     main_token;
+    CallData *cd;
+};
+
+typedef bool (*ast_walker_call_callback)(void *data, struct AstWalker *awd,
+                                         Call call);
+
 typedef struct VariableDeclaration VariableDeclaration;
 struct VariableDeclaration {
     Index main_token;
@@ -46,6 +87,65 @@ struct VariableDeclaration {
 typedef bool (*ast_walker_variable_declaration_callback)(
     void *data, struct AstWalker *awd, VariableDeclaration vd);
 
+typedef struct ComptimeDeclaration ComptimeDeclaration;
+struct ComptimeDeclaration {
+    Index main_token;
+    Index type;
+    Index expr;
+};
+
+typedef bool (*ast_walker_comptime_declaration_callback)(
+    void *data, struct AstWalker *awd, ComptimeDeclaration cd);
+
+typedef struct Assignment Assignment;
+struct Assignment {
+    Index main_token;
+    Index expr;
+};
+
+typedef bool (*ast_walker_assignment_callback)(void *data, struct AstWalker *awd,
+                                               Assignment assignment);
+
+typedef struct While While;
+struct While {
+    // The while keyword
+    Index     main_token;
+    LoopData *ld;
+    Index     block;
+};
+
+typedef bool (*ast_walker_while_callback)(void *data, struct AstWalker *awd,
+                                          While while_);
+
+typedef struct For For;
+struct For {
+    // The name of the variable
+    Index     main_token;
+    LoopData *ld;
+    Index     block;
+};
+
+typedef bool (*ast_walker_for_callback)(void *data, struct AstWalker *awd,
+                                        For for_);
+
+typedef struct Return Return;
+struct Return {
+    Index main_token;
+    Index expr;
+};
+
+typedef bool (*ast_walker_return_callback)(void *data, struct AstWalker *awd,
+                                           Return ret);
+
+typedef struct Import Import;
+struct Import {
+    // The name of the module
+    Index main_token;
+};
+
+typedef bool (*ast_walker_import_callback)(void *data, struct AstWalker *awd,
+                                           Import import);
+
 typedef struct Eof Eof;
 struct Eof {
     Index main_token;
@@ -59,7 +159,17 @@ struct AstWalker {
     ast_walker_block_callback                block;
     ast_walker_function_definiton_callback   function_definition;
     ast_walker_integer_literal_callback      integer_literal;
+    ast_walker_float_literal_callback        float_literal;
+    ast_walker_identifier_callback           identifier;
+    ast_walker_binary_operation_callback     binary_operation;
+    ast_walker_call_callback                 call;
     ast_walker_variable_declaration_callback variable_declaration;
+    ast_walker_comptime_declaration_callback comptime_declaration;
+    ast_walker_assignment_callback           assignment;
+    ast_walker_while_callback                while_;
+    ast_walker_for_callback                  for_;
+    ast_walker_return_callback               return_;
+    ast_walker_import_callback               import;
     ast_walker_eof_callback                  eof;
 
     Module                                  *m;
@@ -68,11 +178,93 @@ struct AstWalker {
     void                                    *user_data;
 };
 
+// The walker is iterative, so it does not use the native stack for nesting.
 void ast_walker_walk(AstWalker *aw);
 void ast_walker_walk_top_level_node(AstWalker *aw, usz top_level_node);
 void ast_walker_walk_node(AstWalker *aw, Node *node);
 void ast_walker_walk_block(AstWalker *aw, Node *node);
 void ast_walker_walk_function_definition(AstWalker *aw, Node *node);
 void ast_walker_walk_integer(AstWalker *aw, Node *node);
+void ast_walker_walk_float(AstWalker *aw, Node *node);
+void ast_walker_walk_identifier(AstWalker *aw, Node *node);
+void ast_walker_walk_binary_operation(AstWalker *aw, Node *node);
+void ast_walker_walk_call(AstWalker *aw, Node *node);
 void ast_walker_walk_variable_declaration(AstWalker *aw, Node *node);
+void ast_walker_walk_comptime_declaration(AstWalker *aw, Node *node);
+void ast_walker_walk_assignment(AstWalker *aw, Node *node);
+void ast_walker_walk_while(AstWalker *aw, Node *node);
+void ast_walker_walk_for(AstWalker *aw, Node *node);
+void ast_walker_walk_return(AstWalker *aw, Node *node);
+void ast_walker_walk_import(AstWalker *aw, Node *node);
 void ast_walker_walk_eof(AstWalker *aw, Node *node);
+
+enum AstVisitOrder {
+    // The node is visited before its children
+    AST_VISIT_PRE  = 1 << 0,
+    // The node is visited after its children
+    AST_VISIT_POST = 1 << 1,
+};
+typedef enum AstVisitOrder AstVisitOrder;
+
+typedef struct AstVisit    AstVisit;
+struct AstVisit {
+    Index         node;
+    AstVisitOrder order;
+};
+
+enum AstIteratorEntryState {
+    AST_ITERATOR_ENTRY_NEW,
+    // The pre visit was returned, the children are pushed on the next call.
+    AST_ITERATOR_ENTRY_VISITED,
+    AST_ITERATOR_ENTRY_EXPANDED,
+};
+typedef enum AstIteratorEntryState AstIteratorEntryState;
+
+typedef struct AstIteratorEntry    AstIteratorEntry;
+struct AstIteratorEntry {
+    Index                 node;
+    AstIteratorEntryState state;
+};
+
+// Walks the ast depth first with an explicit stack allocated in the arena, so
+// deep nesting does not overflow the native stack. Instead of calling
+// callbacks, every visit is returned by ast_iterator_next:
+//
+//     AstVisit visit;
+//     while (ast_iterator_next(&it, &visit)) {
+//         switch (it.m->nodes.items[visit.node].type) { ... }
+//     }
+typedef struct AstIterator AstIterator;
+struct AstIterator {
+    Module *m;
+    Arena  *arena;
+    // Bitset of AstVisitOrder
+    u32     orders;
+    struct {
+        usz               count;
+        usz               capacity;
+        AstIteratorEntry *items;
+    } stack;
+};
+
+void ast_iterator_init(AstIterator *it, Module *m, Arena *arena, u32 orders);
+// Pushes a root node, roots are walked in the reverse order of pushing.
+void ast_iterator_push(AstIterator *it, Index node);
+// Pushes all top level nodes, so they are walked in source order.
+void ast_iterator_push_top_level(AstIterator *it);
+bool ast_iterator_next(AstIterator *it, AstVisit *out);
+// Only valid directly after a pre visit, the children and the post visit of
+// that node are skipped.
+void ast_iterator_skip_children(AstIterator *it);
+
+// All nodes of the module grouped by their type. The nodes of a type are
+// contiguous and in module order, so a pass can handle one node type at a
+// time.
+typedef struct AstNodeBatches AstNodeBatches;
+struct AstNodeBatches {
+    Index *nodes[NODE_TYPE_COUNT];
+    usz    counts[NODE_TYPE_COUNT];
+};
+
+// The batches are allocated in the arena.
+AstNodeBatches ast_node_batches(Module *m, Arena *arena);
@@ -0,0 +1,455 @@
+#define _POSIX_C_SOURCE 200809L
+#include "build.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "common.h"
+#include "da.h"
+#include "interface.h"
+#include "lexer.h"
+
+// Changing what the key hashes requires a new version, so the stamps of older
+// builds do not match anymore.
+#define BUILD_VERSION "thor-build-1"
+
+typedef u64 BuildKey;
+
+// Hashes the length before the bytes, so `ab c` and `a bc` differ.
+BuildKey build_hash_str(BuildKey hash, str s) {
+    u64 len = s.len;
+    hash    = hash_fnv1a(hash, &len, sizeof(len));
+    return hash_fnv1a(hash, s.ptr, s.len);
+}
+
+// Replaces the extension of the path, main.th becomes main.<extension>.
+char *build_path_with_extension(char const *path, char const *extension) {
+    char const *dot   = strrchr(path, '.');
+    char const *slash = strrchr(path, '/');
+    usz         len   = dot != NULL && (slash == NULL || dot > slash)
+                          ? (usz)(dot - path)
+                          : strlen(path);
+    str   path_str    = str_format("%.*s.%s", (int)len, path, extension);
+    char *result      = to_cstr(path_str);
+    str_destroy(path_str);
+    return result;
+}
+
+char *build_path_in_directory(char const *path, char const *name,
+                              char const *extension) {
+    str   dir      = path_directory(path);
+    str   path_str = str_format("%.*s/%s.%s", (int)dir.len, dir.ptr, name,
+                                extension);
+    char *result   = to_cstr(path_str);
+    str_destroy(path_str);
+    str_destroy(dir);
+    return result;
+}
+
+// Reads the module declaration and the imports from the tokens, the file is
+// only parsed when it is compiled, which also reports its errors.
+bool build_module_scan(BuildModule *module) {
+    str source;
+    if (!read_file(module->path, &source)) {
+        log_error("could not read %s", module->path);
+        return false;
+    }
+    Lexer l = lexer_create(source, NULL);
+    str_destroy(source);
+    Tokens t = lexer_lex_tokens(&l);
+
+    bool first      = true;
+    bool line_start = true;
+    for (usz i = 0; i < t.len; i++) {
+        TokenType type = t.tokens[i].type;
+        if (type == TOKEN_TYPE_NONE) {
+            continue;
+        }
+        if (type == TOKEN_TYPE_EOL) {
+            line_start = true;
+            continue;
+        }
+        bool identifier = i + 1 < t.len &&
+                          t.tokens[i + 1].type == TOKEN_TYPE_IDENTIFIER;
+        if (first && type == TOKEN_TYPE_MODULE && identifier) {
+            module->name = tokens_token_cstr(l.input, &t, i + 1);
+        } else if (line_start && type == TOKEN_TYPE_IMPORT && identifier) {
+            da_append(&module->imports, tokens_token_cstr(l.input, &t, i + 1));
+        }
+        first      = false;
+        line_start = false;
+    }
+    if (module->name == NULL) {
+        module->name = to_cstr((str){.ptr = "main", .len = 4});
+    }
+
+    tokens_destroy(t);
+    lexer_destroy(l);
+    return true;
+}
+
+isz build_graph_find(BuildGraph *graph, char const *name, char const *path) {
+    for (usz i = 0; i < graph->modules.count; i++) {
+        BuildModule *module = &graph->modules.items[i];
+        if ((name != NULL && module->name != NULL &&
+             strcmp(module->name, name) == 0) ||
+            (path != NULL && strcmp(module->path, path) == 0)) {
+            return (isz)i;
+        }
+    }
+    return -1;
+}
+
+void build_graph_add(BuildGraph *graph, char *path,
+                     char const *output_extension) {
+    BuildModule module = {
+        .path   = path,
+        .output = build_path_with_extension(path, output_extension),
+        .stamp  = build_path_with_extension(path, BUILD_STAMP_EXTENSION),
+    };
+    da_append(&graph->modules, module);
+}
+
+// Adds the dependencies and dependents of every module, the imports that are
+// not in the graph stay imports of interfaces.
+bool build_graph_link(BuildGraph *graph) {
+    for (usz i = 0; i < graph->modules.count; i++) {
+        BuildModule *module = &graph->modules.items[i];
+        for (usz j = 0; j < module->imports.count; j++) {
+            char const *name       = module->imports.items[j];
+            isz         dependency = build_graph_find(graph, name, NULL);
+            if (dependency == -1) {
+                char *path = build_path_in_directory(
+                    module->path, name, BUILD_SOURCE_EXTENSION);
+                isz other = build_graph_find(graph, NULL, path);
+                free(path);
+                if (other != -1) {
+                    BuildModule *imported = &graph->modules.items[other];
+                    log_error("%s is imported as %s, but declares the module "
+                              "%s",
+                              imported->path, name, imported->name);
+                    return false;
+                }
+                continue;
+            }
+            da_append(&module->dependencies, (usz)dependency);
+            da_append(&graph->modules.items[dependency].dependents, i);
+        }
+    }
+    return true;
+}
+
+// Removes the modules without imports of the graph until none are left, the
+// modules that remain import each other.
+bool build_graph_check_cycles(BuildGraph *graph) {
+    usz  count     = graph->modules.count;
+    usz *remaining = calloc(count, sizeof(usz));
+    struct {
+        usz  count;
+        usz  capacity;
+        usz *items;
+    } ready = {0};
+    for (usz i = 0; i < count; i++) {
+        remaining[i] = graph->modules.items[i].dependencies.count;
+        if (remaining[i] == 0) {
+            da_append(&ready, i);
+        }
+    }
+
+    usz removed = 0;
+    while (ready.count > 0) {
+        BuildModule *module = &graph->modules.items[ready.items[--ready.count]];
+        removed += 1;
+        for (usz i = 0; i < module->dependents.count; i++) {
+            usz dependent = module->dependents.items[i];
+            if (--remaining[dependent] == 0) {
+                da_append(&ready, dependent);
+            }
+        }
+    }
+
+    // A module that remains imports one that remains, after count steps
+    // along those imports the walk is inside a cycle.
+    bool ok = removed == count;
+    for (usz i = 0; !ok && i < count; i++) {
+        if (remaining[i] == 0) {
+            continue;
+        }
+        usz cycle = i;
+        for (usz step = 0; step < count; step++) {
+            BuildModule *module = &graph->modules.items[cycle];
+            for (usz j = 0; j < module->dependencies.count; j++) {
+                if (remaining[module->dependencies.items[j]] > 0) {
+                    cycle = module->dependencies.items[j];
+                    break;
+                }
+            }
+        }
+        log_error("the imports of %s form a cycle",
+                  graph->modules.items[cycle].path);
+        break;
+    }
+    da_destroy(&ready);
+    free(remaining);
+    return ok;
+}
+
+bool build_graph_scan(BuildGraph *graph, char const *const *inputs,
+                      usz input_count, char const *output_extension) {
+    for (usz i = 0; i < input_count; i++) {
+        if (build_graph_find(graph, NULL, inputs[i]) == -1) {
+            build_graph_add(graph, to_cstr((str){.ptr = (char *)inputs[i],
+                                                 .len = strlen(inputs[i])}),
+                            output_extension);
+        }
+    }
+
+    // The graph grows while it is scanned, the imported files are scanned
+    // after the inputs.
+    for (usz i = 0; i < graph->modules.count; i++) {
+        if (!build_module_scan(&graph->modules.items[i])) {
+            return false;
+        }
+        BuildModule *module = &graph->modules.items[i];
+        for (usz j = 0; j < i; j++) {
+            if (strcmp(graph->modules.items[j].name, module->name) == 0) {
+                log_error("%s and %s both declare the module %s",
+                          graph->modules.items[j].path, module->path,
+                          module->name);
+                return false;
+            }
+        }
+        if (strcmp(module->name, "main") != 0) {
+            module->interface = build_path_in_directory(
+                module->path, module->name, INTERFACE_EXTENSION);
+        }
+
+        for (usz j = 0; j < module->imports.count; j++) {
+            char const *name = module->imports.items[j];
+            if (build_graph_find(graph, name, NULL) != -1) {
+                continue;
+            }
+            char *path = build_path_in_directory(module->path, name,
+                                                 BUILD_SOURCE_EXTENSION);
+            if (build_graph_find(graph, NULL, path) != -1 ||
+                access(path, F_OK) != 0) {
+                free(path);
+                continue;
+            }
+            build_graph_add(graph, path, output_extension);
+            // The array may have moved.
+            module = &graph->modules.items[i];
+        }
+    }
+
+    return build_graph_link(graph) && build_graph_check_cycles(graph);
+}
+
+void build_graph_destroy(BuildGraph *graph) {
+    for (usz i = 0; i < graph->modules.count; i++) {
+        BuildModule *module = &graph->modules.items[i];
+        for (usz j = 0; j < module->imports.count; j++) {
+            free(module->imports.items[j]);
+        }
+        da_destroy(&module->imports);
+        da_destroy(&module->dependencies);
+        da_destroy(&module->dependents);
+        free(module->name);
+        free(module->path);
+        free(module->output);
+        free(module->interface);
+        free(module->stamp);
+    }
+    da_destroy(&graph->modules);
+}
+
+typedef struct BuildRun BuildRun;
+
+// The task of a module, it is submitted by the last of its imports.
+typedef struct BuildJob BuildJob;
+struct BuildJob {
+    BuildRun     *run;
+    usz           module;
+    // The imports that are not built yet
+    _Atomic(usz)  pending;
+    _Atomic(bool) import_failed;
+};
+
+struct BuildRun {
+    BuildGraph     *graph;
+    ThreadPool     *pool;
+    ThreadPoolGroup group;
+    BuildJob       *jobs;
+    str             flags;
+    BuildCompile    compile;
+    void           *data;
+    _Atomic(usz)    compiled;
+    _Atomic(usz)    up_to_date;
+    _Atomic(usz)    failed;
+};
+
+// A missing interface is hashed as empty, the compilation of the importer
+// reports it.
+BuildKey build_hash_interface(BuildKey hash, char const *path) {
+    str bytes = {0};
+    if (path != NULL && read_file(path, &bytes)) {
+        hash = build_hash_str(hash, bytes);
+        str_destroy(bytes);
+        return hash;
+    }
+    return build_hash_str(hash, bytes);
+}
+
+// Hashes everything the output depends on. The interfaces of the imports of
+// the build are final because they are built before the module.
+bool build_module_key(BuildRun *run, BuildModule *module, BuildKey *out) {
+    str source;
+    if (!read_file(module->path, &source)) {
+        return false;
+    }
+    BuildKey key = hash_fnv1a(HASH_FNV1A_OFFSET_BASIS, BUILD_VERSION,
+                              sizeof(BUILD_VERSION));
+    key          = build_hash_str(key, run->flags);
+    key          = hash_fnv1a(key, module->output, strlen(module->output) + 1);
+    key          = build_hash_str(key, source);
+    str_destroy(source);
+
+    str   dir_str = path_directory(module->path);
+    char *dir     = to_cstr(dir_str);
+    str_destroy(dir_str);
+    for (usz i = 0; i < module->imports.count; i++) {
+        char const *name       = module->imports.items[i];
+        isz         dependency = build_graph_find(run->graph, name, NULL);
+        char       *found      = NULL;
+        char const *path       = NULL;
+        if (dependency != -1) {
+            path = run->graph->modules.items[dependency].interface;
+        } else {
+            found = interface_find((str){.ptr = (char *)name,
+                                         .len = strlen(name)},
+                                   dir, run->graph->interface_dirs,
+                                   run->graph->interface_dir_count);
+            path  = found;
+        }
+        key = hash_fnv1a(key, name, strlen(name) + 1);
+        key = build_hash_interface(key, path);
+        free(found);
+    }
+    free(dir);
+
+    *out = key;
+    return true;
+}
+
+str build_stamp_str(BuildKey key) {
+    return str_format("%016llx\n", (unsigned long long)key);
+}
+
+bool build_module_up_to_date(BuildModule *module, BuildKey key) {
+    str stamp;
+    if (!read_file(module->stamp, &stamp)) {
+        return false;
+    }
+    str  expected = build_stamp_str(key);
+    bool same     = str_equal(stamp, expected);
+    str_destroy(expected);
+    str_destroy(stamp);
+    return same && access(module->output, F_OK) == 0 &&
+           (module->interface == NULL ||
+            access(module->interface, F_OK) == 0);
+}
+
+// Without the stamp the module is compiled again by the next build.
+void build_module_write_stamp(BuildModule *module, BuildKey key) {
+    str   stamp = build_stamp_str(key);
+    FILE *file  = fopen(module->stamp, "wb");
+    bool  ok    = file != NULL &&
+              fwrite(stamp.ptr, 1, stamp.len, file) == stamp.len;
+    if (file != NULL) {
+        ok = fclose(file) == 0 && ok;
+    }
+    if (!ok) {
+        log_warning("could not write the stamp %s", module->stamp);
+        remove(module->stamp);
+    }
+    str_destroy(stamp);
+}
+
+void build_job_run(void *data) {
+    BuildJob    *job    = data;
+    BuildRun    *run    = job->run;
+    BuildModule *module = &run->graph->modules.items[job->module];
+
+    bool ok = true;
+    if (atomic_load(&job->import_failed)) {
+        log_error("%s is not compiled, because an import failed",
+                  module->path);
+        ok = false;
+    } else {
+        BuildKey key;
+        bool     has_key = build_module_key(run, module, &key);
+        if (has_key && build_module_up_to_date(module, key)) {
+            atomic_fetch_add(&run->up_to_date, 1);
+        } else {
+            remove(module->stamp);
+            ok = run->compile(module, run->data);
+            if (ok) {
+                atomic_fetch_add(&run->compiled, 1);
+            }
+            // The interfaces of the imports do not change during the build,
+            // only the source could have changed while it was compiled.
+            if (ok && has_key) {
+                build_module_write_stamp(module, key);
+            }
+        }
+    }
+    if (!ok) {
+        atomic_fetch_add(&run->failed, 1);
+    }
+
+    for (usz i = 0; i < module->dependents.count; i++) {
+        BuildJob *dependent = &run->jobs[module->dependents.items[i]];
+        if (!ok) {
+            atomic_store(&dependent->import_failed, true);
+        }
+        if (atomic_fetch_sub(&dependent->pending, 1) == 1) {
+            thread_pool_submit(run->pool, &run->group, build_job_run,
+                               dependent);
+        }
+    }
+}
+
+bool build_graph_run(BuildGraph *graph, ThreadPool *pool, str flags,
+                     BuildCompile compile, void *data, BuildStats *stats) {
+    usz      count = graph->modules.count;
+    BuildRun run   = {
+          .graph   = graph,
+          .pool    = pool,
+          .jobs    = calloc(count, sizeof(BuildJob)),
+          .flags   = flags,
+          .compile = compile,
+          .data    = data,
+    };
+    for (usz i = 0; i < count; i++) {
+        run.jobs[i].run    = &run;
+        run.jobs[i].module = i;
+        atomic_init(&run.jobs[i].pending,
+                    graph->modules.items[i].dependencies.count);
+        atomic_init(&run.jobs[i].import_failed, false);
+    }
+    for (usz i = 0; i < count; i++) {
+        if (graph->modules.items[i].dependencies.count == 0) {
+            thread_pool_submit(pool, &run.group, build_job_run, &run.jobs[i]);
+        }
+    }
+    thread_pool_wait(pool, &run.group);
+    free(run.jobs);
+
+    *stats = (BuildStats){
+        .compiled   = atomic_load(&run.compiled),
+        .up_to_date = atomic_load(&run.up_to_date),
+        .failed     = atomic_load(&run.failed),
+    };
+    return stats->failed == 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "common.h"
+
+// ================
+// -- build --
+// Builds a program of several modules in the order of their imports. The
+// imports of the inputs are followed to name.th next to the importing file,
+// so only the roots of the program have to be given.
+//
+// A module is compiled after the modules it imports, modules that do not
+// depend on each other are compiled in parallel. Its key hashes its source,
+// the flags of the compilation and the interfaces of its imports, and is
+// stored in a stamp file next to its output. A module with the same key as
+// in the last build is not compiled again. Because an interface file is only
+// rewritten if it changes, a change to the body of a function does not
+// rebuild the modules that import it.
+// ================
+
+#define BUILD_SOURCE_EXTENSION "th"
+#define BUILD_STAMP_EXTENSION  "thb"
+
+typedef struct BuildModule BuildModule;
+struct BuildModule {
+    // main for a file without a module declaration
+    char *name;
+    // The source
+    char *path;
+    // The output of the compilation, the source with the output extension
+    char *output;
+    // name.thi next to the source, NULL for main, which has no interface
+    char *interface;
+    // The output with the stamp extension
+    char *stamp;
+    // The names of the imports in the order of the source
+    struct {
+        usz    count;
+        usz    capacity;
+        char **items;
+    } imports;
+    // The imported modules of the build, imports that are not part of the
+    // build are read from the interface directories
+    struct {
+        usz  count;
+        usz  capacity;
+        usz *items;
+    } dependencies;
+    // The modules that import this one
+    struct {
+        usz  count;
+        usz  capacity;
+        usz *items;
+    } dependents;
+};
+
+typedef struct BuildGraph BuildGraph;
+struct BuildGraph {
+    struct {
+        usz          count;
+        usz          capacity;
+        BuildModule *items;
+    } modules;
+    // Searched for the interfaces of imports outside the build after the
+    // directory of the importing module
+    char const *const *interface_dirs;
+    usz                interface_dir_count;
+};
+
+// Compiles one module into its output and its interface, the errors are
+// reported by the callback. Called from the workers of the pool.
+typedef bool (*BuildCompile)(BuildModule const *module, void *data);
+
+typedef struct BuildStats BuildStats;
+struct BuildStats {
+    usz compiled;
+    // Modules with the same key as in the last build
+    usz up_to_date;
+    // Modules that failed and modules that were not compiled because one of
+    // their imports failed
+    usz failed;
+};
+
+// Scans the inputs and every module they import. Returns false and reports
+// the error if a file can not be read, two files declare the same module, an
+// imported file declares another module or the imports form a cycle.
+bool build_graph_scan(BuildGraph *graph, char const *const *inputs,
+                      usz input_count, char const *output_extension);
+void build_graph_destroy(BuildGraph *graph);
+
+// Compiles the modules that changed on the pool, flags are the options of the
+// compilation that change the output. Returns false if a module failed.
+bool build_graph_run(BuildGraph *graph, ThreadPool *pool, str flags,
+                     BuildCompile compile, void *data, BuildStats *stats);
@@ -0,0 +1,627 @@
+#include "bytecode.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "comptime.h"
+#include "da.h"
+#include "language.h"
+#include "lexer.h"
+#include "node_column.h"
+#include "uthash.h"
+
+#define BYTECODE_NO_INSTRUCTION ((Index)-1)
+
+typedef struct BytecodeCompiler BytecodeCompiler;
+struct BytecodeCompiler {
+    Module           *m;
+    ModuleAnalyse    *ma;
+    Tokens           *t;
+    str               input;
+    BytecodeProgram  *program;
+    // The first register of every argument, variable and loop variable,
+    // indexed by the symbol id
+    Index            *registers;
+    // The function index of every function, indexed by the symbol id
+    Index            *functions;
+    BytecodeFunction *function;
+    // Registers below are variables, the others are the temporaries of the
+    // current statement.
+    usz               variables;
+    usz               top;
+    // The instruction that wrote the whole result of the last expression
+    // into a new temporary, so it can write into a variable instead.
+    Index             retarget;
+    bool              ok;
+};
+
+usz bytecode_lanes(Type type) { return type_value_lanes(type); }
+
+Index bytecode_alloc(BytecodeCompiler *bc, usz lanes) {
+    Index reg = bc->top;
+    bc->top += lanes;
+    if (bc->top > BYTECODE_MAX_REGISTERS) {
+        if (bc->ok) {
+            log_error("%s needs more than %d registers", bc->function->name,
+                      BYTECODE_MAX_REGISTERS);
+        }
+        bc->ok  = false;
+        bc->top = 0;
+        return 0;
+    }
+    if (bc->top > bc->function->register_count) {
+        bc->function->register_count = bc->top;
+    }
+    return reg;
+}
+
+Index bytecode_emit(BytecodeCompiler *bc, BytecodeInstruction instruction) {
+    da_append(&bc->function->code, instruction);
+    return bc->function->code.count - 1;
+}
+
+// The type of the value of an expression, after its conversion.
+Type bytecode_value_type(BytecodeCompiler *bc, Index node_index) {
+    Type converted = node_column_get(&bc->ma->attributes.converted, node_index);
+    return converted.type != BUILTIN_TYPE_NONE
+               ? converted
+               : node_column_get(&bc->ma->attributes.type, node_index);
+}
+
+// Integer arithmetic wraps by shifting out the bits above the type.
+u8 bytecode_wrap_shift(Type type) {
+    return type_is_float(type) ? 0 : 64 - type_bits(type);
+}
+
+BytecodeSlot bytecode_slot(Type element, ComptimeLane lane) {
+    BytecodeSlot slot = {0};
+    if (type_is_float(element)) {
+        if (type_bits(element) == 32) {
+            slot.f32 = (f32)lane.real;
+        } else {
+            slot.f64 = lane.real;
+        }
+    } else if (type_kind(element) == BUILTIN_TYPE_KIND_SIGNED) {
+        u8 shift = bytecode_wrap_shift(element);
+        slot.i   = (i64)(lane.integer << shift) >> shift;
+    } else {
+        slot.u = lane.integer;
+    }
+    return slot;
+}
+
+// Loads a value into a new temporary.
+Index bytecode_constant(BytecodeCompiler *bc, ComptimeValue value) {
+    BytecodeProgram *program = bc->program;
+    Index            index   = program->constants.count;
+    usz              lanes   = bytecode_lanes(value.type);
+    for (usz i = 0; i < lanes; i++) {
+        da_append(&program->constants,
+                  bytecode_slot(type_element(value.type), value.lanes[i]));
+    }
+
+    Index reg    = bytecode_alloc(bc, lanes);
+    bc->retarget = bytecode_emit(bc, (BytecodeInstruction){
+                                         .op    = BYTECODE_OP_CONST,
+                                         .type  = value.type.type,
+                                         .lanes = lanes,
+                                         .dst   = reg,
+                                         .b     = index,
+                                     });
+    return reg;
+}
+
+// The implicit conversions of the analyse, they never lose a value.
+Index bytecode_convert(BytecodeCompiler *bc, Index reg, Type from, Type to) {
+    if (type_equal(from, to)) {
+        return reg;
+    }
+    if (!type_is_vector(from) && type_is_vector(to)) {
+        Index scalar = bytecode_convert(bc, reg, from, type_element(to));
+        Index vector = bytecode_alloc(bc, to.lanes);
+        bc->retarget = bytecode_emit(bc, (BytecodeInstruction){
+                                             .op    = BYTECODE_OP_SPLAT,
+                                             .type  = to.type,
+                                             .lanes = to.lanes,
+                                             .dst   = vector,
+                                             .a     = scalar,
+                                         });
+        return vector;
+    }
+
+    usz   lanes  = bytecode_lanes(to);
+    Index result = bytecode_alloc(bc, lanes);
+    bc->retarget = bytecode_emit(bc, (BytecodeInstruction){
+                                         .op    = BYTECODE_OP_CONVERT,
+                                         .type  = to.type,
+                                         .lanes = lanes,
+                                         .aux   = from.type,
+                                         .dst   = result,
+                                         .a     = reg,
+                                     });
+    return result;
+}
+
+// The ops of a kind follow each other in the order _U, _S, _F32, _F64, or _I,
+// _F32, _F64 for == and !=.
+BytecodeOp bytecode_binary_op(TokenType op, Type operand) {
+    usz kind = type_is_float(operand)
+                   ? (type_bits(operand) == 32 ? 2 : 3)
+                   : type_kind(operand) == BUILTIN_TYPE_KIND_SIGNED;
+    usz equality = kind == 0 ? 0 : kind - 1;
+    switch (op) {
+        case TOKEN_TYPE_PLUS:
+            return BYTECODE_OP_ADD_U + kind;
+        case TOKEN_TYPE_MINUS:
+            return BYTECODE_OP_SUB_U + kind;
+        case TOKEN_TYPE_ASTERISK:
+            return BYTECODE_OP_MUL_U + kind;
+        case TOKEN_TYPE_EQUAL_EQUAL:
+            return BYTECODE_OP_EQ_I + equality;
+        case TOKEN_TYPE_BANG_EQUAL:
+            return BYTECODE_OP_NE_I + equality;
+        case TOKEN_TYPE_LESS:
+            return BYTECODE_OP_LT_U + kind;
+        case TOKEN_TYPE_LESS_EQUAL:
+            return BYTECODE_OP_LE_U + kind;
+        case TOKEN_TYPE_GREATER:
+            return BYTECODE_OP_GT_U + kind;
+        case TOKEN_TYPE_GREATER_EQUAL:
+            return BYTECODE_OP_GE_U + kind;
+        default:
+            break;
+    }
+    UNREACHABLE("invalid binary operator");
+}
+
+Index bytecode_expression(BytecodeCompiler *bc, Index node_index);
+
+Index bytecode_binary_operation(BytecodeCompiler *bc, Node *node, Type type) {
+    Index lhs = bytecode_expression(bc, node->data.lhs);
+    Index rhs = bytecode_expression(bc, node->data.rhs);
+    // Both operands have the same type after their conversions.
+    Type  operand = bytecode_value_type(bc, node->data.lhs);
+    usz   lanes   = bytecode_lanes(operand);
+    Index result  = bytecode_alloc(bc, lanes);
+    bc->retarget  = bytecode_emit(
+        bc, (BytecodeInstruction){
+                .op    = bytecode_binary_op(
+                    bc->t->tokens[node->main_token].type, type_element(operand)),
+                .type  = type.type,
+                .lanes = lanes,
+                .aux   = bytecode_wrap_shift(operand),
+                .dst   = result,
+                .a     = lhs,
+                .b     = rhs,
+            });
+    return result;
+}
+
+void bytecode_move(BytecodeCompiler *bc, Index dst, Index src, usz lanes) {
+    bytecode_emit(bc, (BytecodeInstruction){
+                          .op    = BYTECODE_OP_MOVE,
+                          .lanes = lanes,
+                          .dst   = dst,
+                          .a     = src,
+                      });
+}
+
+// The analyse only allows integer literals as lanes.
+u64 bytecode_lane(BytecodeCompiler *bc, Index node_index) {
+    Node *node = &bc->m->nodes.items[node_index];
+    return extra_data_integer(bc->t,
+                              bc->t->tokens[node->main_token].extra_data);
+}
+
+// Builtins and vector constructors only move lanes around. extract returns
+// the register of the lane, the other calls build a new temporary.
+Index bytecode_builtin(BytecodeCompiler *bc, Node *node, Type type,
+                       Index *args) {
+    CallData *call = &bc->m->extra_data.items[node->data.lhs].data.call;
+    char     *name = tokens_token_cstr(bc->input, bc->t, node->main_token);
+    AnalyseBuiltin builtin = analyse_builtin_from_name(name);
+    free(name);
+
+    usz   lanes = bytecode_lanes(type);
+    Index result;
+    switch (builtin) {
+        case ANALYSE_BUILTIN_EXTRACT:
+            return args[0] + bytecode_lane(bc, call->items[1]);
+        case ANALYSE_BUILTIN_INSERT:
+            result = bytecode_alloc(bc, lanes);
+            bytecode_move(bc, result, args[0], lanes);
+            bytecode_move(bc, result + bytecode_lane(bc, call->items[1]),
+                          args[2], 1);
+            return result;
+        case ANALYSE_BUILTIN_SHUFFLE: {
+            usz source_lanes =
+                bytecode_value_type(bc, call->items[0]).lanes;
+            result = bytecode_alloc(bc, lanes);
+            for (usz i = 2; i < call->count; i++) {
+                u64 lane = bytecode_lane(bc, call->items[i]);
+                bytecode_move(bc, result + i - 2,
+                              lane < source_lanes
+                                  ? args[0] + lane
+                                  : args[1] + lane - source_lanes,
+                              1);
+            }
+            return result;
+        }
+        case ANALYSE_BUILTIN_ARENA:
+        case ANALYSE_BUILTIN_ALLOC:
+        case ANALYSE_BUILTIN_RESET:
+        case ANALYSE_BUILTIN_RELEASE:
+            result       = bytecode_alloc(bc, 1);
+            bc->retarget = bytecode_emit(bc, (BytecodeInstruction){
+                                                 .op    = BYTECODE_OP_ARENA,
+                                                 .type  = type.type,
+                                                 .lanes = 1,
+                                                 .aux   = builtin,
+                                                 .dst   = result,
+                                                 .a     = args[0],
+                                                 .b     = call->count > 1
+                                                              ? args[1]
+                                                              : 0,
+                                             });
+            return result;
+        case ANALYSE_BUILTIN_NONE:
+            break;
+    }
+
+    result = bytecode_alloc(bc, lanes);
+    if (call->count == 1) {
+        bc->retarget = bytecode_emit(bc, (BytecodeInstruction){
+                                             .op    = BYTECODE_OP_SPLAT,
+                                             .type  = type.type,
+                                             .lanes = lanes,
+                                             .dst   = result,
+                                             .a     = args[0],
+                                         });
+        return result;
+    }
+    for (usz i = 0; i < call->count; i++) {
+        bytecode_move(bc, result + i, args[i], 1);
+    }
+    return result;
+}
+
+// The arguments are moved to the end of the window, where the window of the
+// callee starts.
+Index bytecode_call(BytecodeCompiler *bc, Node *node, Index node_index,
+                    Type type) {
+    CallData *call = &bc->m->extra_data.items[node->data.lhs].data.call;
+    Index    *args = malloc(sizeof(Index) * (call->count + 1));
+    for (usz i = 0; i < call->count; i++) {
+        args[i] = bytecode_expression(bc, call->items[i]);
+    }
+
+    Index result;
+    Index symbol = node_column_get(&bc->ma->attributes.symbol, node_index);
+    if (symbol == ANALYSE_INDEX_NONE) {
+        bc->retarget = BYTECODE_NO_INSTRUCTION;
+        result       = bytecode_builtin(bc, node, type, args);
+    } else if (bc->ma->symbols.items[symbol].kind ==
+               ANALYSE_SYMBOL_KIND_IMPORTED_FUNCTION) {
+        // Only the interface of the module is known, not its bytecode.
+        if (bc->ok) {
+            log_error("%s calls an imported function, the interpreter only "
+                      "runs a single module",
+                      bc->function->name);
+        }
+        bc->ok       = false;
+        bc->retarget = BYTECODE_NO_INSTRUCTION;
+        result       = bytecode_alloc(bc, bytecode_lanes(type));
+    } else {
+        result       = bytecode_alloc(bc, bytecode_lanes(type));
+        Index window = bc->top;
+        for (usz i = 0; i < call->count; i++) {
+            usz lanes = bytecode_lanes(bytecode_value_type(bc, call->items[i]));
+            bytecode_move(bc, bytecode_alloc(bc, lanes), args[i], lanes);
+        }
+        bc->retarget = bytecode_emit(bc, (BytecodeInstruction){
+                                             .op    = BYTECODE_OP_CALL,
+                                             .type  = type.type,
+                                             .lanes = bytecode_lanes(type),
+                                             .dst   = result,
+                                             .a     = window,
+                                             .b     = bc->functions[symbol],
+                                         });
+    }
+    free(args);
+    return result;
+}
+
+// Returns the register of the value, converted to the type it is used as.
+// Identifiers use the register of their variable directly.
+Index bytecode_expression(BytecodeCompiler *bc, Index node_index) {
+    Node *node   = &bc->m->nodes.items[node_index];
+    Type  type   = node_column_get(&bc->ma->attributes.type, node_index);
+    Type  to     = bytecode_value_type(bc, node_index);
+    Index symbol = node_column_get(&bc->ma->attributes.symbol, node_index);
+    Index result;
+    switch (node->type) {
+        case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL: {
+            // Literals are converted while compiling.
+            Token        *token = &bc->t->tokens[node->main_token];
+            ComptimeValue value = {.type = type};
+            if (node->type == NODE_TYPE_FLOAT_LITERAL) {
+                value.lanes[0].real = extra_data_float(bc->t, token->extra_data);
+            } else if (type_is_float(type)) {
+                value.lanes[0].real =
+                    (f64)extra_data_integer(bc->t, token->extra_data);
+            } else {
+                value.lanes[0].integer =
+                    extra_data_integer(bc->t, token->extra_data);
+            }
+            return bytecode_constant(bc, comptime_convert(value, to));
+        }
+        case NODE_TYPE_IDENTIFIER:
+            if (bc->ma->symbols.items[symbol].kind ==
+                ANALYSE_SYMBOL_KIND_COMPTIME) {
+                AnalyseComptime *comptime = analyse_find_comptime(bc->ma, symbol);
+                return bytecode_constant(bc,
+                                         comptime_convert(comptime->value, to));
+            }
+            bc->retarget = BYTECODE_NO_INSTRUCTION;
+            result       = bc->registers[symbol];
+            break;
+        case NODE_TYPE_BINARY_OPERATION:
+            result = bytecode_binary_operation(bc, node, type);
+            break;
+        case NODE_TYPE_CALL:
+            result = bytecode_call(bc, node, node_index, type);
+            break;
+        case NODE_TYPE_BLOCK:
+        case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+        case NODE_TYPE_RETURN:
+        case NODE_TYPE_IMPORT:
+        case NODE_TYPE_EOF:
+            UNREACHABLE("statements are no expressions");
+    }
+    return bytecode_convert(bc, result, type, to);
+}
+
+// Computes the expression directly into dst if possible.
+void bytecode_expression_into(BytecodeCompiler *bc, Index node_index,
+                              Index dst) {
+    Index result = bytecode_expression(bc, node_index);
+    if (result == dst) {
+        return;
+    }
+    BytecodeInstruction *last =
+        bc->retarget == BYTECODE_NO_INSTRUCTION
+            ? NULL
+            : &bc->function->code.items[bc->retarget];
+    if (last != NULL && last->dst == result) {
+        last->dst = dst;
+        return;
+    }
+    bytecode_move(bc, dst, result,
+                  bytecode_lanes(bytecode_value_type(bc, node_index)));
+}
+
+Index bytecode_variable(BytecodeCompiler *bc, Index symbol) {
+    Index reg = bytecode_alloc(
+        bc, bytecode_lanes(bc->ma->symbols.items[symbol].type));
+    bc->registers[symbol] = reg;
+    bc->variables         = bc->top;
+    return reg;
+}
+
+void bytecode_patch_jump(BytecodeCompiler *bc, Index jump) {
+    bc->function->code.items[jump].b = bc->function->code.count;
+}
+
+void bytecode_block(BytecodeCompiler *bc, Index node_index);
+
+// while: the condition is checked before every iteration.
+void bytecode_while(BytecodeCompiler *bc, Node *node) {
+    LoopData *ld     = &bc->m->extra_data.items[node->data.lhs].data.loop;
+    Index     header = bc->function->code.count;
+    Index     condition = bytecode_expression(bc, ld->lhs);
+    Index     exit      = bytecode_emit(bc, (BytecodeInstruction){
+                                                .op = BYTECODE_OP_JUMP_IF_FALSE,
+                                                .a  = condition,
+                                            });
+    bc->top = bc->variables;
+
+    bytecode_block(bc, node->data.rhs);
+    bytecode_emit(bc, (BytecodeInstruction){
+                          .op = BYTECODE_OP_JUMP,
+                          .b  = header,
+                      });
+    bytecode_patch_jump(bc, exit);
+}
+
+// for: the end of the range is evaluated once and kept in a register next to
+// the variable.
+void bytecode_for(BytecodeCompiler *bc, Node *node, Index node_index) {
+    LoopData *ld       = &bc->m->extra_data.items[node->data.lhs].data.loop;
+    Index     symbol   = node_column_get(&bc->ma->attributes.symbol, node_index);
+    Type      type     = bc->ma->symbols.items[symbol].type;
+    Index     variable = bytecode_variable(bc, symbol);
+    Index     end      = bytecode_alloc(bc, 1);
+    bc->variables      = bc->top;
+    bytecode_expression_into(bc, ld->lhs, variable);
+    bytecode_expression_into(bc, ld->rhs, end);
+    bc->top = bc->variables;
+
+    Index header = bytecode_emit(
+        bc, (BytecodeInstruction){
+                .op  = type_kind(type) == BUILTIN_TYPE_KIND_SIGNED
+                           ? BYTECODE_OP_JUMP_UNLESS_LESS_S
+                           : BYTECODE_OP_JUMP_UNLESS_LESS_U,
+                .dst = end,
+                .a   = variable,
+            });
+    bytecode_block(bc, node->data.rhs);
+    bytecode_emit(bc, (BytecodeInstruction){
+                          .op  = BYTECODE_OP_INCREMENT,
+                          .dst = variable,
+                      });
+    bytecode_emit(bc, (BytecodeInstruction){
+                          .op = BYTECODE_OP_JUMP,
+                          .b  = header,
+                      });
+    bytecode_patch_jump(bc, header);
+}
+
+void bytecode_statement(BytecodeCompiler *bc, Index node_index) {
+    Node *node   = &bc->m->nodes.items[node_index];
+    Index symbol = node_column_get(&bc->ma->attributes.symbol, node_index);
+    switch (node->type) {
+        case NODE_TYPE_BLOCK:
+            bytecode_block(bc, node_index);
+            break;
+        case NODE_TYPE_VARIABLE_DECLARATION:
+            bytecode_expression_into(bc, node->data.rhs,
+                                     bytecode_variable(bc, symbol));
+            break;
+        case NODE_TYPE_ASSIGNMENT:
+            bytecode_expression_into(bc, node->data.rhs, bc->registers[symbol]);
+            break;
+        case NODE_TYPE_WHILE:
+            bytecode_while(bc, node);
+            break;
+        case NODE_TYPE_FOR:
+            bytecode_for(bc, node, node_index);
+            break;
+        case NODE_TYPE_RETURN: {
+            Type type = bytecode_value_type(bc, node->data.rhs);
+            bytecode_emit(bc, (BytecodeInstruction){
+                                  .op    = BYTECODE_OP_RETURN,
+                                  .type  = type.type,
+                                  .lanes = bytecode_lanes(type),
+                                  .a = bytecode_expression(bc, node->data.rhs),
+                              });
+            break;
+        }
+        case NODE_TYPE_EOF:
+            break;
+        case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_IMPORT:
+        case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_BINARY_OPERATION:
+        case NODE_TYPE_CALL:
+            UNREACHABLE("the analyse only allows statements in blocks");
+    }
+    // The temporaries of a statement are dead after it.
+    bc->top = bc->variables;
+}
+
+void bytecode_block(BytecodeCompiler *bc, Index node_index) {
+    Node      *node  = &bc->m->nodes.items[node_index];
+    BlockData *block = &bc->m->extra_data.items[node->data.lhs].data.block;
+    for (usz i = 0; i < block->count; i++) {
+        bytecode_statement(bc, block->items[i]);
+    }
+}
+
+// The arguments get the first registers in the order of the parameters.
+void bytecode_function(BytecodeCompiler *bc, Index node_index,
+                       BytecodeFunction *function) {
+    bc->function  = function;
+    bc->variables = 0;
+    bc->top       = 0;
+
+    Node                  *node = &bc->m->nodes.items[node_index];
+    FunctionPrototypeData *fpd =
+        &bc->m->extra_data.items[node->data.lhs].data.function_prototype;
+    Index *arguments = malloc(sizeof(Index) * (fpd->args.count + 1));
+    Index  scope = node_column_get(&bc->ma->attributes.scope, node_index);
+    AnalyseVariable *var, *var_tmp;
+    HASH_ITER(hh, bc->ma->scopes.items[scope].variables, var, var_tmp) {
+        AnalyseSymbol *symbol = &bc->ma->symbols.items[var->symbol];
+        if (symbol->kind == ANALYSE_SYMBOL_KIND_ARGUMENT) {
+            arguments[symbol->argument] = var->symbol;
+        }
+    }
+    for (usz i = 0; i < fpd->args.count; i++) {
+        bytecode_variable(bc, arguments[i]);
+    }
+    free(arguments);
+    function->argument_registers = bc->top;
+
+    bytecode_block(bc, node->data.rhs);
+    bytecode_emit(bc, (BytecodeInstruction){
+                          .op    = BYTECODE_OP_RETURN_ZERO,
+                          .type  = function->return_type.type,
+                          .lanes = bytecode_lanes(function->return_type),
+                      });
+}
+
+bool bytecode_compile(Module *m, ModuleAnalyse *ma, Tokens *t, str input,
+                      BytecodeProgram *out) {
+    assert(ma->errors.count == 0 &&
+           "bytecode_compile requires a module without analyse errors");
+    *out                = (BytecodeProgram){0};
+    BytecodeCompiler bc = {
+        .m         = m,
+        .ma        = ma,
+        .t         = t,
+        .input     = input,
+        .program   = out,
+        .registers = calloc(ma->symbols.count + 1, sizeof(Index)),
+        .functions = calloc(ma->symbols.count + 1, sizeof(Index)),
+        .ok        = true,
+    };
+
+    // All functions are known before the first call is compiled.
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node_index = m->top_level_nodes.items[i];
+        Node *node       = &m->nodes.items[node_index];
+        if (node->type != NODE_TYPE_FUNCTION_DEFINITION) {
+            continue;
+        }
+        Index symbol = node_column_get(&ma->attributes.symbol, node_index);
+        bc.functions[symbol]      = out->functions.count;
+        BytecodeFunction function = {
+            .name        = tokens_token_cstr(input, t, node->main_token),
+            .return_type = ma->symbols.items[symbol].type,
+        };
+        da_append(&out->functions, function);
+    }
+
+    for (usz i = 0, f = 0; i < m->top_level_nodes.count; i++) {
+        Index node_index = m->top_level_nodes.items[i];
+        if (m->nodes.items[node_index].type == NODE_TYPE_FUNCTION_DEFINITION) {
+            bytecode_function(&bc, node_index, &out->functions.items[f++]);
+        }
+    }
+
+    free(bc.registers);
+    free(bc.functions);
+    if (!bc.ok) {
+        bytecode_program_destroy(out);
+    }
+    return bc.ok;
+}
+
+void bytecode_program_destroy(BytecodeProgram *program) {
+    for (usz i = 0; i < program->functions.count; i++) {
+        free(program->functions.items[i].name);
+        da_destroy(&program->functions.items[i].code);
+    }
+    da_destroy(&program->functions);
+    da_destroy(&program->constants);
+}
+
+Index bytecode_find_function(BytecodeProgram *program, char const *name) {
+    for (usz i = 0; i < program->functions.count; i++) {
+        if (strcmp(program->functions.items[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return BYTECODE_NO_FUNCTION;
+}
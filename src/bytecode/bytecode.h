@@ -0,0 +1,133 @@
+#pragma once
+
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "language.h"
+#include "lexer.h"
+
+// ================
+// -- bytecode --
+// A register based bytecode for the interpreter backend, compiled straight
+// from the analysed Module without LLVM.
+//
+// Every function has its own window of registers. A register is one slot of
+// 64 bits, a vector of n lanes uses n consecutive registers. Arguments are in
+// the first registers of the window, so a call places them at the end of the
+// window of the caller and the callee window starts there.
+//
+// Integers are kept sign or zero extended to 64 bits and bools are 0 or 1, so
+// comparisons and conversions work on the whole slot. f32 is stored as f32.
+// ================
+
+typedef union BytecodeSlot BytecodeSlot;
+union BytecodeSlot {
+    u64 u;
+    i64 i;
+    f32 f32;
+    f64 f64;
+};
+
+// The ops with a _U, _S, _F32 or _F64 suffix are for unsigned integers and
+// bools, signed integers, f32 and f64. The arithmetic ops work on every lane.
+#define BYTECODE_OPS                                                      \
+    /* dst = the lanes constants from b */                                \
+    X(CONST)                                                              \
+    /* dst = a */                                                         \
+    X(MOVE)                                                               \
+    /* every lane of dst = the scalar a */                                \
+    X(SPLAT)                                                              \
+    /* dst = a converted from the type aux to the type */                 \
+    X(CONVERT)                                                            \
+    /* dst = a op b, integers wrap to 64 - aux bits */                    \
+    X(ADD_U) X(ADD_S) X(ADD_F32) X(ADD_F64)                               \
+    X(SUB_U) X(SUB_S) X(SUB_F32) X(SUB_F64)                               \
+    X(MUL_U) X(MUL_S) X(MUL_F32) X(MUL_F64)                               \
+    /* dst = a op b as bools, == and != are the same for all integers */  \
+    X(EQ_I) X(EQ_F32) X(EQ_F64)                                           \
+    X(NE_I) X(NE_F32) X(NE_F64)                                           \
+    X(LT_U) X(LT_S) X(LT_F32) X(LT_F64)                                   \
+    X(LE_U) X(LE_S) X(LE_F32) X(LE_F64)                                   \
+    X(GT_U) X(GT_S) X(GT_F32) X(GT_F64)                                   \
+    X(GE_U) X(GE_S) X(GE_F32) X(GE_F64)                                   \
+    /* Jumps to the instruction b */                                      \
+    X(JUMP)                                                               \
+    /* Jumps to the instruction b if the bool a is false */               \
+    X(JUMP_IF_FALSE)                                                      \
+    /* Jumps to the instruction b unless a < dst, for for loops */        \
+    X(JUMP_UNLESS_LESS_U) X(JUMP_UNLESS_LESS_S)                           \
+    /* dst += 1, the loop variable of a for loop never overflows */       \
+    X(INCREMENT)                                                          \
+    /* dst = the function b called with the window starting at a */       \
+    X(CALL)                                                               \
+    /* Returns a, or zero from the end of a function */                   \
+    X(RETURN) X(RETURN_ZERO)                                              \
+    /* dst = the arena builtin aux of the runtime, called with a and b */ \
+    X(ARENA)
+
+enum BytecodeOp {
+#define X(name) BYTECODE_OP_##name,
+    BYTECODE_OPS
+#undef X
+};
+typedef enum BytecodeOp BytecodeOp;
+
+typedef struct BytecodeInstruction BytecodeInstruction;
+struct BytecodeInstruction {
+    u8  op;
+    // The BuiltinType of the result, the element type of vectors
+    u8  type;
+    // 1 for scalars
+    u8  lanes;
+    // CONVERT: the BuiltinType of a, integer arithmetic: 64 - bits of the type,
+    // ARENA: the AnalyseBuiltin
+    u8  aux;
+    u16 dst;
+    u16 a;
+    // A register, or an instruction, constant or function index
+    u32 b;
+};
+
+typedef struct BytecodeCode BytecodeCode;
+struct BytecodeCode {
+    usz                  count;
+    usz                  capacity;
+    BytecodeInstruction *items;
+};
+
+typedef struct BytecodeFunction BytecodeFunction;
+struct BytecodeFunction {
+    char        *name;
+    // The registers of the arguments, they come first in the window
+    usz          argument_registers;
+    usz          register_count;
+    Type         return_type;
+    BytecodeCode code;
+};
+
+typedef struct BytecodeProgram BytecodeProgram;
+struct BytecodeProgram {
+    // The top level functions in source order
+    struct {
+        usz               count;
+        usz               capacity;
+        BytecodeFunction *items;
+    } functions;
+    // The literals and comptime values
+    struct {
+        usz           count;
+        usz           capacity;
+        BytecodeSlot *items;
+    } constants;
+};
+
+#define BYTECODE_MAX_REGISTERS UINT16_MAX
+#define BYTECODE_NO_FUNCTION   ((Index)-1)
+
+// The analyse may not contain errors. Fails if a function needs more than
+// BYTECODE_MAX_REGISTERS registers or calls an imported function.
+bool  bytecode_compile(Module *m, ModuleAnalyse *ma, Tokens *t, str input,
+                       BytecodeProgram *out);
+void  bytecode_program_destroy(BytecodeProgram *program);
+// BYTECODE_NO_FUNCTION if there is no function with the name.
+Index bytecode_find_function(BytecodeProgram *program, char const *name);
@@ -0,0 +1,308 @@
+#include "interp.h"
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "da.h"
+#include "language.h"
+#include "thor_runtime.h"
+
+// The implicit conversions of the analyse. Integers are already extended to
+// 64 bits, so they stay the same.
+BytecodeSlot interp_convert(BytecodeSlot value, Type from, Type to) {
+    if (!type_is_float(to)) {
+        return value;
+    }
+
+    f64 real;
+    if (type_is_float(from)) {
+        real = type_bits(from) == 32 ? (f64)value.f32 : value.f64;
+    } else if (type_kind(from) == BUILTIN_TYPE_KIND_SIGNED) {
+        real = (f64)value.i;
+    } else {
+        real = (f64)value.u;
+    }
+
+    BytecodeSlot result = {0};
+    if (type_bits(to) == 32) {
+        result.f32 = (f32)real;
+    } else {
+        result.f64 = real;
+    }
+    return result;
+}
+
+// The arena builtins on the u64 handles and addresses of thor code.
+u64 interp_arena(AnalyseBuiltin builtin, u64 a, u64 b) {
+    ThorArena *arena = (ThorArena *)(uptr)a;
+    switch (builtin) {
+        case ANALYSE_BUILTIN_ARENA:
+            return (uptr)thor_arena_create(a);
+        case ANALYSE_BUILTIN_ALLOC:
+            return (uptr)thor_arena_alloc(arena, b);
+        case ANALYSE_BUILTIN_RESET:
+            return (uptr)thor_arena_reset(arena);
+        case ANALYSE_BUILTIN_RELEASE:
+            return (uptr)thor_arena_release(arena);
+        case ANALYSE_BUILTIN_EXTRACT:
+        case ANALYSE_BUILTIN_INSERT:
+        case ANALYSE_BUILTIN_SHUFFLE:
+        case ANALYSE_BUILTIN_NONE:
+            break;
+    }
+    UNREACHABLE("invalid arena builtin");
+}
+
+void interp_reserve(Interp *interp, usz registers) {
+    da_ensure_size(&interp->registers, registers, sizeof(BytecodeSlot));
+}
+
+// Computed gotos are a GNU extension, supported by GCC and Clang.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// Runs the function until it returns to the caller of interp_call. Called with
+// handlers_out only returns the addresses of the handlers, indexed by the
+// BytecodeOp, for interp_create.
+bool interp_execute(Interp *interp, Index function, BytecodeSlot *out,
+                    void const *const **handlers_out) {
+    static void const *const handlers[] = {
+#define X(name) &&op_##name,
+        BYTECODE_OPS
+#undef X
+    };
+    if (handlers_out != NULL) {
+        *handlers_out = handlers;
+        return true;
+    }
+
+    static BytecodeSlot const zero[VECTOR_MAX_LANES] = {0};
+    BytecodeSlot const       *constants = interp->program->constants.items;
+    InterpInstruction const  *code      = interp->code[function];
+    InterpInstruction const  *ip        = code;
+    BytecodeInstruction const *ins;
+    usz                       base = 0;
+    BytecodeSlot             *r    = interp->registers.items;
+    BytecodeSlot const       *value;
+
+#define DISPATCH           \
+    do {                   \
+        ins = &ip->ins;    \
+        goto *ip->handler; \
+    } while (0)
+#define NEXT      \
+    do {          \
+        ip += 1;  \
+        DISPATCH; \
+    } while (0)
+#define JUMP(target)          \
+    do {                      \
+        ip = code + (target); \
+        DISPATCH;             \
+    } while (0)
+#define LANES     for (usz lane = 0; lane < ins->lanes; lane++)
+#define A         r[ins->a + lane]
+#define B         r[ins->b + lane]
+#define D         r[ins->dst + lane]
+// Integers wrap to their bits, aux is the number of the unused upper bits.
+#define WRAP_U(x) (((x) << ins->aux) >> ins->aux)
+#define WRAP_S(x) ((i64)((x) << ins->aux) >> ins->aux)
+
+    DISPATCH;
+
+op_CONST:
+    LANES D = constants[ins->b + lane];
+    NEXT;
+op_MOVE:
+    LANES D = A;
+    NEXT;
+op_SPLAT: {
+    BytecodeSlot scalar = r[ins->a];
+    LANES D             = scalar;
+    NEXT;
+}
+op_CONVERT: {
+    Type from = {.type = ins->aux};
+    Type to   = {.type = ins->type};
+    LANES D   = interp_convert(A, from, to);
+    NEXT;
+}
+
+#define ARITHMETIC(name, op)        \
+    op_##name##_U:                  \
+    LANES D.u = WRAP_U(A.u op B.u); \
+    NEXT;                           \
+    op_##name##_S:                  \
+    LANES D.i = WRAP_S(A.u op B.u); \
+    NEXT;                           \
+    op_##name##_F32:                \
+    LANES D.f32 = A.f32 op B.f32;   \
+    NEXT;                           \
+    op_##name##_F64:                \
+    LANES D.f64 = A.f64 op B.f64;   \
+    NEXT;
+    ARITHMETIC(ADD, +)
+    ARITHMETIC(SUB, -)
+    ARITHMETIC(MUL, *)
+#undef ARITHMETIC
+
+// Float comparisons are ordered, except != like in the generated code.
+#define EQUALITY(name, op)      \
+    op_##name##_I:              \
+    LANES D.u = A.u op B.u;     \
+    NEXT;                       \
+    op_##name##_F32:            \
+    LANES D.u = A.f32 op B.f32; \
+    NEXT;                       \
+    op_##name##_F64:            \
+    LANES D.u = A.f64 op B.f64; \
+    NEXT;
+    EQUALITY(EQ, ==)
+    EQUALITY(NE, !=)
+#undef EQUALITY
+
+#define ORDERING(name, op)      \
+    op_##name##_U:              \
+    LANES D.u = A.u op B.u;     \
+    NEXT;                       \
+    op_##name##_S:              \
+    LANES D.u = A.i op B.i;     \
+    NEXT;                       \
+    op_##name##_F32:            \
+    LANES D.u = A.f32 op B.f32; \
+    NEXT;                       \
+    op_##name##_F64:            \
+    LANES D.u = A.f64 op B.f64; \
+    NEXT;
+    ORDERING(LT, <)
+    ORDERING(LE, <=)
+    ORDERING(GT, >)
+    ORDERING(GE, >=)
+#undef ORDERING
+
+op_JUMP:
+    JUMP(ins->b);
+op_JUMP_IF_FALSE:
+    if (!r[ins->a].u) {
+        JUMP(ins->b);
+    }
+    NEXT;
+op_JUMP_UNLESS_LESS_U:
+    if (!(r[ins->a].u < r[ins->dst].u)) {
+        JUMP(ins->b);
+    }
+    NEXT;
+op_JUMP_UNLESS_LESS_S:
+    if (!(r[ins->a].i < r[ins->dst].i)) {
+        JUMP(ins->b);
+    }
+    NEXT;
+op_INCREMENT:
+    r[ins->dst].u += 1;
+    NEXT;
+op_ARENA:
+    r[ins->dst].u = interp_arena(ins->aux, r[ins->a].u, r[ins->b].u);
+    NEXT;
+
+op_CALL: {
+    if (interp->frames.count >= INTERP_MAX_DEPTH) {
+        log_error("stack overflow in %s, more than %d nested calls",
+                  interp->program->functions.items[ins->b].name,
+                  INTERP_MAX_DEPTH);
+        return false;
+    }
+    InterpFrame frame = {
+        .code = code,
+        .ip   = ip + 1,
+        .base = base,
+        .dst  = ins->dst,
+    };
+    da_append(&interp->frames, frame);
+
+    base += ins->a;
+    interp_reserve(
+        interp, base + interp->program->functions.items[ins->b].register_count);
+    r    = interp->registers.items + base;
+    code = interp->code[ins->b];
+    ip   = code;
+    DISPATCH;
+}
+
+op_RETURN:
+    value = &r[ins->a];
+    goto return_value;
+op_RETURN_ZERO:
+    value = zero;
+    goto return_value;
+return_value:
+    if (interp->frames.count == 0) {
+        memcpy(out, value, sizeof(BytecodeSlot) * ins->lanes);
+        return true;
+    }
+    {
+        InterpFrame frame = interp->frames.items[--interp->frames.count];
+        // The window of the callee is above dst, they never overlap.
+        base = frame.base;
+        r    = interp->registers.items + base;
+        memcpy(&r[frame.dst], value, sizeof(BytecodeSlot) * ins->lanes);
+        code = frame.code;
+        ip   = frame.ip;
+        DISPATCH;
+    }
+
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef LANES
+#undef A
+#undef B
+#undef D
+#undef WRAP_U
+#undef WRAP_S
+}
+#pragma GCC diagnostic pop
+
+void interp_create(Interp *out, BytecodeProgram *program) {
+    void const *const *handlers;
+    interp_execute(NULL, 0, NULL, &handlers);
+
+    *out = (Interp){
+        .program = program,
+        .code    = malloc(sizeof(InterpInstruction *) *
+                          (program->functions.count + 1)),
+    };
+    for (usz i = 0; i < program->functions.count; i++) {
+        BytecodeCode      *code     = &program->functions.items[i].code;
+        InterpInstruction *threaded =
+            malloc(sizeof(InterpInstruction) * (code->count + 1));
+        for (usz j = 0; j < code->count; j++) {
+            threaded[j] = (InterpInstruction){
+                .handler = handlers[code->items[j].op],
+                .ins     = code->items[j],
+            };
+        }
+        out->code[i] = threaded;
+    }
+}
+
+void interp_destroy(Interp *interp) {
+    for (usz i = 0; i < interp->program->functions.count; i++) {
+        free(interp->code[i]);
+    }
+    free(interp->code);
+    da_destroy(&interp->registers);
+    da_destroy(&interp->frames);
+}
+
+bool interp_call(Interp *interp, Index function, BytecodeSlot const *args,
+                 BytecodeSlot *out) {
+    BytecodeFunction *callee = &interp->program->functions.items[function];
+    interp_reserve(interp, callee->register_count);
+    if (callee->argument_registers > 0) {
+        memcpy(interp->registers.items, args,
+               sizeof(BytecodeSlot) * callee->argument_registers);
+    }
+    interp->frames.count = 0;
+    return interp_execute(interp, function, out, NULL);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "bytecode.h"
+#include "common.h"
+
+// ================
+// -- interp --
+// Runs a BytecodeProgram without LLVM, so a program starts without any
+// compilation to machine code. The code of every function is threaded once
+// when the interpreter is created: each instruction stores the address of its
+// handler, so dispatching an instruction is a single indirect jump.
+// ================
+
+// Deeper calls are a stack overflow, which stops the program.
+#define INTERP_MAX_DEPTH 100000
+
+typedef struct InterpInstruction InterpInstruction;
+struct InterpInstruction {
+    void const         *handler;
+    BytecodeInstruction ins;
+};
+
+typedef struct InterpFrame InterpFrame;
+struct InterpFrame {
+    // The code of the caller
+    InterpInstruction const *code;
+    // The instruction after the call
+    InterpInstruction const *ip;
+    // The window of the caller
+    usz                      base;
+    u16                      dst;
+};
+
+typedef struct Interp Interp;
+struct Interp {
+    BytecodeProgram    *program;
+    // The threaded code, indexed by the function index
+    InterpInstruction **code;
+    struct {
+        usz           count;
+        usz           capacity;
+        BytecodeSlot *items;
+    } registers;
+    struct {
+        usz          count;
+        usz          capacity;
+        InterpFrame *items;
+    } frames;
+};
+
+// The program has to outlive the interpreter.
+void interp_create(Interp *out, BytecodeProgram *program);
+void interp_destroy(Interp *interp);
+// Calls the function with the registers of its arguments, the result is stored
+// in out, which needs a slot for every lane of the return type. Returns false
+// on a stack overflow.
+bool interp_call(Interp *interp, Index function, BytecodeSlot const *args,
+                 BytecodeSlot *out);
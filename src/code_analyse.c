@@ -3,11 +3,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "ast.h"
 #include "common.h"
+#include "comptime.h"
 #include "da.h"
+#include "flat_pass.h"
 #include "language.h"
 #include "lexer.h"
+#include "node_column.h"
 #include "uthash.h"
 
 // FIXME: CLEANUP IS ALL STILL MISSING, DON'T FORGET
@@ -17,17 +21,29 @@ struct AnalyseData {
     Module       *m;
     Tokens       *t;
     str           input;
-    ModuleAnalyse module_analyse;
-    Index         cur_scope;
+    ModuleAnalyse     module_analyse;
+    Index             cur_scope;
+    // NULL without imports
+    ModuleInterfaces *imports;
 };
 
 bool analyse_is_expression(Node *node) {
     switch (node->type) {
         case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_BINARY_OPERATION:
+        case NODE_TYPE_CALL:
             return true;
         case NODE_TYPE_BLOCK:
         case NODE_TYPE_FUNCTION_DEFINITION:
         case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+        case NODE_TYPE_RETURN:
+        case NODE_TYPE_IMPORT:
         case NODE_TYPE_EOF:
             return false;
     }
@@ -37,10 +53,20 @@ bool analyse_is_top_level(NodeType type) {
     switch (type) {
         case NODE_TYPE_EOF:
         case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_IMPORT:
             return true;
         case NODE_TYPE_BLOCK:
         case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_BINARY_OPERATION:
+        case NODE_TYPE_CALL:
         case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+        case NODE_TYPE_RETURN:
             return false;
     }
     return false;
@@ -65,15 +91,71 @@ void begin_scope(AnalyseData *data, Index *out, Index node_index,
         .super_scope = data->cur_scope,
     };
     da_append(&data->module_analyse.scopes, scope);
-    *out             = data->module_analyse.scopes.count - 1;
+    *out            = data->module_analyse.scopes.count - 1;
+    data->cur_scope = *out;
 
-    NodeToScope *n2s = malloc(sizeof(NodeToScope));
-    *n2s             = (NodeToScope){
-                    .node  = node_index,
-                    .scope = *out,
+    // The top level scope has no node, node 0 is a real node.
+    if (type != ANALYSE_SCOPE_TYPE_TOP_LEVEL) {
+        node_column_set(&data->module_analyse.attributes.scope, node_index,
+                        *out);
+    }
+}
+
+Index add_symbol(AnalyseData *data, AnalyseSymbol symbol) {
+    da_append(&data->module_analyse.symbols, symbol);
+    return data->module_analyse.symbols.count - 1;
+}
+
+// inline and noinline, hot and cold exclude each other, and every attribute
+// may only be given once. Invalid attributes are reported and left out.
+FunctionAttributes analyse_function_attributes(AnalyseData *data,
+                                               FunctionAttributeTokens *tokens,
+                                               char const *function_name,
+                                               Index       function_node) {
+    static FunctionAttributes const conflicts[][2] = {
+        {FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_INLINE),
+         FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_NOINLINE)},
+        {FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_HOT),
+         FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_COLD)},
     };
 
-    HASH_ADD_USZ(data->module_analyse.nodes_to_scopes, node, n2s);
+    AnalyseError       error      = {.node = function_node};
+    FunctionAttributes attributes = 0;
+    for (usz i = 0; i < tokens->count; i++) {
+        char *name = tokens_token_cstr(data->input, data->t, tokens->items[i]);
+        FunctionAttributes attribute = 0;
+#define X(upper, lower)                                                  \
+    if (strcmp(name, #lower) == 0) {                                     \
+        attribute = FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_##upper);  \
+    }
+        FUNCTION_ATTRIBUTES
+#undef X
+        free(name);
+
+        error.type = ANALYSE_ERROR_NONE;
+        if (attribute == 0) {
+            error.type = ANALYSE_ERROR_UNKNOWN_ATTRIBUTE;
+        } else if (attributes & attribute) {
+            error.type = ANALYSE_ERROR_CONFLICTING_ATTRIBUTES;
+        } else if (attribute ==
+                       FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_FASTCC) &&
+                   strcmp(function_name, "main") == 0) {
+            error.type = ANALYSE_ERROR_FASTCC_MAIN;
+        }
+        for (usz c = 0; c < sizeof(conflicts) / sizeof(conflicts[0]); c++) {
+            if ((attribute == conflicts[c][0] && attributes & conflicts[c][1]) ||
+                (attribute == conflicts[c][1] && attributes & conflicts[c][0])) {
+                error.type = ANALYSE_ERROR_CONFLICTING_ATTRIBUTES;
+            }
+        }
+
+        if (error.type != ANALYSE_ERROR_NONE) {
+            da_append(&data->module_analyse.errors, error);
+        } else {
+            attributes |= attribute;
+        }
+    }
+    return attributes;
 }
 
 void add_function_to_scope(AnalyseData *data, Index scope_index,
@@ -89,6 +171,20 @@ void add_function_to_scope(AnalyseData *data, Index scope_index,
             tokens_token_cstr(data->input, data->t, function_node->main_token),
     };
 
+    // Another function with the same name would be unreachable by calls.
+    AnalyseScope    *scope = &data->module_analyse.scopes.items[scope_index];
+    AnalyseFunction *existing;
+    HASH_FIND_STR(scope->functions, function.name, existing);
+    if (existing != NULL) {
+        free(function.name);
+        AnalyseError error = {
+            .type = ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE,
+            .node = function_node_index,
+        };
+        da_append(&data->module_analyse.errors, error);
+        return;
+    }
+
     Type return_type;
     if (!check_type(data, function_prototype->return_type, &return_type)) {
         AnalyseError error = {
@@ -114,10 +210,22 @@ void add_function_to_scope(AnalyseData *data, Index scope_index,
         }
     }
 
+    AnalyseSymbol symbol = {
+        .kind  = ANALYSE_SYMBOL_KIND_FUNCTION,
+        .node  = function_node_index,
+        .scope = scope_index,
+        .type  = return_type,
+    };
+    function.return_type = return_type;
+    function.attributes  = analyse_function_attributes(
+        data, &function_prototype->attributes, function.name,
+        function_node_index);
+    function.symbol = add_symbol(data, symbol);
+    node_column_set(&data->module_analyse.attributes.symbol,
+                    function_node_index, function.symbol);
+
     AnalyseFunction *function_mem = malloc(sizeof(AnalyseFunction));
     *function_mem                 = function;
-
-    AnalyseScope *scope = &data->module_analyse.scopes.items[scope_index];
     HASH_ADD_STR(scope->functions, name, function_mem);
 }
 
@@ -127,13 +235,11 @@ void end_scope(AnalyseData *data, Index scope) {
 
 void free_module_analyse(ModuleAnalyse *module_analyse) {
 
-    // Node to scope
-    NodeToScope *node_to_scope, *node_to_scope_tmp;
-    HASH_ITER(hh, module_analyse->nodes_to_scopes, node_to_scope,
-              node_to_scope_tmp) {
-        HASH_DEL(module_analyse->nodes_to_scopes, node_to_scope);
-        free(node_to_scope);
-    }
+    // Node attributes
+    node_column_destroy(&module_analyse->attributes.scope);
+    node_column_destroy(&module_analyse->attributes.type);
+    node_column_destroy(&module_analyse->attributes.converted);
+    node_column_destroy(&module_analyse->attributes.symbol);
 
     // Scopes
     for (usz i = 0; i < module_analyse->scopes.count; i++) {
@@ -149,11 +255,14 @@ void free_module_analyse(ModuleAnalyse *module_analyse) {
         HASH_ITER(hh, scope->functions, func, func_tmp) {
             HASH_DEL(scope->functions, func);
             free(func->name);
+            free(func->module);
             da_destroy(&func->argument_types);
             free(func);
         }
     }
     da_destroy(&module_analyse->scopes);
+    da_destroy(&module_analyse->symbols);
+    da_destroy(&module_analyse->comptimes);
 
     // Errors
     da_destroy(&module_analyse->errors);
@@ -168,14 +277,44 @@ void free_module_analyse(ModuleAnalyse *module_analyse) {
     }
 }
 
-void analyse_data_init_types(AnalyseData *analyse_data) {
-    TypeNameToType *u32   = malloc(sizeof(TypeNameToType));
-    u32->type.type        = BUILTIN_TYPE_U32;
-    char const u32_name[] = "u32";
-    u32->type_name        = malloc(sizeof(u32_name));
-    memcpy(u32->type_name, u32_name, sizeof(u32_name));
+char *analyse_strdup(char const *s) {
+    usz   len  = strlen(s) + 1;
+    char *copy = malloc(len);
+    memcpy(copy, s, len);
+    return copy;
+}
+
+void analyse_data_add_type(AnalyseData *analyse_data, char const *name,
+                           Type type) {
+    TypeNameToType *entry = malloc(sizeof(TypeNameToType));
+    entry->type           = type;
+    entry->type_name      = analyse_strdup(name);
 
-    HASH_ADD_STR(analyse_data->module_analyse.types, type_name, u32);
+    HASH_ADD_STR(analyse_data->module_analyse.types, type_name, entry);
+}
+
+// Adds the scalar type and its vector types.
+void analyse_data_add_scalar_type(AnalyseData *analyse_data, char const *name,
+                                  BuiltinType type) {
+    analyse_data_add_type(analyse_data, name, (Type){.type = type});
+#define X(n) n,
+    static u32 const lanes[] = {VECTOR_LANES};
+#undef X
+    for (usz i = 0; i < sizeof(lanes) / sizeof(lanes[0]); i++) {
+        str   vector_str  = str_format("%sx%u", name, lanes[i]);
+        char *vector_name = to_cstr(vector_str);
+        str_destroy(vector_str);
+        analyse_data_add_type(analyse_data, vector_name,
+                              (Type){.type = type, .lanes = lanes[i]});
+        free(vector_name);
+    }
+}
+
+void analyse_data_init_types(AnalyseData *analyse_data) {
+#define X(upper, lower, kind, bits) \
+    analyse_data_add_scalar_type(analyse_data, #lower, BUILTIN_TYPE_##upper);
+    BUILTIN_TYPES
+#undef X
 }
 
 // Checks recursevly, if we are in an function body
@@ -214,7 +353,9 @@ bool is_identifier_in_use(AnalyseData *analyse_data, Node *node, Index scope) {
         if (scope == analyse_data->module_analyse.root_scope) {
             return false;
         } else {
-            return is_identifier_in_use(analyse_data, node, scope);
+            return is_identifier_in_use(
+                analyse_data, node,
+                analyse_data->module_analyse.scopes.items[scope].super_scope);
         }
     }
 
@@ -223,23 +364,535 @@ bool is_identifier_in_use(AnalyseData *analyse_data, Node *node, Index scope) {
 
 void analyse_node(AnalyseData *analyse_data, Node *node, Index node_index);
 
+// Searches the variable in the current scope and all its super scopes, NULL if
+// there is no variable with that name.
+AnalyseVariable *analyse_find_variable(AnalyseData *analyse_data,
+                                       char const  *name) {
+    Index scope = analyse_data->cur_scope;
+    while (true) {
+        AnalyseVariable *variable;
+        HASH_FIND_STR(analyse_data->module_analyse.scopes.items[scope].variables,
+                      name, variable);
+        if (variable != NULL ||
+            scope == analyse_data->module_analyse.root_scope) {
+            return variable;
+        }
+        scope = analyse_data->module_analyse.scopes.items[scope].super_scope;
+    }
+}
+
 bool analyse_expression(AnalyseData *analyse_data, Node *node, Index node_index,
-                        Type *out_type) {
+                        Type *out_type);
+
+bool analyse_is_comparison(TokenType type) {
+    switch (type) {
+        case TOKEN_TYPE_EQUAL_EQUAL:
+        case TOKEN_TYPE_BANG_EQUAL:
+        case TOKEN_TYPE_LESS:
+        case TOKEN_TYPE_LESS_EQUAL:
+        case TOKEN_TYPE_GREATER:
+        case TOKEN_TYPE_GREATER_EQUAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+u64 analyse_integer(AnalyseData *analyse_data, Index node_index) {
+    Node *node = &analyse_data->m->nodes.items[node_index];
+    return extra_data_integer(
+        analyse_data->t, analyse_data->t->tokens[node->main_token].extra_data);
+}
+
+// Literals and arithmetic on literals only, a comparison is always a bool.
+bool analyse_is_literal(AnalyseData *analyse_data, Index node_index) {
+    Node *node = &analyse_data->m->nodes.items[node_index];
     switch (node->type) {
         case NODE_TYPE_INTEGER_LITERAL:
-            *out_type = (Type){.type = BUILTIN_TYPE_U32};
+        case NODE_TYPE_FLOAT_LITERAL:
+            return true;
+        case NODE_TYPE_BINARY_OPERATION:
+            return !analyse_is_comparison(
+                       analyse_data->t->tokens[node->main_token].type) &&
+                   analyse_is_literal(analyse_data, node->data.lhs) &&
+                   analyse_is_literal(analyse_data, node->data.rhs);
+        default:
+            return false;
+    }
+}
+
+// Whether every literal of the expression is a value of the scalar type to.
+bool analyse_literal_fits(AnalyseData *analyse_data, Index node_index,
+                          Type to) {
+    Node *node = &analyse_data->m->nodes.items[node_index];
+    switch (node->type) {
+        case NODE_TYPE_INTEGER_LITERAL: {
+            u64 integer = analyse_integer(analyse_data, node_index);
+            if (type_is_float(to)) {
+                return integer <= 1ull << type_mantissa_bits(to);
+            }
+            return type_is_integer(to) && integer <= type_integer_max(to);
+        }
+        case NODE_TYPE_FLOAT_LITERAL:
+            return type_is_float(to);
+        case NODE_TYPE_BINARY_OPERATION:
+            return analyse_literal_fits(analyse_data, node->data.lhs, to) &&
+                   analyse_literal_fits(analyse_data, node->data.rhs, to);
+        default:
+            return false;
+    }
+}
+
+void analyse_retype_literal(AnalyseData *analyse_data, Index node_index,
+                            Type to) {
+    Node *node = &analyse_data->m->nodes.items[node_index];
+    if (node->type == NODE_TYPE_BINARY_OPERATION) {
+        analyse_retype_literal(analyse_data, node->data.lhs, to);
+        analyse_retype_literal(analyse_data, node->data.rhs, to);
+    }
+    node_column_set(&analyse_data->module_analyse.attributes.type, node_index,
+                    to);
+}
+
+// Checks that the expression with the type from can be used as a value of the
+// type to. Literals have no fixed type, they take the type they are used as if
+// their values fit into it. Every other expression is converted if the
+// conversion is implicit.
+bool analyse_convert(AnalyseData *analyse_data, Index node_index, Type from,
+                     Type to) {
+    if (type_equal(from, to)) {
+        return true;
+    }
+
+    Type element = type_element(to);
+    if (!type_is_vector(from) && analyse_is_literal(analyse_data, node_index) &&
+        analyse_literal_fits(analyse_data, node_index, element)) {
+        analyse_retype_literal(analyse_data, node_index, element);
+        from = element;
+    } else if (!type_converts(from, to)) {
+        return false;
+    }
+
+    if (!type_equal(from, to)) {
+        node_column_set(&analyse_data->module_analyse.attributes.converted,
+                        node_index, to);
+    }
+    return true;
+}
+
+// Converts the operands to the type of the other operand, a literal operand
+// takes the type of the other one first. False if they have no common type.
+bool analyse_unify(AnalyseData *analyse_data, Index lhs, Type lhs_type,
+                   Index rhs, Type rhs_type, Type *out_type) {
+    if (analyse_is_literal(analyse_data, rhs) &&
+        analyse_convert(analyse_data, rhs, rhs_type, lhs_type)) {
+        *out_type = lhs_type;
+    } else if (analyse_convert(analyse_data, lhs, lhs_type, rhs_type)) {
+        *out_type = rhs_type;
+    } else if (analyse_convert(analyse_data, rhs, rhs_type, lhs_type)) {
+        *out_type = lhs_type;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+AnalyseBuiltin analyse_builtin_from_name(char const *name) {
+#define X(upper, lower)                \
+    if (strcmp(name, #lower) == 0) {   \
+        return ANALYSE_BUILTIN_##upper; \
+    }
+    ANALYSE_BUILTINS
+#undef X
+    return ANALYSE_BUILTIN_NONE;
+}
+
+bool analyse_builtin_is_arena(AnalyseBuiltin builtin) {
+    return builtin == ANALYSE_BUILTIN_ARENA ||
+           builtin == ANALYSE_BUILTIN_ALLOC ||
+           builtin == ANALYSE_BUILTIN_RESET ||
+           builtin == ANALYSE_BUILTIN_RELEASE;
+}
+
+// Reports the error, returns false so it can be returned directly.
+bool analyse_error(AnalyseData *analyse_data, Index node_index,
+                   AnalyseErrorType type) {
+    AnalyseError error = {.node = node_index, .type = type};
+    da_append(&analyse_data->module_analyse.errors, error);
+    return false;
+}
+
+bool analyse_call_argument(AnalyseData *analyse_data, CallData *call, usz i,
+                           Type *out_type) {
+    return analyse_expression(analyse_data,
+                              &analyse_data->m->nodes.items[call->items[i]],
+                              call->items[i], out_type);
+}
+
+// A lane has to be an integer literal, so it is known at compile time and can
+// be checked against the lanes.
+bool analyse_lane(AnalyseData *analyse_data, CallData *call, usz i,
+                  usz lanes) {
+    Type type;
+    if (!analyse_call_argument(analyse_data, call, i, &type)) {
+        return false;
+    }
+    Node *node = &analyse_data->m->nodes.items[call->items[i]];
+    if (node->type == NODE_TYPE_INTEGER_LITERAL &&
+        analyse_integer(analyse_data, call->items[i]) < lanes) {
+        return true;
+    }
+    return analyse_error(analyse_data, call->items[i],
+                         ANALYSE_ERROR_INVALID_LANE);
+}
+
+// The scope of the innermost function, ANALYSE_INDEX_NONE outside of
+// functions.
+Index analyse_function_scope(AnalyseData *analyse_data) {
+    Index scope = analyse_data->cur_scope;
+    while (scope != analyse_data->module_analyse.root_scope) {
+        if (analyse_data->module_analyse.scopes.items[scope].type ==
+            ANALYSE_SCOPE_TYPE_FUNCTION) {
+            return scope;
+        }
+        scope = analyse_data->module_analyse.scopes.items[scope].super_scope;
+    }
+    return ANALYSE_INDEX_NONE;
+}
+
+// The function of the innermost function scope, NULL outside of functions or
+// if the function has an unknown type and was never added.
+AnalyseFunction *analyse_current_function(AnalyseData *analyse_data) {
+    Index function_scope = analyse_function_scope(analyse_data);
+    if (function_scope == ANALYSE_INDEX_NONE) {
+        return NULL;
+    }
+    Index function_node =
+        analyse_data->module_analyse.scopes.items[function_scope].node;
+    char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                   analyse_data->m->nodes.items[function_node]
+                                       .main_token);
+    AnalyseFunction *function = analyse_find_function(
+        &analyse_data->module_analyse, analyse_data->cur_scope, name);
+    free(name);
+    return function;
+}
+
+// The arena builtins call the runtime, so they are impure. Their arguments
+// are u64 handles and sizes.
+bool analyse_arena_builtin(AnalyseData *analyse_data, CallData *call,
+                           Index node_index, Type *out_type) {
+    if (analyse_function_scope(analyse_data) == ANALYSE_INDEX_NONE) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_COMPTIME_IMPURE_CALL);
+    }
+    AnalyseFunction *caller = analyse_current_function(analyse_data);
+    if (caller != NULL &&
+        caller->attributes & FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_PURE)) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_IMPURE_CALL);
+    }
+
+    Type u64_type = {.type = BUILTIN_TYPE_U64};
+    for (usz i = 0; i < call->count; i++) {
+        Type argument_type;
+        if (!analyse_call_argument(analyse_data, call, i, &argument_type)) {
+            return false;
+        }
+        if (!analyse_convert(analyse_data, call->items[i], argument_type,
+                             u64_type)) {
+            return analyse_error(
+                analyse_data, call->items[i],
+                ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE);
+        }
+    }
+    *out_type = u64_type;
+    return true;
+}
+
+bool analyse_builtin(AnalyseData *analyse_data, AnalyseBuiltin builtin,
+                     CallData *call, Index node_index, Type *out_type) {
+    static usz const argument_counts[] = {
+        [ANALYSE_BUILTIN_EXTRACT] = 2,
+        [ANALYSE_BUILTIN_INSERT]  = 3,
+        [ANALYSE_BUILTIN_SHUFFLE] = 2,
+        [ANALYSE_BUILTIN_ARENA]   = 1,
+        [ANALYSE_BUILTIN_ALLOC]   = 2,
+        [ANALYSE_BUILTIN_RESET]   = 1,
+        [ANALYSE_BUILTIN_RELEASE] = 1,
+    };
+    if (builtin == ANALYSE_BUILTIN_SHUFFLE
+            ? call->count < 2 || !type_valid_lanes(call->count - 2)
+            : call->count != argument_counts[builtin]) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_CALL_ARGUMENT_COUNT);
+    }
+    if (analyse_builtin_is_arena(builtin)) {
+        return analyse_arena_builtin(analyse_data, call, node_index, out_type);
+    }
+
+    Type vector;
+    if (!analyse_call_argument(analyse_data, call, 0, &vector)) {
+        return false;
+    }
+    if (!type_is_vector(vector)) {
+        return analyse_error(analyse_data, call->items[0],
+                             ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE);
+    }
+
+    switch (builtin) {
+        case ANALYSE_BUILTIN_EXTRACT:
+            if (!analyse_lane(analyse_data, call, 1, vector.lanes)) {
+                return false;
+            }
+            *out_type = type_element(vector);
+            return true;
+        case ANALYSE_BUILTIN_INSERT: {
+            Type value;
+            if (!analyse_lane(analyse_data, call, 1, vector.lanes) ||
+                !analyse_call_argument(analyse_data, call, 2, &value)) {
+                return false;
+            }
+            if (!analyse_convert(analyse_data, call->items[2], value,
+                                 type_element(vector))) {
+                return analyse_error(
+                    analyse_data, call->items[2],
+                    ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE);
+            }
+            *out_type = vector;
             return true;
+        }
+        case ANALYSE_BUILTIN_SHUFFLE: {
+            Type other;
+            if (!analyse_call_argument(analyse_data, call, 1, &other)) {
+                return false;
+            }
+            if (!type_equal(vector, other)) {
+                return analyse_error(
+                    analyse_data, call->items[1],
+                    ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE);
+            }
+            for (usz i = 2; i < call->count; i++) {
+                if (!analyse_lane(analyse_data, call, i, vector.lanes * 2)) {
+                    return false;
+                }
+            }
+            *out_type = (Type){.type = vector.type, .lanes = call->count - 2};
+            return true;
+        }
+        case ANALYSE_BUILTIN_ARENA:
+        case ANALYSE_BUILTIN_ALLOC:
+        case ANALYSE_BUILTIN_RESET:
+        case ANALYSE_BUILTIN_RELEASE:
+        case ANALYSE_BUILTIN_NONE:
+            break;
+    }
+    UNREACHABLE("invalid builtin");
+}
+
+// u32x4(a, b, c, d) creates a vector from one value per lane, u32x4(a) uses a
+// for every lane.
+bool analyse_vector_constructor(AnalyseData *analyse_data, Type vector,
+                                CallData *call, Index node_index,
+                                Type *out_type) {
+    if (call->count != 1 && call->count != vector.lanes) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_CALL_ARGUMENT_COUNT);
+    }
+    for (usz i = 0; i < call->count; i++) {
+        Type argument_type;
+        if (!analyse_call_argument(analyse_data, call, i, &argument_type)) {
+            return false;
+        }
+        if (!analyse_convert(analyse_data, call->items[i], argument_type,
+                             type_element(vector))) {
+            return analyse_error(
+                analyse_data, call->items[i],
+                ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE);
+        }
+    }
+    *out_type = vector;
+    return true;
+}
+
+// The arguments have to match the parameters of the function in count and
+// type, the type of the call is the return type. Functions shadow the builtins
+// and the vector constructors.
+bool analyse_call(AnalyseData *analyse_data, Node *node, Index node_index,
+                  Type *out_type) {
+    CallData *call = &analyse_data->m->extra_data.items[node->data.lhs].data.call;
+    char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                   node->main_token);
+    AnalyseFunction *function = analyse_find_function(
+        &analyse_data->module_analyse, analyse_data->cur_scope, name);
+    if (function == NULL) {
+        AnalyseBuiltin builtin = analyse_builtin_from_name(name);
+        Type           vector  = {0};
+        bool           is_vector =
+            check_type(analyse_data, node->main_token, &vector) &&
+            type_is_vector(vector);
+        free(name);
+        if (builtin != ANALYSE_BUILTIN_NONE) {
+            return analyse_builtin(analyse_data, builtin, call, node_index,
+                                   out_type);
+        }
+        if (is_vector) {
+            return analyse_vector_constructor(analyse_data, vector, call,
+                                              node_index, out_type);
+        }
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_UNDEFINED_FUNCTION);
+    }
+    free(name);
+
+    if (call->count != function->argument_types.count) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_CALL_ARGUMENT_COUNT);
+    }
+
+    FunctionAttributes pure = FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_PURE);
+    AnalyseFunction   *caller = analyse_current_function(analyse_data);
+    if (caller != NULL && caller->attributes & pure &&
+        !(function->attributes & pure)) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_IMPURE_CALL);
+    }
+    // Only comptime declarations have calls at the top level, they are
+    // evaluated during the compilation. The bodies of imported functions are
+    // not known.
+    if (analyse_data->cur_scope == analyse_data->module_analyse.root_scope &&
+        function->module != NULL) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_COMPTIME_IMPORTED_CALL);
+    }
+    if (analyse_data->cur_scope == analyse_data->module_analyse.root_scope &&
+        !(function->attributes & pure)) {
+        return analyse_error(analyse_data, node_index,
+                             ANALYSE_ERROR_COMPTIME_IMPURE_CALL);
+    }
+
+    for (usz i = 0; i < call->count; i++) {
+        Type argument_type;
+        if (!analyse_call_argument(analyse_data, call, i, &argument_type)) {
+            return false;
+        }
+        if (!analyse_convert(analyse_data, call->items[i], argument_type,
+                             function->argument_types.items[i])) {
+            return analyse_error(
+                analyse_data, node_index,
+                ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE);
+        }
+    }
+
+    *out_type = function->return_type;
+    node_column_set(&analyse_data->module_analyse.attributes.symbol, node_index,
+                    function->symbol);
+    return true;
+}
+
+// Analyses the expression and reports its errors, returns false if there was
+// an error.
+bool analyse_expression(AnalyseData *analyse_data, Node *node, Index node_index,
+                        Type *out_type) {
+    node_column_set(&analyse_data->module_analyse.attributes.scope, node_index,
+                    analyse_data->cur_scope);
+    switch (node->type) {
+        case NODE_TYPE_INTEGER_LITERAL:
+            // Used as u32 if nothing else is expected, and as u64 if it is too
+            // large for u32.
+            *out_type = (Type){
+                .type = analyse_integer(analyse_data, node_index) <= UINT32_MAX
+                            ? BUILTIN_TYPE_U32
+                            : BUILTIN_TYPE_U64,
+            };
+            break;
+        case NODE_TYPE_FLOAT_LITERAL:
+            *out_type = (Type){.type = BUILTIN_TYPE_F64};
+            break;
+        case NODE_TYPE_IDENTIFIER: {
+            char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                           node->main_token);
+            AnalyseVariable *variable = analyse_find_variable(analyse_data, name);
+            free(name);
+            if (variable == NULL) {
+                AnalyseError error = {
+                    .node = node_index,
+                    .type = ANALYSE_ERROR_UNDEFINED_IDENTIFIER,
+                };
+                da_append(&analyse_data->module_analyse.errors, error);
+                return false;
+            }
+            *out_type = variable->type;
+            node_column_set(&analyse_data->module_analyse.attributes.symbol,
+                            node_index, variable->symbol);
+            break;
+        }
+        case NODE_TYPE_BINARY_OPERATION: {
+            Type lhs_type, rhs_type;
+            if (!analyse_expression(
+                    analyse_data,
+                    &analyse_data->m->nodes.items[node->data.lhs],
+                    node->data.lhs, &lhs_type) ||
+                !analyse_expression(
+                    analyse_data,
+                    &analyse_data->m->nodes.items[node->data.rhs],
+                    node->data.rhs, &rhs_type)) {
+                return false;
+            }
+            Type operand_type;
+            if (!analyse_unify(analyse_data, node->data.lhs, lhs_type,
+                               node->data.rhs, rhs_type, &operand_type)) {
+                AnalyseError error = {
+                    .node = node_index,
+                    .type = ANALYSE_ERROR_OPERANDS_DIFFRENT_TYPE,
+                };
+                da_append(&analyse_data->module_analyse.errors, error);
+                return false;
+            }
+            // Bools can only be compared with == and !=, a comparison is a
+            // bool per lane.
+            TokenType op = analyse_data->t->tokens[node->main_token].type;
+            if (type_is_bool(operand_type) && op != TOKEN_TYPE_EQUAL_EQUAL &&
+                op != TOKEN_TYPE_BANG_EQUAL) {
+                AnalyseError error = {
+                    .node = node_index,
+                    .type = ANALYSE_ERROR_INVALID_OPERAND_TYPE,
+                };
+                da_append(&analyse_data->module_analyse.errors, error);
+                return false;
+            }
+            *out_type = analyse_is_comparison(op)
+                            ? (Type){.type  = BUILTIN_TYPE_BOOL,
+                                     .lanes = operand_type.lanes}
+                            : operand_type;
+            break;
+        }
+        case NODE_TYPE_CALL:
+            if (!analyse_call(analyse_data, node, node_index, out_type)) {
+                return false;
+            }
+            break;
         case NODE_TYPE_BLOCK:
         case NODE_TYPE_FUNCTION_DEFINITION:
         case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+        case NODE_TYPE_RETURN:
+        case NODE_TYPE_IMPORT:
         case NODE_TYPE_EOF:
             return false;
     }
-    return false;
+
+    node_column_set(&analyse_data->module_analyse.attributes.type, node_index,
+                    *out_type);
+    return true;
 }
 
 void analyse_variable(AnalyseData *analyse_data, Node *node, Index node_index) {
-    assert(node->type == NODE_TYPE_VARIABLE_DECLARATION);
+    assert(node->type == NODE_TYPE_VARIABLE_DECLARATION ||
+           node->type == NODE_TYPE_COMPTIME_DECLARATION);
     if (is_identifier_in_use(analyse_data, node, analyse_data->cur_scope)) {
         AnalyseError error = {
             .node = node_index,
@@ -250,8 +903,9 @@ void analyse_variable(AnalyseData *analyse_data, Node *node, Index node_index) {
         return;
     }
 
-    Type expression_type;
-    if (!analyse_expression(analyse_data, &analyse_data->m->nodes.items[node->data.rhs], node->data.rhs, &expression_type)) {
+    Type  expression_type;
+    Node *expression = &analyse_data->m->nodes.items[node->data.rhs];
+    if (!analyse_is_expression(expression)) {
         AnalyseError error = {
             .node = node_index,
             .type = ANALYSE_ERROR_EXPECTED_EXPRESSION_FOR_VARIABLE_DECLARATION,
@@ -260,6 +914,10 @@ void analyse_variable(AnalyseData *analyse_data, Node *node, Index node_index) {
 
         return;
     }
+    if (!analyse_expression(analyse_data, expression, node->data.rhs,
+                            &expression_type)) {
+        return;
+    }
 
     if (node->data.lhs != 0) {
         Type variable_type;
@@ -272,7 +930,8 @@ void analyse_variable(AnalyseData *analyse_data, Node *node, Index node_index) {
             return;
         }
 
-        if (variable_type.type != expression_type.type) {
+        if (!analyse_convert(analyse_data, node->data.rhs, expression_type,
+                             variable_type)) {
             AnalyseError error = {
                 .node = node_index,
                 .type = ANALYSE_ERROR_VARIABLE_EXPRESSION_DIFFRENT_TYPE,
@@ -280,12 +939,23 @@ void analyse_variable(AnalyseData *analyse_data, Node *node, Index node_index) {
             da_append(&analyse_data->module_analyse.errors, error);
             return;
         }
+        expression_type = variable_type;
     }
 
     AnalyseVariable variable = {
         .type = expression_type,
-        .name = tokens_token_cstr(analyse_data->input, analyse_data->t, node->main_token)
+        .name = tokens_token_cstr(analyse_data->input, analyse_data->t, node->main_token),
+        .symbol = add_symbol(analyse_data, (AnalyseSymbol){
+            .kind  = ANALYSE_SYMBOL_KIND_VARIABLE,
+            .node  = node_index,
+            .scope = analyse_data->cur_scope,
+            .type  = expression_type,
+        }),
     };
+    node_column_set(&analyse_data->module_analyse.attributes.type, node_index,
+                    expression_type);
+    node_column_set(&analyse_data->module_analyse.attributes.symbol,
+                    node_index, variable.symbol);
 
     AnalyseVariable *variable_mem = malloc(sizeof(AnalyseVariable));
     *variable_mem = variable;
@@ -293,6 +963,276 @@ void analyse_variable(AnalyseData *analyse_data, Node *node, Index node_index) {
     HASH_ADD_STR(analyse_data->module_analyse.scopes.items[analyse_data->cur_scope].variables, name, variable_mem);
 }
 
+// A comptime declaration is a variable of the root scope, its value is
+// evaluated after the analyse.
+void analyse_comptime_declaration(AnalyseData *analyse_data, Node *node,
+                                  Index node_index) {
+    ModuleAnalyse *module_analyse = &analyse_data->module_analyse;
+    analyse_variable(analyse_data, node, node_index);
+    Index symbol = node_column_get(&module_analyse->attributes.symbol, node_index);
+    if (symbol == ANALYSE_INDEX_NONE) {
+        return;
+    }
+
+    module_analyse->symbols.items[symbol].kind = ANALYSE_SYMBOL_KIND_COMPTIME;
+    AnalyseComptime comptime = {
+        .node   = node_index,
+        .symbol = symbol,
+        .state  = ANALYSE_COMPTIME_STATE_PENDING,
+    };
+    da_append(&module_analyse->comptimes, comptime);
+}
+
+void analyse_block(AnalyseData *analyse_data, Node *node, Index node_index);
+
+LoopHint analyse_loop_hint_from_name(char const *name) {
+#define X(upper, lower)                 \
+    if (strcmp(name, #lower) == 0) {    \
+        return LOOP_HINT_##upper;       \
+    }
+    LOOP_HINTS
+#undef X
+    return LOOP_HINT_NONE;
+}
+
+bool analyse_loop_has_hint(AnalyseData *analyse_data, Index loop_node,
+                           LoopHint hint) {
+    Node     *node = &analyse_data->m->nodes.items[loop_node];
+    LoopData *ld   = &analyse_data->m->extra_data.items[node->data.lhs].data.loop;
+    for (usz i = 0; i < ld->hints.count; i++) {
+        char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                       ld->hints.items[i].name);
+        LoopHint found = analyse_loop_hint_from_name(name);
+        free(name);
+        if (found == hint) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether a #parallel loop is between the current scope and scope.
+bool analyse_crosses_parallel_loop(AnalyseData *analyse_data, Index scope) {
+    Index cur = analyse_data->cur_scope;
+    while (cur != scope && cur != analyse_data->module_analyse.root_scope) {
+        AnalyseScope *s = &analyse_data->module_analyse.scopes.items[cur];
+        if (s->type == ANALYSE_SCOPE_TYPE_LOOP &&
+            analyse_loop_has_hint(analyse_data, s->node, LOOP_HINT_PARALLEL)) {
+            return true;
+        }
+        cur = s->super_scope;
+    }
+    return false;
+}
+
+// Only variables and arguments can be assigned. A #parallel loop may only
+// assign the variables declared in it, so its iterations stay independent.
+void analyse_assignment(AnalyseData *analyse_data, Node *node,
+                        Index node_index) {
+    assert(node->type == NODE_TYPE_ASSIGNMENT);
+    char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                   node->main_token);
+    AnalyseVariable *variable = analyse_find_variable(analyse_data, name);
+    free(name);
+    if (variable == NULL) {
+        analyse_error(analyse_data, node_index,
+                      ANALYSE_ERROR_UNDEFINED_IDENTIFIER);
+        return;
+    }
+
+    AnalyseSymbol symbol =
+        analyse_data->module_analyse.symbols.items[variable->symbol];
+    if (symbol.kind != ANALYSE_SYMBOL_KIND_VARIABLE &&
+        symbol.kind != ANALYSE_SYMBOL_KIND_ARGUMENT) {
+        analyse_error(analyse_data, node_index, ANALYSE_ERROR_NOT_ASSIGNABLE);
+        return;
+    }
+    if (analyse_crosses_parallel_loop(analyse_data, symbol.scope)) {
+        analyse_error(analyse_data, node_index,
+                      ANALYSE_ERROR_PARALLEL_LOOP_ASSIGNMENT);
+        return;
+    }
+
+    Type expression_type;
+    if (!analyse_expression(analyse_data,
+                            &analyse_data->m->nodes.items[node->data.rhs],
+                            node->data.rhs, &expression_type)) {
+        return;
+    }
+    if (!analyse_convert(analyse_data, node->data.rhs, expression_type,
+                         variable->type)) {
+        analyse_error(analyse_data, node_index,
+                      ANALYSE_ERROR_VARIABLE_EXPRESSION_DIFFRENT_TYPE);
+        return;
+    }
+    node_column_set(&analyse_data->module_analyse.attributes.symbol,
+                    node_index, variable->symbol);
+}
+
+// Every hint may only be given once. #unroll takes an optional count of at
+// least 1, #vectorize a width that is a power of two up to
+// LOOP_HINT_MAX_VECTORIZE_WIDTH and #parallel no argument.
+void analyse_loop_hints(AnalyseData *analyse_data, LoopHintTokens *hints,
+                        Index node_index) {
+    u32 given = 0;
+    for (usz i = 0; i < hints->count; i++) {
+        LoopHintToken token = hints->items[i];
+        char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                       token.name);
+        LoopHint hint = analyse_loop_hint_from_name(name);
+        free(name);
+        if (hint == LOOP_HINT_NONE) {
+            analyse_error(analyse_data, node_index,
+                          ANALYSE_ERROR_UNKNOWN_LOOP_HINT);
+            continue;
+        }
+
+        u64 argument =
+            token.argument != 0
+                ? extra_data_integer(
+                      analyse_data->t,
+                      analyse_data->t->tokens[token.argument].extra_data)
+                : 0;
+        bool valid = !(given & (1u << hint));
+        switch (hint) {
+            case LOOP_HINT_UNROLL:
+                valid = valid && (token.argument == 0 || argument >= 1);
+                break;
+            case LOOP_HINT_VECTORIZE:
+                valid = valid && token.argument != 0 && argument >= 1 &&
+                        argument <= LOOP_HINT_MAX_VECTORIZE_WIDTH &&
+                        (argument & (argument - 1)) == 0;
+                break;
+            case LOOP_HINT_PARALLEL:
+                valid = valid && token.argument == 0;
+                break;
+            case LOOP_HINT_NONE:
+                break;
+        }
+        if (!valid) {
+            analyse_error(analyse_data, node_index,
+                          ANALYSE_ERROR_INVALID_LOOP_HINT);
+        }
+        given |= 1u << hint;
+    }
+}
+
+// The condition of a while loop has to be a bool. The range of a for loop
+// needs integer bounds with a common type, which is the type of the variable.
+// The operands are analysed outside of the loop scope.
+bool analyse_loop_operands(AnalyseData *analyse_data, Node *node,
+                           LoopData *ld, Type *out_type) {
+    Type lhs_type, rhs_type;
+    if (!analyse_expression(analyse_data,
+                            &analyse_data->m->nodes.items[ld->lhs], ld->lhs,
+                            &lhs_type)) {
+        return false;
+    }
+    if (node->type == NODE_TYPE_WHILE) {
+        if (!type_equal(lhs_type, (Type){.type = BUILTIN_TYPE_BOOL})) {
+            return analyse_error(analyse_data, ld->lhs,
+                                 ANALYSE_ERROR_CONDITION_NOT_BOOL);
+        }
+        return true;
+    }
+
+    if (!analyse_expression(analyse_data,
+                            &analyse_data->m->nodes.items[ld->rhs], ld->rhs,
+                            &rhs_type)) {
+        return false;
+    }
+    if (!analyse_unify(analyse_data, ld->lhs, lhs_type, ld->rhs, rhs_type,
+                       out_type) ||
+        !type_is_integer(*out_type) || type_is_vector(*out_type)) {
+        return analyse_error(analyse_data, ld->lhs,
+                             ANALYSE_ERROR_INVALID_RANGE);
+    }
+    return true;
+}
+
+// A loop opens a scope around its block, the variable of a for loop is
+// declared in it.
+void analyse_loop(AnalyseData *analyse_data, Node *node, Index node_index) {
+    assert(node->type == NODE_TYPE_WHILE || node->type == NODE_TYPE_FOR);
+    LoopData *ld = &analyse_data->m->extra_data.items[node->data.lhs].data.loop;
+    analyse_loop_hints(analyse_data, &ld->hints, node_index);
+
+    Type type;
+    if (!analyse_loop_operands(analyse_data, node, ld, &type)) {
+        return;
+    }
+    if (node->type == NODE_TYPE_FOR &&
+        is_identifier_in_use(analyse_data, node, analyse_data->cur_scope)) {
+        analyse_error(analyse_data, node_index,
+                      ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE);
+        return;
+    }
+
+    Index loop_scope;
+    begin_scope(analyse_data, &loop_scope, node_index, ANALYSE_SCOPE_TYPE_LOOP);
+    if (node->type == NODE_TYPE_FOR) {
+        AnalyseVariable variable = {
+            .type   = type,
+            .name   = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                        node->main_token),
+            .symbol = add_symbol(analyse_data,
+                                 (AnalyseSymbol){
+                                     .kind  = ANALYSE_SYMBOL_KIND_LOOP_VARIABLE,
+                                     .node  = node_index,
+                                     .scope = loop_scope,
+                                     .type  = type,
+                                 }),
+        };
+        node_column_set(&analyse_data->module_analyse.attributes.type,
+                        node_index, type);
+        node_column_set(&analyse_data->module_analyse.attributes.symbol,
+                        node_index, variable.symbol);
+
+        AnalyseVariable *variable_mem = malloc(sizeof(AnalyseVariable));
+        *variable_mem                 = variable;
+        HASH_ADD_STR(
+            analyse_data->module_analyse.scopes.items[loop_scope].variables,
+            name, variable_mem);
+    }
+
+    analyse_block(analyse_data, &analyse_data->m->nodes.items[node->data.rhs],
+                  node->data.rhs);
+    end_scope(analyse_data, loop_scope);
+}
+
+void analyse_return(AnalyseData *analyse_data, Node *node, Index node_index) {
+    assert(node->type == NODE_TYPE_RETURN);
+    Index function_scope = analyse_function_scope(analyse_data);
+    if (function_scope == ANALYSE_INDEX_NONE) {
+        AnalyseError error = {
+            .node = node_index,
+            .type = ANALYSE_ERROR_RETURN_NOT_ALLOWED_IN_NONE_FUNCTION_SCOPE,
+        };
+        da_append(&analyse_data->module_analyse.errors, error);
+        return;
+    }
+
+    Type expression_type;
+    if (!analyse_expression(analyse_data,
+                            &analyse_data->m->nodes.items[node->data.rhs],
+                            node->data.rhs, &expression_type)) {
+        return;
+    }
+
+    // A function with an unknown return type was never added and already
+    // reported.
+    AnalyseFunction *function = analyse_current_function(analyse_data);
+    if (function != NULL &&
+        !analyse_convert(analyse_data, node->data.rhs, expression_type,
+                         function->return_type)) {
+        AnalyseError error = {
+            .node = node_index,
+            .type = ANALYSE_ERROR_RETURN_EXPRESSION_DIFFRENT_TYPE,
+        };
+        da_append(&analyse_data->module_analyse.errors, error);
+    }
+}
+
 void analyse_block(AnalyseData *analyse_data, Node *node, Index node_index) {
     assert(node->type == NODE_TYPE_BLOCK);
     Index      extra_data = node->data.lhs;
@@ -311,12 +1251,10 @@ void analyse_block(AnalyseData *analyse_data, Node *node, Index node_index) {
     end_scope(analyse_data, block_scope);
 }
 
-void analyse_function_definition(AnalyseData *analyse_data, Node *node,
-                                 Index node_index) {
-
-    add_function_to_scope(analyse_data, analyse_data->cur_scope, node,
-                          node_index);
-
+// Analyses the arguments and the block of a function, the function itself has
+// to be already added to its scope.
+void analyse_function_body(AnalyseData *analyse_data, Node *node,
+                           Index node_index) {
     Index function_scope;
     assert(node->type == NODE_TYPE_FUNCTION_DEFINITION);
     Index                  extra_data = node->data.lhs;
@@ -326,7 +1264,7 @@ void analyse_function_definition(AnalyseData *analyse_data, Node *node,
                 ANALYSE_SCOPE_TYPE_FUNCTION);
 
     for (usz i = 0; i < function_prototype->args.count; i++) {
-        Type type;
+        Type type = {.type = BUILTIN_TYPE_NONE};
         if (!check_type(analyse_data, function_prototype->args.items[i].type,
                         &type)) {
 
@@ -336,10 +1274,30 @@ void analyse_function_definition(AnalyseData *analyse_data, Node *node,
             };
             da_append(&analyse_data->module_analyse.errors, error);
         }
+        char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                       function_prototype->args.items[i].name);
+        AnalyseVariable *existing;
+        HASH_FIND_STR(
+            analyse_data->module_analyse.scopes.items[function_scope].variables,
+            name, existing);
+        if (existing != NULL) {
+            free(name);
+            analyse_error(analyse_data, node_index,
+                          ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE);
+            continue;
+        }
         AnalyseVariable analyse_variable = {
-            .type = type,
-            .name = tokens_token_cstr(analyse_data->input, analyse_data->t,
-                                      function_prototype->args.items[i].name)};
+            .type   = type,
+            .name   = name,
+            .symbol = add_symbol(analyse_data,
+                                 (AnalyseSymbol){
+                                     .kind     = ANALYSE_SYMBOL_KIND_ARGUMENT,
+                                     .node     = node_index,
+                                     .argument = i,
+                                     .scope    = function_scope,
+                                     .type     = type,
+                                 }),
+        };
         AnalyseVariable *analyse_variable_mem = malloc(sizeof(AnalyseVariable));
         *analyse_variable_mem                 = analyse_variable;
 
@@ -354,19 +1312,44 @@ void analyse_function_definition(AnalyseData *analyse_data, Node *node,
     end_scope(analyse_data, function_scope);
 }
 
+void analyse_function_definition(AnalyseData *analyse_data, Node *node,
+                                 Index node_index) {
+    add_function_to_scope(analyse_data, analyse_data->cur_scope, node,
+                          node_index);
+    analyse_function_body(analyse_data, node, node_index);
+}
+
+// Phase 1: Only collects the signature of top level functions, the bodies are
+// analysed in phase 2 after all functions are known. Comptime declarations are
+// analysed after all signatures.
 void analyse_top_level_node(AnalyseData *analyse_data, Index node_index) {
     AnalyseError error;
     Node        *node = &analyse_data->m->nodes.items[node_index];
+    node_column_set(&analyse_data->module_analyse.attributes.scope, node_index,
+                    analyse_data->cur_scope);
 
     switch (node->type) {
         case NODE_TYPE_FUNCTION_DEFINITION:
-            analyse_function_definition(analyse_data, node, node_index);
+            add_function_to_scope(analyse_data, analyse_data->cur_scope, node,
+                                  node_index);
+            return;
+        // Imports are declared after all functions, see analyse_import
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_IMPORT:
         case NODE_TYPE_EOF:
             return;
 
         case NODE_TYPE_BLOCK:
         case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_BINARY_OPERATION:
+        case NODE_TYPE_CALL:
         case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+        case NODE_TYPE_RETURN:
             error = (AnalyseError){
                 .type = ANALYSE_ERROR_INVALID_TOP_LEVEL_STATEMENT,
                 .node = node_index,
@@ -376,8 +1359,64 @@ void analyse_top_level_node(AnalyseData *analyse_data, Index node_index) {
     }
 }
 
+// Declares the functions of the imported interface in the root scope. The
+// functions of the module are already declared, so a clash is reported at the
+// import.
+void analyse_import(AnalyseData *analyse_data, Node *node, Index node_index) {
+    char *name = tokens_token_cstr(analyse_data->input, analyse_data->t,
+                                   node->main_token);
+    ModuleInterface *interface =
+        analyse_data->imports != NULL
+            ? module_interfaces_find(analyse_data->imports, name)
+            : NULL;
+    free(name);
+    if (interface == NULL) {
+        analyse_error(analyse_data, node_index, ANALYSE_ERROR_UNKNOWN_MODULE);
+        return;
+    }
+
+    Index         root_scope = analyse_data->module_analyse.root_scope;
+    AnalyseScope *root = &analyse_data->module_analyse.scopes.items[root_scope];
+    for (usz i = 0; i < interface->functions.count; i++) {
+        InterfaceFunction *imported = &interface->functions.items[i];
+        AnalyseFunction   *existing;
+        AnalyseVariable   *variable;
+        HASH_FIND_STR(root->functions, imported->name, existing);
+        HASH_FIND_STR(root->variables, imported->name, variable);
+        if (existing != NULL || variable != NULL) {
+            analyse_error(analyse_data, node_index,
+                          ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE);
+            continue;
+        }
+
+        AnalyseSymbol symbol = {
+            .kind  = ANALYSE_SYMBOL_KIND_IMPORTED_FUNCTION,
+            .node  = node_index,
+            .scope = root_scope,
+            .type  = imported->return_type,
+        };
+        AnalyseFunction *function = malloc(sizeof(AnalyseFunction));
+        *function                 = (AnalyseFunction){
+                            .name        = analyse_strdup(imported->name),
+                            .module      = analyse_strdup(interface->name),
+                            .node        = node_index,
+                            .symbol      = add_symbol(analyse_data, symbol),
+                            .return_type = imported->return_type,
+                            .attributes  = imported->attributes,
+        };
+        for (usz a = 0; a < imported->argument_types.count; a++) {
+            da_append(&function->argument_types,
+                      imported->argument_types.items[a]);
+        }
+        HASH_ADD_STR(root->functions, name, function);
+    }
+}
+
 void analyse_node(AnalyseData *analyse_data, Node *node, Index node_index) {
     AnalyseError error;
+    // Blocks, loops and functions overwrite this with the scope they open.
+    node_column_set(&analyse_data->module_analyse.attributes.scope, node_index,
+                    analyse_data->cur_scope);
     switch (node->type) {
 
         case NODE_TYPE_BLOCK:
@@ -396,6 +1435,13 @@ void analyse_node(AnalyseData *analyse_data, Node *node, Index node_index) {
             analyse_function_definition(analyse_data, node, node_index);
             return;
         case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_BINARY_OPERATION:
+        case NODE_TYPE_CALL:
+        // Only allowed at the top level
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_IMPORT:
             error = (AnalyseError){
                 .node = node_index,
                 .type = ANALYSE_ERROR_INVALID_NODE,
@@ -414,25 +1460,389 @@ void analyse_node(AnalyseData *analyse_data, Node *node, Index node_index) {
             }
             analyse_variable(analyse_data, node, node_index);
             return;
+        case NODE_TYPE_ASSIGNMENT:
+            analyse_assignment(analyse_data, node, node_index);
+            return;
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+            analyse_loop(analyse_data, node, node_index);
+            return;
+        case NODE_TYPE_RETURN:
+            analyse_return(analyse_data, node, node_index);
+            return;
         case NODE_TYPE_EOF:
             return;
     }
 }
 
-ModuleAnalyse analyse_module(Module *m, Tokens *t, str input) {
+
+// A function whose body gets analysed in phase 2, all nodes of the function
+// are in the range first_node..=node.
+typedef struct AnalyseFunctionBody AnalyseFunctionBody;
+struct AnalyseFunctionBody {
+    Index first_node;
+    Index node;
+};
+
+typedef struct AnalyseFunctionBodies AnalyseFunctionBodies;
+struct AnalyseFunctionBodies {
+    usz                  count;
+    usz                  capacity;
+    AnalyseFunctionBody *items;
+};
+
+// Every worker is a task of the thread pool that analyses a contiguous range
+// of function bodies into its own scopes, symbols and errors. Scope 0 of a worker is a copy of the root scope
+// and the first shared_symbols symbols are copies of the phase 1 symbols, both
+// are only read during phase 2. The node columns are shared, because the
+// functions of different workers never share a node.
+typedef struct AnalyseWorker AnalyseWorker;
+struct AnalyseWorker {
+    AnalyseData            data;
+    AnalyseFunctionBodies *bodies;
+    usz                    begin;
+    usz                    end;
+    Index                  shared_symbols;
+};
+
+void analyse_worker_run(void *arg) {
+    AnalyseWorker *worker = arg;
+    for (usz i = worker->begin; i < worker->end; i++) {
+        Index node_index = worker->bodies->items[i].node;
+        analyse_function_body(&worker->data,
+                              &worker->data.m->nodes.items[node_index],
+                              node_index);
+    }
+}
+
+Index analyse_worker_global_scope(Index scope, Index root_scope,
+                                  Index scope_base) {
+    if (scope == ANALYSE_INDEX_NONE) {
+        return scope;
+    }
+    return scope == 0 ? root_scope : scope_base + scope - 1;
+}
+
+Index analyse_worker_global_symbol(Index symbol, Index shared_symbols,
+                                   Index symbol_base) {
+    if (symbol == ANALYSE_INDEX_NONE || symbol < shared_symbols) {
+        return symbol;
+    }
+    return symbol_base + symbol - shared_symbols;
+}
+
+// Moves the results of a worker into the module analyse. Workers are merged
+// in source order, so the result is the same for every thread count.
+void analyse_worker_merge(AnalyseData *analyse_data, AnalyseWorker *worker) {
+    ModuleAnalyse *global      = &analyse_data->module_analyse;
+    ModuleAnalyse *local       = &worker->data.module_analyse;
+    Index          root_scope  = global->root_scope;
+    Index          scope_base  = global->scopes.count;
+    Index          symbol_base = global->symbols.count;
+    Index          shared      = worker->shared_symbols;
+
+    for (usz i = 1; i < local->scopes.count; i++) {
+        AnalyseScope scope = local->scopes.items[i];
+        scope.super_scope  = analyse_worker_global_scope(
+            scope.super_scope, root_scope, scope_base);
+
+        AnalyseVariable *var, *var_tmp;
+        HASH_ITER(hh, scope.variables, var, var_tmp) {
+            var->symbol =
+                analyse_worker_global_symbol(var->symbol, shared, symbol_base);
+        }
+        da_append(&global->scopes, scope);
+    }
+
+    for (usz i = shared; i < local->symbols.count; i++) {
+        AnalyseSymbol symbol = local->symbols.items[i];
+        symbol.scope =
+            analyse_worker_global_scope(symbol.scope, root_scope, scope_base);
+        da_append(&global->symbols, symbol);
+    }
+
+    for (usz i = 0; i < local->errors.count; i++) {
+        da_append(&global->errors, local->errors.items[i]);
+    }
+
+    NodeAttributes *attributes = &global->attributes;
+    for (usz i = worker->begin; i < worker->end; i++) {
+        AnalyseFunctionBody body = worker->bodies->items[i];
+        for (Index node = body.first_node; node <= body.node; node++) {
+            node_column_set(&attributes->scope, node,
+                            analyse_worker_global_scope(
+                                node_column_get(&attributes->scope, node),
+                                root_scope, scope_base));
+            node_column_set(&attributes->symbol, node,
+                            analyse_worker_global_symbol(
+                                node_column_get(&attributes->symbol, node),
+                                shared, symbol_base));
+        }
+    }
+
+    da_destroy(&local->scopes);
+    da_destroy(&local->symbols);
+    da_destroy(&local->errors);
+}
+
+usz analyse_thread_count(usz requested, usz function_count) {
+    usz thread_count = requested;
+    if (thread_count == 0) {
+        long cores   = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cores > 0 ? (usz)cores : 1;
+    }
+    if (thread_count > function_count) {
+        thread_count = function_count;
+    }
+    return thread_count == 0 ? 1 : thread_count;
+}
+
+ModuleAnalyse analyse_module_threaded(Module *m, Tokens *t, str input,
+                                      usz thread_count) {
+    return analyse_module_with_imports(m, t, input, NULL, thread_count);
+}
+
+ModuleAnalyse analyse_module_with_imports(Module *m, Tokens *t, str input,
+                                          ModuleInterfaces *imports,
+                                          usz               thread_count) {
     ModuleAnalyse module_analyse = {0};
     AnalyseData   analyse_data   = {
             .m              = m,
             .t              = t,
             .input          = input,
             .module_analyse = module_analyse,
+            .imports        = imports,
     };
 
+    NodeAttributes *attributes = &analyse_data.module_analyse.attributes;
+    node_column_init(&attributes->scope, m->nodes.count, ANALYSE_INDEX_NONE);
+    node_column_init(&attributes->type, m->nodes.count,
+                     (Type){.type = BUILTIN_TYPE_NONE});
+    node_column_init(&attributes->converted, m->nodes.count,
+                     (Type){.type = BUILTIN_TYPE_NONE});
+    node_column_init(&attributes->symbol, m->nodes.count, ANALYSE_INDEX_NONE);
+
     analyse_data_init_types(&analyse_data);
+    begin_scope(&analyse_data, &analyse_data.module_analyse.root_scope, 0,
+                ANALYSE_SCOPE_TYPE_TOP_LEVEL);
+
+    // Phase 1: Collect all top level functions and the imported functions and
+    // analyse the comptime declarations, which can call all of them.
+    AnalyseFunctionBodies bodies = {0};
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node_index = m->top_level_nodes.items[i];
+        analyse_top_level_node(&analyse_data, node_index);
 
+        if (m->nodes.items[node_index].type == NODE_TYPE_FUNCTION_DEFINITION) {
+            AnalyseFunctionBody body = {
+                .first_node = flat_subtree_begin(m, node_index),
+                .node       = node_index,
+            };
+            da_append(&bodies, body);
+        }
+    }
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node_index = m->top_level_nodes.items[i];
+        Node *node       = &m->nodes.items[node_index];
+        if (node->type == NODE_TYPE_IMPORT) {
+            analyse_import(&analyse_data, node, node_index);
+        }
+    }
     for (usz i = 0; i < m->top_level_nodes.count; i++) {
-        analyse_top_level_node(&analyse_data, m->top_level_nodes.items[i]);
+        Index node_index = m->top_level_nodes.items[i];
+        Node *node       = &m->nodes.items[node_index];
+        if (node->type == NODE_TYPE_COMPTIME_DECLARATION) {
+            analyse_comptime_declaration(&analyse_data, node, node_index);
+        }
+    }
+
+    // Phase 2: Analyse the function bodies
+    thread_count           = analyse_thread_count(thread_count, bodies.count);
+    AnalyseWorker *workers = calloc(thread_count, sizeof(AnalyseWorker));
+    AnalyseScope   root =
+        analyse_data.module_analyse.scopes
+            .items[analyse_data.module_analyse.root_scope];
+
+    for (usz i = 0; i < thread_count; i++) {
+        AnalyseWorker *worker = &workers[i];
+        ModuleAnalyse *local  = &worker->data.module_analyse;
+        worker->bodies        = &bodies;
+        worker->begin         = bodies.count * i / thread_count;
+        worker->end           = bodies.count * (i + 1) / thread_count;
+        worker->data.m        = m;
+        worker->data.t        = t;
+        worker->data.input    = input;
+        local->attributes     = *attributes;
+        local->types          = analyse_data.module_analyse.types;
+        da_append(&local->scopes, root);
+        ModuleAnalyse *global  = &analyse_data.module_analyse;
+        worker->shared_symbols = global->symbols.count;
+        for (usz s = 0; s < global->symbols.count; s++) {
+            da_append(&local->symbols, global->symbols.items[s]);
+        }
+    }
+
+    if (thread_count == 1) {
+        analyse_worker_run(&workers[0]);
+    } else {
+        ThreadPool     *pool  = thread_pool_global();
+        ThreadPoolGroup group = {0};
+        for (usz i = 0; i < thread_count; i++) {
+            thread_pool_submit(pool, &group, analyse_worker_run, &workers[i]);
+        }
+        thread_pool_wait(pool, &group);
+    }
+
+    for (usz i = 0; i < thread_count; i++) {
+        analyse_worker_merge(&analyse_data, &workers[i]);
+    }
+
+    free(workers);
+    da_destroy(&bodies);
+
+    if (analyse_data.module_analyse.errors.count == 0) {
+        comptime_evaluate(m, &analyse_data.module_analyse, t, input);
     }
 
-    return module_analyse;
+    return analyse_data.module_analyse;
+}
+
+ModuleAnalyse analyse_module(Module *m, Tokens *t, str input) {
+    return analyse_module_threaded(m, t, input, 0);
+}
+
+ModuleInterface analyse_module_interface(Module *m, ModuleAnalyse *ma) {
+    ModuleInterface interface = {.name = to_cstr(m->name)};
+    FunctionAttributes export = FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_EXPORT);
+
+    AnalyseFunction *function, *function_tmp;
+    HASH_ITER(hh, ma->scopes.items[ma->root_scope].functions, function,
+              function_tmp) {
+        if (function->module != NULL || !(function->attributes & export)) {
+            continue;
+        }
+        InterfaceFunction exported = {
+            .name        = analyse_strdup(function->name),
+            .return_type = function->return_type,
+            .attributes  = function->attributes,
+        };
+        for (usz i = 0; i < function->argument_types.count; i++) {
+            da_append(&exported.argument_types,
+                      function->argument_types.items[i]);
+        }
+        module_interface_add(&interface, exported);
+    }
+    return interface;
+}
+
+char *analyse_symbol_name(Module *m, AnalyseFunction *function) {
+    char *module = function->module != NULL ? analyse_strdup(function->module)
+                                            : to_cstr(m->name);
+    str   name   = strcmp(module, "main") == 0
+                       ? str_format("%s", function->name)
+                       : str_format("%s.%s", module, function->name);
+    free(module);
+    char *cstr = to_cstr(name);
+    str_destroy(name);
+    return cstr;
+}
+
+AnalyseComptime *analyse_find_comptime(ModuleAnalyse *module_analyse,
+                                       Index          symbol) {
+    for (usz i = 0; i < module_analyse->comptimes.count; i++) {
+        if (module_analyse->comptimes.items[i].symbol == symbol) {
+            return &module_analyse->comptimes.items[i];
+        }
+    }
+    return NULL;
+}
+
+AnalyseFunction *analyse_find_function(ModuleAnalyse *module_analyse,
+                                       Index scope, char const *name) {
+    while (true) {
+        AnalyseFunction *function;
+        HASH_FIND_STR(module_analyse->scopes.items[scope].functions, name,
+                      function);
+        if (function != NULL || scope == module_analyse->root_scope) {
+            return function;
+        }
+        scope = module_analyse->scopes.items[scope].super_scope;
+    }
+}
+
+char const *analyse_error_type_str(AnalyseErrorType type) {
+    switch (type) {
+        case ANALYSE_ERROR_NONE:
+            return "no error";
+        case ANALYSE_ERROR_INVALID_TOP_LEVEL_STATEMENT:
+            return "statement is not allowed at the top level";
+        case ANALYSE_ERROR_FUNCTION_NOT_ALLOWED_IN_SCOPE:
+            return "functions are not allowed in this scope";
+        case ANALYSE_ERROR_UNKOWN_TYPE:
+            return "unknown type";
+        case ANALYSE_ERROR_VARIABLE_UNKOWN_TYPE:
+            return "unknown type for variable";
+        case ANALYSE_ERROR_VARIABLE_EXPRESSION_DIFFRENT_TYPE:
+            return "the expression has a different type than the variable";
+        case ANALYSE_ERROR_EXPECTED_EXPRESSION_FOR_VARIABLE_DECLARATION:
+            return "expected an expression for the variable declaration";
+        case ANALYSE_ERROR_INVALID_NODE:
+            return "invalid statement";
+        case ANALYSE_ERROR_VARIABLE_NOT_ALLOWED_IN_NONE_FUNCTION_SCOPE:
+            return "variables are only allowed in functions";
+        case ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE:
+            return "identifier is already in use";
+        case ANALYSE_ERROR_UNDEFINED_IDENTIFIER:
+            return "undefined identifier";
+        case ANALYSE_ERROR_OPERANDS_DIFFRENT_TYPE:
+            return "the operands have different types";
+        case ANALYSE_ERROR_RETURN_EXPRESSION_DIFFRENT_TYPE:
+            return "the expression has a different type than the return type";
+        case ANALYSE_ERROR_RETURN_NOT_ALLOWED_IN_NONE_FUNCTION_SCOPE:
+            return "return is only allowed in functions";
+        case ANALYSE_ERROR_UNDEFINED_FUNCTION:
+            return "undefined function";
+        case ANALYSE_ERROR_CALL_ARGUMENT_COUNT:
+            return "wrong number of arguments for the function";
+        case ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE:
+            return "the argument has a different type than the parameter";
+        case ANALYSE_ERROR_INVALID_LANE:
+            return "the lane has to be an integer literal smaller than the "
+                   "lanes of the vector";
+        case ANALYSE_ERROR_UNKNOWN_ATTRIBUTE:
+            return "unknown function attribute";
+        case ANALYSE_ERROR_CONFLICTING_ATTRIBUTES:
+            return "the function attribute conflicts with another attribute";
+        case ANALYSE_ERROR_FASTCC_MAIN:
+            return "main is called from C and can not use @fastcc";
+        case ANALYSE_ERROR_IMPURE_CALL:
+            return "a @pure function can only call @pure functions";
+        case ANALYSE_ERROR_NOT_ASSIGNABLE:
+            return "only variables and arguments can be assigned";
+        case ANALYSE_ERROR_INVALID_OPERAND_TYPE:
+            return "the operator can not be used with the type of the operands";
+        case ANALYSE_ERROR_CONDITION_NOT_BOOL:
+            return "the condition of a while loop has to be a bool";
+        case ANALYSE_ERROR_INVALID_RANGE:
+            return "the range of a for loop needs integer bounds of a common "
+                   "type";
+        case ANALYSE_ERROR_UNKNOWN_LOOP_HINT:
+            return "unknown loop hint";
+        case ANALYSE_ERROR_INVALID_LOOP_HINT:
+            return "the loop hint is repeated or has an invalid argument";
+        case ANALYSE_ERROR_PARALLEL_LOOP_ASSIGNMENT:
+            return "a #parallel loop can only assign variables declared in it";
+        case ANALYSE_ERROR_COMPTIME_IMPURE_CALL:
+            return "a comptime declaration can only call @pure functions";
+        case ANALYSE_ERROR_COMPTIME_CYCLE:
+            return "the comptime declaration depends on its own value";
+        case ANALYSE_ERROR_COMPTIME_LIMIT:
+            return "the comptime evaluation exceeded the step or call depth "
+                   "limit";
+        case ANALYSE_ERROR_UNKNOWN_MODULE:
+            return "no interface of the imported module was found";
+        case ANALYSE_ERROR_COMPTIME_IMPORTED_CALL:
+            return "a comptime declaration can not call imported functions";
+    }
+    return "invalid analyse error";
 }
@@ -1,10 +1,15 @@
 #pragma once
 
 #include "ast.h"
+#include "interface.h"
 #include "language.h"
 #include "lexer.h"
+#include "node_column.h"
 #include "uthash.h"
 
+// Used in the node columns for nodes that don't have a scope or symbol.
+#define ANALYSE_INDEX_NONE ((Index)-1)
+
 enum AnalyseScopeType {
     // Can contain functions but no variables
     ANALYSE_SCOPE_TYPE_TOP_LEVEL,
@@ -12,6 +17,9 @@ enum AnalyseScopeType {
     ANALYSE_SCOPE_TYPE_FUNCTION,
     // Same as function, just diffrent name
     ANALYSE_SCOPE_TYPE_BLOCK,
+    // Opened by for and while around their block, contains the variable of a
+    // for loop
+    ANALYSE_SCOPE_TYPE_LOOP,
 };
 typedef enum AnalyseScopeType AnalyseScopeType;
 
@@ -26,6 +34,30 @@ enum AnalyseErrorType {
     ANALYSE_ERROR_INVALID_NODE,
     ANALYSE_ERROR_VARIABLE_NOT_ALLOWED_IN_NONE_FUNCTION_SCOPE,
     ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE,
+    ANALYSE_ERROR_UNDEFINED_IDENTIFIER,
+    ANALYSE_ERROR_OPERANDS_DIFFRENT_TYPE,
+    ANALYSE_ERROR_RETURN_EXPRESSION_DIFFRENT_TYPE,
+    ANALYSE_ERROR_RETURN_NOT_ALLOWED_IN_NONE_FUNCTION_SCOPE,
+    ANALYSE_ERROR_UNDEFINED_FUNCTION,
+    ANALYSE_ERROR_CALL_ARGUMENT_COUNT,
+    ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE,
+    ANALYSE_ERROR_INVALID_LANE,
+    ANALYSE_ERROR_UNKNOWN_ATTRIBUTE,
+    ANALYSE_ERROR_CONFLICTING_ATTRIBUTES,
+    ANALYSE_ERROR_FASTCC_MAIN,
+    ANALYSE_ERROR_IMPURE_CALL,
+    ANALYSE_ERROR_NOT_ASSIGNABLE,
+    ANALYSE_ERROR_INVALID_OPERAND_TYPE,
+    ANALYSE_ERROR_CONDITION_NOT_BOOL,
+    ANALYSE_ERROR_INVALID_RANGE,
+    ANALYSE_ERROR_UNKNOWN_LOOP_HINT,
+    ANALYSE_ERROR_INVALID_LOOP_HINT,
+    ANALYSE_ERROR_PARALLEL_LOOP_ASSIGNMENT,
+    ANALYSE_ERROR_COMPTIME_IMPURE_CALL,
+    ANALYSE_ERROR_COMPTIME_CYCLE,
+    ANALYSE_ERROR_COMPTIME_LIMIT,
+    ANALYSE_ERROR_UNKNOWN_MODULE,
+    ANALYSE_ERROR_COMPTIME_IMPORTED_CALL,
 };
 typedef enum AnalyseErrorType AnalyseErrorType;
 
@@ -37,26 +69,109 @@ struct AnalyseError {
     Index            node;
 };
 
+// Functions that are part of the language, a thor function with the same name
+// shadows them. Calls of builtins and vector constructors like u32x4(1, 2, 3, 4)
+// have no symbol.
+#define ANALYSE_BUILTINS                                         \
+    /* extract(vector, lane), lane is an integer literal */      \
+    X(EXTRACT, extract)                                          \
+    /* insert(vector, lane, value), returns the new vector */    \
+    X(INSERT, insert)                                            \
+    /* shuffle(a, b, lanes...), lanes index into a and then b,   \
+       the result has one lane per index */                      \
+    X(SHUFFLE, shuffle)                                          \
+    /* arena(size), a new arena with blocks of size bytes, or of \
+       the default size for 0. Returns the u64 handle */         \
+    X(ARENA, arena)                                              \
+    /* alloc(arena, size), returns the u64 address of size      \
+       bytes, freed with the arena */                            \
+    X(ALLOC, alloc)                                              \
+    /* reset(arena), frees all allocations, returns the arena */ \
+    X(RESET, reset)                                              \
+    /* release(arena), frees the arena, returns 0 */             \
+    X(RELEASE, release)
+
+enum AnalyseBuiltin {
+    ANALYSE_BUILTIN_NONE,
+#define X(upper, lower) ANALYSE_BUILTIN_##upper,
+    ANALYSE_BUILTINS
+#undef X
+};
+typedef enum AnalyseBuiltin AnalyseBuiltin;
+
+enum AnalyseSymbolKind {
+    ANALYSE_SYMBOL_KIND_FUNCTION,
+    // A function of an imported module, declared by the import node
+    ANALYSE_SYMBOL_KIND_IMPORTED_FUNCTION,
+    ANALYSE_SYMBOL_KIND_VARIABLE,
+    ANALYSE_SYMBOL_KIND_ARGUMENT,
+    // The variable of a for loop, it can not be assigned
+    ANALYSE_SYMBOL_KIND_LOOP_VARIABLE,
+    // A comptime declaration, its value is in ModuleAnalyse.comptimes
+    ANALYSE_SYMBOL_KIND_COMPTIME,
+};
+typedef enum AnalyseSymbolKind AnalyseSymbolKind;
+
+// Every declared function, variable and argument gets a symbol, the symbol id
+// is the index into ModuleAnalyse.symbols.
+typedef struct AnalyseSymbol AnalyseSymbol;
+struct AnalyseSymbol {
+    AnalyseSymbolKind kind;
+    // The declaring node, the function node for arguments and the loop node
+    // for loop variables
+    Index             node;
+    // Only used for arguments, the position in the argument list
+    usz               argument;
+    Index             scope;
+    Type              type;
+};
+
 typedef struct AnalyseFunction AnalyseFunction;
 struct AnalyseFunction {
     UT_hash_handle hh;
     char          *name;
+    // The module of an imported function, NULL for the functions of this
+    // module
+    char          *module;
+    // The function node, or the import node of an imported function
     Index          node;
+    Index          symbol;
     Type           return_type;
     struct {
         usz   count;
         usz   capacity;
         Type *items;
     } argument_types;
+    // The valid attributes of the function
+    FunctionAttributes attributes;
 };
 
 typedef struct AnalyseVariable AnalyseVariable;
 struct AnalyseVariable {
     UT_hash_handle hh;
     char          *name;
+    Index          symbol;
     Type           type;
 };
 
+enum AnalyseComptimeState {
+    ANALYSE_COMPTIME_STATE_PENDING,
+    // Being evaluated, a use in this state is a cycle
+    ANALYSE_COMPTIME_STATE_EVALUATING,
+    ANALYSE_COMPTIME_STATE_DONE,
+    ANALYSE_COMPTIME_STATE_FAILED,
+};
+typedef enum AnalyseComptimeState AnalyseComptimeState;
+
+typedef struct AnalyseComptime AnalyseComptime;
+struct AnalyseComptime {
+    Index                node;
+    Index                symbol;
+    AnalyseComptimeState state;
+    // Only valid in ANALYSE_COMPTIME_STATE_DONE
+    ComptimeValue        value;
+};
+
 typedef struct AnalyseScope AnalyseScope;
 struct AnalyseScope {
     AnalyseFunction *functions;
@@ -68,13 +183,6 @@ struct AnalyseScope {
     AnalyseScopeType type;
 };
 
-typedef struct NodeToScope NodeToScope;
-struct NodeToScope {
-    UT_hash_handle hh;
-    Index          node;
-    Index          scope;
-};
-
 typedef struct TypeNameToType TypeNameToType;
 struct TypeNameToType {
     UT_hash_handle hh;
@@ -82,11 +190,29 @@ struct TypeNameToType {
     Type           type;
 };
 
+NODE_COLUMN(Index, Index)
+NODE_COLUMN(Type, Type)
+
+// The analysis results per node, every column has Module.nodes.count entries.
+typedef struct NodeAttributes NodeAttributes;
+struct NodeAttributes {
+    // The scope a function or block node opened, for every other node the
+    // scope it was analysed in. ANALYSE_INDEX_NONE if never analysed.
+    NodeColumnIndex scope;
+    // The resolved type of expressions and variable declarations.
+    NodeColumnType  type;
+    // The type an expression is implicitly converted to where it is used,
+    // BUILTIN_TYPE_NONE if it is used as it is.
+    NodeColumnType  converted;
+    // The symbol declared by the node, the variable an identifier or
+    // assignment refers to or the function a call refers to.
+    // ANALYSE_INDEX_NONE if there is none.
+    NodeColumnIndex symbol;
+};
+
 typedef struct ModuleAnalyse ModuleAnalyse;
 struct ModuleAnalyse {
-    // Which scope to which node
-    // All nodes are allocated with malloc, don't forget to free all of them.
-    NodeToScope    *nodes_to_scopes;
+    NodeAttributes  attributes;
     TypeNameToType *types;
     Index           root_scope;
     struct {
@@ -95,6 +221,19 @@ struct ModuleAnalyse {
         AnalyseScope *items;
     } scopes;
 
+    struct {
+        usz            count;
+        usz            capacity;
+        AnalyseSymbol *items;
+    } symbols;
+
+    // The comptime declarations in source order
+    struct {
+        usz              count;
+        usz              capacity;
+        AnalyseComptime *items;
+    } comptimes;
+
     struct {
         usz           count;
         usz           capacity;
@@ -102,4 +241,43 @@ struct ModuleAnalyse {
     } errors;
 };
 
+// Analyses the module in two phases. Phase 1 collects the signatures of all top
+// level functions, so functions can be used before their declaration, and
+// then the comptime declarations. Phase 2 analyses the function bodies in
+// thread_count tasks on the global thread pool, 0 uses one task per core. The
+// result does not depend on the thread count. Without errors, the comptime declarations are
+// evaluated afterwards.
+ModuleAnalyse analyse_module_threaded(Module *m, Tokens *t, str input,
+                                      usz thread_count);
+// Same as analyse_module_threaded, the import nodes declare the functions of
+// the interfaces with their name. imports may be NULL for a module without
+// imports.
+ModuleAnalyse analyse_module_with_imports(Module *m, Tokens *t, str input,
+                                          ModuleInterfaces *imports,
+                                          usz               thread_count);
+// Same as analyse_module_threaded with one task per core.
 ModuleAnalyse analyse_module(Module *m, Tokens *t, str input);
+void          free_module_analyse(ModuleAnalyse *module_analyse);
+
+// The interface with the @export functions of the analysed module.
+ModuleInterface analyse_module_interface(Module *m, ModuleAnalyse *ma);
+// The name of the function in the generated code. The functions of the main
+// module keep their name, the functions of every other module are prefixed
+// with the module, like math.add, so modules can use the same names. Has to be
+// freed.
+char           *analyse_symbol_name(Module *m, AnalyseFunction *function);
+
+// Searches the function in scope and all its super scopes, NULL if there is no
+// function with that name.
+AnalyseFunction *analyse_find_function(ModuleAnalyse *module_analyse,
+                                       Index scope, char const *name);
+// The comptime declaration of the symbol, NULL if it is none.
+AnalyseComptime *analyse_find_comptime(ModuleAnalyse *module_analyse,
+                                       Index          symbol);
+// ANALYSE_BUILTIN_NONE if name is no builtin.
+AnalyseBuiltin   analyse_builtin_from_name(char const *name);
+// The builtins that call the arena functions of the runtime.
+bool             analyse_builtin_is_arena(AnalyseBuiltin builtin);
+// LOOP_HINT_NONE if name is no loop hint.
+LoopHint         analyse_loop_hint_from_name(char const *name);
+char const      *analyse_error_type_str(AnalyseErrorType type);
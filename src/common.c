@@ -1,9 +1,12 @@
 #include "common.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "da.h"
 
 typedef struct string_pool_node string_pool_node;
@@ -18,7 +21,7 @@ static struct {
 
 char *to_cstr_in_string_pool(str str) {
     char *new_str = malloc(str.len + 1);
-    memcpy(new_str, str.ptr, str.len + 1);
+    memcpy(new_str, str.ptr, str.len);
     new_str[str.len] = '\0';
 
     string_pool_take_ownership(new_str);
@@ -27,7 +30,7 @@ char *to_cstr_in_string_pool(str str) {
 
 char *to_cstr(str str) {
     char *new_str = malloc(str.len + 1);
-    memcpy(new_str, str.ptr, str.len + 1);
+    memcpy(new_str, str.ptr, str.len);
     new_str[str.len] = '\0';
     return new_str;
 }
@@ -122,6 +125,42 @@ void str_fprintln(FILE *file, str to_print) {
     fwrite("\n", sizeof(char), 1, file);
 }
 
+bool read_file(char const *path, str *out) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        fclose(file);
+        return false;
+    }
+    long len = ftell(file);
+    if (len < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    char *buffer = malloc(len > 0 ? len : 1);
+    if (fread(buffer, 1, len, file) != (usz)len) {
+        free(buffer);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    *out = (str){.ptr = buffer, .len = len};
+    return true;
+}
+
+str path_directory(char const *path) {
+    char const *slash = strrchr(path, '/');
+    if (slash == NULL) {
+        return str_format(".");
+    }
+    return str_format("%.*s", slash == path ? 1 : (int)(slash - path), path);
+}
+
 void string_pool_free(char *str) {
     string_pool_node *node      = string_pool.head;
     string_pool_node *prev_node = NULL;
@@ -188,58 +227,115 @@ bool vec_ensure_size(usz len, usz *cap, void **ptr, usz item_size,
     return true;
 }
 
+#define HASH_FNV1A_PRIME 0x100000001b3ull
+
+u64 hash_fnv1a(u64 hash, void const *bytes, usz len) {
+    u8 const *b = bytes;
+    for (usz i = 0; i < len; i++) {
+        hash ^= b[i];
+        hash *= HASH_FNV1A_PRIME;
+    }
+    return hash;
+}
+
+void *arena_alloc(Arena *arena, usz size) {
+    usz         align        = alignof(max_align_t);
+    usz         aligned_size = (size + align - 1) & ~(align - 1);
+    ArenaBlock *block        = arena->head;
+
+    if (block == NULL || block->capacity - block->used < aligned_size) {
+        usz capacity    = aligned_size > ARENA_BLOCK_SIZE ? aligned_size
+                                                          : ARENA_BLOCK_SIZE;
+        block           = malloc(sizeof(ArenaBlock) + capacity);
+        assert(block != NULL && "arena_alloc could not alloc");
+        block->next     = arena->head;
+        block->used     = 0;
+        block->capacity = capacity;
+        arena->head     = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += aligned_size;
+    return ptr;
+}
+
+void arena_reset(Arena *arena) {
+    if (arena->head == NULL) {
+        return;
+    }
+
+    ArenaBlock *block = arena->head->next;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+void arena_destroy(Arena *arena) {
+    arena_reset(arena);
+    free(arena->head);
+    arena->head = NULL;
+}
+
 static struct {
     usz    count;
     usz    capacity;
     FILE **items;
 } log_files = {.count = 0, .capacity = 0, .items = NULL};
 
+static _Thread_local FILE *log_captured = NULL;
+
 void log_register_file(FILE *file) { da_append(&log_files, file); }
-void log_debug(char const *format, ...) {
+void log_capture(FILE *file) { log_captured = file; }
+
+void log_write(FILE *file, char const *prefix, char const *format,
+               va_list va) {
+    va_list copy;
+    va_copy(copy, va);
+    fprintf(file, "%s", prefix);
+    vfprintf(file, format, copy);
+    va_end(copy);
+    fprintf(file, "\n%s", RESET);
+}
+
+void log_va(char const *prefix, char const *format, va_list va) {
+    if (log_captured != NULL) {
+        log_write(log_captured, prefix, format, va);
+        return;
+    }
     for (usz i = 0; i < log_files.count; i++) {
-        FILE *file = log_files.items[i];
-        fprintf(file, DEBUG "DEBUG: ");
-        va_list va;
-        va_start(va, format);
-        vfprintf(file, format, va);
-        va_end(va);
-        fprintf(file, "\n%s", RESET);
+        log_write(log_files.items[i], prefix, format, va);
     }
 }
+
+void log_debug(char const *format, ...) {
+    va_list va;
+    va_start(va, format);
+    log_va(DEBUG "DEBUG: ", format, va);
+    va_end(va);
+}
 void log_info(char const *format, ...) {
-    for (usz i = 0; i < log_files.count; i++) {
-        FILE *file = log_files.items[i];
-        fprintf(file, "INFO: ");
-        va_list va;
-        va_start(va, format);
-        vfprintf(file, format, va);
-        va_end(va);
-        fprintf(file, "\n%s", RESET);
-    }
+    va_list va;
+    va_start(va, format);
+    log_va("INFO: ", format, va);
+    va_end(va);
 }
 void log_warning(char const *format, ...) {
-    for (usz i = 0; i < log_files.count; i++) {
-        FILE *file = log_files.items[i];
-        fprintf(file, WARNING "WARNING: ");
-        va_list va;
-        va_start(va, format);
-        vfprintf(file, format, va);
-        va_end(va);
-        fprintf(file, "\n%s", RESET);
-    }
+    va_list va;
+    va_start(va, format);
+    log_va(WARNING "WARNING: ", format, va);
+    va_end(va);
 }
 void log_error(char const *format, ...) {
-    for (usz i = 0; i < log_files.count; i++) {
-        FILE *file = log_files.items[i];
-        fprintf(file, ERROR "ERROR: ");
-        va_list va;
-        va_start(va, format);
-        vfprintf(file, format, va);
-        va_end(va);
-        fprintf(file, "\n%s", RESET);
-    }
+    va_list va;
+    va_start(va, format);
+    log_va(ERROR "ERROR: ", format, va);
+    va_end(va);
 }
-// Aborts
+// Aborts. Always goes to the registered files, a captured log would be lost.
 void NORETURN log_fatal(char const *format, ...) {
     for (usz i = 0; i < log_files.count; i++) {
         FILE *file = log_files.items[i];
@@ -254,3 +350,445 @@ void NORETURN log_fatal(char const *format, ...) {
     }
     abort();
 }
+
+typedef struct ThreadPoolJob ThreadPoolJob;
+struct ThreadPoolJob {
+    ThreadPoolTask   task;
+    void            *data;
+    ThreadPoolGroup *group;
+};
+
+// A slot is read by thieves while the owner may write it, a thief only uses
+// what it read if it wins the race for top afterwards.
+typedef struct ThreadPoolSlot ThreadPoolSlot;
+struct ThreadPoolSlot {
+    _Atomic(ThreadPoolTask)    task;
+    _Atomic(void *)            data;
+    _Atomic(ThreadPoolGroup *) group;
+};
+
+// A buffer that was replaced by a larger one may still be read by a thief,
+// so it is only freed with the pool.
+typedef struct ThreadPoolBuffer ThreadPoolBuffer;
+struct ThreadPoolBuffer {
+    ThreadPoolBuffer *retired;
+    isz               capacity;
+    ThreadPoolSlot    slots[];
+};
+
+// The deque of Chase and Lev, with the C11 memory orders of "Correct and
+// Efficient Work-Stealing for Weak Memory Models" by Lê et al. Only the owner
+// pushes and takes at the bottom, every other worker steals at the top.
+typedef struct ThreadPoolDeque ThreadPoolDeque;
+struct ThreadPoolDeque {
+    alignas(64) _Atomic(isz) top;
+    alignas(64) _Atomic(isz) bottom;
+    _Atomic(ThreadPoolBuffer *) buffer;
+};
+
+// The tasks submitted from outside of the pool, a ring buffer.
+typedef struct ThreadPoolQueue ThreadPoolQueue;
+struct ThreadPoolQueue {
+    pthread_mutex_t lock;
+    usz             first;
+    usz             count;
+    usz             capacity;
+    ThreadPoolJob  *items;
+};
+
+typedef struct ThreadPoolWorker ThreadPoolWorker;
+struct ThreadPoolWorker {
+    ThreadPool     *pool;
+    pthread_t       thread;
+    usz             index;
+    ThreadPoolDeque deque;
+    // Tasks that are running on this worker, a task that waits runs others
+    usz             depth;
+    Arena           arena;
+};
+
+struct ThreadPool {
+    ThreadPoolWorker *workers;
+    usz               worker_count;
+    ThreadPoolQueue   injected;
+    // Tasks in the deques and the queue, the workers sleep while it is 0
+    _Atomic(usz)      queued;
+    // Tasks that are queued or running
+    _Atomic(usz)      unfinished;
+    _Atomic(bool)     stop;
+    pthread_mutex_t   lock;
+    // Signaled when a task is queued or the pool stops
+    pthread_cond_t    work;
+    // Signaled when a group or the whole pool is done, and when a task is
+    // queued while workers wait on a group
+    pthread_cond_t    done;
+    // Workers that wait on a group, guarded by lock
+    usz               waiting;
+};
+
+#define THREAD_POOL_INITIAL_CAPACITY 64
+
+// The worker that runs on this thread, NULL outside of every pool.
+static _Thread_local ThreadPoolWorker *thread_pool_current = NULL;
+
+ThreadPoolBuffer *thread_pool_buffer_create(isz capacity) {
+    ThreadPoolBuffer *buffer =
+        malloc(sizeof(ThreadPoolBuffer) + sizeof(ThreadPoolSlot) * capacity);
+    assert(buffer != NULL && "thread_pool_submit could not alloc");
+    buffer->retired  = NULL;
+    buffer->capacity = capacity;
+    return buffer;
+}
+
+void thread_pool_slot_store(ThreadPoolBuffer *buffer, isz index,
+                            ThreadPoolJob job) {
+    ThreadPoolSlot *slot = &buffer->slots[index % buffer->capacity];
+    atomic_store_explicit(&slot->task, job.task, memory_order_relaxed);
+    atomic_store_explicit(&slot->data, job.data, memory_order_relaxed);
+    atomic_store_explicit(&slot->group, job.group, memory_order_relaxed);
+}
+
+ThreadPoolJob thread_pool_slot_load(ThreadPoolBuffer *buffer, isz index) {
+    ThreadPoolSlot *slot = &buffer->slots[index % buffer->capacity];
+    return (ThreadPoolJob){
+        .task  = atomic_load_explicit(&slot->task, memory_order_relaxed),
+        .data  = atomic_load_explicit(&slot->data, memory_order_relaxed),
+        .group = atomic_load_explicit(&slot->group, memory_order_relaxed),
+    };
+}
+
+void thread_pool_deque_init(ThreadPoolDeque *deque) {
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->buffer,
+                thread_pool_buffer_create(THREAD_POOL_INITIAL_CAPACITY));
+}
+
+void thread_pool_deque_destroy(ThreadPoolDeque *deque) {
+    ThreadPoolBuffer *buffer = atomic_load(&deque->buffer);
+    while (buffer != NULL) {
+        ThreadPoolBuffer *retired = buffer->retired;
+        free(buffer);
+        buffer = retired;
+    }
+}
+
+void thread_pool_deque_push(ThreadPoolDeque *deque, ThreadPoolJob job) {
+    isz bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    isz top    = atomic_load_explicit(&deque->top, memory_order_acquire);
+    ThreadPoolBuffer *buffer =
+        atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+
+    if (bottom - top > buffer->capacity - 1) {
+        ThreadPoolBuffer *larger =
+            thread_pool_buffer_create(buffer->capacity * 2);
+        for (isz i = top; i < bottom; i++) {
+            thread_pool_slot_store(larger, i, thread_pool_slot_load(buffer, i));
+        }
+        larger->retired = buffer;
+        atomic_store_explicit(&deque->buffer, larger, memory_order_release);
+        buffer = larger;
+    }
+
+    thread_pool_slot_store(buffer, bottom, job);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+}
+
+// Takes the newest task, only called by the owner.
+bool thread_pool_deque_take(ThreadPoolDeque *deque, ThreadPoolJob *out) {
+    isz bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    ThreadPoolBuffer *buffer =
+        atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    isz top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    bool found = top <= bottom;
+    if (found) {
+        *out = thread_pool_slot_load(buffer, bottom);
+        if (top == bottom) {
+            // The last task, a thief may want it too.
+            found = atomic_compare_exchange_strong_explicit(
+                &deque->top, &top, top + 1, memory_order_seq_cst,
+                memory_order_relaxed);
+            atomic_store_explicit(&deque->bottom, bottom + 1,
+                                  memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return found;
+}
+
+// Takes the oldest task, fails if another worker took it first.
+bool thread_pool_deque_steal(ThreadPoolDeque *deque, ThreadPoolJob *out) {
+    isz top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    isz bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return false;
+    }
+
+    ThreadPoolBuffer *buffer =
+        atomic_load_explicit(&deque->buffer, memory_order_acquire);
+    *out = thread_pool_slot_load(buffer, top);
+    return atomic_compare_exchange_strong_explicit(
+        &deque->top, &top, top + 1, memory_order_seq_cst,
+        memory_order_relaxed);
+}
+
+void thread_pool_queue_push(ThreadPoolQueue *queue, ThreadPoolJob job) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        usz capacity = queue->capacity == 0 ? THREAD_POOL_INITIAL_CAPACITY
+                                            : queue->capacity * 2;
+        ThreadPoolJob *items = malloc(sizeof(ThreadPoolJob) * capacity);
+        assert(items != NULL && "thread_pool_submit could not alloc");
+        for (usz i = 0; i < queue->count; i++) {
+            items[i] = queue->items[(queue->first + i) % queue->capacity];
+        }
+        free(queue->items);
+        queue->items    = items;
+        queue->capacity = capacity;
+        queue->first    = 0;
+    }
+    queue->items[(queue->first + queue->count) % queue->capacity] = job;
+    queue->count += 1;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+bool thread_pool_queue_pop(ThreadPoolQueue *queue, ThreadPoolJob *out) {
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->count > 0;
+    if (found) {
+        *out         = queue->items[queue->first];
+        queue->first = (queue->first + 1) % queue->capacity;
+        queue->count -= 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+// The own deque first, then the tasks from outside and then the other
+// workers starting with the next one, so the thieves spread over the workers.
+bool thread_pool_find(ThreadPoolWorker *worker, ThreadPoolJob *out) {
+    ThreadPool *pool = worker->pool;
+    if (thread_pool_deque_take(&worker->deque, out)) {
+        return true;
+    }
+    if (atomic_load_explicit(&pool->queued, memory_order_relaxed) == 0) {
+        return false;
+    }
+    if (thread_pool_queue_pop(&pool->injected, out)) {
+        return true;
+    }
+    for (usz i = 1; i < pool->worker_count; i++) {
+        ThreadPoolWorker *victim =
+            &pool->workers[(worker->index + i) % pool->worker_count];
+        if (thread_pool_deque_steal(&victim->deque, out)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void thread_pool_signal_done(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_run(ThreadPoolWorker *worker, ThreadPoolJob job) {
+    ThreadPool *pool = worker->pool;
+    atomic_fetch_sub(&pool->queued, 1);
+
+    worker->depth += 1;
+    job.task(job.data);
+    worker->depth -= 1;
+    if (worker->depth == 0) {
+        arena_reset(&worker->arena);
+    }
+
+    bool group_done =
+        job.group != NULL && atomic_fetch_sub(&job.group->unfinished, 1) == 1;
+    bool pool_done = atomic_fetch_sub(&pool->unfinished, 1) == 1;
+    if (group_done || pool_done) {
+        thread_pool_signal_done(pool);
+    }
+}
+
+void *thread_pool_worker_run(void *data) {
+    ThreadPoolWorker *worker = data;
+    ThreadPool       *pool   = worker->pool;
+    thread_pool_current      = worker;
+
+    while (true) {
+        ThreadPoolJob job;
+        if (thread_pool_find(worker, &job)) {
+            thread_pool_run(worker, job);
+            continue;
+        }
+
+        // queued is checked under the lock, that submit takes before it
+        // signals, so no wake up is lost.
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->stop)) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        bool stop = atomic_load(&pool->stop) && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) {
+            return NULL;
+        }
+    }
+}
+
+// Stops the first started workers and frees the pool.
+void thread_pool_stop(ThreadPool *pool, usz started) {
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->stop, true);
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (usz i = 0; i < started; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    for (usz i = 0; i < pool->worker_count; i++) {
+        thread_pool_deque_destroy(&pool->workers[i].deque);
+        arena_destroy(&pool->workers[i].arena);
+    }
+    pthread_mutex_destroy(&pool->injected.lock);
+    free(pool->injected.items);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+ThreadPool *thread_pool_create(usz worker_count) {
+    if (worker_count == 0) {
+        long cores   = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cores > 0 ? (usz)cores : 1;
+    }
+
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->workers = calloc(worker_count, sizeof(ThreadPoolWorker));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->unfinished, 0);
+    atomic_init(&pool->stop, false);
+    pthread_mutex_init(&pool->injected.lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (usz i = 0; i < worker_count; i++) {
+        pool->workers[i] = (ThreadPoolWorker){.pool = pool, .index = i};
+        thread_pool_deque_init(&pool->workers[i].deque);
+    }
+    pool->worker_count = worker_count;
+
+    usz started = 0;
+    while (started < worker_count &&
+           pthread_create(&pool->workers[started].thread, NULL,
+                          thread_pool_worker_run,
+                          &pool->workers[started]) == 0) {
+        started += 1;
+    }
+    if (started < worker_count) {
+        thread_pool_stop(pool, started);
+        return NULL;
+    }
+    return pool;
+}
+
+void thread_pool_destroy(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->unfinished) != 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    thread_pool_stop(pool, pool->worker_count);
+}
+
+static ThreadPool    *thread_pool_shared      = NULL;
+static pthread_once_t thread_pool_shared_once = PTHREAD_ONCE_INIT;
+
+void thread_pool_create_shared(void) {
+    thread_pool_shared = thread_pool_create(0);
+    assert(thread_pool_shared != NULL && "could not start the thread pool");
+}
+
+ThreadPool *thread_pool_global(void) {
+    pthread_once(&thread_pool_shared_once, thread_pool_create_shared);
+    return thread_pool_shared;
+}
+
+usz thread_pool_worker_count(ThreadPool *pool) { return pool->worker_count; }
+
+void thread_pool_submit(ThreadPool *pool, ThreadPoolGroup *group,
+                        ThreadPoolTask task, void *data) {
+    if (group != NULL) {
+        atomic_fetch_add(&group->unfinished, 1);
+    }
+    atomic_fetch_add(&pool->unfinished, 1);
+
+    ThreadPoolJob     job    = {.task = task, .data = data, .group = group};
+    ThreadPoolWorker *worker = thread_pool_current;
+    if (worker != NULL && worker->pool == pool) {
+        thread_pool_deque_push(&worker->deque, job);
+    } else {
+        thread_pool_queue_push(&pool->injected, job);
+    }
+    atomic_fetch_add(&pool->queued, 1);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    if (pool->waiting > 0) {
+        pthread_cond_broadcast(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(ThreadPool *pool, ThreadPoolGroup *group) {
+    ThreadPoolWorker *worker = thread_pool_current;
+    if (worker != NULL && worker->pool == pool) {
+        ThreadPoolJob job;
+        while (atomic_load(&group->unfinished) != 0) {
+            if (thread_pool_find(worker, &job)) {
+                thread_pool_run(worker, job);
+                continue;
+            }
+            // The rest of the group runs on other workers, sleeps until it is
+            // done or there is something to help with.
+            pthread_mutex_lock(&pool->lock);
+            pool->waiting += 1;
+            while (atomic_load(&group->unfinished) != 0 &&
+                   atomic_load(&pool->queued) == 0) {
+                pthread_cond_wait(&pool->done, &pool->lock);
+            }
+            pool->waiting -= 1;
+            pthread_mutex_unlock(&pool->lock);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&group->unfinished) != 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+Arena *thread_pool_arena(void) {
+    ThreadPoolWorker *worker = thread_pool_current;
+    return worker != NULL && worker->depth > 0 ? &worker->arena : NULL;
+}
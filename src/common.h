@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdalign.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -31,6 +32,9 @@ typedef int32_t   i32;
 typedef int64_t   i64;
 typedef ptrdiff_t isz;
 
+typedef float     f32;
+typedef double    f64;
+
 #define HASH_FIND_USZ(head, findusz, out) \
     HASH_FIND(hh, head, findusz, sizeof(usz), out)
 #define HASH_ADD_USZ(head, uszfield, add) \
@@ -66,6 +70,12 @@ str  str_format_va(char const *format, va_list va);
 void str_fprint(FILE *file, str to_print);
 void str_fprintln(FILE *file, str to_print);
 
+// Reads the whole file into out, you have to str_destroy it. Returns false if
+// the file could not be read.
+bool read_file(char const *path, str *out);
+// The directory part of the path, . if it has none.
+str  path_directory(char const *path);
+
 void string_pool_free(char *str);
 // This function takes the ownership of a string.
 // You can still use the pointer after giving it to this function, it just has
@@ -76,6 +86,35 @@ void string_pool_free_all(void);
 bool vec_ensure_size(usz len, usz *cap, void **ptr, usz item_size,
                      usz items_to_add);
 
+#define HASH_FNV1A_OFFSET_BASIS 0xcbf29ce484222325ull
+
+// FNV-1a, start with HASH_FNV1A_OFFSET_BASIS and pass the result on to hash
+// more bytes.
+u64 hash_fnv1a(u64 hash, void const *bytes, usz len);
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+struct ArenaBlock {
+    ArenaBlock *next;
+    usz         used;
+    usz         capacity;
+    alignas(max_align_t) u8 data[];
+};
+
+// A bump allocator, everything allocated in an arena is freed at once with
+// arena_reset or arena_destroy. A zero initialised Arena is empty and valid.
+typedef struct Arena Arena;
+struct Arena {
+    ArenaBlock *head;
+};
+
+// The returned memory is aligned for every type and not zeroed.
+void *arena_alloc(Arena *arena, usz size);
+// Frees everything but keeps the newest block for reuse.
+void  arena_reset(Arena *arena);
+void  arena_destroy(Arena *arena);
+
 #define DEBUG "\033[90m"
 #define WARNING "\033[93m"
 #define ERROR "\033[91m"
@@ -84,9 +123,57 @@ bool vec_ensure_size(usz len, usz *cap, void **ptr, usz item_size,
 #define RESET "\033[0m"
 
 void log_register_file(FILE *file);
+// While file is not NULL, the log of the calling thread goes to file instead
+// of the registered files, so the log of a task can be collected.
+void log_capture(FILE *file);
 void log_debug(char const *format, ...);
 void log_info(char const *format, ...);
 void log_warning(char const *format, ...);
 void log_error(char const *format, ...);
 // Aborts
 void log_fatal(char const *format, ...) NORETURN;
+
+// ================
+// -- thread pool --
+// Runs tasks on a fixed set of worker threads. Every worker has a Chase-Lev
+// deque of tasks: a task submitted by a worker goes to the bottom of the
+// deque of that worker, which runs the newest task first, so the follow up
+// task of a task stays on the thread that has its data in the cache. A worker
+// without tasks steals the oldest task of another worker, without a lock.
+// Tasks from threads outside the pool go through a shared queue.
+//
+// Tasks are counted in groups, waiting on a group from a task runs other
+// tasks meanwhile, so tasks can wait on the tasks they submitted.
+// ================
+
+typedef void (*ThreadPoolTask)(void *data);
+
+typedef struct ThreadPool ThreadPool;
+
+// A zero initialised group has no tasks.
+typedef struct ThreadPoolGroup ThreadPoolGroup;
+struct ThreadPoolGroup {
+    _Atomic(usz) unfinished;
+};
+
+// 0 workers for one per core. Returns NULL if the threads could not be
+// started.
+ThreadPool *thread_pool_create(usz worker_count);
+// Waits for every task and stops the workers.
+void        thread_pool_destroy(ThreadPool *pool);
+// The pool with one worker per core that the compiler shares, it is created
+// by the first call and lives until the program exits.
+ThreadPool *thread_pool_global(void);
+usz         thread_pool_worker_count(ThreadPool *pool);
+// Can be called by tasks and by other threads. group may be NULL if nobody
+// waits for the task.
+void        thread_pool_submit(ThreadPool *pool, ThreadPoolGroup *group,
+                               ThreadPoolTask task, void *data);
+// Waits until every task of the group is done, also the tasks that were
+// submitted to the group by its tasks. A worker of the pool runs tasks while
+// it waits.
+void        thread_pool_wait(ThreadPool *pool, ThreadPoolGroup *group);
+// The scratch arena of the worker that runs the calling task, NULL outside
+// of a task. It is reset after every task, also the memory of a task that
+// waits stays valid until that task is done.
+Arena      *thread_pool_arena(void);
@@ -0,0 +1,558 @@
+#include "comptime.h"
+#include <assert.h>
+#include <stdlib.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "da.h"
+#include "language.h"
+#include "lexer.h"
+#include "node_column.h"
+#include "uthash.h"
+
+typedef struct ComptimeLocal ComptimeLocal;
+struct ComptimeLocal {
+    Index         symbol;
+    ComptimeValue value;
+};
+
+// The arguments and variables of a function call.
+typedef struct ComptimeFrame ComptimeFrame;
+struct ComptimeFrame {
+    usz            count;
+    usz            capacity;
+    ComptimeLocal *items;
+};
+
+typedef struct Comptime Comptime;
+struct Comptime {
+    Module          *m;
+    ModuleAnalyse   *ma;
+    Tokens          *t;
+    str              input;
+    usz              steps;
+    usz              depth;
+    // The first error of the declaration that is evaluated
+    AnalyseErrorType error;
+};
+
+enum ComptimeFlow {
+    COMPTIME_FLOW_NEXT,
+    COMPTIME_FLOW_RETURN,
+    COMPTIME_FLOW_ERROR,
+};
+typedef enum ComptimeFlow ComptimeFlow;
+
+bool comptime_fail(Comptime *ct, AnalyseErrorType type) {
+    if (ct->error == ANALYSE_ERROR_NONE) {
+        ct->error = type;
+    }
+    return false;
+}
+
+bool comptime_step(Comptime *ct) {
+    if (++ct->steps > COMPTIME_MAX_STEPS) {
+        return comptime_fail(ct, ANALYSE_ERROR_COMPTIME_LIMIT);
+    }
+    return true;
+}
+
+// Cuts an integer to its bits and rounds f32.
+ComptimeLane comptime_lane(Type type, ComptimeLane lane) {
+    if (type_is_float(type)) {
+        if (type_bits(type) == 32) {
+            lane.real = (f64)(f32)lane.real;
+        }
+        return lane;
+    }
+    u32 bits = type_bits(type);
+    if (bits < 64) {
+        lane.integer &= (1ull << bits) - 1;
+    }
+    return lane;
+}
+
+i64 comptime_signed(Type type, u64 integer) {
+    u32 bits = type_bits(type);
+    if (bits < 64 && (integer >> (bits - 1)) & 1) {
+        integer |= ~((1ull << bits) - 1);
+    }
+    return (i64)integer;
+}
+
+bool comptime_less(Type type, ComptimeLane lhs, ComptimeLane rhs) {
+    if (type_kind(type) == BUILTIN_TYPE_KIND_SIGNED) {
+        return comptime_signed(type, lhs.integer) <
+               comptime_signed(type, rhs.integer);
+    }
+    return lhs.integer < rhs.integer;
+}
+
+ComptimeValue comptime_convert(ComptimeValue value, Type to) {
+    if (type_equal(value.type, to)) {
+        return value;
+    }
+
+    ComptimeValue result  = {.type = to};
+    Type          from    = type_element(value.type);
+    Type          element = type_element(to);
+    for (u32 i = 0; i < type_value_lanes(to); i++) {
+        // A scalar converted to a vector is used for every lane.
+        ComptimeLane lane = value.lanes[type_is_vector(value.type) ? i : 0];
+        bool is_signed    = type_kind(from) == BUILTIN_TYPE_KIND_SIGNED;
+        if (type_is_float(element) && !type_is_float(from)) {
+            lane.real = is_signed ? (f64)comptime_signed(from, lane.integer)
+                                  : (f64)lane.integer;
+        } else if (is_signed) {
+            lane.integer = (u64)comptime_signed(from, lane.integer);
+        }
+        result.lanes[i] = comptime_lane(element, lane);
+    }
+    return result;
+}
+
+ComptimeValue *comptime_local(ComptimeFrame *frame, Index symbol) {
+    for (usz i = 0; i < frame->count; i++) {
+        if (frame->items[i].symbol == symbol) {
+            return &frame->items[i].value;
+        }
+    }
+    return NULL;
+}
+
+void comptime_set(ComptimeFrame *frame, Index symbol, ComptimeValue value) {
+    ComptimeValue *local = comptime_local(frame, symbol);
+    if (local != NULL) {
+        *local = value;
+        return;
+    }
+    ComptimeLocal new_local = {.symbol = symbol, .value = value};
+    da_append(frame, new_local);
+}
+
+Index comptime_symbol(Comptime *ct, Index node_index) {
+    Index symbol = node_column_get(&ct->ma->attributes.symbol, node_index);
+    assert(symbol != ANALYSE_INDEX_NONE && "node has no symbol");
+    return symbol;
+}
+
+bool comptime_declaration(Comptime *ct, AnalyseComptime *comptime,
+                          ComptimeValue *out);
+bool comptime_expression(Comptime *ct, ComptimeFrame *frame, Index node_index,
+                         ComptimeValue *out);
+ComptimeFlow comptime_block(Comptime *ct, ComptimeFrame *frame,
+                            Index node_index, ComptimeValue *out);
+
+bool comptime_identifier(Comptime *ct, ComptimeFrame *frame, Index node_index,
+                         ComptimeValue *out) {
+    Index symbol = comptime_symbol(ct, node_index);
+    if (ct->ma->symbols.items[symbol].kind == ANALYSE_SYMBOL_KIND_COMPTIME) {
+        return comptime_declaration(
+            ct, analyse_find_comptime(ct->ma, symbol), out);
+    }
+    ComptimeValue *value = comptime_local(frame, symbol);
+    assert(value != NULL && "variable was not evaluated");
+    *out = *value;
+    return true;
+}
+
+// Same operations and predicates as cg_binary_operation, integers wrap.
+ComptimeLane comptime_binary_lane(Type operand, TokenType op, ComptimeLane lhs,
+                                  ComptimeLane rhs) {
+    ComptimeLane result = {0};
+    if (type_is_float(operand)) {
+        f64 a = lhs.real;
+        f64 b = rhs.real;
+        switch (op) {
+            case TOKEN_TYPE_PLUS:
+                result.real = a + b;
+                return comptime_lane(operand, result);
+            case TOKEN_TYPE_MINUS:
+                result.real = a - b;
+                return comptime_lane(operand, result);
+            case TOKEN_TYPE_ASTERISK:
+                result.real = a * b;
+                return comptime_lane(operand, result);
+            case TOKEN_TYPE_EQUAL_EQUAL:
+                result.integer = a == b;
+                return result;
+            case TOKEN_TYPE_BANG_EQUAL:
+                result.integer = a != b;
+                return result;
+            case TOKEN_TYPE_LESS:
+                result.integer = a < b;
+                return result;
+            case TOKEN_TYPE_LESS_EQUAL:
+                result.integer = a <= b;
+                return result;
+            case TOKEN_TYPE_GREATER:
+                result.integer = a > b;
+                return result;
+            case TOKEN_TYPE_GREATER_EQUAL:
+                result.integer = a >= b;
+                return result;
+            default:
+                break;
+        }
+        UNREACHABLE("invalid binary operator");
+    }
+
+    bool less  = comptime_less(operand, lhs, rhs);
+    bool equal = lhs.integer == rhs.integer;
+    switch (op) {
+        case TOKEN_TYPE_PLUS:
+            result.integer = lhs.integer + rhs.integer;
+            return comptime_lane(operand, result);
+        case TOKEN_TYPE_MINUS:
+            result.integer = lhs.integer - rhs.integer;
+            return comptime_lane(operand, result);
+        case TOKEN_TYPE_ASTERISK:
+            result.integer = lhs.integer * rhs.integer;
+            return comptime_lane(operand, result);
+        case TOKEN_TYPE_EQUAL_EQUAL:
+            result.integer = equal;
+            return result;
+        case TOKEN_TYPE_BANG_EQUAL:
+            result.integer = !equal;
+            return result;
+        case TOKEN_TYPE_LESS:
+            result.integer = less;
+            return result;
+        case TOKEN_TYPE_LESS_EQUAL:
+            result.integer = less || equal;
+            return result;
+        case TOKEN_TYPE_GREATER:
+            result.integer = !less && !equal;
+            return result;
+        case TOKEN_TYPE_GREATER_EQUAL:
+            result.integer = !less;
+            return result;
+        default:
+            break;
+    }
+    UNREACHABLE("invalid binary operator");
+}
+
+bool comptime_binary_operation(Comptime *ct, ComptimeFrame *frame, Node *node,
+                               ComptimeValue *out) {
+    ComptimeValue lhs, rhs;
+    if (!comptime_expression(ct, frame, node->data.lhs, &lhs) ||
+        !comptime_expression(ct, frame, node->data.rhs, &rhs)) {
+        return false;
+    }
+    // Both operands have the same type after their conversions.
+    Type      operand = type_element(lhs.type);
+    TokenType op      = ct->t->tokens[node->main_token].type;
+    for (u32 i = 0; i < type_value_lanes(lhs.type); i++) {
+        out->lanes[i] = comptime_binary_lane(operand, op, lhs.lanes[i],
+                                             rhs.lanes[i]);
+    }
+    return true;
+}
+
+// The analyse only allows integer literals as lanes.
+void comptime_builtin(AnalyseBuiltin builtin, ComptimeValue *args, usz count,
+                      ComptimeValue *out) {
+    switch (builtin) {
+        case ANALYSE_BUILTIN_EXTRACT:
+            out->lanes[0] = args[0].lanes[args[1].lanes[0].integer];
+            return;
+        case ANALYSE_BUILTIN_INSERT:
+            for (u32 i = 0; i < args[0].type.lanes; i++) {
+                out->lanes[i] = args[0].lanes[i];
+            }
+            out->lanes[args[1].lanes[0].integer] = args[2].lanes[0];
+            return;
+        case ANALYSE_BUILTIN_SHUFFLE: {
+            u32 lanes = args[0].type.lanes;
+            for (usz i = 2; i < count; i++) {
+                u64 lane          = args[i].lanes[0].integer;
+                out->lanes[i - 2] = lane < lanes ? args[0].lanes[lane]
+                                                 : args[1].lanes[lane - lanes];
+            }
+            return;
+        }
+        // The analyse does not allow impure builtins in comptime code.
+        case ANALYSE_BUILTIN_ARENA:
+        case ANALYSE_BUILTIN_ALLOC:
+        case ANALYSE_BUILTIN_RESET:
+        case ANALYSE_BUILTIN_RELEASE:
+        case ANALYSE_BUILTIN_NONE:
+            break;
+    }
+    UNREACHABLE("invalid builtin");
+}
+
+void comptime_vector_constructor(ComptimeValue *args, usz count,
+                                 ComptimeValue *out) {
+    for (u32 i = 0; i < out->type.lanes; i++) {
+        out->lanes[i] = args[count == 1 ? 0 : i].lanes[0];
+    }
+}
+
+// Binds the arguments to the argument symbols of the function and interprets
+// its block in a new frame. Falling off the end returns zero, like the
+// generated code.
+bool comptime_function(Comptime *ct, Index symbol_id, ComptimeValue *args,
+                       ComptimeValue *out) {
+    if (ct->depth >= COMPTIME_MAX_DEPTH) {
+        return comptime_fail(ct, ANALYSE_ERROR_COMPTIME_LIMIT);
+    }
+
+    AnalyseSymbol *symbol   = &ct->ma->symbols.items[symbol_id];
+    Node          *function = &ct->m->nodes.items[symbol->node];
+    Index scope = node_column_get(&ct->ma->attributes.scope, symbol->node);
+
+    ComptimeFrame    frame = {0};
+    AnalyseVariable *var, *var_tmp;
+    HASH_ITER(hh, ct->ma->scopes.items[scope].variables, var, var_tmp) {
+        AnalyseSymbol *argument = &ct->ma->symbols.items[var->symbol];
+        if (argument->kind == ANALYSE_SYMBOL_KIND_ARGUMENT) {
+            comptime_set(&frame, var->symbol, args[argument->argument]);
+        }
+    }
+
+    ct->depth += 1;
+    *out              = (ComptimeValue){.type = symbol->type};
+    ComptimeFlow flow = comptime_block(ct, &frame, function->data.rhs, out);
+    ct->depth -= 1;
+
+    da_destroy(&frame);
+    return flow != COMPTIME_FLOW_ERROR;
+}
+
+bool comptime_call(Comptime *ct, ComptimeFrame *frame, Node *node,
+                   Index node_index, ComptimeValue *out) {
+    CallData      *call = &ct->m->extra_data.items[node->data.lhs].data.call;
+    ComptimeValue *args = malloc(sizeof(ComptimeValue) * (call->count + 1));
+    bool           ok   = true;
+    for (usz i = 0; ok && i < call->count; i++) {
+        ok = comptime_expression(ct, frame, call->items[i], &args[i]);
+    }
+
+    // Calls without a symbol are builtins or vector constructors.
+    if (ok && node_column_get(&ct->ma->attributes.symbol, node_index) ==
+                  ANALYSE_INDEX_NONE) {
+        char *name = tokens_token_cstr(ct->input, ct->t, node->main_token);
+        AnalyseBuiltin builtin = analyse_builtin_from_name(name);
+        free(name);
+        if (builtin != ANALYSE_BUILTIN_NONE) {
+            comptime_builtin(builtin, args, call->count, out);
+        } else {
+            comptime_vector_constructor(args, call->count, out);
+        }
+    } else if (ok) {
+        ok = comptime_function(ct, comptime_symbol(ct, node_index), args, out);
+    }
+
+    free(args);
+    return ok;
+}
+
+// Evaluates the expression and converts it to the type it is used as.
+bool comptime_expression(Comptime *ct, ComptimeFrame *frame, Index node_index,
+                         ComptimeValue *out) {
+    if (!comptime_step(ct)) {
+        return false;
+    }
+
+    Node *node = &ct->m->nodes.items[node_index];
+    Type  type = node_column_get(&ct->ma->attributes.type, node_index);
+    *out       = (ComptimeValue){.type = type};
+    bool ok    = true;
+    switch (node->type) {
+        case NODE_TYPE_INTEGER_LITERAL: {
+            // Integer literals used as floats have a float type.
+            u64 integer = extra_data_integer(
+                ct->t, ct->t->tokens[node->main_token].extra_data);
+            if (type_is_float(type)) {
+                out->lanes[0].real = (f64)integer;
+            } else {
+                out->lanes[0].integer = integer;
+            }
+            out->lanes[0] = comptime_lane(type, out->lanes[0]);
+            break;
+        }
+        case NODE_TYPE_FLOAT_LITERAL:
+            out->lanes[0].real = extra_data_float(
+                ct->t, ct->t->tokens[node->main_token].extra_data);
+            out->lanes[0] = comptime_lane(type, out->lanes[0]);
+            break;
+        case NODE_TYPE_IDENTIFIER:
+            ok = comptime_identifier(ct, frame, node_index, out);
+            break;
+        case NODE_TYPE_BINARY_OPERATION:
+            ok = comptime_binary_operation(ct, frame, node, out);
+            break;
+        case NODE_TYPE_CALL:
+            ok = comptime_call(ct, frame, node, node_index, out);
+            break;
+        case NODE_TYPE_BLOCK:
+        case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+        case NODE_TYPE_RETURN:
+        case NODE_TYPE_IMPORT:
+        case NODE_TYPE_EOF:
+            UNREACHABLE("statements are no expressions");
+    }
+    if (!ok) {
+        return false;
+    }
+
+    Type converted = node_column_get(&ct->ma->attributes.converted, node_index);
+    if (converted.type != BUILTIN_TYPE_NONE) {
+        *out = comptime_convert(*out, converted);
+    }
+    return true;
+}
+
+ComptimeFlow comptime_while(Comptime *ct, ComptimeFrame *frame, Node *node,
+                            ComptimeValue *out) {
+    LoopData *ld = &ct->m->extra_data.items[node->data.lhs].data.loop;
+    while (true) {
+        ComptimeValue condition;
+        if (!comptime_expression(ct, frame, ld->lhs, &condition)) {
+            return COMPTIME_FLOW_ERROR;
+        }
+        if (!condition.lanes[0].integer) {
+            return COMPTIME_FLOW_NEXT;
+        }
+        ComptimeFlow flow = comptime_block(ct, frame, node->data.rhs, out);
+        if (flow != COMPTIME_FLOW_NEXT) {
+            return flow;
+        }
+    }
+}
+
+// The variable runs from the start of the range up to the end, without the
+// end, so it never overflows.
+ComptimeFlow comptime_for(Comptime *ct, ComptimeFrame *frame, Node *node,
+                          Index node_index, ComptimeValue *out) {
+    LoopData     *ld = &ct->m->extra_data.items[node->data.lhs].data.loop;
+    ComptimeValue variable, end;
+    if (!comptime_expression(ct, frame, ld->lhs, &variable) ||
+        !comptime_expression(ct, frame, ld->rhs, &end)) {
+        return COMPTIME_FLOW_ERROR;
+    }
+
+    Index symbol = comptime_symbol(ct, node_index);
+    for (; comptime_less(variable.type, variable.lanes[0], end.lanes[0]);
+         variable.lanes[0].integer += 1) {
+        if (!comptime_step(ct)) {
+            return COMPTIME_FLOW_ERROR;
+        }
+        comptime_set(frame, symbol, variable);
+        ComptimeFlow flow = comptime_block(ct, frame, node->data.rhs, out);
+        if (flow != COMPTIME_FLOW_NEXT) {
+            return flow;
+        }
+    }
+    return COMPTIME_FLOW_NEXT;
+}
+
+// A return stores its value in out.
+ComptimeFlow comptime_statement(Comptime *ct, ComptimeFrame *frame,
+                                Index node_index, ComptimeValue *out) {
+    if (!comptime_step(ct)) {
+        return COMPTIME_FLOW_ERROR;
+    }
+
+    Node         *node = &ct->m->nodes.items[node_index];
+    ComptimeValue value;
+    switch (node->type) {
+        case NODE_TYPE_BLOCK:
+            return comptime_block(ct, frame, node_index, out);
+        case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+            if (!comptime_expression(ct, frame, node->data.rhs, &value)) {
+                return COMPTIME_FLOW_ERROR;
+            }
+            comptime_set(frame, comptime_symbol(ct, node_index), value);
+            return COMPTIME_FLOW_NEXT;
+        case NODE_TYPE_WHILE:
+            return comptime_while(ct, frame, node, out);
+        case NODE_TYPE_FOR:
+            return comptime_for(ct, frame, node, node_index, out);
+        case NODE_TYPE_RETURN:
+            return comptime_expression(ct, frame, node->data.rhs, out)
+                       ? COMPTIME_FLOW_RETURN
+                       : COMPTIME_FLOW_ERROR;
+        // Nested functions are only called, not executed.
+        case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_EOF:
+            return COMPTIME_FLOW_NEXT;
+        case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_BINARY_OPERATION:
+        case NODE_TYPE_CALL:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_IMPORT:
+            break;
+    }
+    UNREACHABLE("the analyse only allows statements in blocks");
+}
+
+ComptimeFlow comptime_block(Comptime *ct, ComptimeFrame *frame,
+                            Index node_index, ComptimeValue *out) {
+    Node      *node  = &ct->m->nodes.items[node_index];
+    BlockData *block = &ct->m->extra_data.items[node->data.lhs].data.block;
+    for (usz i = 0; i < block->count; i++) {
+        ComptimeFlow flow = comptime_statement(ct, frame, block->items[i], out);
+        if (flow != COMPTIME_FLOW_NEXT) {
+            return flow;
+        }
+    }
+    return COMPTIME_FLOW_NEXT;
+}
+
+// Declarations are evaluated on their first use, a use during the own
+// evaluation is a cycle. Every failed declaration reports one error, the
+// declarations that use it fail without another error.
+bool comptime_declaration(Comptime *ct, AnalyseComptime *comptime,
+                          ComptimeValue *out) {
+    switch (comptime->state) {
+        case ANALYSE_COMPTIME_STATE_DONE:
+            *out = comptime->value;
+            return true;
+        case ANALYSE_COMPTIME_STATE_FAILED:
+            return false;
+        case ANALYSE_COMPTIME_STATE_EVALUATING:
+            return comptime_fail(ct, ANALYSE_ERROR_COMPTIME_CYCLE);
+        case ANALYSE_COMPTIME_STATE_PENDING:
+            break;
+    }
+
+    comptime->state        = ANALYSE_COMPTIME_STATE_EVALUATING;
+    AnalyseErrorType outer = ct->error;
+    ct->error              = ANALYSE_ERROR_NONE;
+
+    Node         *node  = &ct->m->nodes.items[comptime->node];
+    ComptimeFrame frame = {0};
+    bool ok = comptime_expression(ct, &frame, node->data.rhs, &comptime->value);
+    da_destroy(&frame);
+
+    comptime->state =
+        ok ? ANALYSE_COMPTIME_STATE_DONE : ANALYSE_COMPTIME_STATE_FAILED;
+    if (!ok && ct->error != ANALYSE_ERROR_NONE) {
+        AnalyseError error = {.type = ct->error, .node = comptime->node};
+        da_append(&ct->ma->errors, error);
+    }
+    ct->error = outer;
+    *out      = comptime->value;
+    return ok;
+}
+
+void comptime_evaluate(Module *m, ModuleAnalyse *ma, Tokens *t, str input) {
+    Comptime ct = {.m = m, .ma = ma, .t = t, .input = input};
+    for (usz i = 0; i < ma->comptimes.count; i++) {
+        // Every declaration gets its own step limit.
+        ct.steps = 0;
+        ComptimeValue value;
+        comptime_declaration(&ct, &ma->comptimes.items[i], &value);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "lexer.h"
+
+// ================
+// -- comptime --
+// Evaluates the comptime declarations of an analysed module by interpreting
+// Module.nodes directly. The expression of a declaration can use literals,
+// earlier comptime declarations, builtins, vector constructors and calls of
+// @pure functions, whose bodies are interpreted with their loops, variables
+// and returns. The results are stored in ModuleAnalyse.comptimes, codegen
+// emits them as constant globals.
+//
+// Arithmetic wraps like the generated code and comparisons use the same
+// predicates, so a value is the same as if it was computed at run time.
+// ================
+
+// Bounds the evaluation, so an endless loop or recursion is an error instead
+// of a hanging compiler. Every evaluated node is a step.
+#define COMPTIME_MAX_STEPS (1u << 24)
+#define COMPTIME_MAX_DEPTH 256
+
+// Evaluates all comptime declarations in source order, the analyse may not
+// contain errors. Failed evaluations are added to ma->errors.
+void comptime_evaluate(Module *m, ModuleAnalyse *ma, Tokens *t, str input);
+// The value converted from its type to the type to, with the implicit
+// conversions of the analyse.
+ComptimeValue comptime_convert(ComptimeValue value, Type to);
@@ -0,0 +1,443 @@
+#define _POSIX_C_SOURCE 200809L
+#include "daemon.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+
+// Larger requests are rejected, a command line is never that long.
+#define DAEMON_MAX_REQUEST        (1024 * 1024)
+// stdin, stdout and stderr of the client
+#define DAEMON_STD_FDS            3
+// A client has this long to send its whole request. The requests are served
+// one after another, so a client that stalls would block every other one.
+#define DAEMON_REQUEST_TIMEOUT_MS 1000
+// The client waits for the answer as long as the compilation takes.
+#define DAEMON_NO_DEADLINE        -1
+
+typedef enum DaemonRequestKind {
+    DAEMON_REQUEST_COMPILE,
+    DAEMON_REQUEST_STOP,
+} DaemonRequestKind;
+
+// Sent with the fds of the client, followed by size bytes: the working
+// directory and then argc arguments, each terminated by a zero byte.
+typedef struct DaemonHeader DaemonHeader;
+struct DaemonHeader {
+    u32 kind;
+    u32 argc;
+    u32 size;
+};
+
+bool daemon_address(char const *path, struct sockaddr_un *out) {
+    *out = (struct sockaddr_un){.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(out->sun_path)) {
+        log_error("the socket path %s is too long", path);
+        return false;
+    }
+    strcpy(out->sun_path, path);
+    return true;
+}
+
+// Returns -1 if no daemon listens on path.
+int daemon_connect(char const *path) {
+    struct sockaddr_un address;
+    if (!daemon_address(path, &address)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool daemon_send(int fd, void const *bytes, usz len) {
+    u8 const *b = bytes;
+    while (len > 0) {
+        ssize_t sent = send(fd, b, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        b += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+i64 daemon_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (i64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Waits until fd can be read, returns false if the deadline passed first. The
+// deadline is in the milliseconds of daemon_now_ms.
+bool daemon_wait(int fd, i64 deadline) {
+    if (deadline == DAEMON_NO_DEADLINE) {
+        return true;
+    }
+    for (;;) {
+        i64 left = deadline - daemon_now_ms();
+        if (left <= 0) {
+            log_error("dropped a client that did not send its request in time");
+            return false;
+        }
+        struct pollfd poll_fd = {.fd = fd, .events = POLLIN};
+        int           ready   = poll(&poll_fd, 1, (int)left);
+        if (ready > 0) {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+bool daemon_receive(int fd, void *bytes, usz len, i64 deadline) {
+    u8 *b = bytes;
+    while (len > 0) {
+        if (!daemon_wait(fd, deadline)) {
+            return false;
+        }
+        ssize_t received = recv(fd, b, len, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        b += received;
+        len -= received;
+    }
+    return true;
+}
+
+bool daemon_send_header(int fd, DaemonHeader *header, int const *fds,
+                        usz fd_count) {
+    union {
+        char           bytes[CMSG_SPACE(sizeof(int) * DAEMON_STD_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec  iov = {.iov_base = header, .iov_len = sizeof(*header)};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+    if (fd_count > 0) {
+        msg.msg_control          = control.bytes;
+        msg.msg_controllen       = CMSG_SPACE(sizeof(int) * fd_count);
+        struct cmsghdr *cmsg     = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level         = SOL_SOCKET;
+        cmsg->cmsg_type          = SCM_RIGHTS;
+        cmsg->cmsg_len           = CMSG_LEN(sizeof(int) * fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == sizeof(*header);
+}
+
+// Every fd that was received is stored in fds, also if the header is broken,
+// so the caller can close them.
+bool daemon_receive_header(int fd, DaemonHeader *header, int *fds,
+                           usz *fd_count, i64 deadline) {
+    union {
+        char           bytes[CMSG_SPACE(sizeof(int) * DAEMON_STD_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec  iov = {.iov_base = header, .iov_len = sizeof(*header)};
+    struct msghdr msg = {.msg_iov        = &iov,
+                         .msg_iovlen     = 1,
+                         .msg_control    = control.bytes,
+                         .msg_controllen = sizeof(control.bytes)};
+
+    *fd_count = 0;
+    if (!daemon_wait(fd, deadline)) {
+        return false;
+    }
+    ssize_t received;
+    do {
+        received = recvmsg(fd, &msg, 0);
+    } while (received < 0 && errno == EINTR);
+
+    for (struct cmsghdr *cmsg = received > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+         cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        usz count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (usz i = 0; i < count && *fd_count < DAEMON_STD_FDS; i++) {
+            memcpy(&fds[(*fd_count)++], CMSG_DATA(cmsg) + i * sizeof(int),
+                   sizeof(int));
+        }
+    }
+    if (received <= 0 || (msg.msg_flags & MSG_CTRUNC) != 0) {
+        return false;
+    }
+    // The rest of a header that was split
+    return daemon_receive(fd, (u8 *)header + received,
+                          sizeof(*header) - received, deadline);
+}
+
+// Points cwd and argv into payload, returns false if it does not contain
+// exactly argc + 1 strings.
+bool daemon_split(char *payload, usz size, u32 argc, char **cwd, char **argv) {
+    usz strings = 0;
+    usz start   = 0;
+    for (usz i = 0; i < size; i++) {
+        if (payload[i] != '\0') {
+            continue;
+        }
+        if (strings == (usz)argc + 1) {
+            return false;
+        }
+        if (strings == 0) {
+            *cwd = payload + start;
+        } else {
+            argv[strings - 1] = payload + start;
+        }
+        strings += 1;
+        start = i + 1;
+    }
+    argv[argc] = NULL;
+    return strings == (usz)argc + 1 && start == size;
+}
+
+// Runs the handler with the fds of the client as stdin, stdout and stderr and
+// the working directory of the client, both are restored afterwards.
+int daemon_run(int const *fds, char const *cwd, int argc, char **argv,
+               DaemonHandler handler, void *data) {
+    fflush(stdout);
+    fflush(stderr);
+    int saved[DAEMON_STD_FDS];
+    for (int i = 0; i < DAEMON_STD_FDS; i++) {
+        saved[i] = dup(i);
+        if (saved[i] < 0) {
+            log_error("could not save the fd %d: %s", i, strerror(errno));
+            while (i-- > 0) {
+                close(saved[i]);
+            }
+            return 1;
+        }
+    }
+    for (int i = 0; i < DAEMON_STD_FDS; i++) {
+        dup2(fds[i], i);
+    }
+
+    int result    = 1;
+    int directory = open(".", O_RDONLY);
+    if (directory < 0 || chdir(cwd) != 0) {
+        log_error("could not change to the directory %s: %s", cwd,
+                  strerror(errno));
+    } else {
+        result = handler(argc, argv, data);
+    }
+    fflush(stdout);
+    fflush(stderr);
+
+    for (int i = 0; i < DAEMON_STD_FDS; i++) {
+        dup2(saved[i], i);
+        close(saved[i]);
+    }
+    // A client that closed its end leaves an error on the streams.
+    clearerr(stdout);
+    clearerr(stderr);
+    if (directory >= 0) {
+        if (fchdir(directory) != 0) {
+            log_error("could not restore the directory: %s", strerror(errno));
+        }
+        close(directory);
+    }
+    return result;
+}
+
+// Returns false if the client asked the daemon to stop.
+bool daemon_handle(int client, DaemonHandler handler, void *data) {
+    DaemonHeader header;
+    int          fds[DAEMON_STD_FDS];
+    usz          fd_count = 0;
+    i64          deadline = daemon_now_ms() + DAEMON_REQUEST_TIMEOUT_MS;
+    bool ok = daemon_receive_header(client, &header, fds, &fd_count, deadline);
+
+    bool  running   = true;
+    i32   exit_code = 1;
+    char *payload   = NULL;
+    char **argv     = NULL;
+    if (ok && header.kind == DAEMON_REQUEST_STOP) {
+        running   = false;
+        exit_code = 0;
+    } else if (ok && header.kind == DAEMON_REQUEST_COMPILE &&
+               fd_count == DAEMON_STD_FDS && header.argc > 0 &&
+               header.size <= DAEMON_MAX_REQUEST &&
+               header.argc <= header.size) {
+        // Every argument takes at least its NUL byte, which bounds argc.
+        char *cwd = NULL;
+        payload   = malloc(header.size);
+        argv      = malloc(sizeof(char *) * ((usz)header.argc + 1));
+        if (payload != NULL && argv != NULL &&
+            daemon_receive(client, payload, header.size, deadline) &&
+            daemon_split(payload, header.size, header.argc, &cwd, argv)) {
+            exit_code =
+                daemon_run(fds, cwd, (int)header.argc, argv, handler, data);
+        }
+    }
+
+    for (usz i = 0; i < fd_count; i++) {
+        close(fds[i]);
+    }
+    free(payload);
+    free(argv);
+    // The client may be gone already, then nobody waits for the answer.
+    daemon_send(client, &exit_code, sizeof(exit_code));
+    return running;
+}
+
+bool daemon_serve(char const *path, DaemonHandler handler, void *data) {
+    struct sockaddr_un address;
+    if (!daemon_address(path, &address)) {
+        return false;
+    }
+    int running_daemon = daemon_connect(path);
+    if (running_daemon >= 0) {
+        close(running_daemon);
+        log_error("a daemon already listens on %s", path);
+        return false;
+    }
+    // Nobody listens on a socket that is left over from a killed daemon.
+    unlink(path);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 ||
+        bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server, SOMAXCONN) != 0) {
+        log_error("could not listen on %s: %s", path, strerror(errno));
+        if (server >= 0) {
+            close(server);
+        }
+        return false;
+    }
+
+    // A client that goes away during its request must not stop the daemon.
+    signal(SIGPIPE, SIG_IGN);
+    bool running = true;
+    while (running) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            log_error("could not accept a client: %s", strerror(errno));
+            break;
+        }
+        running = daemon_handle(client, handler, data);
+        close(client);
+    }
+
+    close(server);
+    unlink(path);
+    return true;
+}
+
+char *daemon_cwd(void) {
+    usz   size = 256;
+    char *cwd  = malloc(size);
+    while (cwd != NULL && getcwd(cwd, size) == NULL) {
+        free(cwd);
+        cwd = NULL;
+        if (errno != ERANGE) {
+            break;
+        }
+        size *= 2;
+        cwd = malloc(size);
+    }
+    return cwd;
+}
+
+bool daemon_send_request(char const *path, DaemonRequestKind kind, int argc,
+                         char **argv, int *exit_code) {
+    int fd = daemon_connect(path);
+    if (fd < 0) {
+        log_error("no daemon listens on %s", path);
+        return false;
+    }
+
+    char *cwd     = NULL;
+    char *payload = NULL;
+    bool  ok      = false;
+    usz   size    = 0;
+    if (kind == DAEMON_REQUEST_COMPILE) {
+        cwd = daemon_cwd();
+        if (cwd == NULL) {
+            log_error("could not get the working directory: %s",
+                      strerror(errno));
+            close(fd);
+            return false;
+        }
+        size = strlen(cwd) + 1;
+        for (int i = 0; i < argc; i++) {
+            size += strlen(argv[i]) + 1;
+        }
+        payload = malloc(size);
+        if (payload == NULL) {
+            log_error("could not allocate the request");
+            free(cwd);
+            close(fd);
+            return false;
+        }
+        usz len = strlen(cwd) + 1;
+        memcpy(payload, cwd, len);
+        for (int i = 0; i < argc; i++) {
+            usz arg_len = strlen(argv[i]) + 1;
+            memcpy(payload + len, argv[i], arg_len);
+            len += arg_len;
+        }
+    }
+
+    DaemonHeader header = {.kind = kind, .argc = argc, .size = size};
+    int          fds[DAEMON_STD_FDS] = {STDIN_FILENO, STDOUT_FILENO,
+                                        STDERR_FILENO};
+    usz fd_count = kind == DAEMON_REQUEST_COMPILE ? DAEMON_STD_FDS : 0;
+    i32 answer   = 1;
+    if (size > DAEMON_MAX_REQUEST) {
+        log_error("the request is too large");
+    } else if (daemon_send_header(fd, &header, fds, fd_count) &&
+               daemon_send(fd, payload, size) &&
+               daemon_receive(fd, &answer, sizeof(answer),
+                              DAEMON_NO_DEADLINE)) {
+        *exit_code = answer;
+        ok         = true;
+    } else {
+        log_error("the daemon on %s did not answer", path);
+    }
+
+    free(cwd);
+    free(payload);
+    close(fd);
+    return ok;
+}
+
+bool daemon_request(char const *path, int argc, char **argv, int *exit_code) {
+    return daemon_send_request(path, DAEMON_REQUEST_COMPILE, argc, argv,
+                               exit_code);
+}
+
+bool daemon_stop(char const *path) {
+    int exit_code;
+    return daemon_send_request(path, DAEMON_REQUEST_STOP, 0, NULL, &exit_code);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "common.h"
+
+// ================
+// -- daemon --
+// A compile server on a unix socket. The client sends its arguments, its
+// working directory and its stdin, stdout and stderr, the daemon compiles
+// with them as if it was started by the client and answers with the exit
+// code. Everything the daemon keeps between requests, like the initialised
+// LLVM targets and the bitcode caches, makes a request cheaper than starting
+// thorc again.
+// ================
+
+// Compiles one request, argv[0] is the program name of the client. Returns the
+// exit code.
+typedef int (*DaemonHandler)(int argc, char **argv, void *data);
+
+// Serves the requests one after another until a client sends a stop request.
+// A client that does not send its whole request within a second is dropped.
+// Returns false if the socket could not be created, for example because
+// another daemon already listens on it.
+bool daemon_serve(char const *path, DaemonHandler handler, void *data);
+// Runs the arguments in the daemon. Returns false if no daemon is listening on
+// path, otherwise the exit code of the request is stored in exit_code.
+bool daemon_request(char const *path, int argc, char **argv, int *exit_code);
+// Returns false if no daemon is listening on path.
+bool daemon_stop(char const *path);
@@ -0,0 +1,122 @@
+#include "flat_pass.h"
+#include <assert.h>
+#include "ast.h"
+#include "common.h"
+#include "node_column.h"
+
+usz flat_child_count(Module *m, Node *node) {
+    switch (node->type) {
+        case NODE_TYPE_BLOCK:
+            return m->extra_data.items[node->data.lhs].data.block.count;
+        case NODE_TYPE_BINARY_OPERATION:
+            return 2;
+        case NODE_TYPE_CALL:
+            return m->extra_data.items[node->data.lhs].data.call.count;
+        case NODE_TYPE_WHILE:
+            return 2;
+        case NODE_TYPE_FOR:
+            return 3;
+        case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_RETURN:
+            return 1;
+        case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_IMPORT:
+        case NODE_TYPE_EOF:
+            return 0;
+    }
+    return 0;
+}
+
+Index flat_child(Module *m, Node *node, usz child) {
+    assert(child < flat_child_count(m, node));
+    switch (node->type) {
+        case NODE_TYPE_BLOCK:
+            return m->extra_data.items[node->data.lhs].data.block.items[child];
+        case NODE_TYPE_BINARY_OPERATION:
+            return child == 0 ? node->data.lhs : node->data.rhs;
+        case NODE_TYPE_CALL:
+            return m->extra_data.items[node->data.lhs].data.call.items[child];
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR: {
+            // The operands and then the block
+            LoopData *ld = &m->extra_data.items[node->data.lhs].data.loop;
+            if (child + 1 == flat_child_count(m, node)) {
+                return node->data.rhs;
+            }
+            return child == 0 ? ld->lhs : ld->rhs;
+        }
+        case NODE_TYPE_FUNCTION_DEFINITION:
+        case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_RETURN:
+            return node->data.rhs;
+        case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_IMPORT:
+        case NODE_TYPE_EOF:
+            break;
+    }
+    UNREACHABLE("node has no children");
+}
+
+Index flat_subtree_begin(Module *m, Index node) {
+    // The first child is the start of the subtree, so follow the first
+    // children down to a leaf.
+    Node *cur = &m->nodes.items[node];
+    while (flat_child_count(m, cur) > 0) {
+        node = flat_child(m, cur, 0);
+        cur  = &m->nodes.items[node];
+    }
+    return node;
+}
+
+NodeColumnFlatIndex flat_parents(Module *m) {
+    NodeColumnFlatIndex parents;
+    node_column_init(&parents, m->nodes.count, FLAT_NO_PARENT);
+
+    for (Index i = 0; i < m->nodes.count; i++) {
+        Node *node = &m->nodes.items[i];
+        for (usz c = 0; c < flat_child_count(m, node); c++) {
+            node_column_set(&parents, flat_child(m, node, c), i);
+        }
+    }
+
+    return parents;
+}
+
+bool flat_module_is_ordered(Module *m) {
+    for (Index i = 0; i < m->nodes.count; i++) {
+        Node *node  = &m->nodes.items[i];
+        usz   count = flat_child_count(m, node);
+
+        // The last child subtree ends right before the node, and every child
+        // subtree ends right before the next one starts.
+        Index expected_end = i;
+        for (usz c = count; c > 0; c--) {
+            Index child = flat_child(m, node, c - 1);
+            if (child + 1 != expected_end) {
+                return false;
+            }
+            expected_end = flat_subtree_begin(m, child);
+        }
+    }
+
+    // The top level subtrees follow each other without gaps.
+    Index expected_begin = 0;
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index top_level_node = m->top_level_nodes.items[i];
+        if (flat_subtree_begin(m, top_level_node) != expected_begin) {
+            return false;
+        }
+        expected_begin = top_level_node + 1;
+    }
+
+    return true;
+}
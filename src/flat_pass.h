@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ast.h"
+#include "common.h"
+#include "lexer.h"
+#include "node_column.h"
+
+// ================
+// -- flat pass --
+// Helpers for passes that sweep linearly over Module.nodes instead of walking
+// the tree. Because of the ordering invariants documented at Module, a single
+// forward sweep visits every child before its parent, which is enough for
+// bottom up analyses like counting, type computation or constant evaluation:
+//
+//     for (Index i = 0; i < m->nodes.count; i++) {
+//         Node *node = &m->nodes.items[i];
+//         for (usz c = 0; c < flat_child_count(m, node); c++) {
+//             // flat_child(m, node, c) was already handled
+//         }
+//     }
+// ================
+
+NODE_COLUMN(Index, FlatIndex)
+
+// Used for nodes without a parent, the top level nodes.
+#define FLAT_NO_PARENT ((Index)-1)
+
+usz   flat_child_count(Module *m, Node *node);
+Index flat_child(Module *m, Node *node, usz child);
+// The first Index of the subtree of node, the subtree is the range
+// flat_subtree_begin(m, node)..=node.
+Index flat_subtree_begin(Module *m, Index node);
+// Computes the parent of every node in one sweep, free it with
+// node_column_destroy.
+NodeColumnFlatIndex flat_parents(Module *m);
+// Checks the ordering invariants, returns false if they are violated.
+bool                flat_module_is_ordered(Module *m);
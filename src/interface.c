@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+#include "interface.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "common.h"
+#include "da.h"
+#include "language.h"
+
+typedef struct InterfaceWriter InterfaceWriter;
+struct InterfaceWriter {
+    usz count;
+    usz capacity;
+    u8 *items;
+};
+
+void interface_write_byte(InterfaceWriter *w, u8 byte) { da_append(w, byte); }
+
+void interface_write_uleb(InterfaceWriter *w, u64 value) {
+    do {
+        u8 byte = value & 0x7f;
+        value >>= 7;
+        interface_write_byte(w, value != 0 ? byte | 0x80 : byte);
+    } while (value != 0);
+}
+
+void interface_write_name(InterfaceWriter *w, char const *name) {
+    usz len = strlen(name);
+    interface_write_uleb(w, len);
+    for (usz i = 0; i < len; i++) {
+        interface_write_byte(w, (u8)name[i]);
+    }
+}
+
+void interface_write_type(InterfaceWriter *w, Type type) {
+    interface_write_byte(w, (u8)type.type);
+    interface_write_byte(w, (u8)type.lanes);
+}
+
+// The reader stops at the first error, every later read returns zero.
+typedef struct InterfaceReader InterfaceReader;
+struct InterfaceReader {
+    str  bytes;
+    usz  pos;
+    bool ok;
+};
+
+u8 interface_read_byte(InterfaceReader *r) {
+    if (!r->ok || r->pos >= r->bytes.len) {
+        r->ok = false;
+        return 0;
+    }
+    return (u8)r->bytes.ptr[r->pos++];
+}
+
+u64 interface_read_uleb(InterfaceReader *r) {
+    u64 value = 0;
+    for (u32 shift = 0; shift < 64; shift += 7) {
+        u8 byte = interface_read_byte(r);
+        value |= (u64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    r->ok = false;
+    return 0;
+}
+
+// A count can not be larger than the bytes that are left, so a broken file
+// can not make the reader allocate more than the file.
+usz interface_read_count(InterfaceReader *r) {
+    u64 count = interface_read_uleb(r);
+    if (count > r->bytes.len - r->pos) {
+        r->ok = false;
+        return 0;
+    }
+    return count;
+}
+
+char *interface_read_name(InterfaceReader *r) {
+    usz len = interface_read_count(r);
+    if (!r->ok || len == 0) {
+        r->ok = false;
+        return NULL;
+    }
+    char *name = to_cstr((str){.ptr = r->bytes.ptr + r->pos, .len = len});
+    r->pos += len;
+    return name;
+}
+
+Type interface_read_type(InterfaceReader *r) {
+    Type type = {.type = interface_read_byte(r)};
+    type.lanes = interface_read_byte(r);
+    if (type.type == BUILTIN_TYPE_NONE || type.type > BUILTIN_TYPE_BOOL ||
+        (type.lanes != 0 && !type_valid_lanes(type.lanes))) {
+        r->ok = false;
+    }
+    return type;
+}
+
+void module_interface_add(ModuleInterface  *interface,
+                          InterfaceFunction function) {
+    da_append(&interface->functions, function);
+}
+
+void module_interface_destroy(ModuleInterface *interface) {
+    for (usz i = 0; i < interface->functions.count; i++) {
+        InterfaceFunction *function = &interface->functions.items[i];
+        free(function->name);
+        da_destroy(&function->argument_types);
+    }
+    da_destroy(&interface->functions);
+    free(interface->name);
+}
+
+int interface_function_compare(void const *a, void const *b) {
+    return strcmp(((InterfaceFunction const *)a)->name,
+                  ((InterfaceFunction const *)b)->name);
+}
+
+str interface_serialize(ModuleInterface *interface) {
+    if (interface->functions.count > 1) {
+        qsort(interface->functions.items, interface->functions.count,
+              sizeof(InterfaceFunction), interface_function_compare);
+    }
+
+    InterfaceWriter w = {0};
+    for (usz i = 0; i < sizeof(INTERFACE_MAGIC) - 1; i++) {
+        interface_write_byte(&w, (u8)INTERFACE_MAGIC[i]);
+    }
+    interface_write_byte(&w, INTERFACE_VERSION);
+    interface_write_name(&w, interface->name);
+
+    interface_write_uleb(&w, interface->functions.count);
+    for (usz i = 0; i < interface->functions.count; i++) {
+        InterfaceFunction *function = &interface->functions.items[i];
+        interface_write_name(&w, function->name);
+        interface_write_uleb(&w, function->attributes);
+        interface_write_type(&w, function->return_type);
+        interface_write_uleb(&w, function->argument_types.count);
+        for (usz a = 0; a < function->argument_types.count; a++) {
+            interface_write_type(&w, function->argument_types.items[a]);
+        }
+    }
+    return (str){.ptr = (char *)w.items, .len = w.count};
+}
+
+bool interface_deserialize(str bytes, ModuleInterface *out) {
+    *out              = (ModuleInterface){0};
+    InterfaceReader r = {.bytes = bytes, .ok = true};
+    for (usz i = 0; i < sizeof(INTERFACE_MAGIC) - 1; i++) {
+        if (interface_read_byte(&r) != (u8)INTERFACE_MAGIC[i]) {
+            return false;
+        }
+    }
+    if (interface_read_byte(&r) != INTERFACE_VERSION) {
+        return false;
+    }
+    out->name = interface_read_name(&r);
+
+    FunctionAttributes known = 0;
+#define X(upper, lower) known |= FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_##upper);
+    FUNCTION_ATTRIBUTES
+#undef X
+
+    usz count = interface_read_count(&r);
+    for (usz i = 0; i < count && r.ok; i++) {
+        InterfaceFunction function = {.name = interface_read_name(&r)};
+        u64               attributes = interface_read_uleb(&r);
+        if (attributes & ~(u64)known) {
+            r.ok = false;
+        }
+        function.attributes  = (FunctionAttributes)attributes;
+        function.return_type = interface_read_type(&r);
+        usz arguments        = interface_read_count(&r);
+        for (usz a = 0; a < arguments && r.ok; a++) {
+            da_append(&function.argument_types, interface_read_type(&r));
+        }
+        module_interface_add(out, function);
+    }
+
+    if (!r.ok || r.pos != bytes.len) {
+        module_interface_destroy(out);
+        *out = (ModuleInterface){0};
+        return false;
+    }
+    return true;
+}
+
+bool interface_write(ModuleInterface *interface, char const *path) {
+    str  bytes = interface_serialize(interface);
+    str  old;
+    bool ok = true;
+    if (read_file(path, &old)) {
+        bool same = str_equal(old, bytes);
+        str_destroy(old);
+        if (same) {
+            str_destroy(bytes);
+            return true;
+        }
+    }
+
+    // Importers never see a half written interface.
+    str   tmp_str = str_format("%s.tmp", path);
+    char *tmp     = to_cstr(tmp_str);
+    str_destroy(tmp_str);
+    FILE *file = fopen(tmp, "wb");
+    if (file == NULL) {
+        log_error("could not write the interface %s", path);
+        ok = false;
+    } else {
+        ok = fwrite(bytes.ptr, 1, bytes.len, file) == bytes.len;
+        ok = fclose(file) == 0 && ok;
+        ok = ok && rename(tmp, path) == 0;
+        if (!ok) {
+            log_error("could not write the interface %s", path);
+            remove(tmp);
+        }
+    }
+    free(tmp);
+    str_destroy(bytes);
+    return ok;
+}
+
+bool interface_read(char const *path, ModuleInterface *out) {
+    str bytes;
+    if (!read_file(path, &bytes)) {
+        return false;
+    }
+    bool ok = interface_deserialize(bytes, out);
+    str_destroy(bytes);
+    if (!ok) {
+        log_error("%s is no valid interface of version %d", path,
+                  INTERFACE_VERSION);
+    }
+    return ok;
+}
+
+char *interface_find(str name, char const *dir, char const *const *dirs,
+                     usz dir_count) {
+    for (isz i = -1; i < (isz)dir_count; i++) {
+        str   path_str = str_format("%s/%.*s.%s", i == -1 ? dir : dirs[i],
+                                    (int)name.len, name.ptr,
+                                    INTERFACE_EXTENSION);
+        char *path     = to_cstr(path_str);
+        str_destroy(path_str);
+        if (access(path, F_OK) == 0) {
+            return path;
+        }
+        free(path);
+    }
+    return NULL;
+}
+
+ModuleInterface *module_interfaces_find(ModuleInterfaces *interfaces,
+                                        char const       *name) {
+    for (usz i = 0; i < interfaces->count; i++) {
+        if (strcmp(interfaces->items[i].name, name) == 0) {
+            return &interfaces->items[i];
+        }
+    }
+    return NULL;
+}
+
+void module_interfaces_destroy(ModuleInterfaces *interfaces) {
+    for (usz i = 0; i < interfaces->count; i++) {
+        module_interface_destroy(&interfaces->items[i]);
+    }
+    da_destroy(interfaces);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common.h"
+#include "language.h"
+
+// ================
+// -- interface --
+// The interface of a module holds the signatures of its @export functions. It
+// is written as a .thi file next to the output of the module, a module that
+// imports it only reads the interface instead of parsing and analysing the
+// source of the dependency again.
+//
+// The file is compact and little endian. After the magic and the version
+// follow the module name and the functions sorted by name, every count and
+// length is an unsigned LEB128 and every type is its builtin type and its
+// lanes in one byte each:
+//
+//     "THI" version name function_count
+//     function: name attributes return_type argument_count argument_types...
+//     name: length bytes...
+// ================
+
+#define INTERFACE_MAGIC     "THI"
+#define INTERFACE_VERSION   1
+#define INTERFACE_EXTENSION "thi"
+
+typedef struct InterfaceFunction InterfaceFunction;
+struct InterfaceFunction {
+    char              *name;
+    Type               return_type;
+    struct {
+        usz   count;
+        usz   capacity;
+        Type *items;
+    } argument_types;
+    FunctionAttributes attributes;
+};
+
+typedef struct ModuleInterface ModuleInterface;
+struct ModuleInterface {
+    char *name;
+    struct {
+        usz                count;
+        usz                capacity;
+        InterfaceFunction *items;
+    } functions;
+};
+
+typedef struct ModuleInterfaces ModuleInterfaces;
+struct ModuleInterfaces {
+    usz              count;
+    usz              capacity;
+    ModuleInterface *items;
+};
+
+// Takes the ownership of the function and its name, the functions are sorted
+// by interface_serialize.
+void             module_interface_add(ModuleInterface  *interface,
+                                      InterfaceFunction function);
+void             module_interface_destroy(ModuleInterface *interface);
+
+// The bytes of the file, the same interface always gives the same bytes.
+str              interface_serialize(ModuleInterface *interface);
+// Returns false if the bytes are no valid interface of this version.
+bool             interface_deserialize(str bytes, ModuleInterface *out);
+
+// Only replaces the file if its bytes change, so the modification time of an
+// unchanged interface stays the same for build tools.
+bool             interface_write(ModuleInterface *interface, char const *path);
+bool             interface_read(char const *path, ModuleInterface *out);
+
+// The path of name.thi in dir or else in the first of the other directories
+// that has it, NULL if none has it.
+char            *interface_find(str name, char const *dir,
+                                char const *const *dirs, usz dir_count);
+
+// NULL if no interface has the name.
+ModuleInterface *module_interfaces_find(ModuleInterfaces *interfaces,
+                                        char const       *name);
+void             module_interfaces_destroy(ModuleInterfaces *interfaces);
@@ -1,12 +1,227 @@
 #pragma once
 
+#include <stdbool.h>
+#include "common.h"
+
+enum BuiltinTypeKind {
+    BUILTIN_TYPE_KIND_NONE,
+    BUILTIN_TYPE_KIND_UNSIGNED,
+    BUILTIN_TYPE_KIND_SIGNED,
+    BUILTIN_TYPE_KIND_FLOAT,
+    BUILTIN_TYPE_KIND_BOOL,
+};
+typedef enum BuiltinTypeKind BuiltinTypeKind;
+
+// The scalar types, name, kind and bits
+#define BUILTIN_TYPES           \
+    X(U8, u8, UNSIGNED, 8)      \
+    X(U16, u16, UNSIGNED, 16)   \
+    X(U32, u32, UNSIGNED, 32)   \
+    X(U64, u64, UNSIGNED, 64)   \
+    X(I8, i8, SIGNED, 8)        \
+    X(I16, i16, SIGNED, 16)     \
+    X(I32, i32, SIGNED, 32)     \
+    X(I64, i64, SIGNED, 64)     \
+    X(F32, f32, FLOAT, 32)      \
+    X(F64, f64, FLOAT, 64)      \
+    X(BOOL, bool, BOOL, 1)
+
 enum BuiltinType {
-    BUILTIN_TYPE_U32,
+    // No type, used for nodes that are not typed or could not be resolved.
+    BUILTIN_TYPE_NONE,
+#define X(upper, lower, kind, bits) BUILTIN_TYPE_##upper,
+    BUILTIN_TYPES
+#undef X
 };
 
 typedef enum BuiltinType BuiltinType;
 
 typedef struct Type      Type;
 struct Type {
+    // The scalar type, or the element type of a vector
     BuiltinType type;
+    // The lanes of a vector type like u32x4, 0 for scalar types
+    u32         lanes;
 };
+
+// The lane counts of the vector types, every scalar type T has the vector
+// types Tx2 to Tx16.
+#define VECTOR_LANES X(2) X(4) X(8) X(16)
+#define VECTOR_MAX_LANES 16
+
+static inline bool type_equal(Type a, Type b) {
+    return a.type == b.type && a.lanes == b.lanes;
+}
+
+static inline bool type_is_vector(Type type) { return type.lanes > 0; }
+
+// The element type of a vector, a scalar type stays the same.
+static inline Type type_element(Type type) {
+    return (Type){.type = type.type};
+}
+
+static inline bool type_valid_lanes(usz lanes) {
+#define X(n) lanes == n ||
+    return VECTOR_LANES false;
+#undef X
+}
+
+static inline BuiltinTypeKind type_kind(Type type) {
+    switch (type.type) {
+#define X(upper, lower, kind, bits) \
+    case BUILTIN_TYPE_##upper:      \
+        return BUILTIN_TYPE_KIND_##kind;
+        BUILTIN_TYPES
+#undef X
+        case BUILTIN_TYPE_NONE:
+            break;
+    }
+    return BUILTIN_TYPE_KIND_NONE;
+}
+
+// The bits of the scalar or element type.
+static inline u32 type_bits(Type type) {
+    switch (type.type) {
+#define X(upper, lower, kind, bits) \
+    case BUILTIN_TYPE_##upper:      \
+        return bits;
+        BUILTIN_TYPES
+#undef X
+        case BUILTIN_TYPE_NONE:
+            break;
+    }
+    return 0;
+}
+
+static inline bool type_is_integer(Type type) {
+    return type_kind(type) == BUILTIN_TYPE_KIND_UNSIGNED ||
+           type_kind(type) == BUILTIN_TYPE_KIND_SIGNED;
+}
+
+static inline bool type_is_float(Type type) {
+    return type_kind(type) == BUILTIN_TYPE_KIND_FLOAT;
+}
+
+static inline bool type_is_bool(Type type) {
+    return type_kind(type) == BUILTIN_TYPE_KIND_BOOL;
+}
+
+// The integers a float type represents exactly go up to 2^mantissa bits.
+static inline u32 type_mantissa_bits(Type type) {
+    return type_bits(type) == 32 ? 24 : 53;
+}
+
+// The largest value of an integer type.
+static inline u64 type_integer_max(Type type) {
+    u32 bits = type_bits(type) - (type_kind(type) == BUILTIN_TYPE_KIND_SIGNED);
+    return bits == 64 ? UINT64_MAX : (1ull << bits) - 1;
+}
+
+// A value computed at compile time. Integers and bools are stored zero
+// extended from their bits and floats as f64, rounded to f32 for f32. Scalars
+// only use the first lane, unused lanes are zero.
+typedef union ComptimeLane ComptimeLane;
+union ComptimeLane {
+    u64 integer;
+    f64 real;
+};
+
+typedef struct ComptimeValue ComptimeValue;
+struct ComptimeValue {
+    Type         type;
+    ComptimeLane lanes[VECTOR_MAX_LANES];
+};
+
+// The used lanes of a value of the type.
+static inline u32 type_value_lanes(Type type) {
+    return type_is_vector(type) ? type.lanes : 1;
+}
+
+// The attributes of functions, written as @name before fn
+#define FUNCTION_ATTRIBUTES                                   \
+    /* Always inlined into the callers */                     \
+    X(INLINE, inline)                                         \
+    /* Never inlined */                                       \
+    X(NOINLINE, noinline)                                     \
+    /* Rarely called, optimised for size and moved away */    \
+    X(COLD, cold)                                             \
+    /* Often called, optimised aggressively */                \
+    X(HOT, hot)                                               \
+    /* Only depends on the arguments, so calls with the same  \
+       arguments can be merged or removed if unused */        \
+    X(PURE, pure)                                             \
+    /* Uses the fast calling convention, not for main */       \
+    X(FASTCC, fastcc)                                         \
+    /* Part of the interface, other modules can import it */  \
+    X(EXPORT, export)
+
+enum FunctionAttribute {
+#define X(upper, lower) FUNCTION_ATTRIBUTE_##upper,
+    FUNCTION_ATTRIBUTES
+#undef X
+};
+typedef enum FunctionAttribute FunctionAttribute;
+
+// A set of FunctionAttribute
+typedef u32                    FunctionAttributes;
+#define FUNCTION_ATTRIBUTE_BIT(attribute) (1u << (attribute))
+
+// The hints of loops, written as #name or #name(argument) before for and while
+#define LOOP_HINTS                                                  \
+    /* #unroll(count) unrolls count times, #unroll leaves the count \
+       to LLVM and #unroll(1) disables unrolling */                 \
+    X(UNROLL, unroll)                                               \
+    /* #vectorize(width) vectorizes with width lanes, a power of    \
+       two up to 64, #vectorize(1) disables vectorization */        \
+    X(VECTORIZE, vectorize)                                         \
+    /* The iterations are independent, so the loop may not assign   \
+       variables declared outside of it */                          \
+    X(PARALLEL, parallel)
+
+enum LoopHint {
+    LOOP_HINT_NONE,
+#define X(upper, lower) LOOP_HINT_##upper,
+    LOOP_HINTS
+#undef X
+};
+typedef enum LoopHint LoopHint;
+
+#define LOOP_HINT_MAX_VECTORIZE_WIDTH 64
+
+// Implicit conversions never lose a value: integers widen, unsigned integers
+// become wider signed integers, integers that fit into the mantissa become
+// floats and f32 becomes f64. A scalar converts to a vector of a type it
+// converts to, by using it for every lane.
+static inline bool type_converts(Type from, Type to) {
+    if (type_equal(from, to)) {
+        return true;
+    }
+    if (!type_is_vector(from) && type_is_vector(to)) {
+        return type_converts(from, type_element(to));
+    }
+    if (from.lanes != to.lanes) {
+        return false;
+    }
+
+    BuiltinTypeKind from_kind = type_kind(from);
+    BuiltinTypeKind to_kind   = type_kind(to);
+    u32             from_bits = type_bits(from);
+    u32             to_bits   = type_bits(to);
+    switch (to_kind) {
+        case BUILTIN_TYPE_KIND_UNSIGNED:
+            return from_kind == BUILTIN_TYPE_KIND_UNSIGNED && from_bits < to_bits;
+        case BUILTIN_TYPE_KIND_SIGNED:
+            return (from_kind == BUILTIN_TYPE_KIND_SIGNED ||
+                    from_kind == BUILTIN_TYPE_KIND_UNSIGNED) &&
+                   from_bits < to_bits;
+        case BUILTIN_TYPE_KIND_FLOAT:
+            return from_kind == BUILTIN_TYPE_KIND_FLOAT
+                       ? from_bits < to_bits
+                       : from_kind != BUILTIN_TYPE_KIND_NONE &&
+                             from_bits < type_mantissa_bits(to);
+        case BUILTIN_TYPE_KIND_BOOL:
+        case BUILTIN_TYPE_KIND_NONE:
+            break;
+    }
+    return false;
+}
@@ -1,5 +1,6 @@
 #include "lexer.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,12 +9,22 @@
 #include "token.h"
 #include "uthash.h"
 
-static keyword_to_token *keyword_to_tokens = NULL;
-static keyword_to_token *k2ts_mem          = NULL;
+// Built once and shared by every lexer, also across threads and the requests
+// of a daemon.
+static keyword_to_token *keyword_to_tokens      = NULL;
+static keyword_to_token *k2ts_mem               = NULL;
+static pthread_once_t    keyword_to_tokens_once = PTHREAD_ONCE_INIT;
 
 void                     init_keyword_to_tokens(void) {
     keyword_to_token k2ts[] = {
-        {.keyword = "fn", .token = TOKEN_TYPE_FN}
+        {.keyword = "fn",       .token = TOKEN_TYPE_FN      },
+        {.keyword = "return",   .token = TOKEN_TYPE_RETURN  },
+        {.keyword = "while",    .token = TOKEN_TYPE_WHILE   },
+        {.keyword = "for",      .token = TOKEN_TYPE_FOR     },
+        {.keyword = "in",       .token = TOKEN_TYPE_IN      },
+        {.keyword = "comptime", .token = TOKEN_TYPE_COMPTIME},
+        {.keyword = "module",   .token = TOKEN_TYPE_MODULE  },
+        {.keyword = "import",   .token = TOKEN_TYPE_IMPORT  },
     };
 
     k2ts_mem = malloc(sizeof(k2ts));
@@ -24,19 +35,19 @@ void                     init_keyword_to_tokens(void) {
 }
 
 keyword_to_token *get_keyword_to_tokens_hash_map(void) {
-    if (keyword_to_tokens == NULL) {
-        init_keyword_to_tokens();
-    }
+    pthread_once(&keyword_to_tokens_once, init_keyword_to_tokens);
     return keyword_to_tokens;
 }
 
 void free_global_resources(void) {
     HASH_CLEAR(hh, keyword_to_tokens);
     free(k2ts_mem);
+    k2ts_mem = NULL;
 }
 
+// l may be NULL for tokens inserted after lexing.
 void NORETURN lexer_fatal_error(Lexer *l, LexerFatalError error) {
-    if (l->fatal_error_cb != NULL) {
+    if (l != NULL && l->fatal_error_cb != NULL) {
         l->fatal_error_cb(error);
     }
     fprintf(stderr, "Could not allocate memory, aborting...");
@@ -54,9 +65,7 @@ void lexer_read_char(Lexer *l) {
 }
 
 Lexer lexer_create(str input, LexerFatalErrorCallback fatal_error_cb) {
-    if (keyword_to_tokens == NULL) {
-        init_keyword_to_tokens();
-    }
+    pthread_once(&keyword_to_tokens_once, init_keyword_to_tokens);
 
     Lexer lexer = {.input          = str_clone(input),
                    .ch             = 0,
@@ -71,7 +80,6 @@ Lexer lexer_create(str input, LexerFatalErrorCallback fatal_error_cb) {
 
 void lexer_destroy(Lexer lexer) {
     str_destroy(lexer.input);
-    free_global_resources();
 }
 
 void tokens_destroy(Tokens t) {
@@ -110,6 +118,13 @@ Index tokens_insert_extra(Lexer *l, Tokens *t, Token *token,
     return tokens_insert(l, t, *token);
 }
 
+Index tokens_insert_integer(Tokens *t, usz pos, usz len, u64 integer) {
+    TokenExtraData data  = {.type = EXTRA_DATA_INTEGER,
+                            .data = {.integer = integer}};
+    Token          token = {.type = TOKEN_TYPE_INTEGER, .pos = pos, .len = len};
+    return tokens_insert_extra(NULL, t, &token, data);
+}
+
 bool is_ident_char(char ch) {
     return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z');
 }
@@ -150,17 +165,52 @@ Token lexer_read_identifier(Lexer *l, Tokens *t) {
     return token;
 }
 
+// 1.5 is a float, the dot has to be followed by a digit.
+Token lexer_read_float(Lexer *l, Tokens *t, usz pos) {
+    // Skip the dot
+    lexer_read_char(l);
+    while (is_number(l->ch)) {
+        lexer_read_char(l);
+    }
+
+    str   float_str  = to_strl(l->input.ptr + pos, l->pos - pos);
+    char *float_cstr = to_cstr(float_str);
+    str_destroy(float_str);
+    TokenExtraData data = {.type = EXTRA_DATA_FLOAT,
+                           .data = {.floating = strtod(float_cstr, NULL)}};
+    free(float_cstr);
+
+    Token token = {.type = TOKEN_TYPE_FLOAT, .pos = pos, .len = l->pos - pos};
+    tokens_insert_extra(l, t, &token, data);
+    return token;
+}
+
 Token lexer_read_number(Lexer *l, Tokens *t) {
-    usz pos    = l->pos;
-    int number = 0;
+    usz  pos      = l->pos;
+    u64  number   = 0;
+    bool overflow = false;
 
     while (is_number(l->ch)) {
-        number *= 10;
-        number += l->ch - '0';
-        /*printf("ch: '%c' number: %d\n", l->ch, number);*/
+        u64 digit = l->ch - '0';
+        overflow  = overflow || number > (UINT64_MAX - digit) / 10;
+        number    = number * 10 + digit;
         lexer_read_char(l);
     }
 
+    if (l->ch == '.' && l->peek_pos < l->input.len &&
+        is_number(l->input.ptr[l->peek_pos])) {
+        return lexer_read_float(l, t, pos);
+    }
+
+    // The parser reports integers that do not fit into 64 bits.
+    if (overflow) {
+        Token token = {.type = TOKEN_TYPE_INTEGER_OUT_OF_RANGE,
+                       .pos  = pos,
+                       .len  = l->pos - pos};
+        tokens_insert(l, t, token);
+        return token;
+    }
+
     TokenExtraData data = {.type = EXTRA_DATA_INTEGER,
                            .data = {.integer = number}};
     Token token = {.type = TOKEN_TYPE_INTEGER, .pos = pos, .len = l->pos - pos};
@@ -180,6 +230,21 @@ void lexer_skip_whitespace(Lexer *l) {
         cur_token.len  = 1;       \
         break;
 
+// A token that is ttype alone and double_ttype if it is followed by second,
+// like < and <=. single_ttype may be TOKEN_TYPE_INVALID.
+#define DOUBLE_TOKEN(char, single_ttype, second, double_ttype) \
+    case char:                                                  \
+        if (l->peek_pos < l->input.len &&                       \
+            l->input.ptr[l->peek_pos] == second) {              \
+            lexer_read_char(l);                                 \
+            cur_token.type = double_ttype;                      \
+            cur_token.len  = 2;                                 \
+        } else {                                                \
+            cur_token.type = single_ttype;                      \
+            cur_token.len  = 1;                                 \
+        }                                                       \
+        break;
+
 Token lexer_next_token(Lexer *l, Tokens *t) {
     lexer_skip_whitespace(l);
 
@@ -193,8 +258,17 @@ Token lexer_next_token(Lexer *l, Tokens *t) {
         SIMPLE_TOKEN('}', TOKEN_TYPE_RBRACE);
         SIMPLE_TOKEN(':', TOKEN_TYPE_COLON);
         SIMPLE_TOKEN(',', TOKEN_TYPE_COMMA);
-        SIMPLE_TOKEN('=', TOKEN_TYPE_EQUAL);
+        SIMPLE_TOKEN('@', TOKEN_TYPE_AT);
+        SIMPLE_TOKEN('#', TOKEN_TYPE_HASH);
+        SIMPLE_TOKEN('+', TOKEN_TYPE_PLUS);
+        SIMPLE_TOKEN('-', TOKEN_TYPE_MINUS);
+        SIMPLE_TOKEN('*', TOKEN_TYPE_ASTERISK);
         SIMPLE_TOKEN('\n', TOKEN_TYPE_EOL);
+        DOUBLE_TOKEN('=', TOKEN_TYPE_EQUAL, '=', TOKEN_TYPE_EQUAL_EQUAL);
+        DOUBLE_TOKEN('!', TOKEN_TYPE_INVALID, '=', TOKEN_TYPE_BANG_EQUAL);
+        DOUBLE_TOKEN('<', TOKEN_TYPE_LESS, '=', TOKEN_TYPE_LESS_EQUAL);
+        DOUBLE_TOKEN('>', TOKEN_TYPE_GREATER, '=', TOKEN_TYPE_GREATER_EQUAL);
+        DOUBLE_TOKEN('.', TOKEN_TYPE_INVALID, '.', TOKEN_TYPE_DOT_DOT);
         case 0:
             cur_token.type = TOKEN_TYPE_EOF;
             cur_token.len  = 1;
@@ -248,13 +322,20 @@ char *tokens_token_cstr(str input, Tokens *t, Index idx) {
     return cstr;
 }
 
-int extra_data_integer(Tokens *t, TokenExtraDataIndex i) {
+u64 extra_data_integer(Tokens *t, TokenExtraDataIndex i) {
     assert(t->extra_data.len > i);
     assert(t->extra_data.data[i].type == EXTRA_DATA_INTEGER);
 
     return t->extra_data.data[i].data.integer;
 }
 
+f64 extra_data_float(Tokens *t, TokenExtraDataIndex i) {
+    assert(t->extra_data.len > i);
+    assert(t->extra_data.data[i].type == EXTRA_DATA_FLOAT);
+
+    return t->extra_data.data[i].data.floating;
+}
+
 void print_tokens(Tokens *t) {
     for (usz i = 0; i < t->len; i++) {
         printf("%s\n", token_type_str(t->tokens[i].type));
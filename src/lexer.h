@@ -6,6 +6,7 @@
 
 enum TokenExtraDataType {
     EXTRA_DATA_INTEGER,
+    EXTRA_DATA_FLOAT,
 };
 typedef enum TokenExtraDataType TokenExtraDataType;
 
@@ -13,7 +14,8 @@ typedef struct TokenExtraData   TokenExtraData;
 struct TokenExtraData {
     TokenExtraDataType type;
     union {
-        int integer;
+        u64 integer;
+        f64 floating;
     } data;
 };
 
@@ -63,10 +65,17 @@ void   lexer_destroy(Lexer lexer);
 Tokens lexer_lex_tokens(Lexer *l);
 
 keyword_to_token *get_keyword_to_tokens_hash_map(void);
+// Frees the keyword table when the program exits, no lexer can be created
+// afterwards.
 void              free_global_resources(void);
 
 str               tokens_token_str(str input, Tokens *t, Index idx);
 char             *tokens_token_cstr(str input, Tokens *t, Index idx);
 void              tokens_destroy(Tokens t);
+// Appends an integer token that was not lexed, like the result of constant
+// folding. pos and len are the source range the integer replaces.
+Index             tokens_insert_integer(Tokens *t, usz pos, usz len,
+                                        u64 integer);
 
-int               extra_data_integer(Tokens *t, TokenExtraDataIndex i);
+u64               extra_data_integer(Tokens *t, TokenExtraDataIndex i);
+f64               extra_data_float(Tokens *t, TokenExtraDataIndex i);
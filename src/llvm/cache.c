@@ -0,0 +1,425 @@
+#include "cache.h"
+#include <errno.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Linker.h>
+#include <llvm/Config/llvm-config.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "da.h"
+#include "lexer.h"
+#include "llvm/codegen.h"
+#include "llvm/emit.h"
+#include "uthash.h"
+
+// Changing the generated code for the same tokens requires a new version, so
+// old cache entries are not used anymore.
+#define BITCODE_CACHE_VERSION "thor-bitcode-2 llvm-" LLVM_VERSION_STRING
+
+// Hashes s with its terminator, NULL hashes like the empty string.
+u64 cache_hash_cstr(u64 hash, char const *s) {
+    if (s == NULL) {
+        s = "";
+    }
+    return hash_fnv1a(hash, s, strlen(s) + 1);
+}
+
+u64 cache_hash_token(CodeGenerator *cg, u64 hash, Index token) {
+    Token *t = &cg->tokens.tokens[token];
+    hash     = hash_fnv1a(hash, &t->type, sizeof(t->type));
+    hash     = hash_fnv1a(hash, cg->parser.input.ptr + t->pos, t->len);
+    // Separates the tokens, so `ab c` and `a bc` differ.
+    return hash_fnv1a(hash, "", 1);
+}
+
+// The tokens from the first attribute or `fn` to the closing brace of the
+// function, end is exclusive.
+void cache_function_tokens(CodeGenerator *cg, Index function, Index *begin,
+                           Index *end) {
+    Node                  *node = &cg->thor_module.nodes.items[function];
+    FunctionPrototypeData *fpd =
+        &cg->thor_module.extra_data.items[node->data.lhs]
+             .data.function_prototype;
+    // Before the attribute name is the @
+    *begin = fpd->attributes.count > 0 ? fpd->attributes.items[0] - 1
+                                       : node->main_token - 1;
+    usz   depth = 0;
+    Index token = *begin;
+    for (; token < cg->tokens.len; token++) {
+        TokenType type = cg->tokens.tokens[token].type;
+        if (type == TOKEN_TYPE_LBRACE) {
+            depth += 1;
+        } else if (type == TOKEN_TYPE_RBRACE && --depth == 0) {
+            break;
+        }
+    }
+    *end = token < cg->tokens.len ? token + 1 : token;
+}
+
+// Hashes the tokens from `fn` to the opening brace.
+u64 cache_hash_signature(CodeGenerator *cg, u64 hash, Index function) {
+    Index begin, end;
+    cache_function_tokens(cg, function, &begin, &end);
+    for (Index token = begin; token < end; token++) {
+        if (cg->tokens.tokens[token].type == TOKEN_TYPE_LBRACE) {
+            break;
+        }
+        hash = cache_hash_token(cg, hash, token);
+    }
+    return hash;
+}
+
+// Imported functions have no tokens, their declaration only depends on the
+// interface.
+u64 cache_hash_import(u64 hash, AnalyseFunction *function) {
+    hash = hash_fnv1a(hash, function->module, strlen(function->module) + 1);
+    hash = hash_fnv1a(hash, function->name, strlen(function->name) + 1);
+    hash = hash_fnv1a(hash, &function->attributes, sizeof(function->attributes));
+    hash = hash_fnv1a(hash, &function->return_type, sizeof(Type));
+    return hash_fnv1a(hash, function->argument_types.items,
+                      sizeof(Type) * function->argument_types.count);
+}
+
+AnalyseComptime *cache_find_comptime(CodeGenerator *cg, char const *name) {
+    AnalyseVariable *variable;
+    HASH_FIND_STR(cg->analyse.scopes.items[cg->analyse.root_scope].variables,
+                  name, variable);
+    return variable == NULL ? NULL
+                            : analyse_find_comptime(&cg->analyse,
+                                                    variable->symbol);
+}
+
+CacheKey bitcode_cache_function_key(CodeGenerator *cg, Index function,
+                                    CodeGenOptLevel level) {
+    u64 hash = HASH_FNV1A_OFFSET_BASIS;
+    hash     = hash_fnv1a(hash, BITCODE_CACHE_VERSION,
+                          sizeof(BITCODE_CACHE_VERSION));
+    hash     = hash_fnv1a(hash, &level, sizeof(level));
+    // The passes optimise for the cpu and features of the target.
+    if (cg->target != NULL) {
+        hash = cache_hash_cstr(hash, cg->target->cpu);
+        hash = cache_hash_cstr(hash, cg->target->features);
+    }
+    // The module is part of the symbol names.
+    hash = hash_fnv1a(hash, cg->thor_module.name.ptr, cg->thor_module.name.len);
+
+    Index begin, end;
+    cache_function_tokens(cg, function, &begin, &end);
+    for (Index token = begin; token < end; token++) {
+        hash = cache_hash_token(cg, hash, token);
+    }
+
+    // Every other function that is named in the body is a dependency, its
+    // signature ends up in the generated declarations. The value of a named
+    // comptime declaration ends up in the generated code.
+    for (Index token = begin; token < end; token++) {
+        if (cg->tokens.tokens[token].type != TOKEN_TYPE_IDENTIFIER) {
+            continue;
+        }
+        char *name = tokens_token_cstr(cg->parser.input, &cg->tokens, token);
+        AnalyseFunction *dependency =
+            analyse_find_function(&cg->analyse, cg->analyse.root_scope, name);
+        AnalyseComptime *comptime = cache_find_comptime(cg, name);
+        free(name);
+        if (dependency != NULL && dependency->module != NULL) {
+            hash = cache_hash_import(hash, dependency);
+        } else if (dependency != NULL && dependency->node != function) {
+            hash = cache_hash_signature(cg, hash, dependency->node);
+        }
+        if (comptime != NULL) {
+            hash = hash_fnv1a(hash, &comptime->value.type, sizeof(Type));
+            hash = hash_fnv1a(hash, comptime->value.lanes,
+                              sizeof(ComptimeLane) *
+                                  type_value_lanes(comptime->value.type));
+        }
+    }
+
+    Token *first = &cg->tokens.tokens[begin];
+    Token *last  = &cg->tokens.tokens[end - 1];
+    return (CacheKey){
+        .hash       = hash,
+        .source_len = last->pos + last->len - first->pos,
+    };
+}
+
+bool bitcode_cache_open(BitcodeCache *out, char const *dir) {
+    *out = (BitcodeCache){0};
+    if (dir != NULL) {
+        if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+            log_error("could not create the cache directory %s: %s", dir,
+                      strerror(errno));
+            return false;
+        }
+        str dir_str = to_str(dir);
+        out->dir    = to_cstr(dir_str);
+        str_destroy(dir_str);
+    }
+    pthread_mutex_init(&out->lock, NULL);
+    return true;
+}
+
+void bitcode_cache_forget(BitcodeCache *cache) {
+    BitcodeCacheEntry *entry, *tmp;
+    HASH_ITER(hh, cache->entries, entry, tmp) {
+        HASH_DEL(cache->entries, entry);
+        LLVMDisposeMemoryBuffer(entry->bitcode);
+        free(entry);
+    }
+    cache->memory = 0;
+}
+
+// The lock has to be held.
+void bitcode_cache_evict(BitcodeCache *cache, BitcodeCacheEntry *entry) {
+    HASH_DEL(cache->entries, entry);
+    cache->memory -= LLVMGetBufferSize(entry->bitcode);
+    LLVMDisposeMemoryBuffer(entry->bitcode);
+    free(entry);
+}
+
+// Takes the ownership of bitcode, it replaces the bitcode of an entry with the
+// same key. The lock has to be held.
+void bitcode_cache_remember(BitcodeCache *cache, CacheKey key,
+                            LLVMMemoryBufferRef bitcode) {
+    usz                size = LLVMGetBufferSize(bitcode);
+    BitcodeCacheEntry *entry;
+    HASH_FIND(hh, cache->entries, &key, sizeof(CacheKey), entry);
+    if (entry != NULL) {
+        bitcode_cache_evict(cache, entry);
+    }
+    if (size > BITCODE_CACHE_MEMORY_LIMIT) {
+        LLVMDisposeMemoryBuffer(bitcode);
+        return;
+    }
+    if (cache->memory + size > BITCODE_CACHE_MEMORY_LIMIT) {
+        bitcode_cache_forget(cache);
+    }
+
+    entry = malloc(sizeof(BitcodeCacheEntry));
+    if (entry == NULL) {
+        LLVMDisposeMemoryBuffer(bitcode);
+        return;
+    }
+    *entry = (BitcodeCacheEntry){.key = key, .bitcode = bitcode};
+    HASH_ADD(hh, cache->entries, key, sizeof(CacheKey), entry);
+    cache->memory += size;
+}
+
+void bitcode_cache_close(BitcodeCache *cache) {
+    bitcode_cache_forget(cache);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->dir);
+    cache->dir = NULL;
+}
+
+char *bitcode_cache_path(BitcodeCache *cache, CacheKey key,
+                         char const *suffix) {
+    str   path_str = str_format("%s/%016llx-%llx.bc%s", cache->dir,
+                                (unsigned long long)key.hash,
+                                (unsigned long long)key.source_len, suffix);
+    char *path     = to_cstr(path_str);
+    str_destroy(path_str);
+    return path;
+}
+
+void cache_ignore_diagnostic(LLVMDiagnosticInfoRef info, void *data) {
+    (void)info;
+    (void)data;
+}
+
+// LLVM reports broken bitcode to the diagnostic handler of the context, and
+// the default handler exits. A broken entry only is a miss.
+bool cache_parse(LLVMContextRef context, LLVMMemoryBufferRef bitcode,
+                 LLVMModuleRef *out) {
+    LLVMDiagnosticHandler handler = LLVMContextGetDiagnosticHandler(context);
+    void                 *data    = LLVMContextGetDiagnosticContext(context);
+    LLVMContextSetDiagnosticHandler(context, cache_ignore_diagnostic, NULL);
+    bool ok = !LLVMParseBitcodeInContext2(context, bitcode, out);
+    LLVMContextSetDiagnosticHandler(context, handler, data);
+    return ok;
+}
+
+bool bitcode_cache_load(BitcodeCache *cache, CacheKey key,
+                        LLVMContextRef context, LLVMModuleRef *out) {
+    pthread_mutex_lock(&cache->lock);
+    BitcodeCacheEntry *entry;
+    HASH_FIND(hh, cache->entries, &key, sizeof(CacheKey), entry);
+    bool remembered = entry != NULL;
+    bool ok = remembered && cache_parse(context, entry->bitcode, out);
+    // A broken entry is a miss, the function is stored again afterwards.
+    if (remembered && !ok) {
+        bitcode_cache_evict(cache, entry);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (remembered || cache->dir == NULL) {
+        return ok;
+    }
+
+    char               *path    = bitcode_cache_path(cache, key, "");
+    LLVMMemoryBufferRef bitcode = NULL;
+    char               *message = NULL;
+    bool found = !LLVMCreateMemoryBufferWithContentsOfFile(path, &bitcode,
+                                                           &message);
+    LLVMDisposeMessage(message);
+    free(path);
+    if (!found) {
+        return false;
+    }
+
+    // A broken entry is a miss, it is overwritten afterwards.
+    ok = cache_parse(context, bitcode, out);
+    if (ok) {
+        pthread_mutex_lock(&cache->lock);
+        bitcode_cache_remember(cache, key, bitcode);
+        pthread_mutex_unlock(&cache->lock);
+    } else {
+        LLVMDisposeMemoryBuffer(bitcode);
+    }
+    return ok;
+}
+
+bool bitcode_cache_store_buffer(BitcodeCache *cache, CacheKey key,
+                                LLVMMemoryBufferRef bitcode) {
+    LLVMMemoryBufferRef copy = LLVMCreateMemoryBufferWithMemoryRangeCopy(
+        LLVMGetBufferStart(bitcode), LLVMGetBufferSize(bitcode), "");
+    if (cache->dir == NULL) {
+        pthread_mutex_lock(&cache->lock);
+        bitcode_cache_remember(cache, key, copy);
+        pthread_mutex_unlock(&cache->lock);
+        return true;
+    }
+
+    // Written to a temporary file first, so other builds never see a
+    // partial entry. Two compilations of a build may store the same key.
+    static atomic_size_t writes = 0;
+    str suffix_str = str_format(".%ld.%zu.tmp", (long)getpid(),
+                                atomic_fetch_add(&writes, 1));
+    char *suffix     = to_cstr(suffix_str);
+    str_destroy(suffix_str);
+    char *tmp_path = bitcode_cache_path(cache, key, suffix);
+    char *path     = bitcode_cache_path(cache, key, "");
+    free(suffix);
+
+    bool  ok   = false;
+    FILE *file = fopen(tmp_path, "wb");
+    if (file != NULL) {
+        usz size = LLVMGetBufferSize(bitcode);
+        ok = fwrite(LLVMGetBufferStart(bitcode), 1, size, file) == size;
+        ok = fclose(file) == 0 && ok;
+        ok = ok && rename(tmp_path, path) == 0;
+        if (!ok) {
+            remove(tmp_path);
+        }
+    }
+    if (!ok) {
+        log_error("could not write the cache entry %s", path);
+    }
+    pthread_mutex_lock(&cache->lock);
+    bitcode_cache_remember(cache, key, copy);
+    pthread_mutex_unlock(&cache->lock);
+
+    free(tmp_path);
+    free(path);
+    return ok;
+}
+
+bool bitcode_cache_store(BitcodeCache *cache, CacheKey key,
+                         LLVMModuleRef module) {
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+    bool                ok      = bitcode_cache_store_buffer(cache, key, bitcode);
+    LLVMDisposeMemoryBuffer(bitcode);
+    return ok;
+}
+
+typedef struct CachedFunctions CachedFunctions;
+struct CachedFunctions {
+    usz            count;
+    usz            capacity;
+    LLVMModuleRef *items;
+};
+
+typedef struct CacheMisses CacheMisses;
+struct CacheMisses {
+    usz    count;
+    usz    capacity;
+    Index *items;
+};
+
+bool code_gen_cached(CodeGenerator *cg, BitcodeCache *cache,
+                     CodeGenOptLevel level, BitcodeCacheStats *stats) {
+    Module *m = &cg->thor_module;
+    *stats    = (BitcodeCacheStats){0};
+
+    // The module of every function in source order, NULL for misses until
+    // they are generated.
+    CachedFunctions functions = {0};
+    CacheMisses     misses    = {0};
+    CacheMisses     slots     = {0};
+    struct {
+        usz       count;
+        usz       capacity;
+        CacheKey *items;
+    } keys = {0};
+
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node = m->top_level_nodes.items[i];
+        if (m->nodes.items[node].type != NODE_TYPE_FUNCTION_DEFINITION) {
+            continue;
+        }
+
+        CacheKey      key    = bitcode_cache_function_key(cg, node, level);
+        LLVMModuleRef module = NULL;
+        if (bitcode_cache_load(cache, key, cg->context, &module)) {
+            stats->hits += 1;
+        } else {
+            da_append(&misses, node);
+            da_append(&slots, functions.count);
+            da_append(&keys, key);
+        }
+        da_append(&functions, module);
+    }
+
+    bool ok = true;
+    if (misses.count > 0) {
+        CodeGenShards shards =
+            code_gen_function_shards(cg, misses.items, misses.count, level);
+        ok = code_gen_shards_ok(&shards);
+        for (usz i = 0; ok && i < shards.count; i++) {
+            // The bitcode is stored and moves the module into cg->context.
+            LLVMMemoryBufferRef bitcode =
+                LLVMWriteBitcodeToMemoryBuffer(shards.items[i].cg.module);
+            bitcode_cache_store_buffer(cache, keys.items[i], bitcode);
+            ok = !LLVMParseBitcodeInContext2(cg->context, bitcode,
+                                             &functions.items[slots.items[i]]);
+            LLVMDisposeMemoryBuffer(bitcode);
+        }
+        code_gen_shards_destroy(shards);
+        stats->misses = misses.count;
+    }
+
+    for (usz i = 0; i < functions.count; i++) {
+        if (functions.items[i] == NULL) {
+            continue;
+        }
+        // Destroys the function module, also if linking fails.
+        if (ok && LLVMLinkModules2(cg->module, functions.items[i])) {
+            log_error("could not link a cached function");
+            ok = false;
+        } else if (!ok) {
+            LLVMDisposeModule(functions.items[i]);
+        }
+    }
+
+    da_destroy(&functions);
+    da_destroy(&misses);
+    da_destroy(&slots);
+    da_destroy(&keys);
+    return ok;
+}
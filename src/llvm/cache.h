@@ -0,0 +1,73 @@
+#pragma once
+
+#include <llvm-c/Types.h>
+#include <pthread.h>
+#include "common.h"
+#include "llvm/codegen.h"
+
+// ================
+// -- bitcode cache --
+// Caches the optimised bitcode of every top level function in a directory.
+// The key of a function hashes its tokens, the signatures of the functions it
+// names and the optimization level, so a function is only generated again if
+// something it depends on changed. Every function is generated and optimised
+// in its own module, so there is no inlining between functions.
+//
+// The bitcode that was read or written is also kept in memory while the cache
+// is open, so a cache that stays open, like in the daemon, reads an entry
+// only once. A cache without a directory only lives in memory.
+// ================
+
+// If the bitcode in memory grows larger, it is dropped and read again.
+#define BITCODE_CACHE_MEMORY_LIMIT (256 * 1024 * 1024)
+
+// The hash of everything the bitcode of a function depends on, and the length
+// of its source. Functions whose hashes collide rarely have the same length,
+// so most collisions are a miss instead of the wrong bitcode.
+typedef struct CacheKey CacheKey;
+struct CacheKey {
+    u64 hash;
+    u64 source_len;
+};
+
+typedef struct BitcodeCacheEntry BitcodeCacheEntry;
+struct BitcodeCacheEntry {
+    CacheKey            key;
+    LLVMMemoryBufferRef bitcode;
+    UT_hash_handle      hh;
+};
+
+typedef struct BitcodeCache BitcodeCache;
+struct BitcodeCache {
+    // NULL if the cache only lives in memory
+    char              *dir;
+    // Guards the entries, the compilations of a build share the cache.
+    pthread_mutex_t    lock;
+    BitcodeCacheEntry *entries;
+    // The size of the bitcode of every entry
+    usz                memory;
+};
+
+typedef struct BitcodeCacheStats BitcodeCacheStats;
+struct BitcodeCacheStats {
+    usz hits;
+    usz misses;
+};
+
+// Creates dir if it does not exist, dir may be NULL.
+bool     bitcode_cache_open(BitcodeCache *out, char const *dir);
+void     bitcode_cache_close(BitcodeCache *cache);
+CacheKey bitcode_cache_function_key(CodeGenerator *cg, Index function,
+                                    CodeGenOptLevel level);
+// Parses the cached module into context, returns false on a cache miss. An
+// entry that can not be parsed is dropped and counts as a miss.
+bool     bitcode_cache_load(BitcodeCache *cache, CacheKey key,
+                            LLVMContextRef context, LLVMModuleRef *out);
+// Replaces an entry with the same key.
+bool     bitcode_cache_store(BitcodeCache *cache, CacheKey key,
+                             LLVMModuleRef module);
+
+// Generates cg->module from the cache. Only the functions that are not cached
+// are generated and optimised, in parallel, and stored in the cache.
+bool code_gen_cached(CodeGenerator *cg, BitcodeCache *cache,
+                     CodeGenOptLevel level, BitcodeCacheStats *stats);
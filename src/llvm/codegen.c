@@ -1,81 +1,1254 @@
 #include "codegen.h"
 #include <assert.h>
+#include <llvm-c/Analysis.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
 #include <llvm-c/Core.h>
+#include <llvm-c/DebugInfo.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Transforms/PassBuilder.h>
 #include <llvm-c/Types.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "analyse.h"
+#include <string.h>
+#include <unistd.h>
 #include "ast.h"
 #include "ast_walker.h"
+#include "code_analyse.h"
 #include "common.h"
+#include "da.h"
+#include "flat_pass.h"
+#include "language.h"
 #include "lexer.h"
+#include "llvm/emit.h"
+#include "node_column.h"
 #include "parser.h"
+#include "thor_runtime.h"
 
-CodeGenerator code_gen_create(Tokens t, Parser p, Module m) {
-    LLVMContextRef context     = LLVMContextCreate();
-    LLVMBuilderRef builder     = LLVMCreateBuilderInContext(context);
-    char          *module_name = to_cstr(m.name);
-    LLVMModuleRef  module =
-        LLVMModuleCreateWithNameInContext(module_name, context);
+// Creates the LLVM side of the generator in context, the thor side has to be
+// set already.
+void cg_init_llvm_in(CodeGenerator *cg, LLVMContextRef context) {
+    char *module_name = to_cstr(cg->thor_module.name);
+    cg->context       = context;
+    cg->builder       = LLVMCreateBuilderInContext(cg->context);
+    cg->module = LLVMModuleCreateWithNameInContext(module_name, cg->context);
     free(module_name);
 
-    return (CodeGenerator){
-        .thor_module     = m,
-        .parser          = p,
-        .tokens          = t,
+    cg->symbols.count = cg->analyse.symbols.count;
+    cg->symbols.items = calloc(cg->analyse.symbols.count, sizeof(LLVMValueRef));
+    cg->function      = NULL;
+    node_column_init(&cg->values, cg->thor_module.nodes.count, NULL);
+}
+
+void cg_init_llvm(CodeGenerator *cg) {
+    cg_init_llvm_in(cg, LLVMContextCreate());
+}
+
+// Frees the LLVM side of the generator except for its context.
+void cg_release_llvm(CodeGenerator *cg) {
+    node_column_destroy(&cg->values);
+    free(cg->symbols.items);
+    da_destroy(&cg->loops);
 
-        .context         = context,
-        .builder         = builder,
-        .module          = module,
+    LLVMDisposeModule(cg->module);
+    LLVMDisposeBuilder(cg->builder);
+}
+
+void cg_destroy_llvm(CodeGenerator *cg) {
+    cg_release_llvm(cg);
+    LLVMContextDispose(cg->context);
+}
 
-        .named_variables = NULL,
+CodeGenerator code_gen_create(Parser p, Module m, ModuleAnalyse ma) {
+    CodeGenerator cg = {
+        .thor_module = m,
+        .parser      = p,
+        .tokens      = p.tokens,
+        .analyse     = ma,
     };
+    cg_init_llvm(&cg);
+    return cg;
 }
 
 void code_gen_destroy(CodeGenerator cg) {
-    LLVMDisposeModule(cg.module);
-    LLVMDisposeBuilder(cg.builder);
-    LLVMContextDispose(cg.context);
+    cg_destroy_llvm(&cg);
 
+    free_module_analyse(&cg.analyse);
     module_destroy(cg.thor_module);
+    // Also destroys the tokens
     parser_destroy(cg.parser);
-    tokens_destroy(cg.tokens);
 }
 
-void code_gen(CodeGenerator *cg) {
-    AstWalker walker = {
-        .data      = {.m     = &cg->thor_module,
-                      .t     = &cg->tokens,
-                      .input = &cg->parser.input},
-        .user_data = cg,
+LLVMTypeRef cg_scalar_type(CodeGenerator *cg, BuiltinType type) {
+    switch (type) {
+        case BUILTIN_TYPE_U8:
+        case BUILTIN_TYPE_I8:
+            return LLVMInt8TypeInContext(cg->context);
+        case BUILTIN_TYPE_U16:
+        case BUILTIN_TYPE_I16:
+            return LLVMInt16TypeInContext(cg->context);
+        case BUILTIN_TYPE_U32:
+        case BUILTIN_TYPE_I32:
+            return LLVMInt32TypeInContext(cg->context);
+        case BUILTIN_TYPE_U64:
+        case BUILTIN_TYPE_I64:
+            return LLVMInt64TypeInContext(cg->context);
+        case BUILTIN_TYPE_F32:
+            return LLVMFloatTypeInContext(cg->context);
+        case BUILTIN_TYPE_F64:
+            return LLVMDoubleTypeInContext(cg->context);
+        case BUILTIN_TYPE_BOOL:
+            return LLVMInt1TypeInContext(cg->context);
+        case BUILTIN_TYPE_NONE:
+            break;
+    }
+    UNREACHABLE("untyped value in codegen");
+}
+
+LLVMTypeRef cg_type(CodeGenerator *cg, Type type) {
+    LLVMTypeRef scalar = cg_scalar_type(cg, type.type);
+    return type_is_vector(type) ? LLVMVectorType(scalar, type.lanes) : scalar;
+}
+
+Index cg_symbol_id(CodeGenerator *cg, Index node_index) {
+    Index symbol = node_column_get(&cg->analyse.attributes.symbol, node_index);
+    assert(symbol != ANALYSE_INDEX_NONE && "node does not declare a symbol");
+    return symbol;
+}
+
+// Allocas are placed at the start of the entry block, so mem2reg can promote
+// them.
+LLVMValueRef cg_entry_alloca(CodeGenerator *cg, LLVMTypeRef type,
+                             char const *name) {
+    LLVMBasicBlockRef entry   = LLVMGetEntryBasicBlock(cg->function);
+    LLVMBuilderRef    builder = LLVMCreateBuilderInContext(cg->context);
+    LLVMValueRef      first   = LLVMGetFirstInstruction(entry);
+    if (first != NULL) {
+        LLVMPositionBuilderBefore(builder, first);
+    } else {
+        LLVMPositionBuilderAtEnd(builder, entry);
+    }
+
+    LLVMValueRef alloca = LLVMBuildAlloca(builder, type, name);
+    LLVMDisposeBuilder(builder);
+    return alloca;
+}
+
+void cg_add_function_attribute(CodeGenerator *cg, LLVMValueRef fn,
+                               char const *name) {
+    unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    assert(kind != 0 && "unknown llvm attribute");
+    LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex,
+                            LLVMCreateEnumAttribute(cg->context, kind, 0));
+}
+
+// The attributes and the calling convention of thor functions. Declarations
+// need them too, so calls use the same calling convention.
+void cg_function_attributes(CodeGenerator *cg, LLVMValueRef fn,
+                            FunctionAttributes attributes) {
+    static char const *const llvm_attributes[][2] = {
+        [FUNCTION_ATTRIBUTE_INLINE]   = {"alwaysinline"},
+        [FUNCTION_ATTRIBUTE_NOINLINE] = {"noinline"},
+        [FUNCTION_ATTRIBUTE_COLD]     = {"cold"},
+        [FUNCTION_ATTRIBUTE_HOT]      = {"hot"},
+        // Locals are the only memory a thor function can access.
+        [FUNCTION_ATTRIBUTE_PURE]     = {"readnone", "nounwind"},
+        [FUNCTION_ATTRIBUTE_FASTCC]   = {0},
+        [FUNCTION_ATTRIBUTE_EXPORT]   = {0},
     };
 
-    ast_walker_walk(&walker);
+    for (usz attribute = 0;
+         attribute < sizeof(llvm_attributes) / sizeof(llvm_attributes[0]);
+         attribute++) {
+        if (!(attributes & FUNCTION_ATTRIBUTE_BIT(attribute))) {
+            continue;
+        }
+        for (usz i = 0; i < 2 && llvm_attributes[attribute][i] != NULL; i++) {
+            cg_add_function_attribute(cg, fn, llvm_attributes[attribute][i]);
+        }
+    }
+
+    if (attributes & FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_FASTCC)) {
+        LLVMSetFunctionCallConv(fn, LLVMFastCallConv);
+    }
 }
 
-void         cg_top_level(CodeGenerator *cg, Node *node);
+// Adds the function with its symbol name, type and attributes.
+LLVMValueRef cg_add_function(CodeGenerator *cg, AnalyseFunction *function) {
+    usz          count  = function->argument_types.count;
+    LLVMTypeRef *params = malloc(sizeof(LLVMTypeRef) * (count + 1));
+    for (usz i = 0; i < count; i++) {
+        params[i] = cg_type(cg, function->argument_types.items[i]);
+    }
+
+    char        *name    = analyse_symbol_name(&cg->thor_module, function);
+    LLVMTypeRef  fn_type = LLVMFunctionType(cg_type(cg, function->return_type),
+                                            params, count, false);
+    LLVMValueRef fn      = LLVMAddFunction(cg->module, name, fn_type);
+    free(params);
+    free(name);
+    cg_function_attributes(cg, fn, function->attributes);
+    return fn;
+}
 
-void         cg_module(CodeGenerator *cg) {}
+// Declares all top level functions before any body is generated, so bodies
+// can refer to functions declared later.
+void cg_declare_function(CodeGenerator *cg, Index node_index) {
+    Node                  *node = &cg->thor_module.nodes.items[node_index];
+    FunctionPrototypeData *fpd =
+        &cg->thor_module.extra_data.items[node->data.lhs]
+             .data.function_prototype;
+    Index symbol_id = cg_symbol_id(cg, node_index);
 
-void         cg_top_level(CodeGenerator *cg, Node *node) {}
+    char *name = tokens_token_cstr(cg->parser.input, &cg->tokens,
+                                   node->main_token);
+    AnalyseFunction *function = analyse_find_function(
+        &cg->analyse, cg->analyse.root_scope, name);
+    free(name);
+    assert(function != NULL && "function was not analysed");
+
+    LLVMValueRef fn = cg_add_function(cg, function);
+
+    for (usz i = 0; i < fpd->args.count; i++) {
+        str arg_name = tokens_token_str(cg->parser.input, &cg->tokens,
+                                        fpd->args.items[i].name);
+        LLVMSetValueName2(LLVMGetParam(fn, i), arg_name.ptr, arg_name.len);
+        str_destroy(arg_name);
+    }
 
-LLVMValueRef cg_integer_literal(CodeGenerator *cg, Node *node) {
-    int integer = extra_data_integer(
+    cg->symbols.items[symbol_id] = fn;
+}
+
+void cg_begin_function(CodeGenerator *cg, Index node_index) {
+    cg->function = cg->symbols.items[cg_symbol_id(cg, node_index)];
+    LLVMBasicBlockRef entry =
+        LLVMAppendBasicBlockInContext(cg->context, cg->function, "entry");
+    LLVMPositionBuilderAtEnd(cg->builder, entry);
+
+    // Arguments are spilled into allocas like every other variable.
+    Index function_scope =
+        node_column_get(&cg->analyse.attributes.scope, node_index);
+    AnalyseVariable *var, *var_tmp;
+    HASH_ITER(hh, cg->analyse.scopes.items[function_scope].variables, var,
+              var_tmp) {
+        AnalyseSymbol *symbol = &cg->analyse.symbols.items[var->symbol];
+        if (symbol->kind != ANALYSE_SYMBOL_KIND_ARGUMENT) {
+            continue;
+        }
+        LLVMValueRef alloca =
+            cg_entry_alloca(cg, cg_type(cg, symbol->type), var->name);
+        LLVMBuildStore(cg->builder, LLVMGetParam(cg->function, symbol->argument),
+                       alloca);
+        cg->symbols.items[var->symbol] = alloca;
+    }
+}
+
+void cg_end_function(CodeGenerator *cg, Index node_index) {
+    LLVMBasicBlockRef block = LLVMGetInsertBlock(cg->builder);
+    if (block != LLVMGetEntryBasicBlock(cg->function) &&
+        LLVMGetFirstInstruction(block) == NULL &&
+        LLVMGetFirstUse(LLVMBasicBlockAsValue(block)) == NULL) {
+        // The empty block after a final return, the exit of a final loop is
+        // reachable and returns the zero value.
+        LLVMDeleteBasicBlock(block);
+    } else if (LLVMGetBasicBlockTerminator(block) == NULL) {
+        // Functions without a return at the end return the zero value of
+        // their return type.
+        AnalyseSymbol *symbol =
+            &cg->analyse.symbols.items[cg_symbol_id(cg, node_index)];
+        LLVMBuildRet(cg->builder, LLVMConstNull(cg_type(cg, symbol->type)));
+    }
+    cg->function = NULL;
+}
+
+// Integer literals used as floats have a float type.
+LLVMValueRef cg_integer_literal(CodeGenerator *cg, Index node_index) {
+    Node *node    = &cg->thor_module.nodes.items[node_index];
+    u64   integer = extra_data_integer(
         &cg->tokens, cg->tokens.tokens[node->main_token].extra_data);
-    return LLVMConstInt(LLVMInt32TypeInContext(cg->context), integer, false);
+    Type type = node_column_get(&cg->analyse.attributes.type, node_index);
+    if (type_is_float(type)) {
+        return LLVMConstReal(cg_type(cg, type), (f64)integer);
+    }
+    return LLVMConstInt(cg_type(cg, type), integer, false);
 }
 
-LLVMValueRef cg_get_value(CodeGenerator *cg, Node *node) {
-    assert(analy_is_expression(node) && "node is not an expression");
+LLVMValueRef cg_float_literal(CodeGenerator *cg, Index node_index) {
+    Node *node     = &cg->thor_module.nodes.items[node_index];
+    f64   floating = extra_data_float(
+        &cg->tokens, cg->tokens.tokens[node->main_token].extra_data);
+    Type type = node_column_get(&cg->analyse.attributes.type, node_index);
+    return LLVMConstReal(cg_type(cg, type), floating);
+}
 
-    switch (node->type) {
-        case NODE_TYPE_INTEGER_LITERAL:
-            return cg_integer_literal(cg, node);
+LLVMValueRef cg_comptime_value(CodeGenerator *cg, ComptimeValue *value) {
+    Type         element = type_element(value->type);
+    LLVMTypeRef  type    = cg_type(cg, element);
+    LLVMValueRef lanes[VECTOR_MAX_LANES];
+    for (u32 i = 0; i < type_value_lanes(value->type); i++) {
+        lanes[i] = type_is_float(element)
+                       ? LLVMConstReal(type, value->lanes[i].real)
+                       : LLVMConstInt(type, value->lanes[i].integer, false);
+    }
+    return type_is_vector(value->type)
+               ? LLVMConstVector(lanes, value->type.lanes)
+               : lanes[0];
+}
+
+// Comptime values become private constant globals, created in the module on
+// their first use.
+LLVMValueRef cg_comptime_global(CodeGenerator *cg, Index symbol_id) {
+    if (cg->symbols.items[symbol_id] != NULL) {
+        return cg->symbols.items[symbol_id];
+    }
+    AnalyseComptime *comptime = analyse_find_comptime(&cg->analyse, symbol_id);
+    assert(comptime != NULL &&
+           comptime->state == ANALYSE_COMPTIME_STATE_DONE &&
+           "comptime was not evaluated");
+
+    char *name = tokens_token_cstr(
+        cg->parser.input, &cg->tokens,
+        cg->thor_module.nodes.items[comptime->node].main_token);
+    LLVMValueRef global =
+        LLVMAddGlobal(cg->module, cg_type(cg, comptime->value.type), name);
+    free(name);
+    LLVMSetInitializer(global, cg_comptime_value(cg, &comptime->value));
+    LLVMSetGlobalConstant(global, true);
+    LLVMSetLinkage(global, LLVMPrivateLinkage);
+    LLVMSetUnnamedAddress(global, LLVMGlobalUnnamedAddr);
+
+    cg->symbols.items[symbol_id] = global;
+    return global;
+}
+
+LLVMValueRef cg_identifier(CodeGenerator *cg, Index node_index) {
+    Index        symbol_id = cg_symbol_id(cg, node_index);
+    LLVMValueRef alloca =
+        cg->analyse.symbols.items[symbol_id].kind == ANALYSE_SYMBOL_KIND_COMPTIME
+            ? cg_comptime_global(cg, symbol_id)
+            : cg->symbols.items[symbol_id];
+    assert(alloca != NULL && "variable was not generated");
+    Type type = node_column_get(&cg->analyse.attributes.type, node_index);
+    return LLVMBuildLoad2(cg->builder, cg_type(cg, type), alloca, "");
+}
+
+// A vector with value in every lane.
+LLVMValueRef cg_splat(CodeGenerator *cg, LLVMValueRef value, u32 lanes) {
+    LLVMTypeRef  vector_type = LLVMVectorType(LLVMTypeOf(value), lanes);
+    LLVMValueRef vector      = LLVMBuildInsertElement(
+        cg->builder, LLVMGetUndef(vector_type), value,
+        LLVMConstNull(LLVMInt32TypeInContext(cg->context)), "");
+    LLVMValueRef mask = LLVMConstNull(
+        LLVMVectorType(LLVMInt32TypeInContext(cg->context), lanes));
+    return LLVMBuildShuffleVector(cg->builder, vector,
+                                  LLVMGetUndef(vector_type), mask, "");
+}
+
+// The implicit conversions of the analyse, they never lose a value.
+LLVMValueRef cg_convert(CodeGenerator *cg, LLVMValueRef value, Type from,
+                        Type to) {
+    if (type_equal(from, to)) {
+        return value;
+    }
+    if (!type_is_vector(from) && type_is_vector(to)) {
+        return cg_splat(cg, cg_convert(cg, value, from, type_element(to)),
+                        to.lanes);
+    }
+
+    LLVMTypeRef type      = cg_type(cg, to);
+    bool        is_signed = type_kind(from) == BUILTIN_TYPE_KIND_SIGNED;
+    if (type_is_float(to)) {
+        if (type_is_float(from)) {
+            return LLVMBuildFPExt(cg->builder, value, type, "");
+        }
+        return is_signed ? LLVMBuildSIToFP(cg->builder, value, type, "")
+                         : LLVMBuildUIToFP(cg->builder, value, type, "");
+    }
+    return is_signed ? LLVMBuildSExt(cg->builder, value, type, "")
+                     : LLVMBuildZExt(cg->builder, value, type, "");
+}
+
+// Stores the value of an expression, converted to the type it is used as.
+void cg_set_value(CodeGenerator *cg, Index node_index, LLVMValueRef value) {
+    Type converted =
+        node_column_get(&cg->analyse.attributes.converted, node_index);
+    if (converted.type != BUILTIN_TYPE_NONE) {
+        value = cg_convert(
+            cg, value, node_column_get(&cg->analyse.attributes.type, node_index),
+            converted);
+    }
+    node_column_set(&cg->values, node_index, value);
+}
+
+// The type of the value of an expression, after its conversion.
+Type cg_value_type(CodeGenerator *cg, Index node_index) {
+    Type converted =
+        node_column_get(&cg->analyse.attributes.converted, node_index);
+    return converted.type != BUILTIN_TYPE_NONE
+               ? converted
+               : node_column_get(&cg->analyse.attributes.type, node_index);
+}
+
+// Unsigned integers and bools, signed integers and floats use different
+// predicates.
+LLVMValueRef cg_compare(CodeGenerator *cg, Type type,
+                        LLVMIntPredicate  unsigned_predicate,
+                        LLVMIntPredicate  signed_predicate,
+                        LLVMRealPredicate real_predicate, LLVMValueRef lhs,
+                        LLVMValueRef rhs) {
+    if (type_is_float(type)) {
+        return LLVMBuildFCmp(cg->builder, real_predicate, lhs, rhs, "");
+    }
+    return LLVMBuildICmp(cg->builder,
+                         type_kind(type) == BUILTIN_TYPE_KIND_SIGNED
+                             ? signed_predicate
+                             : unsigned_predicate,
+                         lhs, rhs, "");
+}
+
+LLVMValueRef cg_binary_operation(CodeGenerator *cg, Index node_index) {
+    Node        *node = &cg->thor_module.nodes.items[node_index];
+    LLVMValueRef lhs  = node_column_get(&cg->values, node->data.lhs);
+    LLVMValueRef rhs  = node_column_get(&cg->values, node->data.rhs);
+    assert(lhs != NULL && rhs != NULL && "operands were not generated");
+
+    // Both operands have the same type after their conversions.
+    Type operand  = cg_value_type(cg, node->data.lhs);
+    bool floating = type_is_float(operand);
+    switch (cg->tokens.tokens[node->main_token].type) {
+        case TOKEN_TYPE_PLUS:
+            return floating ? LLVMBuildFAdd(cg->builder, lhs, rhs, "")
+                            : LLVMBuildAdd(cg->builder, lhs, rhs, "");
+        case TOKEN_TYPE_MINUS:
+            return floating ? LLVMBuildFSub(cg->builder, lhs, rhs, "")
+                            : LLVMBuildSub(cg->builder, lhs, rhs, "");
+        case TOKEN_TYPE_ASTERISK:
+            return floating ? LLVMBuildFMul(cg->builder, lhs, rhs, "")
+                            : LLVMBuildMul(cg->builder, lhs, rhs, "");
+        case TOKEN_TYPE_EQUAL_EQUAL:
+            return cg_compare(cg, operand, LLVMIntEQ, LLVMIntEQ, LLVMRealOEQ,
+                              lhs, rhs);
+        case TOKEN_TYPE_BANG_EQUAL:
+            return cg_compare(cg, operand, LLVMIntNE, LLVMIntNE, LLVMRealUNE,
+                              lhs, rhs);
+        case TOKEN_TYPE_LESS:
+            return cg_compare(cg, operand, LLVMIntULT, LLVMIntSLT, LLVMRealOLT,
+                              lhs, rhs);
+        case TOKEN_TYPE_LESS_EQUAL:
+            return cg_compare(cg, operand, LLVMIntULE, LLVMIntSLE, LLVMRealOLE,
+                              lhs, rhs);
+        case TOKEN_TYPE_GREATER:
+            return cg_compare(cg, operand, LLVMIntUGT, LLVMIntSGT, LLVMRealOGT,
+                              lhs, rhs);
+        case TOKEN_TYPE_GREATER_EQUAL:
+            return cg_compare(cg, operand, LLVMIntUGE, LLVMIntSGE, LLVMRealOGE,
+                              lhs, rhs);
+        default:
+            break;
+    }
+    UNREACHABLE("invalid binary operator");
+}
+
+// The analyse only allows integer literals as lanes, so they are constants.
+LLVMValueRef cg_lane(CodeGenerator *cg, LLVMValueRef lane) {
+    return LLVMConstInt(LLVMInt32TypeInContext(cg->context),
+                        LLVMConstIntGetZExtValue(lane), false);
+}
+
+// Declares the runtime function in the module on its first use, every shard
+// declares the functions it uses.
+LLVMValueRef cg_runtime_function(CodeGenerator *cg, char const *name,
+                                 LLVMTypeRef return_type, LLVMTypeRef *params,
+                                 usz count) {
+    LLVMValueRef fn = LLVMGetNamedFunction(cg->module, name);
+    if (fn == NULL) {
+        fn = LLVMAddFunction(cg->module, name,
+                             LLVMFunctionType(return_type, params, count, false));
+        cg_add_function_attribute(cg, fn, "nounwind");
+    }
+    return fn;
+}
+
+// The arena argument is the first one, passed as a pointer.
+LLVMValueRef cg_runtime_call(CodeGenerator *cg, char const *name,
+                             bool takes_arena, LLVMValueRef *args, usz count) {
+    LLVMTypeRef  i64    = LLVMInt64TypeInContext(cg->context);
+    LLVMTypeRef  ptr    = LLVMPointerType(LLVMInt8TypeInContext(cg->context), 0);
+    LLVMTypeRef  params[2];
+    LLVMValueRef values[2];
+    for (usz i = 0; i < count; i++) {
+        params[i] = i == 0 && takes_arena ? ptr : i64;
+        values[i] = params[i] == ptr
+                        ? LLVMBuildIntToPtr(cg->builder, args[i], ptr, "")
+                        : args[i];
+    }
+
+    LLVMValueRef fn   = cg_runtime_function(cg, name, ptr, params, count);
+    LLVMValueRef call = LLVMBuildCall2(cg->builder, LLVMGlobalGetValueType(fn),
+                                       fn, values, count, "");
+    return LLVMBuildPtrToInt(cg->builder, call, i64, "");
+}
+
+// The cur and end of an arena without a block, read instead of a released
+// arena. Never written, as cur is 0.
+LLVMValueRef cg_arena_empty(CodeGenerator *cg) {
+    LLVMTypeRef  i64   = LLVMInt64TypeInContext(cg->context);
+    LLVMValueRef empty = LLVMGetNamedGlobal(cg->module, "thor_arena_empty");
+    if (empty == NULL) {
+        LLVMTypeRef type = LLVMArrayType(i64, 2);
+        empty = LLVMAddGlobal(cg->module, type, "thor_arena_empty");
+        LLVMSetInitializer(empty, LLVMConstNull(type));
+        LLVMSetLinkage(empty, LLVMPrivateLinkage);
+    }
+    return LLVMConstBitCast(empty, LLVMPointerType(i64, 0));
+}
+
+// The bump pointer fast path of thor_arena_alloc is inlined, only allocations
+// that do not fit into the current block call the runtime. cur and end are the
+// first fields of the ThorArena and always aligned, so size fits if it is at
+// most end - cur. Both are 0 before the first block, then even size 0 takes
+// the slow path, which allocates the block. A released arena reads the empty
+// cur and end, the slow path returns 0 for it.
+LLVMValueRef cg_arena_alloc(CodeGenerator *cg, LLVMValueRef arena,
+                            LLVMValueRef size) {
+    LLVMTypeRef  i32      = LLVMInt32TypeInContext(cg->context);
+    LLVMTypeRef  i64      = LLVMInt64TypeInContext(cg->context);
+    LLVMValueRef zero     = LLVMConstInt(i64, 0, false);
+    LLVMValueRef released = LLVMBuildICmp(cg->builder, LLVMIntEQ, arena, zero, "");
+    LLVMValueRef cur_ptr  = LLVMBuildSelect(
+        cg->builder, released, cg_arena_empty(cg),
+        LLVMBuildIntToPtr(cg->builder, arena, LLVMPointerType(i64, 0), ""),
+        "arena_cur");
+    LLVMValueRef one      = LLVMConstInt(i64, 1, false);
+    LLVMValueRef end_ptr =
+        LLVMBuildInBoundsGEP2(cg->builder, i64, cur_ptr, &one, 1, "arena_end");
+    LLVMValueRef cur = LLVMBuildLoad2(cg->builder, i64, cur_ptr, "");
+    LLVMValueRef end = LLVMBuildLoad2(cg->builder, i64, end_ptr, "");
+    LLVMSetAlignment(cur, 8);
+    LLVMSetAlignment(end, 8);
+    LLVMValueRef fits = LLVMBuildAnd(
+        cg->builder, LLVMBuildICmp(cg->builder, LLVMIntNE, cur, zero, ""),
+        LLVMBuildICmp(cg->builder, LLVMIntULE, size,
+                      LLVMBuildSub(cg->builder, end, cur, ""), ""),
+        "");
+
+    LLVMBasicBlockRef fast =
+        LLVMAppendBasicBlockInContext(cg->context, cg->function, "alloc_fast");
+    LLVMBasicBlockRef slow =
+        LLVMAppendBasicBlockInContext(cg->context, cg->function, "alloc_slow");
+    LLVMBasicBlockRef done =
+        LLVMAppendBasicBlockInContext(cg->context, cg->function, "alloc_done");
+    LLVMValueRef branch = LLVMBuildCondBr(cg->builder, fits, fast, slow);
+    LLVMMetadataRef weights[] = {
+        LLVMMDStringInContext2(cg->context, "branch_weights",
+                               strlen("branch_weights")),
+        LLVMValueAsMetadata(LLVMConstInt(i32, 2000, false)),
+        LLVMValueAsMetadata(LLVMConstInt(i32, 1, false)),
+    };
+    LLVMSetMetadata(branch,
+                    LLVMGetMDKindIDInContext(cg->context, "prof", strlen("prof")),
+                    LLVMMetadataAsValue(cg->context,
+                                        LLVMMDNodeInContext2(cg->context,
+                                                             weights, 3)));
+
+    LLVMPositionBuilderAtEnd(cg->builder, fast);
+    LLVMValueRef mask    = LLVMConstInt(i64, THOR_ARENA_ALIGNMENT - 1, false);
+    LLVMValueRef aligned = LLVMBuildAnd(
+        cg->builder, LLVMBuildAdd(cg->builder, size, mask, ""),
+        LLVMBuildNot(cg->builder, mask, ""), "");
+    LLVMSetAlignment(
+        LLVMBuildStore(cg->builder, LLVMBuildAdd(cg->builder, cur, aligned, ""),
+                       cur_ptr),
+        8);
+    LLVMBuildBr(cg->builder, done);
+
+    LLVMPositionBuilderAtEnd(cg->builder, slow);
+    LLVMValueRef args[]    = {arena, size};
+    LLVMValueRef allocated =
+        cg_runtime_call(cg, "thor_arena_alloc_slow", true, args, 2);
+    cg_add_function_attribute(
+        cg, LLVMGetNamedFunction(cg->module, "thor_arena_alloc_slow"), "cold");
+    LLVMBuildBr(cg->builder, done);
+
+    LLVMPositionBuilderAtEnd(cg->builder, done);
+    LLVMValueRef      address    = LLVMBuildPhi(cg->builder, i64, "");
+    LLVMValueRef      values[]   = {cur, allocated};
+    LLVMBasicBlockRef incoming[] = {fast, slow};
+    LLVMAddIncoming(address, values, incoming, 2);
+    return address;
+}
+
+LLVMValueRef cg_builtin(CodeGenerator *cg, AnalyseBuiltin builtin,
+                        LLVMValueRef *args, usz count) {
+    switch (builtin) {
+        case ANALYSE_BUILTIN_EXTRACT:
+            return LLVMBuildExtractElement(cg->builder, args[0],
+                                           cg_lane(cg, args[1]), "");
+        case ANALYSE_BUILTIN_INSERT:
+            return LLVMBuildInsertElement(cg->builder, args[0], args[2],
+                                          cg_lane(cg, args[1]), "");
+        case ANALYSE_BUILTIN_SHUFFLE: {
+            for (usz i = 2; i < count; i++) {
+                args[i] = cg_lane(cg, args[i]);
+            }
+            LLVMValueRef mask = LLVMConstVector(args + 2, count - 2);
+            return LLVMBuildShuffleVector(cg->builder, args[0], args[1], mask,
+                                          "");
+        }
+        case ANALYSE_BUILTIN_ARENA:
+            return cg_runtime_call(cg, "thor_arena_create", false, args, count);
+        case ANALYSE_BUILTIN_ALLOC:
+            return cg_arena_alloc(cg, args[0], args[1]);
+        case ANALYSE_BUILTIN_RESET:
+            return cg_runtime_call(cg, "thor_arena_reset", true, args, count);
+        case ANALYSE_BUILTIN_RELEASE:
+            return cg_runtime_call(cg, "thor_arena_release", true, args, count);
+        case ANALYSE_BUILTIN_NONE:
+            break;
+    }
+    UNREACHABLE("invalid builtin");
+}
+
+LLVMValueRef cg_vector_constructor(CodeGenerator *cg, Type type,
+                                   LLVMValueRef *args, usz count) {
+    if (count == 1) {
+        return cg_splat(cg, args[0], type.lanes);
+    }
+    LLVMValueRef vector = LLVMGetUndef(cg_type(cg, type));
+    for (usz i = 0; i < count; i++) {
+        vector = LLVMBuildInsertElement(
+            cg->builder, vector, args[i],
+            LLVMConstInt(LLVMInt32TypeInContext(cg->context), i, false), "");
+    }
+    return vector;
+}
+
+LLVMValueRef cg_call(CodeGenerator *cg, Index node_index) {
+    Module   *m    = &cg->thor_module;
+    Node     *node = &m->nodes.items[node_index];
+    CallData *cd   = &m->extra_data.items[node->data.lhs].data.call;
+
+    LLVMValueRef *args = malloc(sizeof(LLVMValueRef) * (cd->count + 1));
+    for (usz i = 0; i < cd->count; i++) {
+        args[i] = node_column_get(&cg->values, cd->items[i]);
+        assert(args[i] != NULL && "argument was not generated");
+    }
+
+    LLVMValueRef call;
+    // Calls without a symbol are builtins or vector constructors.
+    if (node_column_get(&cg->analyse.attributes.symbol, node_index) ==
+        ANALYSE_INDEX_NONE) {
+        char *name = tokens_token_cstr(cg->parser.input, &cg->tokens,
+                                       node->main_token);
+        AnalyseBuiltin builtin = analyse_builtin_from_name(name);
+        free(name);
+        call = builtin != ANALYSE_BUILTIN_NONE
+                   ? cg_builtin(cg, builtin, args, cd->count)
+                   : cg_vector_constructor(
+                         cg,
+                         node_column_get(&cg->analyse.attributes.type,
+                                         node_index),
+                         args, cd->count);
+    } else {
+        LLVMValueRef function =
+            cg->symbols.items[cg_symbol_id(cg, node_index)];
+        assert(function != NULL && "function was not declared");
+        call = LLVMBuildCall2(cg->builder, LLVMGlobalGetValueType(function),
+                              function, args, cd->count, "");
+        LLVMSetInstructionCallConv(call, LLVMGetFunctionCallConv(function));
+    }
+    free(args);
+    return call;
+}
+
+void cg_return(CodeGenerator *cg, Index node_index) {
+    Node        *node  = &cg->thor_module.nodes.items[node_index];
+    LLVMValueRef value = node_column_get(&cg->values, node->data.rhs);
+    assert(value != NULL && "expression was not generated");
+    LLVMBuildRet(cg->builder, value);
+
+    // Statements after the return still need a block, it is unreachable.
+    LLVMBasicBlockRef after =
+        LLVMAppendBasicBlockInContext(cg->context, cg->function, "after_return");
+    LLVMPositionBuilderAtEnd(cg->builder, after);
+}
+
+void cg_variable_declaration(CodeGenerator *cg, Index node_index) {
+    Node          *node      = &cg->thor_module.nodes.items[node_index];
+    Index          symbol_id = cg_symbol_id(cg, node_index);
+    AnalyseSymbol *symbol    = &cg->analyse.symbols.items[symbol_id];
+
+    char *name = tokens_token_cstr(cg->parser.input, &cg->tokens,
+                                   node->main_token);
+    LLVMValueRef alloca = cg_entry_alloca(cg, cg_type(cg, symbol->type), name);
+    free(name);
+
+    LLVMValueRef value = node_column_get(&cg->values, node->data.rhs);
+    assert(value != NULL && "expression was not generated");
+    LLVMBuildStore(cg->builder, value, alloca);
+
+    cg->symbols.items[symbol_id] = alloca;
+}
+
+void cg_assignment(CodeGenerator *cg, Index node_index) {
+    Node        *node   = &cg->thor_module.nodes.items[node_index];
+    LLVMValueRef alloca = cg->symbols.items[cg_symbol_id(cg, node_index)];
+    assert(alloca != NULL && "variable was not generated");
+    LLVMValueRef value = node_column_get(&cg->values, node->data.rhs);
+    assert(value != NULL && "expression was not generated");
+    LLVMBuildStore(cg->builder, value, alloca);
+}
 
+typedef struct CodeGenMetadata CodeGenMetadata;
+struct CodeGenMetadata {
+    usz              count;
+    usz              capacity;
+    LLVMMetadataRef *items;
+};
+
+// !{!"name", value}, or !{!"name"} if value is NULL.
+void cg_loop_property(CodeGenerator *cg, CodeGenMetadata *properties,
+                      char const *name, LLVMValueRef value) {
+    LLVMMetadataRef property[2] = {
+        LLVMMDStringInContext2(cg->context, name, strlen(name))};
+    usz count = 1;
+    if (value != NULL) {
+        property[count++] = LLVMValueAsMetadata(value);
+    }
+    da_append(properties, LLVMMDNodeInContext2(cg->context, property, count));
+}
+
+// The llvm.loop metadata of the hints, NULL if the loop has none. The first
+// operand of a loop id is the loop id itself, so every loop gets its own.
+//
+// The C API can not create the distinct empty nodes llvm.access.group needs,
+// so #parallel only enables the vectorizer. The analyse already guarantees
+// that the iterations do not depend on each other.
+LLVMMetadataRef cg_loop_metadata(CodeGenerator *cg, LoopHintTokens *hints) {
+    if (hints->count == 0) {
+        return NULL;
+    }
+
+    bool unroll   = false;
+    bool parallel = false;
+    u64  count    = 0;
+    u64  width    = 0;
+    for (usz i = 0; i < hints->count; i++) {
+        char *name = tokens_token_cstr(cg->parser.input, &cg->tokens,
+                                       hints->items[i].name);
+        LoopHint hint = analyse_loop_hint_from_name(name);
+        free(name);
+        Index argument = hints->items[i].argument;
+        u64   value    = argument != 0
+                             ? extra_data_integer(
+                                   &cg->tokens,
+                                   cg->tokens.tokens[argument].extra_data)
+                             : 0;
+        switch (hint) {
+            case LOOP_HINT_UNROLL:
+                unroll = true;
+                count  = value;
+                break;
+            case LOOP_HINT_VECTORIZE:
+                width = value;
+                break;
+            case LOOP_HINT_PARALLEL:
+                parallel = true;
+                break;
+            case LOOP_HINT_NONE:
+                UNREACHABLE("unknown loop hint in codegen");
+        }
+    }
+
+    LLVMTypeRef     i32  = LLVMInt32TypeInContext(cg->context);
+    LLVMValueRef    on   = LLVMConstInt(LLVMInt1TypeInContext(cg->context), 1,
+                                        false);
+    // Replaced by the loop id
+    LLVMMetadataRef self = LLVMTemporaryMDNode(cg->context, NULL, 0);
+    CodeGenMetadata properties = {0};
+    da_append(&properties, self);
+    if (unroll && count == 0) {
+        cg_loop_property(cg, &properties, "llvm.loop.unroll.enable", NULL);
+    } else if (unroll && count == 1) {
+        cg_loop_property(cg, &properties, "llvm.loop.unroll.disable", NULL);
+    } else if (unroll) {
+        cg_loop_property(cg, &properties, "llvm.loop.unroll.count",
+                         LLVMConstInt(i32, count, false));
+    }
+    if (width != 0) {
+        cg_loop_property(cg, &properties, "llvm.loop.vectorize.width",
+                         LLVMConstInt(i32, width, false));
+    }
+    if (width > 1 || (parallel && width == 0)) {
+        cg_loop_property(cg, &properties, "llvm.loop.vectorize.enable", on);
+    }
+
+    LLVMMetadataRef loop =
+        LLVMMDNodeInContext2(cg->context, properties.items, properties.count);
+    LLVMMetadataReplaceAllUsesWith(self, loop);
+    da_destroy(&properties);
+    return loop;
+}
+
+// While loops generate their condition in the header, for loops generate
+// their range before the loop.
+void cg_begin_loop(CodeGenerator *cg, Index node_index) {
+    CodeGenLoop loop = {
+        .node   = node_index,
+        .header = LLVMAppendBasicBlockInContext(cg->context, cg->function,
+                                                "loop_header"),
+    };
+    if (cg->thor_module.nodes.items[node_index].type == NODE_TYPE_WHILE) {
+        LLVMBuildBr(cg->builder, loop.header);
+        LLVMPositionBuilderAtEnd(cg->builder, loop.header);
+    }
+    da_append(&cg->loops, loop);
+}
+
+// The header of the innermost loop branches into its block or out of the
+// loop. The variable of a for loop runs from the start of the range up to the
+// end, without the end.
+void cg_begin_loop_body(CodeGenerator *cg) {
+    CodeGenLoop *loop = &cg->loops.items[cg->loops.count - 1];
+    Node        *node = &cg->thor_module.nodes.items[loop->node];
+    LoopData    *ld = &cg->thor_module.extra_data.items[node->data.lhs].data.loop;
+
+    LLVMBasicBlockRef body =
+        LLVMAppendBasicBlockInContext(cg->context, cg->function, "loop_body");
+    loop->exit =
+        LLVMAppendBasicBlockInContext(cg->context, cg->function, "loop_exit");
+
+    LLVMValueRef condition;
+    if (node->type == NODE_TYPE_FOR) {
+        Index          symbol_id = cg_symbol_id(cg, loop->node);
+        AnalyseSymbol *symbol    = &cg->analyse.symbols.items[symbol_id];
+        LLVMTypeRef    type      = cg_type(cg, symbol->type);
+        char *name = tokens_token_cstr(cg->parser.input, &cg->tokens,
+                                       node->main_token);
+        LLVMValueRef variable = cg_entry_alloca(cg, type, name);
+        free(name);
+        LLVMBuildStore(cg->builder, node_column_get(&cg->values, ld->lhs),
+                       variable);
+        cg->symbols.items[symbol_id] = variable;
+
+        LLVMBuildBr(cg->builder, loop->header);
+        LLVMPositionBuilderAtEnd(cg->builder, loop->header);
+        LLVMValueRef value = LLVMBuildLoad2(cg->builder, type, variable, "");
+        condition          = LLVMBuildICmp(
+            cg->builder,
+            type_kind(symbol->type) == BUILTIN_TYPE_KIND_SIGNED ? LLVMIntSLT
+                                                                : LLVMIntULT,
+            value, node_column_get(&cg->values, ld->rhs), "");
+    } else {
+        condition = node_column_get(&cg->values, ld->lhs);
+    }
+    assert(condition != NULL && "condition was not generated");
+
+    LLVMBuildCondBr(cg->builder, condition, body, loop->exit);
+    LLVMPositionBuilderAtEnd(cg->builder, body);
+}
+
+// The latch at the end of the body branches back to the header and carries
+// the hints of the loop.
+void cg_end_loop(CodeGenerator *cg, Index node_index) {
+    CodeGenLoop loop = cg->loops.items[--cg->loops.count];
+    Node       *node = &cg->thor_module.nodes.items[node_index];
+    LoopData   *ld = &cg->thor_module.extra_data.items[node->data.lhs].data.loop;
+
+    if (node->type == NODE_TYPE_FOR) {
+        Index        symbol_id = cg_symbol_id(cg, node_index);
+        Type         type      = cg->analyse.symbols.items[symbol_id].type;
+        LLVMValueRef variable  = cg->symbols.items[symbol_id];
+        LLVMValueRef value =
+            LLVMBuildLoad2(cg->builder, cg_type(cg, type), variable, "");
+        LLVMValueRef one = LLVMConstInt(cg_type(cg, type), 1, false);
+        // The variable is below the end of the range, so it never overflows.
+        LLVMValueRef next =
+            type_kind(type) == BUILTIN_TYPE_KIND_SIGNED
+                ? LLVMBuildNSWAdd(cg->builder, value, one, "")
+                : LLVMBuildNUWAdd(cg->builder, value, one, "");
+        LLVMBuildStore(cg->builder, next, variable);
+    }
+
+    LLVMValueRef    latch    = LLVMBuildBr(cg->builder, loop.header);
+    LLVMMetadataRef metadata = cg_loop_metadata(cg, &ld->hints);
+    if (metadata != NULL) {
+        LLVMSetMetadata(latch,
+                        LLVMGetMDKindIDInContext(cg->context, "llvm.loop",
+                                                 strlen("llvm.loop")),
+                        LLVMMetadataAsValue(cg->context, metadata));
+    }
+    LLVMPositionBuilderAtEnd(cg->builder, loop.exit);
+}
+
+void cg_pre_visit(CodeGenerator *cg, Index node_index) {
+    switch (cg->thor_module.nodes.items[node_index].type) {
+        case NODE_TYPE_FUNCTION_DEFINITION:
+            cg_begin_function(cg, node_index);
+            return;
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+            cg_begin_loop(cg, node_index);
+            return;
         case NODE_TYPE_BLOCK:
+            // The operands of the loop were generated before its block.
+            if (cg->loops.count > 0 &&
+                cg->thor_module.nodes
+                        .items[cg->loops.items[cg->loops.count - 1].node]
+                        .data.rhs == node_index) {
+                cg_begin_loop_body(cg);
+            }
+            return;
+        case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_BINARY_OPERATION:
+        case NODE_TYPE_CALL:
+        case NODE_TYPE_VARIABLE_DECLARATION:
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_RETURN:
+        case NODE_TYPE_IMPORT:
+        case NODE_TYPE_EOF:
+            return;
+    }
+}
+
+// Children are visited before the post visit, so the values of all operands
+// are already in cg->values.
+void cg_post_visit(CodeGenerator *cg, Index node_index) {
+    switch (cg->thor_module.nodes.items[node_index].type) {
         case NODE_TYPE_FUNCTION_DEFINITION:
+            cg_end_function(cg, node_index);
+            return;
+        case NODE_TYPE_INTEGER_LITERAL:
+            cg_set_value(cg, node_index, cg_integer_literal(cg, node_index));
+            return;
+        case NODE_TYPE_FLOAT_LITERAL:
+            cg_set_value(cg, node_index, cg_float_literal(cg, node_index));
+            return;
+        case NODE_TYPE_IDENTIFIER:
+            cg_set_value(cg, node_index, cg_identifier(cg, node_index));
+            return;
+        case NODE_TYPE_BINARY_OPERATION:
+            cg_set_value(cg, node_index, cg_binary_operation(cg, node_index));
+            return;
+        case NODE_TYPE_CALL:
+            cg_set_value(cg, node_index, cg_call(cg, node_index));
+            return;
         case NODE_TYPE_VARIABLE_DECLARATION:
+            cg_variable_declaration(cg, node_index);
+            return;
+        case NODE_TYPE_ASSIGNMENT:
+            cg_assignment(cg, node_index);
+            return;
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+            cg_end_loop(cg, node_index);
+            return;
+        case NODE_TYPE_RETURN:
+            cg_return(cg, node_index);
+            return;
+        // Evaluated by the analyse, see cg_comptime_global
+        case NODE_TYPE_COMPTIME_DECLARATION:
+        case NODE_TYPE_BLOCK:
+        case NODE_TYPE_IMPORT:
         case NODE_TYPE_EOF:
-            UNREACHABLE("not an expression node");
+            return;
+    }
+}
+
+// Declares every function of the module, but only generates the bodies of the
+// given top level nodes.
+bool cg_generate(CodeGenerator *cg, Index const *nodes, usz count) {
+    assert(cg->analyse.errors.count == 0 &&
+           "code_gen requires a module without analyse errors");
+    Module *m = &cg->thor_module;
+
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node_index = m->top_level_nodes.items[i];
+        if (m->nodes.items[node_index].type == NODE_TYPE_FUNCTION_DEFINITION) {
+            cg_declare_function(cg, node_index);
+        }
+    }
+    // Imported functions are only declared, they are linked in with the
+    // object of their module.
+    AnalyseFunction *function, *function_tmp;
+    HASH_ITER(hh, cg->analyse.scopes.items[cg->analyse.root_scope].functions,
+              function, function_tmp) {
+        if (function->module != NULL) {
+            cg->symbols.items[function->symbol] = cg_add_function(cg, function);
+        }
+    }
+
+    Arena       arena = {0};
+    AstIterator it;
+    AstVisit    visit;
+    ast_iterator_init(&it, m, &arena, AST_VISIT_PRE | AST_VISIT_POST);
+    for (usz i = count; i > 0; i--) {
+        if (m->nodes.items[nodes[i - 1]].type != NODE_TYPE_COMPTIME_DECLARATION) {
+            ast_iterator_push(&it, nodes[i - 1]);
+        }
+    }
+    while (ast_iterator_next(&it, &visit)) {
+        if (visit.order == AST_VISIT_PRE) {
+            cg_pre_visit(cg, visit.node);
+        } else {
+            cg_post_visit(cg, visit.node);
+        }
+    }
+    arena_destroy(&arena);
+
+    char *message = NULL;
+    if (LLVMVerifyModule(cg->module, LLVMReturnStatusAction, &message)) {
+        log_error("generated invalid LLVM IR: %s", message);
+        LLVMDisposeMessage(message);
+        return false;
+    }
+    LLVMDisposeMessage(message);
+    return true;
+}
+
+bool code_gen(CodeGenerator *cg) {
+    return cg_generate(cg, cg->thor_module.top_level_nodes.items,
+                       cg->thor_module.top_level_nodes.count);
+}
+
+char const *code_gen_opt_level_str(CodeGenOptLevel level) {
+    switch (level) {
+        case CODE_GEN_OPT_LEVEL_O0:
+            return "O0";
+        case CODE_GEN_OPT_LEVEL_O1:
+            return "O1";
+        case CODE_GEN_OPT_LEVEL_O2:
+            return "O2";
+        case CODE_GEN_OPT_LEVEL_O3:
+            return "O3";
+    }
+    return "invalid optimization level";
+}
+
+char const *cg_pipeline_str(CodeGenPipeline pipeline) {
+    switch (pipeline) {
+        case CODE_GEN_PIPELINE_DEFAULT:
+            return "default";
+        case CODE_GEN_PIPELINE_THIN_PRE_LINK:
+            return "thinlto-pre-link";
+        case CODE_GEN_PIPELINE_THIN_BACKEND:
+            return "thinlto";
+    }
+    UNREACHABLE("invalid pipeline");
+}
+
+bool code_gen_optimize(CodeGenerator *cg, CodeGenOptLevel level) {
+    return code_gen_optimize_module(cg->module, CODE_GEN_PIPELINE_DEFAULT,
+                                    level, cg->target);
+}
+
+bool code_gen_optimize_module(LLVMModuleRef module, CodeGenPipeline pipeline,
+                              CodeGenOptLevel level, EmitOptions const *target) {
+    // The passes query the target for its costs and legal types.
+    EmitOptions tm_options = target != NULL ? *target : emit_options_default();
+    tm_options.opt_level   = level;
+    LLVMTargetMachineRef tm;
+    if (!emit_target_machine_create(&tm_options, &tm)) {
+        return false;
+    }
+    emit_prepare_module(module, tm);
+
+    str   pipeline_str  = str_format("%s<%s>", cg_pipeline_str(pipeline),
+                                     code_gen_opt_level_str(level));
+    char *pipeline_cstr = to_cstr(pipeline_str);
+    str_destroy(pipeline_str);
+
+    LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef error = LLVMRunPasses(module, pipeline_cstr, tm, options);
+    LLVMDisposePassBuilderOptions(options);
+    LLVMDisposeTargetMachine(tm);
+    free(pipeline_cstr);
+
+    if (error != NULL) {
+        char *message = LLVMGetErrorMessage(error);
+        log_error("running the optimization pipeline failed: %s", message);
+        LLVMDisposeErrorMessage(message);
+        return false;
+    }
+    return true;
+}
+
+usz code_gen_shard_count(usz requested, usz function_count) {
+    usz shard_count = requested;
+    if (shard_count == 0) {
+        long cores  = sysconf(_SC_NPROCESSORS_ONLN);
+        shard_count = cores > 0 ? (usz)cores : 1;
+    }
+    if (shard_count > function_count) {
+        shard_count = function_count;
+    }
+    return shard_count == 0 ? 1 : shard_count;
+}
+
+// Splits the top level nodes into contiguous ranges with about the same amount
+// of nodes. The split only depends on the module, so the output is the same
+// for every run.
+void cg_partition(Module *m, CodeGenShards *shards) {
+    usz total = 0;
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node = m->top_level_nodes.items[i];
+        total += node - flat_subtree_begin(m, node) + 1;
+    }
+
+    usz shard = 0, size = 0;
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node = m->top_level_nodes.items[i];
+        da_append(&shards->items[shard].nodes, node);
+        size += node - flat_subtree_begin(m, node) + 1;
+
+        // Moves to the next shard once this one has its part of the nodes.
+        if (shard + 1 < shards->count &&
+            size * shards->count >= total * (shard + 1)) {
+            shard += 1;
+        }
+    }
+}
+
+void cg_shard_run(void *data) {
+    CodeGenShard *shard = data;
+    shard->ok = cg_generate(&shard->cg, shard->nodes.items, shard->nodes.count) &&
+                code_gen_optimize_module(shard->cg.module, shard->pipeline,
+                                         shard->level, shard->cg.target);
+}
+
+// Every shard is a task of the global thread pool, a single shard runs on the
+// calling thread.
+void cg_shards_run(CodeGenShards *shards) {
+    if (shards->count == 1) {
+        cg_shard_run(&shards->items[0]);
+        return;
+    }
+
+    ThreadPool     *pool  = thread_pool_global();
+    ThreadPoolGroup group = {0};
+    for (usz i = 0; i < shards->count; i++) {
+        thread_pool_submit(pool, &group, cg_shard_run, &shards->items[i]);
+    }
+    thread_pool_wait(pool, &group);
+}
+
+CodeGenShards cg_shards_create(CodeGenerator *cg, usz count,
+                               CodeGenPipeline pipeline,
+                               CodeGenOptLevel level) {
+    CodeGenShards shards = {.count = count};
+    shards.items         = calloc(shards.count, sizeof(CodeGenShard));
+    for (usz i = 0; i < shards.count; i++) {
+        CodeGenShard *shard = &shards.items[i];
+        // The shard borrows the thor side and owns its LLVM side.
+        shard->cg = (CodeGenerator){
+            .thor_module = cg->thor_module,
+            .parser      = cg->parser,
+            .tokens      = cg->tokens,
+            .analyse     = cg->analyse,
+            .target      = cg->target,
+        };
+        shard->pipeline = pipeline;
+        shard->level    = level;
+        shard->context  = LLVMOrcCreateNewThreadSafeContext();
+        cg_init_llvm_in(&shard->cg,
+                        LLVMOrcThreadSafeContextGetContext(shard->context));
+    }
+    return shards;
+}
+
+CodeGenShards code_gen_shards(CodeGenerator *cg, usz shard_count,
+                              CodeGenOptLevel level) {
+    return code_gen_shards_with_pipeline(cg, shard_count,
+                                         CODE_GEN_PIPELINE_DEFAULT, level);
+}
+
+CodeGenShards code_gen_shards_with_pipeline(CodeGenerator  *cg,
+                                            usz             shard_count,
+                                            CodeGenPipeline pipeline,
+                                            CodeGenOptLevel level) {
+    Module *m         = &cg->thor_module;
+    usz     functions = 0;
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        if (m->nodes.items[m->top_level_nodes.items[i]].type ==
+            NODE_TYPE_FUNCTION_DEFINITION) {
+            functions += 1;
+        }
+    }
+
+    CodeGenShards shards = cg_shards_create(
+        cg, code_gen_shard_count(shard_count, functions), pipeline, level);
+    cg_partition(m, &shards);
+    cg_shards_run(&shards);
+    return shards;
+}
+
+CodeGenShards code_gen_function_shards(CodeGenerator *cg,
+                                       Index const *functions, usz count,
+                                       CodeGenOptLevel level) {
+    CodeGenShards shards =
+        cg_shards_create(cg, count, CODE_GEN_PIPELINE_DEFAULT, level);
+    for (usz i = 0; i < count; i++) {
+        da_append(&shards.items[i].nodes, functions[i]);
+    }
+    cg_shards_run(&shards);
+    return shards;
+}
+
+bool code_gen_shards_ok(CodeGenShards *shards) {
+    for (usz i = 0; i < shards->count; i++) {
+        if (!shards->items[i].ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LLVMOrcThreadSafeModuleRef code_gen_shard_take_module(CodeGenShard *shard) {
+    LLVMOrcThreadSafeModuleRef module =
+        LLVMOrcCreateNewThreadSafeModule(shard->cg.module, shard->context);
+    shard->cg.module = NULL;
+    return module;
+}
+
+bool code_gen_link_module(CodeGenerator *cg, LLVMModuleRef module) {
+    // Modules can only be linked inside of one context, so the module moves
+    // over as bitcode.
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+    LLVMModuleRef       moved;
+    bool failed = LLVMParseBitcodeInContext2(cg->context, bitcode, &moved);
+    LLVMDisposeMemoryBuffer(bitcode);
+    if (failed) {
+        log_error("could not read the bitcode of a module");
+        return false;
+    }
+
+    // Destroys moved
+    if (LLVMLinkModules2(cg->module, moved)) {
+        log_error("could not link a module");
+        return false;
+    }
+    return true;
+}
+
+bool code_gen_link_shards(CodeGenerator *cg, CodeGenShards *shards) {
+    for (usz i = 0; i < shards->count; i++) {
+        if (!code_gen_link_module(cg, shards->items[i].cg.module)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void code_gen_shards_destroy(CodeGenShards shards) {
+    for (usz i = 0; i < shards.count; i++) {
+        cg_release_llvm(&shards.items[i].cg);
+        LLVMOrcDisposeThreadSafeContext(shards.items[i].context);
+        da_destroy(&shards.items[i].nodes);
     }
+    free(shards.items);
 }
@@ -1,31 +1,147 @@
 #pragma once
 
+#include <llvm-c/Orc.h>
 #include <llvm-c/Types.h>
 #include "ast.h"
+#include "code_analyse.h"
 #include "lexer.h"
+#include "node_column.h"
 #include "parser.h"
-#include "uthash.h"
 
-typedef struct NamedVariable NamedVariable;
-struct NamedVariable {
-    char const    *name;
-    LLVMValueRef   value;
-    UT_hash_handle hh;
+enum CodeGenOptLevel {
+    CODE_GEN_OPT_LEVEL_O0,
+    CODE_GEN_OPT_LEVEL_O1,
+    CODE_GEN_OPT_LEVEL_O2,
+    CODE_GEN_OPT_LEVEL_O3,
+};
+typedef enum CodeGenOptLevel CodeGenOptLevel;
+
+enum CodeGenPipeline {
+    // default<On>, for modules that are complete on their own
+    CODE_GEN_PIPELINE_DEFAULT,
+    // thinlto-pre-link<On>, leaves the cross module work to the backend
+    CODE_GEN_PIPELINE_THIN_PRE_LINK,
+    // thinlto<On>, after the functions of other modules were imported
+    CODE_GEN_PIPELINE_THIN_BACKEND,
+};
+typedef enum CodeGenPipeline CodeGenPipeline;
+
+NODE_COLUMN(LLVMValueRef, Value)
+
+// Defined in llvm/emit.h
+typedef struct EmitOptions EmitOptions;
+
+// A for or while loop whose block is being generated.
+typedef struct CodeGenLoop CodeGenLoop;
+struct CodeGenLoop {
+    Index             node;
+    // Evaluates the condition and branches to the body or the exit
+    LLVMBasicBlockRef header;
+    LLVMBasicBlockRef exit;
 };
 
 typedef struct CodeGenerator CodeGenerator;
 struct CodeGenerator {
     Module         thor_module;
     Parser         parser;
+    // Owned by the parser
     Tokens         tokens;
+    ModuleAnalyse  analyse;
 
     LLVMContextRef context;
     LLVMBuilderRef builder;
     LLVMModuleRef  module;
+    // The machine the module is optimised for, NULL for a generic cpu of the
+    // host. Not owned.
+    EmitOptions const *target;
 
-    NamedVariable *named_variables;
+    // The value of every expression node, filled while generating.
+    NodeColumnValue values;
+    // The function or alloca for every symbol of the analyse, indexed by the
+    // symbol id.
+    struct {
+        usz           count;
+        LLVMValueRef *items;
+    } symbols;
+    // The function which is currently generated
+    LLVMValueRef function;
+    // The loops around the current node, the innermost last
+    struct {
+        usz          count;
+        usz          capacity;
+        CodeGenLoop *items;
+    } loops;
 };
 
-CodeGenerator code_gen_create(Tokens t, Parser p, Module m);
+// Takes the ownership of the parser, module and analyse. The analyse may not
+// contain errors.
+CodeGenerator code_gen_create(Parser p, Module m, ModuleAnalyse ma);
 void          code_gen_destroy(CodeGenerator cg);
-void          code_gen(CodeGenerator *cg);
+// Lowers the thor module to LLVM IR and verifies it, returns false and logs the
+// problem if the verification failed.
+bool          code_gen(CodeGenerator *cg);
+// Runs the default<O0> to default<O3> pipeline of the new pass manager.
+bool          code_gen_optimize(CodeGenerator *cg, CodeGenOptLevel level);
+// Sets the triple and data layout of target on the module before the passes
+// run, the passes see the cpu and features of target, so the vectorizer uses
+// its vector width. target may be NULL like CodeGenerator.target.
+bool          code_gen_optimize_module(LLVMModuleRef      module,
+                                       CodeGenPipeline    pipeline,
+                                       CodeGenOptLevel    level,
+                                       EmitOptions const *target);
+char const   *code_gen_opt_level_str(CodeGenOptLevel level);
+
+// ================
+// -- shards --
+// Parallel code generation. The top level nodes are split into shards, every
+// shard has its own context, module and builder, so the shards are generated
+// and optimised on their own threads. Every shard declares all functions, but
+// only defines its own, so the shards can be emitted as separate objects or
+// linked back into one module.
+// ================
+
+typedef struct CodeGenShard CodeGenShard;
+struct CodeGenShard {
+    // Borrows the thor module, parser and analyse
+    CodeGenerator               cg;
+    // Owns the context of cg, thread safe so the module can be handed to ORC
+    LLVMOrcThreadSafeContextRef context;
+    CodeGenPipeline             pipeline;
+    CodeGenOptLevel             level;
+    // The top level nodes of this shard
+    struct {
+        usz    count;
+        usz    capacity;
+        Index *items;
+    } nodes;
+    bool ok;
+};
+
+typedef struct CodeGenShards CodeGenShards;
+struct CodeGenShards {
+    usz           count;
+    CodeGenShard *items;
+};
+
+// Generates and optimises the module in shard_count shards, 0 uses one shard
+// per core. There are never more shards than functions. Check the result
+// with code_gen_shards_ok.
+CodeGenShards code_gen_shards(CodeGenerator *cg, usz shard_count,
+                              CodeGenOptLevel level);
+// Same as code_gen_shards, but the shards are optimised with pipeline.
+CodeGenShards code_gen_shards_with_pipeline(CodeGenerator  *cg,
+                                            usz             shard_count,
+                                            CodeGenPipeline pipeline,
+                                            CodeGenOptLevel level);
+// One shard per function, the shards run on one thread per core.
+CodeGenShards code_gen_function_shards(CodeGenerator *cg,
+                                       Index const *functions, usz count,
+                                       CodeGenOptLevel level);
+bool          code_gen_shards_ok(CodeGenShards *shards);
+// Moves the module of the shard out of it, the shard can still be destroyed.
+LLVMOrcThreadSafeModuleRef code_gen_shard_take_module(CodeGenShard *shard);
+// Links a module of any context into cg->module, module stays valid.
+bool          code_gen_link_module(CodeGenerator *cg, LLVMModuleRef module);
+// Links all shards into cg->module, the shards stay valid.
+bool          code_gen_link_shards(CodeGenerator *cg, CodeGenShards *shards);
+void          code_gen_shards_destroy(CodeGenShards shards);
@@ -0,0 +1,139 @@
+#include "emit.h"
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "llvm/codegen.h"
+
+EmitOptions emit_options_default(void) {
+    return (EmitOptions){
+        .cpu        = NULL,
+        .features   = NULL,
+        .reloc      = LLVMRelocPIC,
+        .code_model = LLVMCodeModelDefault,
+        .opt_level  = CODE_GEN_OPT_LEVEL_O0,
+    };
+}
+
+static pthread_once_t emit_initialized = PTHREAD_ONCE_INIT;
+
+void emit_initialize_native(void) {
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+}
+
+void emit_initialize(void) {
+    pthread_once(&emit_initialized, emit_initialize_native);
+}
+
+LLVMCodeGenOptLevel emit_llvm_opt_level(CodeGenOptLevel level) {
+    switch (level) {
+        case CODE_GEN_OPT_LEVEL_O0:
+            return LLVMCodeGenLevelNone;
+        case CODE_GEN_OPT_LEVEL_O1:
+            return LLVMCodeGenLevelLess;
+        case CODE_GEN_OPT_LEVEL_O2:
+            return LLVMCodeGenLevelDefault;
+        case CODE_GEN_OPT_LEVEL_O3:
+            return LLVMCodeGenLevelAggressive;
+    }
+    UNREACHABLE("invalid optimization level");
+}
+
+bool emit_target_machine_create(EmitOptions const   *options,
+                                LLVMTargetMachineRef *out) {
+    emit_initialize();
+
+    char         *triple = LLVMGetDefaultTargetTriple();
+    LLVMTargetRef target;
+    char         *message = NULL;
+    if (LLVMGetTargetFromTriple(triple, &target, &message)) {
+        log_error("no target for %s: %s", triple, message);
+        LLVMDisposeMessage(message);
+        LLVMDisposeMessage(triple);
+        return false;
+    }
+
+    bool  native   = options->cpu != NULL && strcmp(options->cpu, "native") == 0;
+    char *cpu      = native ? LLVMGetHostCPUName() : NULL;
+    char *features = native && options->features == NULL
+                       ? LLVMGetHostCPUFeatures()
+                       : NULL;
+
+    *out = LLVMCreateTargetMachine(
+        target, triple,
+        native ? cpu : (options->cpu != NULL ? options->cpu : ""),
+        features != NULL ? features
+                         : (options->features != NULL ? options->features : ""),
+        emit_llvm_opt_level(options->opt_level), options->reloc,
+        options->code_model);
+
+    LLVMDisposeMessage(features);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(triple);
+    return true;
+}
+
+void emit_prepare_module(LLVMModuleRef module, LLVMTargetMachineRef tm) {
+    char *triple = LLVMGetTargetMachineTriple(tm);
+    LLVMSetTarget(module, triple);
+    LLVMDisposeMessage(triple);
+
+    LLVMTargetDataRef data_layout = LLVMCreateTargetDataLayout(tm);
+    char             *layout      = LLVMCopyStringRepOfTargetData(data_layout);
+    LLVMSetDataLayout(module, layout);
+    LLVMDisposeMessage(layout);
+    LLVMDisposeTargetData(data_layout);
+}
+
+LLVMCodeGenFileType emit_llvm_file_type(EmitFileType type) {
+    switch (type) {
+        case EMIT_FILE_TYPE_OBJECT:
+            return LLVMObjectFile;
+        case EMIT_FILE_TYPE_ASSEMBLY:
+            return LLVMAssemblyFile;
+    }
+    UNREACHABLE("invalid file type");
+}
+
+bool emit_to_file(LLVMModuleRef module, EmitOptions const *options,
+                  EmitFileType type, char const *path) {
+    LLVMTargetMachineRef tm;
+    if (!emit_target_machine_create(options, &tm)) {
+        return false;
+    }
+    emit_prepare_module(module, tm);
+
+    char *message = NULL;
+    // The C API takes a mutable path, but does not modify it.
+    bool  failed  = LLVMTargetMachineEmitToFile(
+        tm, module, (char *)path, emit_llvm_file_type(type), &message);
+    if (failed) {
+        log_error("could not emit %s: %s", path, message);
+    }
+    LLVMDisposeMessage(message);
+    LLVMDisposeTargetMachine(tm);
+    return !failed;
+}
+
+bool emit_to_memory(LLVMModuleRef module, EmitOptions const *options,
+                    EmitFileType type, LLVMMemoryBufferRef *out) {
+    LLVMTargetMachineRef tm;
+    if (!emit_target_machine_create(options, &tm)) {
+        return false;
+    }
+    emit_prepare_module(module, tm);
+
+    char *message = NULL;
+    bool  failed  = LLVMTargetMachineEmitToMemoryBuffer(
+        tm, module, emit_llvm_file_type(type), &message, out);
+    if (failed) {
+        log_error("could not emit: %s", message);
+    }
+    LLVMDisposeMessage(message);
+    LLVMDisposeTargetMachine(tm);
+    return !failed;
+}
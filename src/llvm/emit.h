@@ -0,0 +1,40 @@
+#pragma once
+
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Types.h>
+#include "common.h"
+#include "llvm/codegen.h"
+
+enum EmitFileType {
+    EMIT_FILE_TYPE_OBJECT,
+    EMIT_FILE_TYPE_ASSEMBLY,
+};
+typedef enum EmitFileType EmitFileType;
+
+typedef struct EmitOptions EmitOptions;
+struct EmitOptions {
+    // NULL for a generic cpu, "native" for the cpu of the host
+    char const     *cpu;
+    // NULL for the features of cpu, or the host features if cpu is "native"
+    char const     *features;
+    LLVMRelocMode   reloc;
+    LLVMCodeModel   code_model;
+    CodeGenOptLevel opt_level;
+};
+
+// Generic cpu for the host triple, PIC and the default code model.
+EmitOptions emit_options_default(void);
+// Initialises the native target once, can be called from every thread.
+void        emit_initialize(void);
+// Creates a target machine for the host triple.
+bool        emit_target_machine_create(EmitOptions const   *options,
+                                       LLVMTargetMachineRef *out);
+// Sets the triple and data layout of the module to the ones of the target
+// machine, emit_to_file and emit_to_memory do this too.
+void        emit_prepare_module(LLVMModuleRef module, LLVMTargetMachineRef tm);
+bool        emit_to_file(LLVMModuleRef module, EmitOptions const *options,
+                         EmitFileType type, char const *path);
+// Emits into a memory buffer, which has to be disposed with
+// LLVMDisposeMemoryBuffer.
+bool        emit_to_memory(LLVMModuleRef module, EmitOptions const *options,
+                           EmitFileType type, LLVMMemoryBufferRef *out);
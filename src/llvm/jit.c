@@ -0,0 +1,195 @@
+#include "jit.h"
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "da.h"
+#include "llvm/emit.h"
+#include "thor_runtime.h"
+
+// Suffix of the real function bodies, the plain name is a lazy stub.
+#define JIT_BODY_SUFFIX "$body"
+
+typedef struct JitAliases JitAliases;
+struct JitAliases {
+    usz                         count;
+    usz                         capacity;
+    LLVMOrcCSymbolAliasMapPair *items;
+};
+
+bool jit_check(LLVMErrorRef error, char const *what) {
+    if (error == NULL) {
+        return true;
+    }
+
+    char *message = LLVMGetErrorMessage(error);
+    log_error("jit: %s: %s", what, message);
+    LLVMDisposeErrorMessage(message);
+    return false;
+}
+
+// Defines the functions of the runtime at their addresses in this process, so
+// they are found without exporting them from the executable.
+bool jit_define_runtime(Jit *jit) {
+    LLVMJITSymbolFlags flags = {
+        .GenericFlags = LLVMJITSymbolGenericFlagsExported |
+                        LLVMJITSymbolGenericFlagsCallable,
+        .TargetFlags  = 0,
+    };
+#define X(name) +1
+    usz const count = 0 THOR_RUNTIME_FUNCTIONS;
+#undef X
+    LLVMOrcCSymbolMapPairs symbols = malloc(sizeof(*symbols) * count);
+    usz                    i       = 0;
+#define X(name)                                                        \
+    symbols[i].Name = LLVMOrcLLJITMangleAndIntern(jit->lljit, #name); \
+    symbols[i].Sym  = (LLVMJITEvaluatedSymbol){                        \
+        .Address = (LLVMOrcJITTargetAddress)(uptr)&name,               \
+        .Flags   = flags,                                              \
+    };                                                                 \
+    i += 1;
+    THOR_RUNTIME_FUNCTIONS
+#undef X
+
+    LLVMOrcMaterializationUnitRef runtime =
+        LLVMOrcAbsoluteSymbols(symbols, count);
+    free(symbols);
+    return jit_check(
+        LLVMOrcJITDylibDefine(LLVMOrcLLJITGetMainJITDylib(jit->lljit), runtime),
+        "define runtime");
+}
+
+bool jit_create(Jit *out) {
+    *out = (Jit){0};
+
+    emit_initialize();
+
+    if (!jit_check(LLVMOrcCreateLLJIT(&out->lljit, NULL), "create LLJIT")) {
+        return false;
+    }
+
+    LLVMOrcExecutionSessionRef es =
+        LLVMOrcLLJITGetExecutionSession(out->lljit);
+    char const *triple = LLVMOrcLLJITGetTripleString(out->lljit);
+
+    if (!jit_check(LLVMOrcCreateLocalLazyCallThroughManager(triple, es, 0,
+                                                            &out->lctm),
+                   "create lazy call through manager")) {
+        jit_destroy(out);
+        return false;
+    }
+    out->ism = LLVMOrcCreateLocalIndirectStubsManager(triple);
+
+    // Makes the symbols of the process, like libc, available to thor code.
+    LLVMOrcDefinitionGeneratorRef process_symbols;
+    if (!jit_check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+                       &process_symbols,
+                       LLVMOrcLLJITGetGlobalPrefix(out->lljit), NULL, NULL),
+                   "create process symbol generator")) {
+        jit_destroy(out);
+        return false;
+    }
+    LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(out->lljit),
+                                process_symbols);
+
+    if (!jit_define_runtime(out)) {
+        jit_destroy(out);
+        return false;
+    }
+    return true;
+}
+
+void jit_destroy(Jit *jit) {
+    if (jit->lljit != NULL) {
+        LLVMConsumeError(LLVMOrcDisposeLLJIT(jit->lljit));
+    }
+    if (jit->ism != NULL) {
+        LLVMOrcDisposeIndirectStubsManager(jit->ism);
+    }
+    if (jit->lctm != NULL) {
+        LLVMOrcDisposeLazyCallThroughManager(jit->lctm);
+    }
+    *jit = (Jit){0};
+}
+
+// Renames the functions the module defines to name$body and adds their plain
+// names to aliases, so calls from other modules go through the lazy stubs.
+void jit_rename_bodies(Jit *jit, LLVMModuleRef module, JitAliases *aliases) {
+    for (LLVMValueRef function = LLVMGetFirstFunction(module);
+         function != NULL; function = LLVMGetNextFunction(function)) {
+        if (LLVMIsDeclaration(function)) {
+            continue;
+        }
+
+        size_t      len;
+        char const *name_ptr = LLVMGetValueName2(function, &len);
+        char       *name     = to_cstr((str){.ptr = (char *)name_ptr, .len = len});
+        str         body_name = str_format("%s" JIT_BODY_SUFFIX, name);
+        LLVMSetValueName2(function, body_name.ptr, body_name.len);
+        char *body_cname = to_cstr(body_name);
+        str_destroy(body_name);
+
+        LLVMOrcCSymbolAliasMapPair alias = {
+            .Name  = LLVMOrcLLJITMangleAndIntern(jit->lljit, name),
+            .Entry = {
+                .Name  = LLVMOrcLLJITMangleAndIntern(jit->lljit, body_cname),
+                .Flags = {.GenericFlags = LLVMJITSymbolGenericFlagsExported |
+                                          LLVMJITSymbolGenericFlagsCallable,
+                          .TargetFlags  = 0},
+            },
+        };
+        da_append(aliases, alias);
+        free(body_cname);
+        free(name);
+    }
+}
+
+bool jit_add_shards(Jit *jit, CodeGenShards *shards) {
+    LLVMOrcJITDylibRef main_jd = LLVMOrcLLJITGetMainJITDylib(jit->lljit);
+    JitAliases         aliases = {0};
+
+    for (usz i = 0; i < shards->count; i++) {
+        jit_rename_bodies(jit, shards->items[i].cg.module, &aliases);
+        // ORC only compiles the module once one of its bodies is looked up.
+        if (!jit_check(LLVMOrcLLJITAddLLVMIRModule(
+                           jit->lljit, main_jd,
+                           code_gen_shard_take_module(&shards->items[i])),
+                       "add module")) {
+            for (usz j = 0; j < aliases.count; j++) {
+                LLVMOrcReleaseSymbolStringPoolEntry(aliases.items[j].Name);
+                LLVMOrcReleaseSymbolStringPoolEntry(aliases.items[j].Entry.Name);
+            }
+            da_destroy(&aliases);
+            return false;
+        }
+    }
+
+    if (aliases.count == 0) {
+        return true;
+    }
+
+    LLVMOrcMaterializationUnitRef stubs = LLVMOrcLazyReexports(
+        jit->lctm, jit->ism, main_jd, aliases.items, aliases.count);
+    da_destroy(&aliases);
+
+    return jit_check(LLVMOrcJITDylibDefine(main_jd, stubs), "define stubs");
+}
+
+bool jit_add_object(Jit *jit, LLVMMemoryBufferRef object) {
+    return jit_check(
+        LLVMOrcLLJITAddObjectFile(
+            jit->lljit, LLVMOrcLLJITGetMainJITDylib(jit->lljit), object),
+        "add object");
+}
+
+bool jit_lookup(Jit *jit, char const *name, void **out) {
+    LLVMOrcExecutorAddress address;
+    if (!jit_check(LLVMOrcLLJITLookup(jit->lljit, &address, name), name)) {
+        return false;
+    }
+    *out = (void *)(uptr)address;
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Types.h>
+#include "common.h"
+#include "llvm/codegen.h"
+
+// An in process JIT on top of LLVM's LLJIT. Functions are compiled lazily,
+// the first call of a function compiles it, so only functions that actually
+// run are compiled.
+typedef struct Jit Jit;
+struct Jit {
+    LLVMOrcLLJITRef                  lljit;
+    LLVMOrcLazyCallThroughManagerRef lctm;
+    LLVMOrcIndirectStubsManagerRef   ism;
+};
+
+bool jit_create(Jit *out);
+void jit_destroy(Jit *jit);
+// Adds the functions the shards define, every shard becomes its own lazily
+// compiled module. The modules move into the JIT, the shards still have to be
+// destroyed by the caller.
+bool jit_add_shards(Jit *jit, CodeGenShards *shards);
+// Adds an object that was emitted for the host, the JIT takes the buffer. It
+// is linked once one of its symbols is looked up.
+bool jit_add_object(Jit *jit, LLVMMemoryBufferRef object);
+// Looks up a function, this does not compile it.
+bool jit_lookup(Jit *jit, char const *name, void **out);
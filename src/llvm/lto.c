@@ -0,0 +1,365 @@
+#include "lto.h"
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Linker.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "common.h"
+#include "da.h"
+#include "llvm/codegen.h"
+#include "uthash.h"
+
+char *lto_value_name(LLVMValueRef value) {
+    usz         len;
+    char const *name = LLVMGetValueName2(value, &len);
+    return to_cstr((str){.ptr = (char *)name, .len = len});
+}
+
+void lto_summary_add_callee(LtoFunctionSummary *summary, LLVMValueRef callee) {
+    if (!LLVMIsAFunction(callee) || LLVMGetIntrinsicID(callee) != 0) {
+        return;
+    }
+
+    char *name = lto_value_name(callee);
+    for (usz i = 0; i < summary->callees.count; i++) {
+        if (strcmp(summary->callees.items[i], name) == 0) {
+            free(name);
+            return;
+        }
+    }
+    da_append(&summary->callees, name);
+}
+
+LtoFunctionSummary lto_summarize_function(LLVMValueRef function) {
+    LtoFunctionSummary summary = {.name = lto_value_name(function)};
+    for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(function);
+         block != NULL; block = LLVMGetNextBasicBlock(block)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(block); inst != NULL;
+             inst = LLVMGetNextInstruction(inst)) {
+            summary.instructions += 1;
+            if (LLVMIsACallInst(inst)) {
+                lto_summary_add_callee(&summary, LLVMGetCalledValue(inst));
+            }
+        }
+    }
+    return summary;
+}
+
+LtoModule lto_module_create(LLVMModuleRef module) {
+    LtoModule out = {.bitcode = LLVMWriteBitcodeToMemoryBuffer(module)};
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL;
+         function = LLVMGetNextFunction(function)) {
+        if (!LLVMIsDeclaration(function)) {
+            da_append(&out.functions, lto_summarize_function(function));
+        }
+    }
+    return out;
+}
+
+bool lto_modules_generate(CodeGenerator *cg, usz module_count,
+                          CodeGenOptLevel level, LtoModules *out) {
+    CodeGenShards shards = code_gen_shards_with_pipeline(
+        cg, module_count, CODE_GEN_PIPELINE_THIN_PRE_LINK, level);
+    bool ok     = code_gen_shards_ok(&shards);
+    out->target = cg->target;
+    for (usz i = 0; ok && i < shards.count; i++) {
+        da_append(out, lto_module_create(shards.items[i].cg.module));
+    }
+    code_gen_shards_destroy(shards);
+    return ok;
+}
+
+void lto_modules_destroy(LtoModules modules) {
+    for (usz i = 0; i < modules.count; i++) {
+        LtoModule *module = &modules.items[i];
+        for (usz f = 0; f < module->functions.count; f++) {
+            LtoFunctionSummary *summary = &module->functions.items[f];
+            for (usz c = 0; c < summary->callees.count; c++) {
+                free(summary->callees.items[c]);
+            }
+            da_destroy(&summary->callees);
+            free(summary->name);
+        }
+        da_destroy(&module->functions);
+        LLVMDisposeMemoryBuffer(module->bitcode);
+    }
+    da_destroy(&modules);
+}
+
+typedef struct LtoCandidate LtoCandidate;
+struct LtoCandidate {
+    char const *name;
+    usz         limit;
+};
+
+typedef struct LtoCandidates LtoCandidates;
+struct LtoCandidates {
+    usz           count;
+    usz           capacity;
+    LtoCandidate *items;
+};
+
+// Breadth first over the call graph of the summaries, starting at the calls of
+// the module. The limits only decrease, so a function that is too big for the
+// first limit it sees is too big for all others.
+void lto_compute_imports(LtoIndex *index, LtoModules *modules,
+                         usz const *offsets, usz total, Index module,
+                         usz limit) {
+    LtoCandidates candidates = {0};
+    bool         *imported   = calloc(total + 1, sizeof(bool));
+
+    LtoModule *m = &modules->items[module];
+    for (usz f = 0; f < m->functions.count; f++) {
+        LtoFunctionSummary *summary = &m->functions.items[f];
+        for (usz c = 0; c < summary->callees.count; c++) {
+            da_append(&candidates,
+                      ((LtoCandidate){summary->callees.items[c], limit}));
+        }
+    }
+
+    for (usz i = 0; i < candidates.count; i++) {
+        LtoCandidate   candidate = candidates.items[i];
+        LtoIndexEntry *entry;
+        HASH_FIND_STR(index->functions, candidate.name, entry);
+        if (entry == NULL || entry->module == module) {
+            continue;
+        }
+
+        LtoFunctionSummary *summary =
+            &modules->items[entry->module].functions.items[entry->function];
+        usz id = offsets[entry->module] + entry->function;
+        if (imported[id] || summary->instructions > candidate.limit) {
+            continue;
+        }
+
+        imported[id] = true;
+        da_append(&index->imports[module],
+                  ((LtoImport){entry->module, entry->function}));
+        for (usz c = 0; c < summary->callees.count; c++) {
+            da_append(&candidates, ((LtoCandidate){summary->callees.items[c],
+                                                   candidate.limit * 7 / 10}));
+        }
+    }
+
+    free(imported);
+    da_destroy(&candidates);
+}
+
+LtoIndex lto_thin_link(LtoModules *modules, CodeGenOptLevel level) {
+    LtoIndex index = {
+        .count   = modules->count,
+        .imports = calloc(modules->count, sizeof(LtoImports)),
+    };
+
+    // The id of a function is the offset of its module plus its position.
+    usz *offsets = malloc(sizeof(usz) * (modules->count + 1));
+    usz  total   = 0;
+    for (usz m = 0; m < modules->count; m++) {
+        offsets[m] = total;
+        for (usz f = 0; f < modules->items[m].functions.count; f++) {
+            LtoIndexEntry *entry = malloc(sizeof(LtoIndexEntry));
+            entry->name          = modules->items[m].functions.items[f].name;
+            entry->module        = m;
+            entry->function      = f;
+            HASH_ADD_KEYPTR(hh, index.functions, entry->name,
+                            strlen(entry->name), entry);
+            total += 1;
+        }
+    }
+
+    // Nothing is inlined at O0, so importing would only cost time.
+    usz limit =
+        level == CODE_GEN_OPT_LEVEL_O0 ? 0 : LTO_IMPORT_INSTRUCTION_LIMIT;
+    for (usz m = 0; limit > 0 && m < modules->count; m++) {
+        lto_compute_imports(&index, modules, offsets, total, m, limit);
+    }
+
+    free(offsets);
+    return index;
+}
+
+void lto_index_destroy(LtoIndex *index) {
+    LtoIndexEntry *entry, *entry_tmp;
+    HASH_ITER(hh, index->functions, entry, entry_tmp) {
+        HASH_DEL(index->functions, entry);
+        free(entry);
+    }
+    for (usz i = 0; i < index->count; i++) {
+        da_destroy(&index->imports[i]);
+    }
+    free(index->imports);
+    index->imports = NULL;
+    index->count   = 0;
+}
+
+// The C API can not delete the body of a function, so the function is
+// replaced by a new declaration.
+void lto_make_declaration(LLVMValueRef function) {
+    char *name = lto_value_name(function);
+    LLVMSetValueName2(function, "", 0);
+    LLVMValueRef declaration =
+        LLVMAddFunction(LLVMGetGlobalParent(function), name,
+                        LLVMGlobalGetValueType(function));
+    LLVMSetFunctionCallConv(declaration, LLVMGetFunctionCallConv(function));
+    LLVMReplaceAllUsesWith(function, declaration);
+    LLVMDeleteFunction(function);
+    free(name);
+}
+
+bool lto_is_imported(LtoImports *imports, LtoModule *source, Index source_index,
+                     char const *name) {
+    for (usz i = 0; i < imports->count; i++) {
+        LtoImport import = imports->items[i];
+        if (import.module == source_index &&
+            strcmp(source->functions.items[import.function].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Links the imported functions of source into the backend. They are
+// available_externally, so the optimizer can inline them, but they are never
+// emitted. Every other function of source becomes a declaration.
+bool lto_import_from(LtoBackend *backend, LtoModules *modules,
+                     LtoImports *imports, Index source) {
+    bool any = false;
+    for (usz i = 0; i < imports->count; i++) {
+        any = any || imports->items[i].module == source;
+    }
+    if (!any) {
+        return true;
+    }
+
+    LLVMModuleRef module;
+    if (LLVMParseBitcodeInContext2(backend->context,
+                                   modules->items[source].bitcode, &module)) {
+        log_error("could not read the bitcode of module %zu", source);
+        return false;
+    }
+
+    LLVMValueRef next;
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL;
+         function = next) {
+        // New declarations are added at the end, they are skipped.
+        next = LLVMGetNextFunction(function);
+        if (LLVMIsDeclaration(function)) {
+            continue;
+        }
+
+        char *name = lto_value_name(function);
+        if (lto_is_imported(imports, &modules->items[source], source, name)) {
+            LLVMSetLinkage(function, LLVMAvailableExternallyLinkage);
+        } else {
+            lto_make_declaration(function);
+        }
+        free(name);
+    }
+
+    // Destroys module
+    if (LLVMLinkModules2(backend->module, module)) {
+        log_error("could not import the functions of module %zu", source);
+        return false;
+    }
+    return true;
+}
+
+void lto_backend_run(LtoBackend *backend, LtoModules *modules, LtoIndex *index,
+                     Index module, CodeGenOptLevel level) {
+    backend->context = LLVMContextCreate();
+    if (LLVMParseBitcodeInContext2(backend->context,
+                                   modules->items[module].bitcode,
+                                   &backend->module)) {
+        log_error("could not read the bitcode of module %zu", module);
+        backend->module = NULL;
+        return;
+    }
+
+    // Every source module is read once for all of its imports.
+    for (usz source = 0; source < modules->count; source++) {
+        if (source != module &&
+            !lto_import_from(backend, modules, &index->imports[module],
+                             source)) {
+            return;
+        }
+    }
+
+    backend->ok = code_gen_optimize_module(
+        backend->module, CODE_GEN_PIPELINE_THIN_BACKEND, level,
+        modules->target);
+}
+
+// The arguments of the task of a backend.
+typedef struct LtoBackendTask LtoBackendTask;
+struct LtoBackendTask {
+    LtoBackend     *backend;
+    LtoModules     *modules;
+    LtoIndex       *index;
+    Index           module;
+    CodeGenOptLevel level;
+};
+
+void lto_backend_task_run(void *data) {
+    LtoBackendTask *task = data;
+    lto_backend_run(task->backend, task->modules, task->index, task->module,
+                    task->level);
+}
+
+// Every backend is a task of the global thread pool.
+LtoBackends lto_thin_backends(LtoModules *modules, LtoIndex *index,
+                              CodeGenOptLevel level) {
+    LtoBackends backends = {
+        .count = modules->count,
+        .items = calloc(modules->count, sizeof(LtoBackend)),
+    };
+
+    LtoBackendTask *tasks = calloc(backends.count, sizeof(LtoBackendTask));
+    ThreadPool     *pool  = thread_pool_global();
+    ThreadPoolGroup group = {0};
+    for (usz i = 0; i < backends.count; i++) {
+        tasks[i] = (LtoBackendTask){
+            .backend = &backends.items[i],
+            .modules = modules,
+            .index   = index,
+            .module  = i,
+            .level   = level,
+        };
+        thread_pool_submit(pool, &group, lto_backend_task_run, &tasks[i]);
+    }
+    thread_pool_wait(pool, &group);
+
+    free(tasks);
+    return backends;
+}
+
+bool lto_backends_ok(LtoBackends *backends) {
+    for (usz i = 0; i < backends->count; i++) {
+        if (!backends->items[i].ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool lto_link_backends(CodeGenerator *cg, LtoBackends *backends) {
+    for (usz i = 0; i < backends->count; i++) {
+        if (!code_gen_link_module(cg, backends->items[i].module)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void lto_backends_destroy(LtoBackends backends) {
+    for (usz i = 0; i < backends.count; i++) {
+        if (backends.items[i].module != NULL) {
+            LLVMDisposeModule(backends.items[i].module);
+        }
+        if (backends.items[i].context != NULL) {
+            LLVMContextDispose(backends.items[i].context);
+        }
+    }
+    free(backends.items);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <llvm-c/Types.h>
+#include "common.h"
+#include "llvm/codegen.h"
+#include "uthash.h"
+
+// ================
+// -- thin lto --
+// Whole program optimisation in the style of ThinLTO:
+//
+// 1. The program is generated in modules with the pre link pipeline, in
+//    parallel. Every module is kept as bitcode together with a summary of the
+//    functions it defines.
+// 2. The thin link only reads the summaries. It builds the combined index and
+//    decides which small functions every module imports from the others.
+// 3. The backends import those functions as available_externally definitions
+//    and run the ThinLTO backend pipeline, one module per thread, so small
+//    helpers get inlined across modules without a serial link of the whole
+//    program.
+//
+// The LLVM C API can not write the summaries of LLVM's own ThinLTO, so the
+// summaries are computed by thor from the IR of every module.
+// ================
+
+typedef struct LtoFunctionSummary LtoFunctionSummary;
+struct LtoFunctionSummary {
+    char *name;
+    // Instructions of the pre link optimised body, the cost of an import
+    usz   instructions;
+    // The functions called directly from the body
+    struct {
+        usz    count;
+        usz    capacity;
+        char **items;
+    } callees;
+};
+
+typedef struct LtoModule LtoModule;
+struct LtoModule {
+    LLVMMemoryBufferRef bitcode;
+    // The functions defined in the module
+    struct {
+        usz                 count;
+        usz                 capacity;
+        LtoFunctionSummary *items;
+    } functions;
+};
+
+typedef struct LtoModules LtoModules;
+struct LtoModules {
+    usz                count;
+    usz                capacity;
+    LtoModule         *items;
+    // The target of the generator, the backends are optimised for it
+    EmitOptions const *target;
+};
+
+// Writes the bitcode of module and computes its summary, module stays valid.
+LtoModule lto_module_create(LLVMModuleRef module);
+// Generates cg in module_count modules with the pre link pipeline, 0 for one
+// module per core.
+bool      lto_modules_generate(CodeGenerator *cg, usz module_count,
+                               CodeGenOptLevel level, LtoModules *out);
+void      lto_modules_destroy(LtoModules modules);
+
+typedef struct LtoIndexEntry LtoIndexEntry;
+struct LtoIndexEntry {
+    UT_hash_handle hh;
+    // Owned by the summary
+    char          *name;
+    Index          module;
+    Index          function;
+};
+
+typedef struct LtoImport LtoImport;
+struct LtoImport {
+    Index module;
+    Index function;
+};
+
+typedef struct LtoImports LtoImports;
+struct LtoImports {
+    usz        count;
+    usz        capacity;
+    LtoImport *items;
+};
+
+// The result of the thin link.
+typedef struct LtoIndex LtoIndex;
+struct LtoIndex {
+    // Every defined function of the program by name
+    LtoIndexEntry *functions;
+    // The imports of every module, indexed like the modules
+    usz            count;
+    LtoImports    *imports;
+};
+
+// A function is imported if it has at most this many instructions. Functions
+// called by an imported function get 70% of the limit of their caller, like
+// the import-instr-limit and evolution factor of LLVM.
+#define LTO_IMPORT_INSTRUCTION_LIMIT 100
+
+LtoIndex lto_thin_link(LtoModules *modules, CodeGenOptLevel level);
+void     lto_index_destroy(LtoIndex *index);
+
+typedef struct LtoBackend LtoBackend;
+struct LtoBackend {
+    LLVMContextRef context;
+    LLVMModuleRef  module;
+    bool           ok;
+};
+
+typedef struct LtoBackends LtoBackends;
+struct LtoBackends {
+    usz         count;
+    LtoBackend *items;
+};
+
+// Imports the functions of the index into every module and optimises it with
+// the backend pipeline, on one thread per core. Check the result with
+// lto_backends_ok.
+LtoBackends lto_thin_backends(LtoModules *modules, LtoIndex *index,
+                              CodeGenOptLevel level);
+bool        lto_backends_ok(LtoBackends *backends);
+// Links all backends into cg->module, the backends stay valid.
+bool        lto_link_backends(CodeGenerator *cg, LtoBackends *backends);
+void        lto_backends_destroy(LtoBackends backends);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdlib.h>
+#include "common.h"
+
+// ================
+// -- node column --
+// A node column is a dense side table with one entry per node in
+// Module.nodes. It is indexed directly by the node Index, so looking up an
+// attribute of a node is a single load instead of a hash lookup.
+//
+// It should contain the following members:
+// *items   - A pointer to the item type
+// count    - The amount of nodes the column was created for
+// ================
+
+#define NODE_COLUMN(item_type, name)                  \
+    typedef struct NodeColumn##name NodeColumn##name; \
+    struct NodeColumn##name {                         \
+        usz        count;                             \
+        item_type *items;                             \
+    };
+
+// Allocates the column for node_count nodes and sets every entry to fill.
+#define node_column_init(column, node_count, fill)                           \
+    do {                                                                     \
+        (column)->count = (node_count);                                      \
+        (column)->items = malloc(sizeof(*(column)->items) * (column)->count); \
+        for (usz nc_i = 0; nc_i < (column)->count; nc_i++) {                 \
+            (column)->items[nc_i] = (fill);                                  \
+        }                                                                    \
+    } while (0)
+
+#define node_column_get(column, node) ((column)->items[(node)])
+#define node_column_set(column, node, value) \
+    ((column)->items[(node)] = (value))
+
+#define node_column_destroy(column) free((column)->items)
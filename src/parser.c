@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ast.h"
 #include "common.h"
 #include "da.h"
@@ -40,7 +41,7 @@ Parser parser_create(Tokens t, str input) {
         .cur_token  = 1,
         .peek_token = 2,
         .input      = input,
-        .cur_module = {.name = to_str("main"), .nodes = {0}}
+        .cur_module = {.nodes = {0}},
     };
 
     return p;
@@ -106,10 +107,95 @@ ParseNodeResult parse_integer(Parser *p) {
     };
 }
 
-ParseNodeResult parse_expression(Parser *p) {
+ParseNodeResult parse_float(Parser *p) {
+    Index main_token = p->cur_token;
+
+    return (ParseNodeResult){
+        .type    = PARSE_RESULT_TYPE_OK,
+        .data.ok = {.data       = {0},
+                    .type       = NODE_TYPE_FLOAT_LITERAL,
+                    .main_token = main_token}
+    };
+}
+
+ParseNodeResult parse_identifier(Parser *p) {
+    Index main_token = p->cur_token;
+
+    return (ParseNodeResult){
+        .type    = PARSE_RESULT_TYPE_OK,
+        .data.ok = {.data       = {0},
+                    .type       = NODE_TYPE_IDENTIFIER,
+                    .main_token = main_token}
+    };
+}
+
+ParseNodeResult parse_expression(Parser *p);
+
+// The arguments are inserted before the call, the call itself is not
+// inserted.
+ParseNodeResult parse_call(Parser *p) {
+    Index    main_token = p->cur_token;
+    CallData call_data  = {0};
+
+    // name( <-
+    parser_next_token(p);
+    while (parser_peek_tok(p)->type != TOKEN_TYPE_RPAREN) {
+        Index idx;
+        Node  argument;
+        if (call_data.count > 0) {
+            // name(arg, <-
+            TRY(parser_expect_peek(p, TOKEN_TYPE_COMMA), ParseIndexResult,
+                ParseNodeResult);
+        }
+        // name(arg <-
+        parser_next_token(p);
+        TRY_OUTPUT(parse_expression(p), Node, Node, argument);
+        TRY_OUTPUT(module_insert_node(&p->cur_module, argument), Index, Node,
+                   idx);
+        da_append(&call_data, idx);
+    }
+    // name(args) <-
+    parser_next_token(p);
+
+    Index         ed_idx;
+    NodeExtraData ed = {.type = NODE_EXTRA_DATA_CALL, .data.call = call_data};
+    TRY_OUTPUT(module_insert_extra_data(&p->cur_module, ed), Index, Node,
+               ed_idx);
+
+    return (ParseNodeResult){
+        .type    = PARSE_RESULT_TYPE_OK,
+        .data.ok = {.type       = NODE_TYPE_CALL,
+                    .main_token = main_token,
+                    .data.lhs   = ed_idx}
+    };
+}
+
+ParseNodeResult parse_primary(Parser *p) {
     switch (parser_tok(p)->type) {
         case TOKEN_TYPE_INTEGER:
             return parse_integer(p);
+        case TOKEN_TYPE_INTEGER_OUT_OF_RANGE:
+            return (ParseNodeResult){
+                .type = PARSE_RESULT_TYPE_INTEGER_OUT_OF_RANGE,
+                .data.errors.invalid_token = {*parser_tok(p)}};
+        case TOKEN_TYPE_FLOAT:
+            return parse_float(p);
+        case TOKEN_TYPE_IDENTIFIER:
+            if (parser_peek_tok(p)->type == TOKEN_TYPE_LPAREN) {
+                return parse_call(p);
+            }
+            return parse_identifier(p);
+        case TOKEN_TYPE_LPAREN: {
+            // ( expr <-
+            parser_next_token(p);
+            Node inner;
+            TRY_OUTPUT(parse_expression(p), Node, Node, inner);
+            // ( expr ) <-
+            TRY(parser_expect_peek(p, TOKEN_TYPE_RPAREN), ParseIndexResult,
+                ParseNodeResult);
+            return (ParseNodeResult){.type    = PARSE_RESULT_TYPE_OK,
+                                     .data.ok = inner};
+        }
         default:
             return (ParseNodeResult){
                 .type                      = PARSE_RESULT_TYPE_NOT_EXPRESSION,
@@ -117,6 +203,67 @@ ParseNodeResult parse_expression(Parser *p) {
     }
 }
 
+// The precedence of a binary operator, 0 if the token is no binary operator.
+u32 parse_binary_precedence(TokenType type) {
+    switch (type) {
+        case TOKEN_TYPE_EQUAL_EQUAL:
+        case TOKEN_TYPE_BANG_EQUAL:
+        case TOKEN_TYPE_LESS:
+        case TOKEN_TYPE_LESS_EQUAL:
+        case TOKEN_TYPE_GREATER:
+        case TOKEN_TYPE_GREATER_EQUAL:
+            return 1;
+        case TOKEN_TYPE_PLUS:
+        case TOKEN_TYPE_MINUS:
+            return 2;
+        case TOKEN_TYPE_ASTERISK:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+// Precedence climbing. The operands are inserted into the module before the
+// operation, the returned node itself is not inserted.
+ParseNodeResult parse_binary_operation(Parser *p, u32 min_precedence) {
+    Node lhs;
+    TRY_OUTPUT(parse_primary(p), Node, Node, lhs);
+
+    while (true) {
+        u32 precedence = parse_binary_precedence(parser_peek_tok(p)->type);
+        if (precedence == 0 || precedence < min_precedence) {
+            break;
+        }
+
+        Index lhs_idx, rhs_idx;
+        Node  rhs;
+        TRY_OUTPUT(module_insert_node(&p->cur_module, lhs), Index, Node,
+                   lhs_idx);
+        // lhs op <-
+        parser_next_token(p);
+        Index operator_token = p->cur_token;
+        // lhs op rhs <-
+        parser_next_token(p);
+        TRY_OUTPUT(parse_binary_operation(p, precedence + 1), Node, Node, rhs);
+        TRY_OUTPUT(module_insert_node(&p->cur_module, rhs), Index, Node,
+                   rhs_idx);
+
+        lhs = (Node){
+            .data       = {.lhs = lhs_idx, .rhs = rhs_idx},
+            .type       = NODE_TYPE_BINARY_OPERATION,
+            .main_token = operator_token,
+        };
+    }
+
+    return (ParseNodeResult){.type = PARSE_RESULT_TYPE_OK, .data.ok = lhs};
+}
+
+// Protocol: cur_token is on the first token of the expression, afterwards it
+// is on the last token of the expression.
+ParseNodeResult parse_expression(Parser *p) {
+    return parse_binary_operation(p, 1);
+}
+
 ParseNodeResult parse_variable_declaration(Parser *p) {
     Index main_token = p->cur_token;
     Index lhs        = 0;
@@ -152,6 +299,81 @@ ParseNodeResult parse_variable_declaration(Parser *p) {
     };
 }
 
+// comptime name : type = expr, the same as a variable declaration after the
+// comptime keyword.
+ParseNodeResult parse_comptime_declaration(Parser *p) {
+    // comptime name <-
+    TRY(parser_expect_peek(p, TOKEN_TYPE_IDENTIFIER), ParseIndexResult,
+        ParseNodeResult);
+    ParseNodeResult result = parse_variable_declaration(p);
+    if (result.type == PARSE_RESULT_TYPE_OK) {
+        result.data.ok.type = NODE_TYPE_COMPTIME_DECLARATION;
+    }
+    return result;
+}
+
+// import name, the module is resolved by the analyse.
+ParseNodeResult parse_import(Parser *p) {
+    Index main_token;
+
+    // import name <-
+    TRY_OUTPUT(parser_expect_peek(p, TOKEN_TYPE_IDENTIFIER), Index, Node,
+               main_token);
+    TRY(parser_expect_peek(p, TOKEN_TYPE_EOL), ParseIndexResult,
+        ParseNodeResult);
+    parser_next_token(p);
+
+    return (ParseNodeResult){
+        .type    = PARSE_RESULT_TYPE_OK,
+        .data.ok = (Node){.type = NODE_TYPE_IMPORT, .main_token = main_token}
+    };
+}
+
+ParseNodeResult parse_assignment(Parser *p) {
+    Index main_token = p->cur_token;
+    Node  expr;
+    Index rhs;
+
+    // name = <-
+    TRY(parser_expect_peek(p, TOKEN_TYPE_EQUAL), ParseIndexResult,
+        ParseNodeResult);
+    // name = expr <-
+    parser_next_token(p);
+    TRY_OUTPUT(parse_expression(p), Node, Node, expr);
+    TRY_OUTPUT(module_insert_node(&p->cur_module, expr), Index, Node, rhs);
+    TRY(parser_expect_peek(p, TOKEN_TYPE_EOL), ParseIndexResult,
+        ParseNodeResult);
+    parser_next_token(p);
+
+    return (ParseNodeResult){
+        .type    = PARSE_RESULT_TYPE_OK,
+        .data.ok = (Node){.data       = {.rhs = rhs},
+                          .type       = NODE_TYPE_ASSIGNMENT,
+                          .main_token = main_token}
+    };
+}
+
+ParseNodeResult parse_return(Parser *p) {
+    Index main_token = p->cur_token;
+    Node  expr;
+    Index rhs;
+
+    // return expr <-
+    parser_next_token(p);
+    TRY_OUTPUT(parse_expression(p), Node, Node, expr);
+    TRY_OUTPUT(module_insert_node(&p->cur_module, expr), Index, Node, rhs);
+    TRY(parser_expect_peek(p, TOKEN_TYPE_EOL), ParseIndexResult,
+        ParseNodeResult);
+    parser_next_token(p);
+
+    return (ParseNodeResult){
+        .type    = PARSE_RESULT_TYPE_OK,
+        .data.ok = (Node){.data       = {.rhs = rhs},
+                          .type       = NODE_TYPE_RETURN,
+                          .main_token = main_token}
+    };
+}
+
 ParseNodeResult parse_block(Parser *p) {
     // { ... <-
     parser_next_token(p);
@@ -160,6 +382,11 @@ ParseNodeResult parse_block(Parser *p) {
 
     while (parser_tok(p)->type != TOKEN_TYPE_RBRACE) {
         parser_skip_whitespace(p);
+        // A statement that ends with a block, like a loop, is followed by
+        // whitespace before the }.
+        if (parser_tok(p)->type == TOKEN_TYPE_RBRACE) {
+            break;
+        }
         Index idx;
         Node  out_node;
 
@@ -200,6 +427,9 @@ ParseFunctionArgumentsResult parse_arguments(Parser *p) {
         if (parser_peek_tok(p)->type != TOKEN_TYPE_COMMA) {
             break;
         }
+        // , <-
+        parser_next_token(p);
+        // , name <-
         parser_next_token(p);
     } while (parser_tok(p)->type == TOKEN_TYPE_IDENTIFIER);
 
@@ -208,8 +438,21 @@ ParseFunctionArgumentsResult parse_arguments(Parser *p) {
 }
 
 ParseNodeResult parse_function_defintition(Parser *p) {
-    Index             main_token, return_type;
-    FunctionArguments args;
+    Index                   main_token, return_type;
+    FunctionArguments       args       = {0};
+    FunctionAttributeTokens attributes = {0};
+
+    // @name <-
+    while (parser_tok(p)->type == TOKEN_TYPE_AT) {
+        Index attribute;
+        TRY_OUTPUT(parser_expect_peek(p, TOKEN_TYPE_IDENTIFIER), Index, Node,
+                   attribute);
+        da_append(&attributes, attribute);
+        parser_next_token(p);
+        parser_skip_whitespace(p);
+    }
+    // fn <-
+    TRY(parser_expect(p, TOKEN_TYPE_FN), ParseIndexResult, ParseNodeResult);
 
     // fn name_of_function <-
     TRY_OUTPUT(parser_expect_peek(p, TOKEN_TYPE_IDENTIFIER), Index, Node,
@@ -261,7 +504,9 @@ ParseNodeResult parse_function_defintition(Parser *p) {
 
     NodeExtraData extra_data = {
         .type                    = NODE_EXTRA_DATA_FUNCTION_PROTOTYPE,
-        .data.function_prototype = {.return_type = return_type, .args = args}
+        .data.function_prototype = {.return_type = return_type,
+                                    .args        = args,
+                                    .attributes  = attributes}
     };
     da_append(&p->cur_module.extra_data, extra_data);
     Index ed_idx = p->cur_module.extra_data.count - 1;
@@ -275,6 +520,95 @@ ParseNodeResult parse_function_defintition(Parser *p) {
     return (ParseNodeResult){.type = PARSE_RESULT_TYPE_OK, .data.ok = node};
 }
 
+// #hints while condition { ... } and #hints for name in start..end { ... }.
+// The operands and the block are inserted before the loop, the loop itself is
+// not inserted.
+ParseNodeResult parse_loop(Parser *p) {
+    LoopData loop_data = {0};
+
+    // #name <-
+    while (parser_tok(p)->type == TOKEN_TYPE_HASH) {
+        LoopHintToken hint = {0};
+        TRY_OUTPUT(parser_expect_peek(p, TOKEN_TYPE_IDENTIFIER), Index, Node,
+                   hint.name);
+        if (parser_peek_tok(p)->type == TOKEN_TYPE_LPAREN) {
+            // #name( <-
+            parser_next_token(p);
+            // #name(argument <-
+            TRY_OUTPUT(parser_expect_peek(p, TOKEN_TYPE_INTEGER), Index, Node,
+                       hint.argument);
+            // #name(argument) <-
+            TRY(parser_expect_peek(p, TOKEN_TYPE_RPAREN), ParseIndexResult,
+                ParseNodeResult);
+        }
+        da_append(&loop_data.hints, hint);
+        parser_next_token(p);
+        parser_skip_whitespace(p);
+    }
+
+    Index    main_token = p->cur_token;
+    NodeType type;
+    Node     operand;
+    switch (parser_tok(p)->type) {
+        case TOKEN_TYPE_WHILE:
+            type = NODE_TYPE_WHILE;
+            // while condition <-
+            parser_next_token(p);
+            TRY_OUTPUT(parse_expression(p), Node, Node, operand);
+            TRY_OUTPUT(module_insert_node(&p->cur_module, operand), Index,
+                       Node, loop_data.lhs);
+            break;
+        case TOKEN_TYPE_FOR:
+            type = NODE_TYPE_FOR;
+            // for name <-
+            TRY_OUTPUT(parser_expect_peek(p, TOKEN_TYPE_IDENTIFIER), Index,
+                       Node, main_token);
+            // for name in <-
+            TRY(parser_expect_peek(p, TOKEN_TYPE_IN), ParseIndexResult,
+                ParseNodeResult);
+            // for name in start <-
+            parser_next_token(p);
+            TRY_OUTPUT(parse_expression(p), Node, Node, operand);
+            TRY_OUTPUT(module_insert_node(&p->cur_module, operand), Index,
+                       Node, loop_data.lhs);
+            // for name in start.. <-
+            TRY(parser_expect_peek(p, TOKEN_TYPE_DOT_DOT), ParseIndexResult,
+                ParseNodeResult);
+            // for name in start..end <-
+            parser_next_token(p);
+            TRY_OUTPUT(parse_expression(p), Node, Node, operand);
+            TRY_OUTPUT(module_insert_node(&p->cur_module, operand), Index,
+                       Node, loop_data.rhs);
+            break;
+        default:
+            return (ParseNodeResult){
+                .type                      = PARSE_RESULT_TYPE_EXPECTED_LOOP,
+                .data.errors.invalid_token = {*parser_tok(p)},
+            };
+    }
+
+    // { <-
+    TRY(parser_expect_peek(p, TOKEN_TYPE_LBRACE), ParseIndexResult,
+        ParseNodeResult);
+    Node  block;
+    Index block_idx;
+    TRY_OUTPUT(parse_block(p), Node, Node, block);
+    TRY_OUTPUT(module_insert_node(&p->cur_module, block), Index, Node,
+               block_idx);
+
+    Index         ed_idx;
+    NodeExtraData ed = {.type = NODE_EXTRA_DATA_LOOP, .data.loop = loop_data};
+    TRY_OUTPUT(module_insert_extra_data(&p->cur_module, ed), Index, Node,
+               ed_idx);
+
+    return (ParseNodeResult){
+        .type    = PARSE_RESULT_TYPE_OK,
+        .data.ok = {.type       = type,
+                    .main_token = main_token,
+                    .data       = {.lhs = ed_idx, .rhs = block_idx}}
+    };
+}
+
 ParseNodeResult parse_eof(Parser *p) {
     Index main_token = p->cur_token;
 
@@ -292,10 +626,24 @@ ParseNodeResult parse_eof(Parser *p) {
 ParseNodeResult parse_node(Parser *p) {
     parser_skip_whitespace(p);
     switch (parser_tok(p)->type) {
+        case TOKEN_TYPE_AT:
         case TOKEN_TYPE_FN:
             return parse_function_defintition(p);
         case TOKEN_TYPE_IDENTIFIER:
+            if (parser_peek_tok(p)->type == TOKEN_TYPE_EQUAL) {
+                return parse_assignment(p);
+            }
             return parse_variable_declaration(p);
+        case TOKEN_TYPE_COMPTIME:
+            return parse_comptime_declaration(p);
+        case TOKEN_TYPE_IMPORT:
+            return parse_import(p);
+        case TOKEN_TYPE_HASH:
+        case TOKEN_TYPE_WHILE:
+        case TOKEN_TYPE_FOR:
+            return parse_loop(p);
+        case TOKEN_TYPE_RETURN:
+            return parse_return(p);
         case TOKEN_TYPE_EOF:
             return parse_eof(p);
         default:
@@ -310,8 +658,28 @@ ParseNodeResult parse_node(Parser *p) {
     };
 }
 
+// module name, only before everything else in the file.
+ParseIndexResult parse_module_declaration(Parser *p) {
+    parser_skip_whitespace(p);
+    if (parser_tok(p)->type != TOKEN_TYPE_MODULE) {
+        p->cur_module.name = to_str("main");
+        return (ParseIndexResult){.type = PARSE_RESULT_TYPE_OK};
+    }
+
+    // module name <-
+    Index name;
+    TRY_OUTPUT(parser_expect_peek(p, TOKEN_TYPE_IDENTIFIER), Index, Index,
+               name);
+    TRY(parser_expect_peek(p, TOKEN_TYPE_EOL), ParseIndexResult,
+        ParseIndexResult);
+    parser_next_token(p);
+    p->cur_module.name = tokens_token_str(p->input, &p->tokens, name);
+    return (ParseIndexResult){.type = PARSE_RESULT_TYPE_OK, .data.ok = name};
+}
+
 ParseModuleResult parser_parse_module(Parser *p) {
-    p->cur_module = (Module){.name = to_str("main"), .nodes = {0}};
+    p->cur_module = (Module){.nodes = {0}};
+    TRY(parse_module_declaration(p), ParseIndexResult, ParseModuleResult);
 
     while (parser_tok(p)->type != TOKEN_TYPE_EOF) {
         ParseNodeResult result = parse_node(p);
@@ -336,12 +704,39 @@ ParseModuleResult parser_parse_module(Parser *p) {
                                .data.ok = p->cur_module};
 }
 
+void node_extra_data_destroy(NodeExtraData *ed) {
+    switch (ed->type) {
+        case NODE_EXTRA_DATA_FUNCTION_PROTOTYPE:
+            da_destroy(&ed->data.function_prototype.args);
+            da_destroy(&ed->data.function_prototype.attributes);
+            return;
+        case NODE_EXTRA_DATA_BLOCK:
+            da_destroy(&ed->data.block);
+            return;
+        case NODE_EXTRA_DATA_CALL:
+            da_destroy(&ed->data.call);
+            return;
+        case NODE_EXTRA_DATA_LOOP:
+            da_destroy(&ed->data.loop.hints);
+            return;
+    }
+    UNREACHABLE("invalid extra data type");
+}
+
 void module_destroy(Module m) {
     free(m.nodes.items);
     free(m.top_level_nodes.items);
+    for (usz i = 0; i < m.extra_data.count; i++) {
+        node_extra_data_destroy(&m.extra_data.items[i]);
+    }
+    free(m.extra_data.items);
     str_destroy(m.name);
 }
 
+bool module_is_main(Module const *m) {
+    return m->name.len == 4 && strncmp(m->name.ptr, "main", 4) == 0;
+}
+
 void parser_destroy(Parser p) {
     str_destroy(p.input);
     tokens_destroy(p.tokens);
@@ -356,6 +751,46 @@ void print_integer(Parser *p, Module *m, Node *node) {
     str_destroy(integer);
 }
 
+void print_identifier(Parser *p, Module *m, Node *node) {
+    (void)m;
+    str identifier = tokens_token_str(p->input, &p->tokens, node->main_token);
+    str_fprint(stdout, identifier);
+    str_destroy(identifier);
+}
+
+void print_binary_operation(Parser *p, Module *m, Node *node) {
+    printf("(");
+    print_node(p, m, &m->nodes.items[node->data.lhs]);
+    str op = tokens_token_str(p->input, &p->tokens, node->main_token);
+    printf(" ");
+    str_fprint(stdout, op);
+    printf(" ");
+    str_destroy(op);
+    print_node(p, m, &m->nodes.items[node->data.rhs]);
+    printf(")");
+}
+
+void print_call(Parser *p, Module *m, Node *node) {
+    str name = tokens_token_str(p->input, &p->tokens, node->main_token);
+    str_fprint(stdout, name);
+    str_destroy(name);
+    printf("(");
+    CallData cd = m->extra_data.items[node->data.lhs].data.call;
+    for (usz i = 0; i < cd.count; i++) {
+        print_node(p, m, &m->nodes.items[cd.items[i]]);
+        if (i + 1 < cd.count) {
+            printf(", ");
+        }
+    }
+    printf(")");
+}
+
+void print_return(Parser *p, Module *m, Node *node) {
+    printf("return ");
+    print_node(p, m, &m->nodes.items[node->data.rhs]);
+    printf("\n");
+}
+
 void print_variable_declaration(Parser *p, Module *m, Node *node) {
     str var_name = tokens_token_str(p->input, &p->tokens, node->main_token);
     str_fprint(stdout, var_name);
@@ -373,6 +808,53 @@ void print_variable_declaration(Parser *p, Module *m, Node *node) {
     printf("\n");
 }
 
+void print_assignment(Parser *p, Module *m, Node *node) {
+    str var_name = tokens_token_str(p->input, &p->tokens, node->main_token);
+    str_fprint(stdout, var_name);
+    str_destroy(var_name);
+    printf(" = ");
+    print_node(p, m, &m->nodes.items[node->data.rhs]);
+    printf("\n");
+}
+
+void print_block(Parser *p, Module *m, Node *node);
+
+void print_loop(Parser *p, Module *m, Node *node) {
+    LoopData ld = m->extra_data.items[node->data.lhs].data.loop;
+    for (usz i = 0; i < ld.hints.count; i++) {
+        str hint =
+            tokens_token_str(p->input, &p->tokens, ld.hints.items[i].name);
+        printf("#");
+        str_fprint(stdout, hint);
+        str_destroy(hint);
+        if (ld.hints.items[i].argument != 0) {
+            str argument = tokens_token_str(p->input, &p->tokens,
+                                            ld.hints.items[i].argument);
+            printf("(");
+            str_fprint(stdout, argument);
+            printf(")");
+            str_destroy(argument);
+        }
+        printf(" ");
+    }
+
+    if (node->type == NODE_TYPE_WHILE) {
+        printf("while ");
+        print_node(p, m, &m->nodes.items[ld.lhs]);
+    } else {
+        str name = tokens_token_str(p->input, &p->tokens, node->main_token);
+        printf("for ");
+        str_fprint(stdout, name);
+        str_destroy(name);
+        printf(" in ");
+        print_node(p, m, &m->nodes.items[ld.lhs]);
+        printf("..");
+        print_node(p, m, &m->nodes.items[ld.rhs]);
+    }
+    printf(" ");
+    print_block(p, m, &m->nodes.items[node->data.rhs]);
+}
+
 void print_block(Parser *p, Module *m, Node *node) {
     printf("{\n");
     BlockData bd = m->extra_data.items[node->data.lhs].data.block;
@@ -387,6 +869,15 @@ void print_function_definition(Parser *p, Module *m, Node *node) {
     FunctionPrototypeData fpd =
         m->extra_data.items[node->data.lhs].data.function_prototype;
 
+    for (usz i = 0; i < fpd.attributes.count; i++) {
+        str attribute =
+            tokens_token_str(p->input, &p->tokens, fpd.attributes.items[i]);
+        printf("@");
+        str_fprint(stdout, attribute);
+        printf(" ");
+        str_destroy(attribute);
+    }
+
     str name = tokens_token_str(p->input, &p->tokens, node->main_token);
     printf("fn ");
     str_fprint(stdout, name);
@@ -424,9 +915,33 @@ void print_node(Parser *p, Module *m, Node *node) {
         case NODE_TYPE_VARIABLE_DECLARATION:
             print_variable_declaration(p, m, node);
             break;
+        case NODE_TYPE_COMPTIME_DECLARATION:
+            printf("comptime ");
+            print_variable_declaration(p, m, node);
+            break;
         case NODE_TYPE_INTEGER_LITERAL:
+        case NODE_TYPE_FLOAT_LITERAL:
             print_integer(p, m, node);
             break;
+        case NODE_TYPE_IDENTIFIER:
+            print_identifier(p, m, node);
+            break;
+        case NODE_TYPE_BINARY_OPERATION:
+            print_binary_operation(p, m, node);
+            break;
+        case NODE_TYPE_CALL:
+            print_call(p, m, node);
+            break;
+        case NODE_TYPE_ASSIGNMENT:
+            print_assignment(p, m, node);
+            break;
+        case NODE_TYPE_WHILE:
+        case NODE_TYPE_FOR:
+            print_loop(p, m, node);
+            break;
+        case NODE_TYPE_RETURN:
+            print_return(p, m, node);
+            break;
 
         case NODE_TYPE_BLOCK:
             print_block(p, m, node);
@@ -434,6 +949,11 @@ void print_node(Parser *p, Module *m, Node *node) {
         case NODE_TYPE_FUNCTION_DEFINITION:
             print_function_definition(p, m, node);
             break;
+        case NODE_TYPE_IMPORT:
+            printf("import ");
+            print_identifier(p, m, node);
+            printf("\n");
+            break;
         case NODE_TYPE_EOF:
             printf("<EOF>\n");
             break;
@@ -476,6 +996,13 @@ str parse_error_str(ParseResultType type, ParseErrors errors) {
                               "identifier, expected identifier or ')'",
                               token_type_str(errors.invalid_token.token.type),
                               errors.invalid_token.token.pos);
+        case PARSE_RESULT_TYPE_EXPECTED_LOOP:
+            return str_format("token %s at %zu is not valid after loop hints, "
+                              "expected for or while",
+                              token_type_str(errors.invalid_token.token.type),
+                              errors.invalid_token.token.pos);
+        case PARSE_RESULT_TYPE_INTEGER_OUT_OF_RANGE:
+            return to_str("integer literal out of range");
     }
 
     return to_str("INVALID RESULT TYPE");
@@ -18,6 +18,12 @@ enum ParseResultType {
     // Expected a RPAREN or an identifier, instead found a invalid token. The
     // invalid token ist saved in invalid token.
     PARSE_RESULT_TYPE_EXPECTED_FUNCTION_ARGUMENT_LIST,
+    // Loop hints are not followed by for or while, the invalid token is saved
+    // in invalid token.
+    PARSE_RESULT_TYPE_EXPECTED_LOOP,
+    // An integer literal does not fit into 64 bits, the literal is saved in
+    // invalid token.
+    PARSE_RESULT_TYPE_INTEGER_OUT_OF_RANGE,
 };
 typedef enum ParseResultType        ParseResultType;
 
@@ -90,4 +96,6 @@ ParseModuleResult parser_parse_module(Parser *p);
 void              parser_destroy(Parser p);
 
 void              module_destroy(Module m);
+// True if the module has no module declaration.
+bool              module_is_main(Module const *m);
 void              print_module(Parser *p, Module *m);
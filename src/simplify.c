@@ -0,0 +1,373 @@
+#include "simplify.h"
+#include <assert.h>
+#include <stdlib.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "da.h"
+#include "flat_pass.h"
+#include "language.h"
+#include "lexer.h"
+#include "node_column.h"
+
+NODE_COLUMN(bool, Removed)
+
+typedef struct Simplify Simplify;
+struct Simplify {
+    Module           *m;
+    ModuleAnalyse    *ma;
+    Tokens           *t;
+    NodeColumnRemoved removed;
+    // The amount of identifiers and assignments referring to a symbol,
+    // indexed by symbol id
+    usz              *uses;
+    // Whether a symbol is assigned anywhere, indexed by symbol id
+    bool             *assigned;
+    SimplifyStats     stats;
+};
+
+void simplify_remove_subtree(Simplify *s, Index node) {
+    for (Index i = flat_subtree_begin(s->m, node); i <= node; i++) {
+        node_column_set(&s->removed, i, true);
+    }
+}
+
+u64 simplify_integer(Simplify *s, Index node) {
+    Node *n = &s->m->nodes.items[node];
+    assert(n->type == NODE_TYPE_INTEGER_LITERAL);
+    return extra_data_integer(s->t, s->t->tokens[n->main_token].extra_data);
+}
+
+// Turns node into an integer literal, the new token covers pos..pos+len of the
+// source.
+void simplify_make_integer(Simplify *s, Index node, usz pos, usz len,
+                           u64 integer) {
+    Index token = tokens_insert_integer(s->t, pos, len, integer);
+    s->m->nodes.items[node] = (Node){
+        .type       = NODE_TYPE_INTEGER_LITERAL,
+        .main_token = token,
+        .data       = {0},
+    };
+    node_column_set(&s->ma->attributes.symbol, node, ANALYSE_INDEX_NONE);
+}
+
+// Values wrap like the integer arithmetic of the generated code, the literal
+// keeps the bits of the value, also for signed types.
+bool simplify_fold(Simplify *s, Index node) {
+    Node *n    = &s->m->nodes.items[node];
+    Node *lhs  = &s->m->nodes.items[n->data.lhs];
+    Node *rhs  = &s->m->nodes.items[n->data.rhs];
+    Type  type = node_column_get(&s->ma->attributes.type, node);
+    if (lhs->type != NODE_TYPE_INTEGER_LITERAL ||
+        rhs->type != NODE_TYPE_INTEGER_LITERAL || !type_is_integer(type) ||
+        type_is_vector(type)) {
+        return false;
+    }
+
+    u64 a = simplify_integer(s, n->data.lhs);
+    u64 b = simplify_integer(s, n->data.rhs);
+    u64 value;
+    switch (s->t->tokens[n->main_token].type) {
+        case TOKEN_TYPE_PLUS:
+            value = a + b;
+            break;
+        case TOKEN_TYPE_MINUS:
+            value = a - b;
+            break;
+        case TOKEN_TYPE_ASTERISK:
+            value = a * b;
+            break;
+        default:
+            return false;
+    }
+
+    // The operands are leaves, so the source range of the operation goes from
+    // the lhs token to the end of the rhs token.
+    Token *first = &s->t->tokens[lhs->main_token];
+    Token *last  = &s->t->tokens[rhs->main_token];
+    usz    pos   = first->pos;
+    usz    len   = last->pos + last->len - pos;
+    simplify_remove_subtree(s, n->data.lhs);
+    simplify_remove_subtree(s, n->data.rhs);
+    u32 bits = type_bits(type);
+    if (bits < 64) {
+        value &= (1ull << bits) - 1;
+    }
+    simplify_make_integer(s, node, pos, len, value);
+    return true;
+}
+
+// Scalar integer comptime values are used directly, the others stay loads of
+// their constant global.
+bool simplify_propagate_comptime(Simplify *s, Index node, Index symbol_id) {
+    AnalyseComptime *comptime = analyse_find_comptime(s->ma, symbol_id);
+    if (!type_is_integer(comptime->value.type) ||
+        type_is_vector(comptime->value.type)) {
+        return false;
+    }
+
+    Token *token = &s->t->tokens[s->m->nodes.items[node].main_token];
+    simplify_make_integer(s, node, token->pos, token->len,
+                          comptime->value.lanes[0].integer);
+    return true;
+}
+
+// A variable that is never assigned after its declaration always has the
+// value of its literal expression. Loops run their body more than once, so
+// one assignment anywhere makes the value unknown at every use.
+bool simplify_propagate(Simplify *s, Index node) {
+    Index          symbol_id = node_column_get(&s->ma->attributes.symbol, node);
+    AnalyseSymbol *symbol    = &s->ma->symbols.items[symbol_id];
+    if (symbol->kind == ANALYSE_SYMBOL_KIND_COMPTIME) {
+        return simplify_propagate_comptime(s, node, symbol_id);
+    }
+    if (symbol->kind != ANALYSE_SYMBOL_KIND_VARIABLE ||
+        s->assigned[symbol_id]) {
+        return false;
+    }
+
+    // The declaration is before the identifier, so its expression was already
+    // folded.
+    // A literal that is converted, like a splat into a vector, has a
+    // different type than the variable.
+    Index expression = s->m->nodes.items[symbol->node].data.rhs;
+    if (s->m->nodes.items[expression].type != NODE_TYPE_INTEGER_LITERAL ||
+        node_column_get(&s->ma->attributes.converted, expression).type !=
+            BUILTIN_TYPE_NONE) {
+        return false;
+    }
+
+    Token *token = &s->t->tokens[s->m->nodes.items[node].main_token];
+    simplify_make_integer(s, node, token->pos, token->len,
+                          simplify_integer(s, expression));
+    return true;
+}
+
+// Removes every statement after the first return of a block.
+void simplify_remove_unreachable(Simplify *s, Node *block) {
+    BlockData *bd       = &s->m->extra_data.items[block->data.lhs].data.block;
+    bool       returned = false;
+    for (usz i = 0; i < bd->count; i++) {
+        if (returned) {
+            simplify_remove_subtree(s, bd->items[i]);
+        } else if (s->m->nodes.items[bd->items[i]].type == NODE_TYPE_RETURN) {
+            returned = true;
+        }
+    }
+}
+
+bool simplify_has_side_effects(Simplify *s, Index node) {
+    for (Index i = flat_subtree_begin(s->m, node); i <= node; i++) {
+        switch (s->m->nodes.items[i].type) {
+            case NODE_TYPE_INTEGER_LITERAL:
+            case NODE_TYPE_FLOAT_LITERAL:
+            case NODE_TYPE_IDENTIFIER:
+            case NODE_TYPE_BINARY_OPERATION:
+                break;
+            default:
+                return true;
+        }
+    }
+    return false;
+}
+
+// Removes the variable and all the uses in its expression, so variables only
+// used by it become unused too.
+void simplify_remove_variable(Simplify *s, Index node) {
+    for (Index i = flat_subtree_begin(s->m, node); i <= node; i++) {
+        if (s->m->nodes.items[i].type == NODE_TYPE_IDENTIFIER &&
+            !node_column_get(&s->removed, i)) {
+            s->uses[node_column_get(&s->ma->attributes.symbol, i)] -= 1;
+        }
+    }
+    simplify_remove_subtree(s, node);
+}
+
+Index simplify_remap(Index *map, Index node) {
+    return node == ANALYSE_INDEX_NONE ? node : map[node];
+}
+
+// Moves the remaining nodes to the front of Module.nodes. The order of the
+// nodes does not change, and only whole subtrees were removed, so the
+// ordering invariants of Module still hold.
+void simplify_compact(Simplify *s) {
+    Module         *m          = s->m;
+    NodeAttributes *attributes = &s->ma->attributes;
+    Index          *map        = malloc(sizeof(Index) * m->nodes.count);
+
+    Index count = 0;
+    for (Index i = 0; i < m->nodes.count; i++) {
+        map[i] = node_column_get(&s->removed, i) ? ANALYSE_INDEX_NONE : count++;
+    }
+
+    for (Index i = 0; i < m->nodes.count; i++) {
+        if (map[i] == ANALYSE_INDEX_NONE) {
+            continue;
+        }
+
+        Node node = m->nodes.items[i];
+        switch (node.type) {
+            case NODE_TYPE_BLOCK: {
+                BlockData *bd   = &m->extra_data.items[node.data.lhs].data.block;
+                usz        kept = 0;
+                for (usz c = 0; c < bd->count; c++) {
+                    if (map[bd->items[c]] != ANALYSE_INDEX_NONE) {
+                        bd->items[kept++] = map[bd->items[c]];
+                    }
+                }
+                bd->count = kept;
+                break;
+            }
+            case NODE_TYPE_BINARY_OPERATION:
+                node.data.lhs = map[node.data.lhs];
+                node.data.rhs = map[node.data.rhs];
+                break;
+            case NODE_TYPE_CALL: {
+                // Arguments are never removed on their own.
+                CallData *cd = &m->extra_data.items[node.data.lhs].data.call;
+                for (usz c = 0; c < cd->count; c++) {
+                    cd->items[c] = map[cd->items[c]];
+                }
+                break;
+            }
+            case NODE_TYPE_WHILE:
+            case NODE_TYPE_FOR: {
+                // The operands are never removed on their own.
+                LoopData *ld = &m->extra_data.items[node.data.lhs].data.loop;
+                ld->lhs      = map[ld->lhs];
+                if (node.type == NODE_TYPE_FOR) {
+                    ld->rhs = map[ld->rhs];
+                }
+                node.data.rhs = map[node.data.rhs];
+                break;
+            }
+            case NODE_TYPE_FUNCTION_DEFINITION:
+            case NODE_TYPE_VARIABLE_DECLARATION:
+            case NODE_TYPE_COMPTIME_DECLARATION:
+            case NODE_TYPE_ASSIGNMENT:
+            case NODE_TYPE_RETURN:
+                node.data.rhs = map[node.data.rhs];
+                break;
+            case NODE_TYPE_INTEGER_LITERAL:
+            case NODE_TYPE_FLOAT_LITERAL:
+            case NODE_TYPE_IDENTIFIER:
+            case NODE_TYPE_IMPORT:
+            case NODE_TYPE_EOF:
+                break;
+        }
+
+        // map[i] <= i, so nothing that is still needed is overwritten.
+        m->nodes.items[map[i]] = node;
+        node_column_set(&attributes->scope, map[i],
+                        node_column_get(&attributes->scope, i));
+        node_column_set(&attributes->type, map[i],
+                        node_column_get(&attributes->type, i));
+        node_column_set(&attributes->converted, map[i],
+                        node_column_get(&attributes->converted, i));
+        node_column_set(&attributes->symbol, map[i],
+                        node_column_get(&attributes->symbol, i));
+    }
+
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        m->top_level_nodes.items[i] = map[m->top_level_nodes.items[i]];
+    }
+
+    for (usz i = 0; i < s->ma->symbols.count; i++) {
+        AnalyseSymbol *symbol = &s->ma->symbols.items[i];
+        symbol->node          = simplify_remap(map, symbol->node);
+    }
+
+    for (usz i = 0; i < s->ma->comptimes.count; i++) {
+        AnalyseComptime *comptime = &s->ma->comptimes.items[i];
+        comptime->node            = simplify_remap(map, comptime->node);
+    }
+
+    for (usz i = 0; i < s->ma->scopes.count; i++) {
+        AnalyseScope *scope = &s->ma->scopes.items[i];
+        // The top level scope uses node 0 without a node.
+        if (scope->type != ANALYSE_SCOPE_TYPE_TOP_LEVEL) {
+            scope->node = simplify_remap(map, scope->node);
+        }
+        AnalyseFunction *function, *function_tmp;
+        HASH_ITER(hh, scope->functions, function, function_tmp) {
+            function->node = simplify_remap(map, function->node);
+        }
+    }
+
+    s->stats.removed         = m->nodes.count - count;
+    m->nodes.count           = count;
+    attributes->scope.count     = count;
+    attributes->type.count      = count;
+    attributes->converted.count = count;
+    attributes->symbol.count    = count;
+    free(map);
+}
+
+SimplifyStats simplify_module(Module *m, ModuleAnalyse *ma, Tokens *t) {
+    assert(ma->errors.count == 0 &&
+           "simplify requires a module without analyse errors");
+    Simplify s = {
+        .m        = m,
+        .ma       = ma,
+        .t        = t,
+        .uses     = calloc(ma->symbols.count, sizeof(usz)),
+        .assigned = calloc(ma->symbols.count, sizeof(bool)),
+    };
+    node_column_init(&s.removed, m->nodes.count, false);
+
+    for (Index i = 0; i < m->nodes.count; i++) {
+        if (m->nodes.items[i].type == NODE_TYPE_ASSIGNMENT) {
+            s.assigned[node_column_get(&ma->attributes.symbol, i)] = true;
+        }
+    }
+
+    // Children come before their parents, so one forward sweep folds whole
+    // expression trees and sees the folded value of every variable before its
+    // first use.
+    for (Index i = 0; i < m->nodes.count; i++) {
+        switch (m->nodes.items[i].type) {
+            case NODE_TYPE_BINARY_OPERATION:
+                s.stats.folded += simplify_fold(&s, i);
+                break;
+            case NODE_TYPE_IDENTIFIER:
+                s.stats.propagated += simplify_propagate(&s, i);
+                break;
+            case NODE_TYPE_BLOCK:
+                simplify_remove_unreachable(&s, &m->nodes.items[i]);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // An assigned variable is kept, so its assignments stay valid.
+    for (Index i = 0; i < m->nodes.count; i++) {
+        NodeType type = m->nodes.items[i].type;
+        if ((type == NODE_TYPE_IDENTIFIER || type == NODE_TYPE_ASSIGNMENT) &&
+            !node_column_get(&s.removed, i)) {
+            s.uses[node_column_get(&ma->attributes.symbol, i)] += 1;
+        }
+    }
+
+    // Every use of a variable comes after its declaration, so sweeping
+    // backwards removes a variable only after all its users were decided.
+    for (Index i = m->nodes.count; i > 0; i--) {
+        Index node = i - 1;
+        if (m->nodes.items[node].type != NODE_TYPE_VARIABLE_DECLARATION ||
+            node_column_get(&s.removed, node)) {
+            continue;
+        }
+        Index symbol = node_column_get(&ma->attributes.symbol, node);
+        if (s.uses[symbol] == 0 &&
+            !simplify_has_side_effects(&s, m->nodes.items[node].data.rhs)) {
+            simplify_remove_variable(&s, node);
+        }
+    }
+
+    simplify_compact(&s);
+
+    node_column_destroy(&s.removed);
+    free(s.uses);
+    free(s.assigned);
+    return s.stats;
+}
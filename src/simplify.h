@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "lexer.h"
+
+// ================
+// -- simplify --
+// AST level simplification between analyse_module and codegen:
+//
+// - binary operations on integer literals are folded into a literal
+// - identifiers of variables with a literal value and of scalar integer
+//   comptime declarations are replaced by the value
+// - unused variables with a side effect free expression are removed
+// - statements after a return are removed
+//
+// The nodes are rewritten in place, afterwards Module.nodes is compacted. The
+// node columns and all node Indexes of the analyse are updated, so the analyse
+// stays valid for codegen.
+// ================
+
+typedef struct SimplifyStats SimplifyStats;
+struct SimplifyStats {
+    // Binary operations replaced by a literal
+    usz folded;
+    // Identifiers replaced by the value of their variable
+    usz propagated;
+    // Nodes removed from Module.nodes
+    usz removed;
+};
+
+// The analyse may not contain errors. Folded values get new integer tokens, so
+// t has to be the tokens of the module.
+SimplifyStats simplify_module(Module *m, ModuleAnalyse *ma, Tokens *t);
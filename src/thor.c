@@ -1,11 +1,1174 @@
+// open_memstream, clock_gettime
+#define _POSIX_C_SOURCE 200809L
+#include <llvm-c/Core.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bytecode/bytecode.h"
+#include "bytecode/interp.h"
+#include "build.h"
+#include "code_analyse.h"
 #include "common.h"
+#include "daemon.h"
+#include "da.h"
+#include "interface.h"
+#include "lexer.h"
+#include "llvm/cache.h"
+#include "llvm/codegen.h"
+#include "llvm/emit.h"
+#include "llvm/jit.h"
+#include "llvm/lto.h"
+#include "parser.h"
+#include "simplify.h"
+#include "watch.h"
+
+typedef struct Options Options;
+struct Options {
+    struct {
+        usz          count;
+        usz          capacity;
+        char const **items;
+    } inputs;
+    // The first input, the only one with --run or --interp
+    char const     *input;
+    // Inputs compiled in parallel, 0 for one per core
+    usz             jobs;
+    // NULL for stdout
+    char const     *output;
+    CodeGenOptLevel opt_level;
+    // Runs main in the JIT instead of printing the IR
+    bool            run;
+    // Runs main in the bytecode interpreter, without LLVM
+    bool            interp;
+    // Emits an object or assembly file instead of the IR
+    bool            emit;
+    EmitFileType    emit_type;
+    EmitOptions     emit_options;
+    // Amount of shards generated in parallel, 0 for one per core
+    usz             codegen_units;
+    // Skips the AST simplification before codegen
+    bool            no_simplify;
+    // Directory of the bitcode cache, NULL for no cache
+    char const     *cache_dir;
+    // Whole program optimisation over the codegen units with --lto=thin
+    bool            thin_lto;
+    bool            help;
+    // The socket to serve compile requests on, NULL if not a daemon
+    char const     *daemon;
+    // The socket of the daemon that runs the other arguments, NULL to compile
+    // in this process
+    char const     *connect;
+    // Stops the daemon on connect
+    bool            stop;
+    // Searched for the interfaces of imports after the directory of the input
+    struct {
+        usz          count;
+        usz          capacity;
+        char const **items;
+    } interface_dirs;
+    // Only writes the interface of the module
+    bool            interface_only;
+    // Compiles the inputs and the modules they import, but only the modules
+    // that changed since the last build
+    bool            build;
+    // Compiles again whenever a source changes, until the process is stopped
+    bool            watch;
+};
+
+// What outlives a compilation, the daemon keeps it between requests.
+typedef struct Session Session;
+struct Session {
+    // The open bitcode caches, their directories are absolute
+    struct {
+        usz            count;
+        usz            capacity;
+        BitcodeCache **items;
+    } caches;
+    // The cache of --watch without --cache, it only lives in memory
+    BitcodeCache *memory_cache;
+};
+
+// One input file on its way through the compilation stages.
+typedef struct Compilation Compilation;
+struct Compilation {
+    Options      *options;
+    char const   *input;
+    // NULL without --cache
+    BitcodeCache *cache;
+    // Where the output and the errors of the compilation go
+    FILE         *out;
+    FILE         *err;
+    str           source;
+    Tokens        tokens;
+    Parser        parser;
+    Module        module;
+    // The interfaces of the imported modules, only until the analyse
+    ModuleInterfaces imports;
+    ModuleAnalyse analyse;
+    // The exit code
+    int           result;
+};
+
+void usage(FILE *file, char const *program) {
+    fprintf(file,
+            "usage: %s [options] <file>...\n"
+            "options:\n"
+            "  -O0, -O1, -O2, -O3  optimization level, default is -O0\n"
+            "  -o <file>           write the output to file, the IR is written to\n"
+            "                      stdout and objects next to the input by default\n"
+            "  -j <n>              compile n input files in parallel, 0 shares\n"
+            "                      one worker per core with analyse and\n"
+            "                      codegen, the default\n"
+            "  -c                  emit an object file, and the interface of a\n"
+            "                      module declared with `module name` as\n"
+            "                      name.thi next to it\n"
+            "  -S                  emit an assembly file\n"
+            "  -I <dir>            search the interfaces of imported modules in\n"
+            "                      dir, after the directory of the input\n"
+            "  --interface         only write the interface name.thi of the\n"
+            "                      module, next to the input or into the\n"
+            "                      directory of -o\n"
+            "  --build             compile the inputs and the modules they\n"
+            "                      import from name.th next to them into\n"
+            "                      objects, skips the modules whose source\n"
+            "                      and imported interfaces did not change\n"
+            "  -march=<cpu>        target cpu, native for the cpu of the host\n"
+            "  -fPIC, -fno-pic     emit position independent code, default is -fPIC\n"
+            "  -mcmodel=<model>    code model: small, kernel, medium or large\n"
+            "  --codegen-units <n> generate code in n shards in parallel, 0 for one\n"
+            "                      per core, -c and -S emit one file per shard\n"
+            "  --lto=thin          optimise the codegen units with imports of\n"
+            "                      small functions across units, one unit per\n"
+            "                      core by default\n"
+            "  --cache <dir>       reuse the optimised bitcode of unchanged\n"
+            "                      functions from dir\n"
+            "  --no-simplify       skip the constant folding and dead code\n"
+            "                      elimination on the AST\n"
+            "  --run               run main in process with the JIT, the\n"
+            "                      result of main is the exit code\n"
+            "  --interp            run main in the bytecode interpreter, starts\n"
+            "                      faster than --run but runs slower\n"
+            "  --watch             compile again whenever a source next to an\n"
+            "                      input or an interface in a -I directory\n"
+            "                      changes, the bitcode of unchanged functions\n"
+            "                      is kept in memory\n"
+            "  --daemon <socket>   serve compile requests on the unix socket,\n"
+            "                      the daemon keeps LLVM and the bitcode caches\n"
+            "                      warm between requests\n"
+            "  --connect <socket>  let the daemon on socket compile with the\n"
+            "                      other options, in the current directory,\n"
+            "                      but not --run or --interp\n"
+            "  --stop              stop the daemon given by --connect\n"
+            "  -h, --help          show this help\n",
+            program);
+}
+
+bool parse_code_model(char const *name, LLVMCodeModel *out) {
+    if (strcmp(name, "small") == 0) {
+        *out = LLVMCodeModelSmall;
+    } else if (strcmp(name, "kernel") == 0) {
+        *out = LLVMCodeModelKernel;
+    } else if (strcmp(name, "medium") == 0) {
+        *out = LLVMCodeModelMedium;
+    } else if (strcmp(name, "large") == 0) {
+        *out = LLVMCodeModelLarge;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_options(int argc, char **argv, Options *out) {
+    *out = (Options){.opt_level     = CODE_GEN_OPT_LEVEL_O0,
+                     .emit_options  = emit_options_default(),
+                     .codegen_units = 1};
+    bool codegen_units_given = false;
+
+    for (int i = 1; i < argc; i++) {
+        char const *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            out->help = true;
+            return true;
+        } else if (strcmp(arg, "-O0") == 0) {
+            out->opt_level = CODE_GEN_OPT_LEVEL_O0;
+        } else if (strcmp(arg, "-O1") == 0) {
+            out->opt_level = CODE_GEN_OPT_LEVEL_O1;
+        } else if (strcmp(arg, "-O2") == 0) {
+            out->opt_level = CODE_GEN_OPT_LEVEL_O2;
+        } else if (strcmp(arg, "-O3") == 0) {
+            out->opt_level = CODE_GEN_OPT_LEVEL_O3;
+        } else if (strcmp(arg, "-c") == 0) {
+            out->emit      = true;
+            out->emit_type = EMIT_FILE_TYPE_OBJECT;
+        } else if (strcmp(arg, "-S") == 0) {
+            out->emit      = true;
+            out->emit_type = EMIT_FILE_TYPE_ASSEMBLY;
+        } else if (strncmp(arg, "-march=", 7) == 0) {
+            out->emit_options.cpu = arg + 7;
+        } else if (strcmp(arg, "-fPIC") == 0) {
+            out->emit_options.reloc = LLVMRelocPIC;
+        } else if (strcmp(arg, "-fno-pic") == 0) {
+            out->emit_options.reloc = LLVMRelocStatic;
+        } else if (strncmp(arg, "-mcmodel=", 9) == 0) {
+            if (!parse_code_model(arg + 9, &out->emit_options.code_model)) {
+                log_error("unknown code model %s", arg + 9);
+                return false;
+            }
+        } else if (strncmp(arg, "-j", 2) == 0) {
+            char const *jobs = arg[2] != '\0' ? arg + 2
+                             : i + 1 < argc   ? argv[++i]
+                                              : NULL;
+            char       *end  = NULL;
+            if (jobs != NULL) {
+                out->jobs = strtoull(jobs, &end, 10);
+            }
+            if (end == NULL || *end != '\0' || end == jobs) {
+                log_error("-j expects a number");
+                return false;
+            }
+        } else if (strcmp(arg, "--codegen-units") == 0) {
+            char *end = NULL;
+            if (i + 1 < argc) {
+                out->codegen_units = strtoull(argv[++i], &end, 10);
+            }
+            if (end == NULL || *end != '\0' || end == argv[i]) {
+                log_error("--codegen-units expects a number");
+                return false;
+            }
+            codegen_units_given = true;
+        } else if (strncmp(arg, "--lto=", 6) == 0) {
+            if (strcmp(arg + 6, "thin") != 0) {
+                log_error("unknown lto mode %s, only thin is supported",
+                          arg + 6);
+                return false;
+            }
+            out->thin_lto = true;
+        } else if (strcmp(arg, "--cache") == 0) {
+            if (i + 1 >= argc) {
+                log_error("--cache expects a directory");
+                return false;
+            }
+            out->cache_dir = argv[++i];
+        } else if (strcmp(arg, "--no-simplify") == 0) {
+            out->no_simplify = true;
+        } else if (strcmp(arg, "--run") == 0) {
+            out->run = true;
+        } else if (strcmp(arg, "--interp") == 0) {
+            out->interp = true;
+        } else if (strcmp(arg, "--daemon") == 0) {
+            if (i + 1 >= argc) {
+                log_error("--daemon expects a socket");
+                return false;
+            }
+            out->daemon = argv[++i];
+        } else if (strcmp(arg, "--connect") == 0) {
+            if (i + 1 >= argc) {
+                log_error("--connect expects a socket");
+                return false;
+            }
+            out->connect = argv[++i];
+        } else if (strcmp(arg, "--stop") == 0) {
+            out->stop = true;
+        } else if (strcmp(arg, "-I") == 0) {
+            if (i + 1 >= argc) {
+                log_error("-I expects a directory");
+                return false;
+            }
+            da_append(&out->interface_dirs, argv[++i]);
+        } else if (strcmp(arg, "--interface") == 0) {
+            out->interface_only = true;
+        } else if (strcmp(arg, "--build") == 0) {
+            out->build = true;
+        } else if (strcmp(arg, "--watch") == 0) {
+            out->watch = true;
+        } else if (strcmp(arg, "-o") == 0) {
+            if (i + 1 >= argc) {
+                log_error("-o expects a file");
+                return false;
+            }
+            out->output = argv[++i];
+        } else if (arg[0] == '-') {
+            log_error("unknown option %s", arg);
+            return false;
+        } else {
+            da_append(&out->inputs, arg);
+        }
+    }
+
+    if (out->stop && out->connect == NULL) {
+        log_error("--stop needs the daemon given by --connect");
+        return false;
+    }
+    if (out->daemon != NULL &&
+        (out->connect != NULL || out->inputs.count > 0)) {
+        log_error("--daemon only takes the socket");
+        return false;
+    }
+    if (out->watch && (out->daemon != NULL || out->connect != NULL)) {
+        log_error("--watch can not be combined with --daemon or --connect");
+        return false;
+    }
+    // The program would run inside of the daemon, a crash or an endless loop
+    // of it would take the daemon down for every client.
+    if ((out->run || out->interp) && out->connect != NULL) {
+        log_error("--run and --interp can not be combined with --connect");
+        return false;
+    }
+    if (out->daemon != NULL || out->stop) {
+        return true;
+    }
+    if (out->inputs.count == 0) {
+        log_error("no input file");
+        return false;
+    }
+    out->input = out->inputs.items[0];
+    if (out->inputs.count > 1 && out->output != NULL) {
+        log_error("-o can not be combined with several input files");
+        return false;
+    }
+    if (out->inputs.count > 1 && (out->run || out->interp)) {
+        log_error("--run and --interp take one input file");
+        return false;
+    }
+    if (out->run && out->emit) {
+        log_error("--run can not be combined with -c or -S");
+        return false;
+    }
+    if (out->interp && (out->run || out->emit)) {
+        log_error("--interp can not be combined with --run, -c or -S");
+        return false;
+    }
+    if (out->interface_only && (out->run || out->interp || out->emit)) {
+        log_error("--interface can not be combined with --run, --interp, -c "
+                  "or -S");
+        return false;
+    }
+    if (out->build && (out->run || out->interp || out->interface_only ||
+                       out->output != NULL)) {
+        log_error("--build can not be combined with --run, --interp, "
+                  "--interface or -o");
+        return false;
+    }
+    if (out->build && (out->thin_lto || codegen_units_given)) {
+        log_error("--build compiles every module into one file, it can not be "
+                  "combined with --codegen-units or --lto=thin");
+        return false;
+    }
+    if (out->build && !out->emit) {
+        out->emit      = true;
+        out->emit_type = EMIT_FILE_TYPE_OBJECT;
+    }
+    if (out->thin_lto && out->cache_dir != NULL) {
+        log_error("--lto=thin can not be combined with --cache");
+        return false;
+    }
+    if (out->thin_lto && !codegen_units_given) {
+        out->codegen_units = 0;
+    }
+    out->emit_options.opt_level = out->opt_level;
+    return true;
+}
+
+void options_destroy(Options *options) {
+    da_destroy(&options->inputs);
+    da_destroy(&options->interface_dirs);
+}
+
+// --run and --interp call main as `fn main() u32`, a main with another
+// signature can not be called and is reported.
+bool main_signature_ok(ModuleAnalyse *ma) {
+    AnalyseFunction *main = analyse_find_function(ma, ma->root_scope, "main");
+    if (main == NULL || main->module != NULL) {
+        log_error("no main function to run");
+        return false;
+    }
+    if (main->argument_types.count != 0 ||
+        !type_equal(main->return_type, (Type){.type = BUILTIN_TYPE_U32})) {
+        log_error("main has to be `fn main() u32` to be run");
+        return false;
+    }
+    return true;
+}
+
+// Every function is generated and optimised in its own shard, the JIT only
+// compiles the shards of the functions that are called.
+int run(CodeGenerator *cg, CodeGenOptLevel level) {
+    if (!main_signature_ok(&cg->analyse)) {
+        return 1;
+    }
+
+    Module *m = &cg->thor_module;
+    struct {
+        usz    count;
+        usz    capacity;
+        Index *items;
+    } functions = {0};
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Index node = m->top_level_nodes.items[i];
+        if (m->nodes.items[node].type == NODE_TYPE_FUNCTION_DEFINITION) {
+            da_append(&functions, node);
+        }
+    }
+    CodeGenShards shards =
+        code_gen_function_shards(cg, functions.items, functions.count, level);
+    da_destroy(&functions);
+
+    Jit jit;
+    if (!code_gen_shards_ok(&shards) || !jit_create(&jit)) {
+        code_gen_shards_destroy(shards);
+        return 1;
+    }
+
+    int   result = 1;
+    void *main_address;
+    if (jit_add_shards(&jit, &shards) &&
+        jit_lookup(&jit, "main", &main_address)) {
+        u32 (*thor_main)(void) = (u32 (*)(void))(uptr)main_address;
+        result                 = thor_main();
+    }
+
+    jit_destroy(&jit);
+    code_gen_shards_destroy(shards);
+    return result;
+}
+
+int interp_run(Module *m, ModuleAnalyse *ma, Parser *p) {
+    if (!main_signature_ok(ma)) {
+        return 1;
+    }
+    BytecodeProgram program;
+    if (!bytecode_compile(m, ma, &p->tokens, p->input, &program)) {
+        return 1;
+    }
+
+    int   result = 1;
+    Index main   = bytecode_find_function(&program, "main");
+    if (main == BYTECODE_NO_FUNCTION) {
+        log_error("no main function to run");
+    } else {
+        // interp_call stores every lane of the return type.
+        Type          type  = program.functions.items[main].return_type;
+        BytecodeSlot *value = calloc(type_value_lanes(type),
+                                     sizeof(BytecodeSlot));
+        Interp        interp;
+        interp_create(&interp, &program);
+        if (interp_call(&interp, main, NULL, value)) {
+            result = (u32)value[0].u;
+        }
+        interp_destroy(&interp);
+        free(value);
+    }
+
+    bytecode_program_destroy(&program);
+    return result;
+}
+
+// Replaces the extension of the output or input, main.th becomes main.o or
+// main.<shard>.o if shard is not -1.
+str emit_output_path(Options *options, char const *input, isz shard) {
+    char const *ext  = options->emit_type == EMIT_FILE_TYPE_OBJECT ? "o" : "s";
+    char const *path = options->output != NULL ? options->output : input;
+    if (options->output != NULL && shard == -1) {
+        return str_format("%s", path);
+    }
+
+    char const *dot   = strrchr(path, '.');
+    char const *slash = strrchr(path, '/');
+    usz         len   = dot != NULL && (slash == NULL || dot > slash)
+                          ? (usz)(dot - path)
+                          : strlen(path);
+    if (shard == -1) {
+        return str_format("%.*s.%s", (int)len, path, ext);
+    }
+    return str_format("%.*s.%zd.%s", (int)len, path, shard, ext);
+}
+
+bool emit(LLVMModuleRef module, Options *options, char const *input,
+          isz shard) {
+    str   path_str = emit_output_path(options, input, shard);
+    char *path     = to_cstr(path_str);
+    str_destroy(path_str);
+
+    bool ok = emit_to_file(module, &options->emit_options, options->emit_type,
+                           path);
+    free(path);
+    return ok;
+}
+
+// Runs the pre link generation, the thin link and the backends. The backends
+// are linked into cg->module, unless every backend is emitted on its own.
+bool generate_thin_lto(CodeGenerator *cg, Options *options,
+                       LtoBackends *backends) {
+    LtoModules modules = {0};
+    if (!lto_modules_generate(cg, options->codegen_units, options->opt_level,
+                              &modules)) {
+        lto_modules_destroy(modules);
+        return false;
+    }
+
+    LtoIndex index = lto_thin_link(&modules, options->opt_level);
+    *backends      = lto_thin_backends(&modules, &index, options->opt_level);
+    lto_index_destroy(&index);
+    lto_modules_destroy(modules);
+
+    if (!lto_backends_ok(backends)) {
+        return false;
+    }
+    if (options->emit && backends->count > 1) {
+        return true;
+    }
+    return lto_link_backends(cg, backends);
+}
+
+// Opens the cache of dir once, later compilations of the session reuse it.
+BitcodeCache *session_cache(Session *session, char const *dir) {
+    char cwd[4096];
+    if (dir[0] != '/' && getcwd(cwd, sizeof(cwd)) == NULL) {
+        log_error("could not get the working directory");
+        return NULL;
+    }
+    str   path_str = dir[0] == '/' ? str_format("%s", dir)
+                                   : str_format("%s/%s", cwd, dir);
+    char *path     = to_cstr(path_str);
+    str_destroy(path_str);
+
+    for (usz i = 0; i < session->caches.count; i++) {
+        if (strcmp(session->caches.items[i]->dir, path) == 0) {
+            free(path);
+            return session->caches.items[i];
+        }
+    }
+
+    BitcodeCache *cache = malloc(sizeof(BitcodeCache));
+    if (cache == NULL || !bitcode_cache_open(cache, path)) {
+        free(cache);
+        free(path);
+        return NULL;
+    }
+    free(path);
+    da_append(&session->caches, cache);
+    return cache;
+}
+
+// The cache of every compilation of a watch that has no --cache.
+BitcodeCache *session_memory_cache(Session *session) {
+    if (session->memory_cache == NULL) {
+        BitcodeCache *cache = malloc(sizeof(BitcodeCache));
+        if (cache == NULL || !bitcode_cache_open(cache, NULL)) {
+            free(cache);
+            return NULL;
+        }
+        session->memory_cache = cache;
+    }
+    return session->memory_cache;
+}
+
+void session_destroy(Session *session) {
+    for (usz i = 0; i < session->caches.count; i++) {
+        bitcode_cache_close(session->caches.items[i]);
+        free(session->caches.items[i]);
+    }
+    da_destroy(&session->caches);
+    if (session->memory_cache != NULL) {
+        bitcode_cache_close(session->memory_cache);
+        free(session->memory_cache);
+    }
+}
+
+// Generates and optimises cg->module, with more than one codegen unit the
+// shards are linked into it, unless every shard is emitted on its own.
+bool generate(CodeGenerator *cg, Options *options, BitcodeCache *cache,
+              CodeGenShards *shards, LtoBackends *backends) {
+    if (options->thin_lto) {
+        return generate_thin_lto(cg, options, backends);
+    }
+    if (cache != NULL) {
+        BitcodeCacheStats stats;
+        return code_gen_cached(cg, cache, options->opt_level, &stats);
+    }
+    if (options->codegen_units == 1) {
+        return code_gen(cg) && code_gen_optimize(cg, options->opt_level);
+    }
+
+    *shards = code_gen_shards(cg, options->codegen_units, options->opt_level);
+    if (!code_gen_shards_ok(shards)) {
+        return false;
+    }
+    if (options->emit && shards->count > 1) {
+        return true;
+    }
+    return code_gen_link_shards(cg, shards);
+}
+
+void report_error(FILE *file, char const *path, str input, usz pos,
+                  str message) {
+    usz line = 1, column = 1;
+    for (usz i = 0; i < pos && i < input.len; i++) {
+        if (input.ptr[i] == '\n') {
+            line += 1;
+            column = 1;
+        } else {
+            column += 1;
+        }
+    }
+
+    fprintf(file, "%s:%zu:%zu: " ERROR "error: " RESET, path, line, column);
+    str_fprintln(file, message);
+}
+
+// The stages return false if the compilation ends with them, everything the
+// compilation owns is freed then.
+bool compilation_lex(Compilation *c) {
+    str input;
+    if (!read_file(c->input, &input)) {
+        log_error("could not read %s", c->input);
+        c->result = 1;
+        return false;
+    }
+
+    Lexer l = lexer_create(input, NULL);
+    str_destroy(input);
+    c->tokens = lexer_lex_tokens(&l);
+    c->source = str_clone(l.input);
+    lexer_destroy(l);
+    return true;
+}
+
+bool compilation_parse(Compilation *c) {
+    c->parser             = parser_create(c->tokens, c->source);
+    Parser           *p   = &c->parser;
+    ParseModuleResult mod = parser_parse_module(p);
+    if (mod.type != PARSE_RESULT_TYPE_OK) {
+        str   err   = parse_error_str(mod.type, mod.data.errors);
+        Index token = p->cur_token < p->tokens.len ? p->cur_token
+                                                   : p->tokens.len - 1;
+        report_error(c->err, c->input, p->input, p->tokens.tokens[token].pos,
+                     err);
+        str_destroy(err);
+        module_destroy(p->cur_module);
+        parser_destroy(*p);
+        c->result = 1;
+        return false;
+    }
+
+    c->module = mod.data.ok;
+    return true;
+}
+
+// Searches name.thi in the directory of the input and then in the -I
+// directories.
+bool find_interface(Compilation *c, str name, ModuleInterface *out) {
+    str   dir_str = path_directory(c->input);
+    char *dir     = to_cstr(dir_str);
+    str_destroy(dir_str);
+    char *path = interface_find(name, dir, c->options->interface_dirs.items,
+                                c->options->interface_dirs.count);
+    free(dir);
+    if (path == NULL) {
+        return false;
+    }
+
+    bool ok = interface_read(path, out);
+    if (ok && (strlen(out->name) != name.len ||
+               strncmp(out->name, name.ptr, name.len) != 0)) {
+        log_error("%s is the interface of the module %s", path, out->name);
+        module_interface_destroy(out);
+        ok = false;
+    }
+    free(path);
+    return ok;
+}
+
+// Reads the interfaces of the imported modules. The analyse reports the
+// imports without an interface.
+bool compilation_import(Compilation *c) {
+    Module *m = &c->module;
+    Parser *p = &c->parser;
+    for (usz i = 0; i < m->top_level_nodes.count; i++) {
+        Node *node = &m->nodes.items[m->top_level_nodes.items[i]];
+        if (node->type != NODE_TYPE_IMPORT) {
+            continue;
+        }
+        str             name = tokens_token_str(p->input, &p->tokens,
+                                                node->main_token);
+        ModuleInterface interface;
+        if (find_interface(c, name, &interface)) {
+            da_append(&c->imports, interface);
+        }
+        str_destroy(name);
+    }
+    return true;
+}
+
+bool compilation_analyse(Compilation *c) {
+    Module *m  = &c->module;
+    Parser *p  = &c->parser;
+    c->analyse = analyse_module_with_imports(m, &p->tokens, p->input,
+                                             &c->imports, 0);
+    module_interfaces_destroy(&c->imports);
+    if (c->analyse.errors.count > 0) {
+        for (usz i = 0; i < c->analyse.errors.count; i++) {
+            AnalyseError error   = c->analyse.errors.items[i];
+            Index        token   = m->nodes.items[error.node].main_token;
+            str          message = to_str(analyse_error_type_str(error.type));
+            report_error(c->err, c->input, p->input,
+                         p->tokens.tokens[token].pos, message);
+            str_destroy(message);
+        }
+        free_module_analyse(&c->analyse);
+        module_destroy(*m);
+        parser_destroy(*p);
+        c->result = 1;
+        return false;
+    }
+
+    if (!c->options->no_simplify) {
+        simplify_module(m, &c->analyse, &p->tokens);
+    }
+    return true;
+}
+
+// --interface -o writes to the output, otherwise name.thi is written next to
+// the output or the input.
+str interface_output_path(Options *options, char const *input, str name) {
+    if (options->interface_only && options->output != NULL) {
+        return str_format("%s", options->output);
+    }
+    str dir  = path_directory(options->output != NULL ? options->output
+                                                      : input);
+    str path = str_format("%.*s/%.*s.%s", (int)dir.len, dir.ptr,
+                          (int)name.len, name.ptr, INTERFACE_EXTENSION);
+    str_destroy(dir);
+    return path;
+}
+
+// -c and -S write the interface of a module with a module declaration,
+// --interface only writes the interface.
+bool compilation_interface(Compilation *c) {
+    Options *options = c->options;
+    if (!options->interface_only &&
+        !(options->emit && !module_is_main(&c->module))) {
+        return true;
+    }
+
+    ModuleInterface interface = analyse_module_interface(&c->module,
+                                                         &c->analyse);
+    str   path_str = interface_output_path(options, c->input, c->module.name);
+    char *path     = to_cstr(path_str);
+    str_destroy(path_str);
+    bool ok = interface_write(&interface, path);
+    free(path);
+    module_interface_destroy(&interface);
+    if (ok && !options->interface_only) {
+        return true;
+    }
+
+    c->result = ok ? 0 : 1;
+    free_module_analyse(&c->analyse);
+    module_destroy(c->module);
+    parser_destroy(c->parser);
+    return false;
+}
+
+bool compilation_generate(Compilation *c) {
+    Options *options = c->options;
+    if (options->interp) {
+        c->result = interp_run(&c->module, &c->analyse, &c->parser);
+        free_module_analyse(&c->analyse);
+        module_destroy(c->module);
+        parser_destroy(c->parser);
+        return c->result == 0;
+    }
+
+    CodeGenerator cg       = code_gen_create(c->parser, c->module, c->analyse);
+    cg.target              = &options->emit_options;
+    CodeGenShards shards   = {0};
+    LtoBackends   backends = {0};
+    if (options->run) {
+        c->result = run(&cg, options->opt_level);
+    } else if (!generate(&cg, options, c->cache, &shards, &backends)) {
+        c->result = 1;
+    } else if (options->emit && shards.count > 1) {
+        for (usz i = 0; i < shards.count; i++) {
+            if (!emit(shards.items[i].cg.module, options, c->input, i)) {
+                c->result = 1;
+            }
+        }
+    } else if (options->emit && backends.count > 1) {
+        for (usz i = 0; i < backends.count; i++) {
+            if (!emit(backends.items[i].module, options, c->input, i)) {
+                c->result = 1;
+            }
+        }
+    } else if (options->emit) {
+        c->result = emit(cg.module, options, c->input, -1) ? 0 : 1;
+    } else if (options->output != NULL) {
+        char *message = NULL;
+        if (LLVMPrintModuleToFile(cg.module, options->output, &message)) {
+            log_error("could not write %s: %s", options->output, message);
+            c->result = 1;
+        }
+        LLVMDisposeMessage(message);
+    } else {
+        char *ir = LLVMPrintModuleToString(cg.module);
+        fputs(ir, c->out);
+        LLVMDisposeMessage(ir);
+    }
+
+    lto_backends_destroy(backends);
+    code_gen_shards_destroy(shards);
+    code_gen_destroy(cg);
+    return c->result == 0;
+}
+
+typedef bool (*CompilationStage)(Compilation *c);
+
+static CompilationStage const compilation_stages[] = {
+    compilation_lex,
+    compilation_parse,
+    compilation_import,
+    compilation_analyse,
+    compilation_interface,
+    compilation_generate,
+};
+
+#define COMPILATION_STAGES \
+    (sizeof(compilation_stages) / sizeof(compilation_stages[0]))
+
+// Runs every stage on this thread, returns the exit code.
+int compile(Compilation *c) {
+    for (usz i = 0; i < COMPILATION_STAGES && compilation_stages[i](c); i++) {
+    }
+    return c->result;
+}
+
+// A compilation of a build with several inputs. Every stage is a task that
+// submits the next stage, so the stages of the inputs overlap: one input can
+// be parsed while another one is in codegen.
+typedef struct BuildUnit BuildUnit;
+struct BuildUnit {
+    ThreadPool      *pool;
+    ThreadPoolGroup *group;
+    Compilation      compilation;
+    usz              stage;
+    // The output and the errors are written in the order of the inputs after
+    // the build, so they do not depend on the scheduling.
+    char            *out;
+    size_t           out_size;
+    char            *err;
+    size_t           err_size;
+};
+
+void build_unit_run_stage(void *data) {
+    BuildUnit   *unit = data;
+    Compilation *c    = &unit->compilation;
+    log_capture(c->err);
+    bool next = compilation_stages[unit->stage](c);
+    log_capture(NULL);
+
+    unit->stage += 1;
+    if (next && unit->stage < COMPILATION_STAGES) {
+        thread_pool_submit(unit->pool, unit->group, build_unit_run_stage,
+                           unit);
+    }
+}
+
+// Without -j the build shares the pool of analyse and codegen, with -j it
+// gets a pool of its own.
+int build(Options *options, BitcodeCache *cache) {
+    ThreadPool *pool = options->jobs == 0 ? thread_pool_global()
+                                          : thread_pool_create(options->jobs);
+    if (pool == NULL) {
+        log_error("could not start the build workers");
+        return 1;
+    }
+
+    ThreadPoolGroup group = {0};
+    usz             count = options->inputs.count;
+    BuildUnit      *units = calloc(count, sizeof(BuildUnit));
+    for (usz i = 0; i < count; i++) {
+        BuildUnit *unit = &units[i];
+        *unit           = (BuildUnit){
+            .pool        = pool,
+            .group       = &group,
+            .compilation = {.options = options,
+                            .input   = options->inputs.items[i],
+                            .cache   = cache},
+        };
+        unit->compilation.out = open_memstream(&unit->out, &unit->out_size);
+        unit->compilation.err = open_memstream(&unit->err, &unit->err_size);
+        if (unit->compilation.out == NULL || unit->compilation.err == NULL) {
+            log_error("could not buffer the output of %s",
+                      unit->compilation.input);
+            unit->compilation.result = 1;
+            continue;
+        }
+        thread_pool_submit(pool, &group, build_unit_run_stage, unit);
+    }
+    thread_pool_wait(pool, &group);
+    if (options->jobs != 0) {
+        thread_pool_destroy(pool);
+    }
+
+    int result = 0;
+    for (usz i = 0; i < count; i++) {
+        BuildUnit *unit = &units[i];
+        if (unit->compilation.out != NULL) {
+            fclose(unit->compilation.out);
+        }
+        if (unit->compilation.err != NULL) {
+            fclose(unit->compilation.err);
+        }
+        fwrite(unit->err, 1, unit->err_size, stderr);
+        fwrite(unit->out, 1, unit->out_size, stdout);
+        free(unit->err);
+        free(unit->out);
+        if (unit->compilation.result != 0) {
+            result = 1;
+        }
+    }
+    free(units);
+    return result;
+}
+
+typedef struct ModuleBuild ModuleBuild;
+struct ModuleBuild {
+    Options      *options;
+    BitcodeCache *cache;
+};
+
+// The errors of a module are written at once when it is done, so they do not
+// mix with the errors of the modules compiled at the same time.
+bool module_build_compile(BuildModule const *module, void *data) {
+    ModuleBuild *build    = data;
+    char        *err      = NULL;
+    size_t       err_size = 0;
+    Compilation  c        = {.options = build->options,
+                             .input   = module->path,
+                             .cache   = build->cache,
+                             .out     = stdout,
+                             .err     = open_memstream(&err, &err_size)};
+    if (c.err == NULL) {
+        log_error("could not buffer the errors of %s", module->path);
+        return false;
+    }
+    log_capture(c.err);
+    int result = compile(&c);
+    log_capture(NULL);
+    fclose(c.err);
+
+    flockfile(stderr);
+    fwrite(err, 1, err_size, stderr);
+    funlockfile(stderr);
+    free(err);
+    return result == 0;
+}
+
+// The options that change the output of a module, a module compiled with
+// other options is compiled again.
+str module_build_flags(Options *options) {
+    EmitOptions *emit = &options->emit_options;
+    return str_format("%d %d %s %s %d %d %d", options->opt_level,
+                      options->emit_type, emit->cpu != NULL ? emit->cpu : "",
+                      emit->features != NULL ? emit->features : "",
+                      emit->reloc, emit->code_model, options->no_simplify);
+}
+
+// Like build, -j gives the build a pool of its own.
+int build_modules(Options *options, BitcodeCache *cache) {
+    BuildGraph graph = {.interface_dirs      = options->interface_dirs.items,
+                        .interface_dir_count = options->interface_dirs.count};
+    char const *extension = options->emit_type == EMIT_FILE_TYPE_OBJECT ? "o"
+                                                                        : "s";
+    if (!build_graph_scan(&graph, options->inputs.items, options->inputs.count,
+                          extension)) {
+        build_graph_destroy(&graph);
+        return 1;
+    }
+
+    ThreadPool *pool = options->jobs == 0 ? thread_pool_global()
+                                          : thread_pool_create(options->jobs);
+    if (pool == NULL) {
+        log_error("could not start the build workers");
+        build_graph_destroy(&graph);
+        return 1;
+    }
+
+    ModuleBuild data  = {.options = options, .cache = cache};
+    str         flags = module_build_flags(options);
+    BuildStats  stats;
+    bool        ok = build_graph_run(&graph, pool, flags, module_build_compile,
+                                     &data, &stats);
+    str_destroy(flags);
+    if (options->jobs != 0) {
+        thread_pool_destroy(pool);
+    }
+    build_graph_destroy(&graph);
+    return ok ? 0 : 1;
+}
+
+// Compiles every input, in parallel if there are several.
+int compile_inputs(Options *options, Session *session) {
+    BitcodeCache *cache = NULL;
+    if (options->cache_dir != NULL) {
+        cache = session_cache(session, options->cache_dir);
+        if (cache == NULL) {
+            return 1;
+        }
+    } else if (options->watch && !options->thin_lto) {
+        cache = session_memory_cache(session);
+        if (cache == NULL) {
+            return 1;
+        }
+    }
+    if (options->build) {
+        return build_modules(options, cache);
+    }
+    if (options->inputs.count > 1) {
+        return build(options, cache);
+    }
+
+    Compilation c = {.options = options,
+                     .input   = options->input,
+                     .cache   = cache,
+                     .out     = stdout,
+                     .err     = stderr};
+    return compile(&c);
+}
+
+// Compiles the inputs again whenever a source next to them or an interface in
+// a -I directory changes. The session keeps the bitcode of the unchanged
+// functions in memory, and --build only compiles the changed modules.
+int watch(Options *options) {
+    Watcher watcher;
+    if (!watcher_create(&watcher)) {
+        return 1;
+    }
+    bool ok = true;
+    for (usz i = 0; i < options->inputs.count && ok; i++) {
+        str   dir_str = path_directory(options->inputs.items[i]);
+        char *dir     = to_cstr(dir_str);
+        str_destroy(dir_str);
+        ok = watcher_add(&watcher, dir, BUILD_SOURCE_EXTENSION);
+        free(dir);
+    }
+    for (usz i = 0; i < options->interface_dirs.count && ok; i++) {
+        ok = watcher_add(&watcher, options->interface_dirs.items[i],
+                         INTERFACE_EXTENSION);
+    }
+
+    Session session = {0};
+    while (ok) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int result = compile_inputs(options, &session);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        f64 ms = (f64)(end.tv_sec - start.tv_sec) * 1e3 +
+                 (f64)(end.tv_nsec - start.tv_nsec) / 1e6;
+        fflush(stdout);
+        log_info("compiled in %.1f ms with exit code %d, waiting for changes",
+                 ms, result);
+        string_pool_free_all();
+
+        WatchChanges changes = {0};
+        ok = watcher_wait(&watcher, &changes);
+        for (usz i = 0; i < changes.count; i++) {
+            log_info("%s changed", changes.items[i]);
+        }
+        watch_changes_destroy(&changes);
+    }
+
+    session_destroy(&session);
+    watcher_destroy(&watcher);
+    return 1;
+}
+
+// Compiles a request of a client in the daemon.
+int daemon_compile(int argc, char **argv, void *data) {
+    Options options;
+    int     result = 1;
+    if (!parse_options(argc, argv, &options)) {
+        usage(stderr, argv[0]);
+    } else if (options.help) {
+        usage(stdout, argv[0]);
+        result = 0;
+    } else if (options.daemon != NULL || options.connect != NULL) {
+        log_error("the daemon can not start or connect to a daemon");
+    } else if (options.run || options.interp) {
+        log_error("the daemon does not run programs");
+    } else {
+        result = compile_inputs(&options, data);
+    }
+    options_destroy(&options);
+    string_pool_free_all();
+    return result;
+}
+
+int serve(Options *options) {
+    emit_initialize();
+
+    Session session = {0};
+    bool    ok      = daemon_serve(options->daemon, daemon_compile, &session);
+    session_destroy(&session);
+    return ok ? 0 : 1;
+}
+
+// Sends every argument except --connect and --stop to the daemon.
+int connect_daemon(Options *options, int argc, char **argv) {
+    if (options->stop) {
+        return daemon_stop(options->connect) ? 0 : 1;
+    }
+
+    struct {
+        usz    count;
+        usz    capacity;
+        char **items;
+    } args = {0};
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--connect") == 0) {
+            i += 1;
+        } else {
+            da_append(&args, argv[i]);
+        }
+    }
+
+    int result = 1;
+    if (!daemon_request(options->connect, (int)args.count, args.items,
+                        &result)) {
+        result = 1;
+    }
+    da_destroy(&args);
+    return result;
+}
 
 int main(int argc, char **argv) {
-    log_register_file(stdout);
-    log_debug("debug");
-    log_info("info");
-    log_warning("warning");
-    log_error("error");
-    log_info("about to fatal");
-    log_fatal("fatal");
+    log_register_file(stderr);
+
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        usage(stderr, argv[0]);
+        options_destroy(&options);
+        return 1;
+    }
+
+    int result = 0;
+    if (options.help) {
+        usage(stdout, argv[0]);
+    } else if (options.connect != NULL) {
+        result = connect_daemon(&options, argc, argv);
+    } else if (options.daemon != NULL) {
+        result = serve(&options);
+    } else if (options.watch) {
+        result = watch(&options);
+    } else {
+        Session session = {0};
+        result          = compile_inputs(&options, &session);
+        session_destroy(&session);
+    }
+    options_destroy(&options);
+    string_pool_free_all();
+    free_global_resources();
+    return result;
 }
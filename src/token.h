@@ -8,14 +8,30 @@
     X(NONE, none) /* This is a special Token, used to indicate that an \
                      optional Token is missing */                      \
     X(INVALID, invalid)                                                \
+    /* An integer literal that does not fit into 64 bits */            \
+    X(INTEGER_OUT_OF_RANGE, integer_out_of_range)                      \
     X(EOF, eof)                                                        \
     /* Literals  */                                                    \
     X(IDENTIFIER, identifier)                                          \
     X(INTEGER, integer)                                                \
+    X(FLOAT, float)                                                    \
     /* Delimiters */                                                   \
     X(COMMA, comma)                                                    \
     X(COLON, colon)                                                    \
     X(EQUAL, equal)                                                    \
+    X(AT, at)                                                          \
+    X(HASH, hash)                                                      \
+    X(DOT_DOT, dot_dot)                                                \
+    /* Operators */                                                    \
+    X(PLUS, plus)                                                      \
+    X(MINUS, minus)                                                    \
+    X(ASTERISK, asterisk)                                              \
+    X(EQUAL_EQUAL, equal_equal)                                        \
+    X(BANG_EQUAL, bang_equal)                                          \
+    X(LESS, less)                                                      \
+    X(LESS_EQUAL, less_equal)                                          \
+    X(GREATER, greater)                                                \
+    X(GREATER_EQUAL, greater_equal)                                    \
     /* Barces, Brackets... */                                          \
     X(LPAREN, lparen)                                                  \
     X(RPAREN, rparen)                                                  \
@@ -23,6 +39,13 @@
     X(RBRACE, rbrace)                                                  \
     /* Keywords */                                                     \
     X(FN, fn)                                                          \
+    X(RETURN, return)                                                  \
+    X(WHILE, while)                                                    \
+    X(FOR, for)                                                        \
+    X(IN, in)                                                          \
+    X(COMPTIME, comptime)                                              \
+    X(MODULE, module)                                                  \
+    X(IMPORT, import)                                                  \
     /* Whitespace */                                                   \
     X(EOL, eol)
 
@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200809L
+#include "watch.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "common.h"
+#include "da.h"
+
+#define WATCH_EVENTS \
+    (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+// Large enough for several events with the longest name.
+#define WATCH_BUFFER_SIZE (64 * (sizeof(struct inotify_event) + 256))
+
+bool watcher_create(Watcher *out) {
+    *out = (Watcher){.fd = inotify_init1(IN_CLOEXEC)};
+    if (out->fd < 0) {
+        log_error("could not start watching: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void watcher_destroy(Watcher *watcher) {
+    for (usz i = 0; i < watcher->directories.count; i++) {
+        WatchDirectory *dir = &watcher->directories.items[i];
+        for (usz j = 0; j < dir->extensions.count; j++) {
+            free(dir->extensions.items[j]);
+        }
+        da_destroy(&dir->extensions);
+        free(dir->path);
+    }
+    da_destroy(&watcher->directories);
+    close(watcher->fd);
+}
+
+char *watch_strdup(char const *s) {
+    return to_cstr((str){.ptr = (char *)s, .len = strlen(s)});
+}
+
+bool watcher_add(Watcher *watcher, char const *dir, char const *extension) {
+    int wd = inotify_add_watch(watcher->fd, dir, WATCH_EVENTS | IN_ONLYDIR);
+    if (wd < 0) {
+        log_error("could not watch %s: %s", dir, strerror(errno));
+        return false;
+    }
+
+    // inotify gives the same directory the same wd.
+    WatchDirectory *directory = NULL;
+    for (usz i = 0; i < watcher->directories.count; i++) {
+        if (watcher->directories.items[i].wd == wd) {
+            directory = &watcher->directories.items[i];
+        }
+    }
+    if (directory == NULL) {
+        da_append(&watcher->directories,
+                  ((WatchDirectory){.wd = wd, .path = watch_strdup(dir)}));
+        directory = &watcher->directories.items[watcher->directories.count - 1];
+    }
+    for (usz i = 0; i < directory->extensions.count; i++) {
+        if (strcmp(directory->extensions.items[i], extension) == 0) {
+            return true;
+        }
+    }
+    da_append(&directory->extensions, watch_strdup(extension));
+    return true;
+}
+
+bool watch_matches(WatchDirectory *dir, char const *name) {
+    char const *dot = strrchr(name, '.');
+    if (dot == NULL) {
+        return false;
+    }
+    for (usz i = 0; i < dir->extensions.count; i++) {
+        if (strcmp(dot + 1, dir->extensions.items[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void watch_changes_add(WatchChanges *changes, WatchDirectory *dir,
+                       char const *name) {
+    str   path_str = str_format("%s/%s", dir->path, name);
+    char *path     = to_cstr(path_str);
+    str_destroy(path_str);
+    for (usz i = 0; i < changes->count; i++) {
+        if (strcmp(changes->items[i], path) == 0) {
+            free(path);
+            return;
+        }
+    }
+    da_append(changes, path);
+}
+
+// Reads the events that are ready, returns false if the read failed.
+bool watch_read_events(Watcher *watcher, WatchChanges *changes) {
+    _Alignas(struct inotify_event) char buffer[WATCH_BUFFER_SIZE];
+    isz len = read(watcher->fd, buffer, sizeof(buffer));
+    if (len < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        log_error("could not read the changes: %s", strerror(errno));
+        return false;
+    }
+
+    for (isz pos = 0; pos < len;) {
+        struct inotify_event *event = (struct inotify_event *)(buffer + pos);
+        pos += sizeof(struct inotify_event) + event->len;
+        if (event->len == 0) {
+            continue;
+        }
+        for (usz i = 0; i < watcher->directories.count; i++) {
+            WatchDirectory *dir = &watcher->directories.items[i];
+            if (dir->wd == event->wd && watch_matches(dir, event->name)) {
+                watch_changes_add(changes, dir, event->name);
+            }
+        }
+    }
+    return true;
+}
+
+bool watcher_wait(Watcher *watcher, WatchChanges *changes) {
+    // Events of other files do not end the wait.
+    while (changes->count == 0) {
+        if (!watch_read_events(watcher, changes)) {
+            return false;
+        }
+    }
+
+    struct pollfd fd = {.fd = watcher->fd, .events = POLLIN};
+    for (;;) {
+        int ready = poll(&fd, 1, WATCH_SETTLE_MS);
+        if (ready < 0 && errno != EINTR) {
+            log_error("could not wait for changes: %s", strerror(errno));
+            return false;
+        }
+        if (ready == 0) {
+            return true;
+        }
+        if (ready > 0 && !watch_read_events(watcher, changes)) {
+            return false;
+        }
+    }
+}
+
+void watch_changes_destroy(WatchChanges *changes) {
+    for (usz i = 0; i < changes->count; i++) {
+        free(changes->items[i]);
+    }
+    da_destroy(changes);
+}
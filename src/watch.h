@@ -0,0 +1,55 @@
+#pragma once
+
+#include "common.h"
+
+// ================
+// -- watch --
+// Waits for changes of files with inotify. The directories of the files are
+// watched instead of the files, so a file that an editor replaces by renaming
+// a new file over it is still seen.
+// ================
+
+// Changes that follow each other within this many milliseconds are one
+// change, an editor often writes a file in several steps.
+#define WATCH_SETTLE_MS 20
+
+typedef struct WatchDirectory WatchDirectory;
+struct WatchDirectory {
+    int   wd;
+    char *path;
+    // Only changes of files with these extensions are reported
+    struct {
+        usz    count;
+        usz    capacity;
+        char **items;
+    } extensions;
+};
+
+typedef struct Watcher Watcher;
+struct Watcher {
+    int fd;
+    struct {
+        usz             count;
+        usz             capacity;
+        WatchDirectory *items;
+    } directories;
+};
+
+// The changed files as dir/name, every file once.
+typedef struct WatchChanges WatchChanges;
+struct WatchChanges {
+    usz    count;
+    usz    capacity;
+    char **items;
+};
+
+bool watcher_create(Watcher *out);
+void watcher_destroy(Watcher *watcher);
+// Watches the files with the extension in dir, a directory can be added with
+// several extensions.
+bool watcher_add(Watcher *watcher, char const *dir, char const *extension);
+// Blocks until a watched file is written, created, moved or removed and the
+// changes settled. Returns false if the watch failed.
+bool watcher_wait(Watcher *watcher, WatchChanges *changes);
+
+void watch_changes_destroy(WatchChanges *changes);
@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "language.h"
+#include "lexer.h"
+#include "node_column.h"
+#include "parser.h"
+#include "test_common.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) { string_pool_free_all(); }
+
+void test_analyse_node_attributes(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p, "fn main() u32 {\nx : u32 = 1\n}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(0, ma.errors.count);
+    TEST_ASSERT_EQUAL_size_t(m.nodes.count, ma.attributes.scope.count);
+    TEST_ASSERT_EQUAL_size_t(m.nodes.count, ma.attributes.type.count);
+    TEST_ASSERT_EQUAL_size_t(m.nodes.count, ma.attributes.symbol.count);
+
+    // 0: integer, 1: variable, 2: block, 3: function, 4: eof
+    TEST_ASSERT_EQUAL_size_t(NODE_TYPE_FUNCTION_DEFINITION,
+                             m.nodes.items[3].type);
+    Index function_scope = node_column_get(&ma.attributes.scope, 3);
+    Index block_scope    = node_column_get(&ma.attributes.scope, 2);
+    TEST_ASSERT_EQUAL(ANALYSE_SCOPE_TYPE_FUNCTION,
+                      ma.scopes.items[function_scope].type);
+    TEST_ASSERT_EQUAL(ANALYSE_SCOPE_TYPE_BLOCK,
+                      ma.scopes.items[block_scope].type);
+    TEST_ASSERT_EQUAL_size_t(function_scope,
+                             ma.scopes.items[block_scope].super_scope);
+    TEST_ASSERT_EQUAL_size_t(block_scope,
+                             node_column_get(&ma.attributes.scope, 1));
+    TEST_ASSERT_EQUAL_size_t(block_scope,
+                             node_column_get(&ma.attributes.scope, 0));
+
+    TEST_ASSERT_EQUAL(BUILTIN_TYPE_U32,
+                      node_column_get(&ma.attributes.type, 0).type);
+    TEST_ASSERT_EQUAL(BUILTIN_TYPE_U32,
+                      node_column_get(&ma.attributes.type, 1).type);
+    TEST_ASSERT_EQUAL(BUILTIN_TYPE_NONE,
+                      node_column_get(&ma.attributes.type, 2).type);
+
+    Index variable_symbol = node_column_get(&ma.attributes.symbol, 1);
+    TEST_ASSERT_EQUAL(ANALYSE_SYMBOL_KIND_VARIABLE,
+                      ma.symbols.items[variable_symbol].kind);
+    TEST_ASSERT_EQUAL_size_t(1, ma.symbols.items[variable_symbol].node);
+    Index function_symbol = node_column_get(&ma.attributes.symbol, 3);
+    TEST_ASSERT_EQUAL(ANALYSE_SYMBOL_KIND_FUNCTION,
+                      ma.symbols.items[function_symbol].kind);
+    TEST_ASSERT_EQUAL_size_t(ANALYSE_INDEX_NONE,
+                             node_column_get(&ma.attributes.symbol, 0));
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_identifier_in_use(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p, "fn main(x u32) u32 {\nx := 1\n}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(1, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE,
+                      ma.errors.items[0].type);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_duplicate_function(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "fn f() u32 {\nreturn 1\n}\n"
+                             "fn f() u32 {\nreturn 2\n}\n"
+                             "fn main() u32 {\nreturn f()\n}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(1, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE,
+                      ma.errors.items[0].type);
+    TEST_ASSERT_EQUAL(NODE_TYPE_FUNCTION_DEFINITION,
+                      m.nodes.items[ma.errors.items[0].node].type);
+    TEST_ASSERT_TRUE(ma.errors.items[0].node == m.top_level_nodes.items[1]);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_duplicate_argument(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "fn f(a u32, a u32) u32 {\nreturn a\n}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(1, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_IDENTIFIER_ALREADY_IN_USE,
+                      ma.errors.items[0].type);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_threaded_is_deterministic(void) {
+    Lexer  l;
+    Parser p;
+    Module m = parse(&l, &p,
+                     "fn a() u32 {\nx := 1\n}\n"
+                     "fn b(x u32) u32 {\nx := 2\n}\n"
+                     "fn c() u32 {\ny : u32 = 3\nz := 4\n}\n"
+                     "fn d(y u32) u32 {\ny := 5\n}\n");
+    ModuleAnalyse serial   = analyse_module_threaded(&m, &p.tokens, p.input, 1);
+    ModuleAnalyse parallel = analyse_module_threaded(&m, &p.tokens, p.input, 3);
+
+    TEST_ASSERT_EQUAL_size_t(2, serial.errors.count);
+    TEST_ASSERT_EQUAL_size_t(serial.errors.count, parallel.errors.count);
+    for (usz i = 0; i < serial.errors.count; i++) {
+        TEST_ASSERT_EQUAL(serial.errors.items[i].type,
+                          parallel.errors.items[i].type);
+        TEST_ASSERT_EQUAL_size_t(serial.errors.items[i].node,
+                                 parallel.errors.items[i].node);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(serial.scopes.count, parallel.scopes.count);
+    TEST_ASSERT_EQUAL_size_t(serial.symbols.count, parallel.symbols.count);
+    for (usz i = 0; i < serial.scopes.count; i++) {
+        TEST_ASSERT_EQUAL_size_t(serial.scopes.items[i].node,
+                                 parallel.scopes.items[i].node);
+        TEST_ASSERT_EQUAL_size_t(serial.scopes.items[i].super_scope,
+                                 parallel.scopes.items[i].super_scope);
+    }
+    for (usz i = 0; i < m.nodes.count; i++) {
+        TEST_ASSERT_EQUAL_size_t(
+            node_column_get(&serial.attributes.scope, i),
+            node_column_get(&parallel.attributes.scope, i));
+        TEST_ASSERT_EQUAL_size_t(
+            node_column_get(&serial.attributes.symbol, i),
+            node_column_get(&parallel.attributes.symbol, i));
+    }
+
+    free_module_analyse(&serial);
+    free_module_analyse(&parallel);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_expressions(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "fn main(a u32) u32 {\n"
+                             "x := a * 2 + 1\n"
+                             "y := x - missing\n"
+                             "return x\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(1, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_UNDEFINED_IDENTIFIER,
+                      ma.errors.items[0].type);
+
+    // Identifiers refer to the symbol of their variable or argument.
+    for (Index i = 0; i < m.nodes.count; i++) {
+        if (m.nodes.items[i].type != NODE_TYPE_IDENTIFIER ||
+            i == ma.errors.items[0].node) {
+            continue;
+        }
+        Index symbol = node_column_get(&ma.attributes.symbol, i);
+        TEST_ASSERT_TRUE(symbol != ANALYSE_INDEX_NONE);
+        TEST_ASSERT_TRUE(ma.symbols.items[symbol].kind !=
+                         ANALYSE_SYMBOL_KIND_FUNCTION);
+        TEST_ASSERT_EQUAL(BUILTIN_TYPE_U32,
+                          node_column_get(&ma.attributes.type, i).type);
+    }
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_calls(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "fn main() u32 {\n"
+                             "x := add(1, later(2))\n"
+                             "y := add(1)\n"
+                             "z := missing(x)\n"
+                             "return x\n"
+                             "}\n"
+                             "fn add(a u32, b u32) u32 {\n"
+                             "return a + b\n"
+                             "}\n"
+                             "fn later(a u32) u32 {\n"
+                             "return a\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(2, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_CALL_ARGUMENT_COUNT,
+                      ma.errors.items[0].type);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_UNDEFINED_FUNCTION,
+                      ma.errors.items[1].type);
+
+    // Calls refer to the symbol of the function, also for functions declared
+    // after the call.
+    usz calls = 0;
+    for (Index i = 0; i < m.nodes.count; i++) {
+        if (m.nodes.items[i].type != NODE_TYPE_CALL ||
+            node_column_get(&ma.attributes.type, i).type == BUILTIN_TYPE_NONE) {
+            continue;
+        }
+        Index symbol = node_column_get(&ma.attributes.symbol, i);
+        TEST_ASSERT_TRUE(symbol != ANALYSE_INDEX_NONE);
+        TEST_ASSERT_EQUAL(ANALYSE_SYMBOL_KIND_FUNCTION,
+                          ma.symbols.items[symbol].kind);
+        calls += 1;
+    }
+    TEST_ASSERT_EQUAL_size_t(2, calls);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_vectors(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "fn main() u32 {\n"
+                             "v := u32x4(1, 2, 3, 4) * 2\n"
+                             "w : u32x2 = shuffle(v, v, 0, 7)\n"
+                             "a := extract(v, 4)\n"
+                             "b := u32x4(1, 2)\n"
+                             "c := v + u32x2(1)\n"
+                             "return extract(insert(w, 1, 5), 1)\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(3, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_INVALID_LANE, ma.errors.items[0].type);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_CALL_ARGUMENT_COUNT,
+                      ma.errors.items[1].type);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_OPERANDS_DIFFRENT_TYPE,
+                      ma.errors.items[2].type);
+
+    // The scalar operand of the multiplication is used for every lane.
+    Index v = 0;
+    while (m.nodes.items[v].type != NODE_TYPE_VARIABLE_DECLARATION) {
+        v++;
+    }
+    Type type = node_column_get(&ma.attributes.type, m.nodes.items[v].data.rhs);
+    TEST_ASSERT_EQUAL(BUILTIN_TYPE_U32, type.type);
+    TEST_ASSERT_EQUAL_UINT32(4, type.lanes);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_arenas(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "comptime global := arena(0)\n"
+                             "@pure fn f(a u64) u64 {\n"
+                             "return alloc(a, 8)\n"
+                             "}\n"
+                             "fn main() u32 {\n"
+                             "a := arena(4096)\n"
+                             "b : u8 = 16\n"
+                             "x := alloc(a, b)\n"
+                             "y := alloc(a, 1.5)\n"
+                             "z := reset(a, 1)\n"
+                             "done := release(a)\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    AnalyseErrorType expected[] = {
+        ANALYSE_ERROR_COMPTIME_IMPURE_CALL,
+        ANALYSE_ERROR_IMPURE_CALL,
+        ANALYSE_ERROR_CALL_ARGUMENT_DIFFRENT_TYPE,
+        ANALYSE_ERROR_CALL_ARGUMENT_COUNT,
+    };
+    TEST_ASSERT_EQUAL_size_t(4, ma.errors.count);
+    for (usz i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(expected[i], ma.errors.items[i].type);
+    }
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_conversions(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "fn main(a u8, b i32, c u32) f64 {\n"
+                             "x := a + 300\n"
+                             "y : i64 = a * b\n"
+                             "z : u8 = 256\n"
+                             "w : u32 = b\n"
+                             "f : f32 = c\n"
+                             "return b + 0.5\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    // 300 does not fit into u8, so a is converted to u32, and signed to
+    // unsigned or u32 to f32 could lose values.
+    TEST_ASSERT_EQUAL_size_t(3, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_VARIABLE_EXPRESSION_DIFFRENT_TYPE,
+                      ma.errors.items[0].type);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_VARIABLE_EXPRESSION_DIFFRENT_TYPE,
+                      ma.errors.items[1].type);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_VARIABLE_EXPRESSION_DIFFRENT_TYPE,
+                      ma.errors.items[2].type);
+
+    BuiltinType variables[] = {BUILTIN_TYPE_U32, BUILTIN_TYPE_I64};
+    usz         variable    = 0;
+    for (Index i = 0; i < m.nodes.count && variable < 2; i++) {
+        if (m.nodes.items[i].type == NODE_TYPE_VARIABLE_DECLARATION &&
+            node_column_get(&ma.attributes.symbol, i) != ANALYSE_INDEX_NONE) {
+            TEST_ASSERT_EQUAL(variables[variable],
+                              node_column_get(&ma.attributes.type, i).type);
+            variable += 1;
+        }
+    }
+    TEST_ASSERT_EQUAL_size_t(2, variable);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_function_attributes(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "@inline @noinline @hot @hot @fast\n"
+                             "fn f() u32 {\n"
+                             "return 1\n"
+                             "}\n"
+                             "@pure fn g() u32 {\n"
+                             "return f() + h()\n"
+                             "}\n"
+                             "@pure @fastcc fn h() u32 {\n"
+                             "return 2\n"
+                             "}\n"
+                             "@fastcc fn main() u32 {\n"
+                             "return g()\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    AnalyseErrorType expected[] = {
+        ANALYSE_ERROR_CONFLICTING_ATTRIBUTES, ANALYSE_ERROR_CONFLICTING_ATTRIBUTES,
+        ANALYSE_ERROR_UNKNOWN_ATTRIBUTE,      ANALYSE_ERROR_FASTCC_MAIN,
+        ANALYSE_ERROR_IMPURE_CALL,
+    };
+    TEST_ASSERT_EQUAL_size_t(5, ma.errors.count);
+    for (usz i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(expected[i], ma.errors.items[i].type);
+    }
+
+    // Invalid attributes are left out.
+    AnalyseFunction *f = analyse_find_function(&ma, ma.root_scope, "f");
+    TEST_ASSERT_EQUAL_UINT32(FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_INLINE) |
+                                 FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_HOT),
+                             f->attributes);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_loops(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "fn main(a u32) u32 {\n"
+                             "#unroll(0) #vectorize(3) #fast\n"
+                             "while a {\n"
+                             "}\n"
+                             "for i in 0..1.5 {\n"
+                             "}\n"
+                             "#parallel for j in 0..a {\n"
+                             "j = 1\n"
+                             "a = a + j\n"
+                             "k := j\n"
+                             "k = k * 2\n"
+                             "}\n"
+                             "while a < 10 {\n"
+                             "a = a + 1\n"
+                             "}\n"
+                             "return a\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    AnalyseErrorType expected[] = {
+        ANALYSE_ERROR_INVALID_LOOP_HINT, ANALYSE_ERROR_INVALID_LOOP_HINT,
+        ANALYSE_ERROR_UNKNOWN_LOOP_HINT, ANALYSE_ERROR_CONDITION_NOT_BOOL,
+        ANALYSE_ERROR_INVALID_RANGE,     ANALYSE_ERROR_NOT_ASSIGNABLE,
+        ANALYSE_ERROR_PARALLEL_LOOP_ASSIGNMENT,
+    };
+    TEST_ASSERT_EQUAL_size_t(7, ma.errors.count);
+    for (usz i = 0; i < 7; i++) {
+        TEST_ASSERT_EQUAL(expected[i], ma.errors.items[i].type);
+    }
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_analyse_comptime(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "comptime a := f()\n"
+                             "fn f() u32 {\n"
+                             "comptime b := 1\n"
+                             "return 1\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+
+    TEST_ASSERT_EQUAL_size_t(2, ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_COMPTIME_IMPURE_CALL,
+                      ma.errors.items[0].type);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_INVALID_NODE, ma.errors.items[1].type);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+
+    m  = parse(&l, &p,
+               "comptime sum := triangle(10)\n"
+               "comptime wide : u64 = sum * 2\n"
+               "comptime lanes := u32x4(1, 2, 3, 4) * u32x4(3)\n"
+               "comptime spin := forever()\n"
+               "comptime deep := down(1)\n"
+               "comptime self := selfuse()\n"
+               "@pure fn triangle(n u32) u32 {\n"
+               "s : u32 = 0\n"
+               "for i in 0..n {\n"
+               "s = s + i\n"
+               "}\n"
+               "return s\n"
+               "}\n"
+               "@pure fn forever() u32 {\n"
+               "while 1 == 1 {\n"
+               "}\n"
+               "return 0\n"
+               "}\n"
+               "@pure fn down(n u32) u32 {\n"
+               "return down(n + 1)\n"
+               "}\n"
+               "@pure fn selfuse() u32 {\n"
+               "return self\n"
+               "}\n");
+    ma = analyse_module(&m, &p.tokens, p.input);
+
+    AnalyseErrorType expected[] = {
+        ANALYSE_ERROR_COMPTIME_LIMIT,
+        ANALYSE_ERROR_COMPTIME_LIMIT,
+        ANALYSE_ERROR_COMPTIME_CYCLE,
+    };
+    TEST_ASSERT_EQUAL_size_t(3, ma.errors.count);
+    for (usz i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(expected[i], ma.errors.items[i].type);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(6, ma.comptimes.count);
+    AnalyseComptime *sum = &ma.comptimes.items[0];
+    TEST_ASSERT_EQUAL(ANALYSE_COMPTIME_STATE_DONE, sum->state);
+    TEST_ASSERT_EQUAL(ANALYSE_SYMBOL_KIND_COMPTIME,
+                      ma.symbols.items[sum->symbol].kind);
+    TEST_ASSERT_TRUE(sum->value.lanes[0].integer == 45);
+    AnalyseComptime *wide = &ma.comptimes.items[1];
+    TEST_ASSERT_EQUAL(BUILTIN_TYPE_U64, wide->value.type.type);
+    TEST_ASSERT_TRUE(wide->value.lanes[0].integer == 90);
+    AnalyseComptime *lanes = &ma.comptimes.items[2];
+    TEST_ASSERT_EQUAL_UINT32(4, lanes->value.type.lanes);
+    TEST_ASSERT_TRUE(lanes->value.lanes[3].integer == 12);
+    TEST_ASSERT_EQUAL(ANALYSE_COMPTIME_STATE_FAILED, ma.comptimes.items[3].state);
+
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_analyse_node_attributes);
+    RUN_TEST(test_analyse_identifier_in_use);
+    RUN_TEST(test_analyse_duplicate_function);
+    RUN_TEST(test_analyse_duplicate_argument);
+    RUN_TEST(test_analyse_threaded_is_deterministic);
+    RUN_TEST(test_analyse_expressions);
+    RUN_TEST(test_analyse_calls);
+    RUN_TEST(test_analyse_vectors);
+    RUN_TEST(test_analyse_conversions);
+    RUN_TEST(test_analyse_arenas);
+    RUN_TEST(test_analyse_function_attributes);
+    RUN_TEST(test_analyse_loops);
+    RUN_TEST(test_analyse_comptime);
+    return UNITY_END();
+}
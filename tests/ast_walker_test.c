@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "ast_visitor.h"
+#include "ast_walker.h"
+#include "common.h"
+#include "da.h"
+#include "flat_pass.h"
+#include "lexer.h"
+#include "parser.h"
+#include "test_common.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) { string_pool_free_all(); }
+
+void test_ast_iterator_pre_and_post_order(void) {
+    Lexer  l;
+    Parser p;
+    // 0: integer, 1: variable, 2: block, 3: function, 4: eof
+    Module m = parse(&l, &p, "fn main() u32 {\nx := 1\n}\n");
+
+    Arena       arena = {0};
+    AstIterator it;
+    ast_iterator_init(&it, &m, &arena, AST_VISIT_PRE | AST_VISIT_POST);
+    ast_iterator_push_top_level(&it);
+
+    AstVisit visits[10];
+    usz      count = 0;
+    while (count < 10 && ast_iterator_next(&it, &visits[count])) {
+        count++;
+    }
+
+    Index         expected_nodes[]  = {3, 2, 1, 0, 0, 1, 2, 3, 4, 4};
+    AstVisitOrder expected_orders[] = {
+        AST_VISIT_PRE,  AST_VISIT_PRE,  AST_VISIT_PRE,  AST_VISIT_PRE,
+        AST_VISIT_POST, AST_VISIT_POST, AST_VISIT_POST, AST_VISIT_POST,
+        AST_VISIT_PRE,  AST_VISIT_POST,
+    };
+    TEST_ASSERT_EQUAL_size_t(10, count);
+    for (usz i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_size_t(expected_nodes[i], visits[i].node);
+        TEST_ASSERT_EQUAL(expected_orders[i], visits[i].order);
+    }
+
+    arena_destroy(&arena);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_ast_iterator_skip_children(void) {
+    Lexer  l;
+    Parser p;
+    Module m = parse(&l, &p, "fn main() u32 {\nx := 1\n}\n");
+
+    Arena       arena = {0};
+    AstIterator it;
+    ast_iterator_init(&it, &m, &arena, AST_VISIT_PRE);
+    ast_iterator_push_top_level(&it);
+
+    AstVisit visit;
+    TEST_ASSERT_TRUE(ast_iterator_next(&it, &visit));
+    TEST_ASSERT_EQUAL_size_t(3, visit.node);
+    ast_iterator_skip_children(&it);
+    TEST_ASSERT_TRUE(ast_iterator_next(&it, &visit));
+    TEST_ASSERT_EQUAL_size_t(4, visit.node);
+    TEST_ASSERT_FALSE(ast_iterator_next(&it, &visit));
+
+    arena_destroy(&arena);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+// Nested blocks can't be parsed yet, so the module is built by hand.
+void test_ast_iterator_deep_nesting(void) {
+    usz    depth = 1000000;
+    Module m     = {0};
+
+    for (usz i = 0; i < depth; i++) {
+        BlockData bd = {0};
+        if (i > 0) {
+            da_append(&bd, (Index)(i - 1));
+        }
+        NodeExtraData ed = {.type = NODE_EXTRA_DATA_BLOCK, .data.block = bd};
+        da_append(&m.extra_data, ed);
+        Node node = {.type = NODE_TYPE_BLOCK, .data.lhs = i};
+        da_append(&m.nodes, node);
+    }
+
+    Arena       arena = {0};
+    AstIterator it;
+    ast_iterator_init(&it, &m, &arena, AST_VISIT_POST);
+    ast_iterator_push(&it, depth - 1);
+
+    AstVisit visit;
+    usz      count = 0;
+    while (ast_iterator_next(&it, &visit)) {
+        TEST_ASSERT_EQUAL_size_t(count, visit.node);
+        count++;
+    }
+    TEST_ASSERT_EQUAL_size_t(depth, count);
+
+    arena_destroy(&arena);
+    for (usz i = 0; i < m.extra_data.count; i++) {
+        da_destroy(&m.extra_data.items[i].data.block);
+    }
+    da_destroy(&m.extra_data);
+    da_destroy(&m.nodes);
+}
+
+void test_ast_node_batches(void) {
+    Lexer  l;
+    Parser p;
+    Module m = parse(&l, &p, "fn a() u32 {\nx := 1\ny := 2\n}\n"
+                             "fn b() u32 {\nz := 3\n}\n");
+
+    Arena          arena   = {0};
+    AstNodeBatches batches = ast_node_batches(&m, &arena);
+
+    TEST_ASSERT_EQUAL_size_t(3, batches.counts[NODE_TYPE_INTEGER_LITERAL]);
+    TEST_ASSERT_EQUAL_size_t(3, batches.counts[NODE_TYPE_VARIABLE_DECLARATION]);
+    TEST_ASSERT_EQUAL_size_t(2, batches.counts[NODE_TYPE_FUNCTION_DEFINITION]);
+    TEST_ASSERT_EQUAL_size_t(1, batches.counts[NODE_TYPE_EOF]);
+
+    for (usz type = 0; type < NODE_TYPE_COUNT; type++) {
+        for (usz i = 0; i < batches.counts[type]; i++) {
+            Index node = batches.nodes[type][i];
+            TEST_ASSERT_EQUAL(type, m.nodes.items[node].type);
+            if (i > 0) {
+                TEST_ASSERT_TRUE(batches.nodes[type][i - 1] < node);
+            }
+        }
+    }
+
+    arena_destroy(&arena);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+typedef struct CountData CountData;
+struct CountData {
+    usz variables;
+    usz integers;
+};
+
+bool count_variable_declaration(CountData *data, Module *m, Index node_index,
+                                Node *node) {
+    (void)m;
+    (void)node_index;
+    (void)node;
+    data->variables++;
+    return true;
+}
+
+bool count_integer_literal(CountData *data, Module *m, Index node_index,
+                           Node *node) {
+    (void)m;
+    (void)node_index;
+    (void)node;
+    data->integers++;
+    return true;
+}
+
+bool count_function_definition(CountData *data, Module *m, Index node_index,
+                               Node *node) {
+    (void)data;
+    (void)node;
+    // Only look into the first function
+    return node_index == m->top_level_nodes.items[0];
+}
+
+#define COUNT_NODES(X, ctx)                            \
+    X(ctx, VARIABLE_DECLARATION, variable_declaration) \
+    X(ctx, INTEGER_LITERAL, integer_literal)           \
+    X(ctx, FUNCTION_DEFINITION, function_definition)
+AST_VISITOR(count, CountData, COUNT_NODES)
+
+void test_ast_visitor(void) {
+    Lexer  l;
+    Parser p;
+    Module m = parse(&l, &p, "fn a() u32 {\nx := 1\ny := 2\n}\n"
+                             "fn b() u32 {\nz := 3\n}\n");
+
+    Arena     arena = {0};
+    CountData data  = {0};
+    count_walk(&data, &m, &arena);
+
+    TEST_ASSERT_EQUAL_size_t(2, data.variables);
+    TEST_ASSERT_EQUAL_size_t(2, data.integers);
+    TEST_ASSERT_EQUAL_STRING("variable_declaration",
+                             node_type_str(NODE_TYPE_VARIABLE_DECLARATION));
+
+    arena_destroy(&arena);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+void test_flat_pass(void) {
+    Lexer  l;
+    Parser p;
+    // 0: integer, 1: variable, 2: integer, 3: variable, 4: block,
+    // 5: function, 6: eof
+    Module m = parse(&l, &p, "fn a() u32 {\nx := 1\ny := 2\n}\n");
+
+    TEST_ASSERT_TRUE(flat_module_is_ordered(&m));
+    TEST_ASSERT_EQUAL_size_t(0, flat_subtree_begin(&m, 5));
+    TEST_ASSERT_EQUAL_size_t(2, flat_subtree_begin(&m, 3));
+    TEST_ASSERT_EQUAL_size_t(6, flat_subtree_begin(&m, 6));
+
+    NodeColumnFlatIndex parents = flat_parents(&m);
+    TEST_ASSERT_EQUAL_size_t(1, node_column_get(&parents, 0));
+    TEST_ASSERT_EQUAL_size_t(4, node_column_get(&parents, 1));
+    TEST_ASSERT_EQUAL_size_t(4, node_column_get(&parents, 3));
+    TEST_ASSERT_EQUAL_size_t(5, node_column_get(&parents, 4));
+    TEST_ASSERT_EQUAL_size_t(FLAT_NO_PARENT, node_column_get(&parents, 5));
+    node_column_destroy(&parents);
+
+    // Subtree sizes in one forward sweep, the children are always done.
+    usz sizes[7] = {0};
+    for (Index i = 0; i < m.nodes.count; i++) {
+        Node *node = &m.nodes.items[i];
+        sizes[i]   = 1;
+        for (usz c = 0; c < flat_child_count(&m, node); c++) {
+            sizes[i] += sizes[flat_child(&m, node, c)];
+        }
+    }
+    TEST_ASSERT_EQUAL_size_t(6, sizes[5]);
+    TEST_ASSERT_EQUAL_size_t(5, sizes[4]);
+
+    // Swapping two children breaks the ordering.
+    BlockData *bd  = &m.extra_data.items[m.nodes.items[4].data.lhs].data.block;
+    Index      tmp = bd->items[0];
+    bd->items[0]   = bd->items[1];
+    bd->items[1]   = tmp;
+    TEST_ASSERT_FALSE(flat_module_is_ordered(&m));
+
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ast_iterator_pre_and_post_order);
+    RUN_TEST(test_ast_iterator_skip_children);
+    RUN_TEST(test_ast_iterator_deep_nesting);
+    RUN_TEST(test_ast_node_batches);
+    RUN_TEST(test_ast_visitor);
+    RUN_TEST(test_flat_pass);
+    return UNITY_END();
+}
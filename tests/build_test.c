@@ -0,0 +1,202 @@
+// mkdtemp
+#define _POSIX_C_SOURCE 200809L
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "build.h"
+#include "common.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define MAX_MODULES 8
+
+typedef struct FakeBuild FakeBuild;
+struct FakeBuild {
+    BuildGraph   *graph;
+    _Atomic(bool) compiled[MAX_MODULES];
+};
+
+void write_source(char const *dir, char const *name, char const *source) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.th", dir, name);
+    FILE *file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs(source, file);
+    fclose(file);
+}
+
+// The interface is the amount of @export in the source, a source with fail in
+// it does not compile.
+bool fake_compile(BuildModule const *module, void *data) {
+    FakeBuild *build = data;
+    atomic_store(&build->compiled[module - build->graph->modules.items], true);
+
+    str source;
+    if (!read_file(module->path, &source)) {
+        return false;
+    }
+    char *text    = to_cstr(source);
+    usz   exports = 0;
+    for (char *at = strstr(text, "@export"); at != NULL;
+         at       = strstr(at + 1, "@export")) {
+        exports += 1;
+    }
+    bool ok = strstr(text, "fail") == NULL;
+    free(text);
+    str_destroy(source);
+    if (!ok) {
+        return false;
+    }
+
+    FILE *output = fopen(module->output, "wb");
+    fputs("object", output);
+    fclose(output);
+    if (module->interface != NULL) {
+        FILE *interface = fopen(module->interface, "wb");
+        fprintf(interface, "%zu", exports);
+        fclose(interface);
+    }
+    return true;
+}
+
+isz find_module(BuildGraph *graph, char const *name) {
+    for (usz i = 0; i < graph->modules.count; i++) {
+        if (strcmp(graph->modules.items[i].name, name) == 0) {
+            return (isz)i;
+        }
+    }
+    return -1;
+}
+
+// Writes the letters of the modules that were compiled to built, d for main.
+void run_build(BuildGraph *graph, char const *input, bool expect_ok,
+               char *built) {
+    char const *inputs[] = {input};
+    TEST_ASSERT_TRUE(build_graph_scan(graph, inputs, 1, "o"));
+    TEST_ASSERT_TRUE(graph->modules.count <= MAX_MODULES);
+
+    FakeBuild  build = {.graph = graph};
+    BuildStats stats;
+    str        flags = {.ptr = "flags", .len = 5};
+    TEST_ASSERT_EQUAL(expect_ok,
+                      build_graph_run(graph, thread_pool_global(), flags,
+                                      fake_compile, &build, &stats));
+    TEST_ASSERT_EQUAL_size_t(graph->modules.count,
+                             stats.compiled + stats.up_to_date + stats.failed);
+
+    char const *names[] = {"a", "b", "c", "main"};
+    for (usz n = 0; n < 4; n++) {
+        isz i = find_module(graph, names[n]);
+        if (i != -1 && atomic_load(&build.compiled[i])) {
+            *built++ = "abcd"[n];
+        }
+    }
+    *built = '\0';
+}
+
+void remove_outputs(BuildGraph *graph) {
+    for (usz i = 0; i < graph->modules.count; i++) {
+        BuildModule *module = &graph->modules.items[i];
+        remove(module->output);
+        remove(module->stamp);
+        if (module->interface != NULL) {
+            remove(module->interface);
+        }
+        remove(module->path);
+    }
+}
+
+void test_build_rebuilds_changes(void) {
+    char dir[] = "/tmp/thor-build-XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char main_path[256];
+    snprintf(main_path, sizeof(main_path), "%s/d.th", dir);
+
+    // d (main) imports a and b, both import c
+    write_source(dir, "c", "module c\n@export\nfn c() u32 {\n    return 1\n}\n");
+    write_source(dir, "a", "module a\nimport c\n@export\nfn a() u32 {\n}\n");
+    write_source(dir, "b", "module b\nimport c\n@export\nfn b() u32 {\n}\n");
+    write_source(dir, "d", "import a\nimport b\nfn main() u32 {\n}\n");
+
+    BuildGraph graph = {0};
+    char       built[MAX_MODULES + 1];
+    run_build(&graph, main_path, true, built);
+    TEST_ASSERT_EQUAL_STRING("abcd", built);
+    isz main = find_module(&graph, "main");
+    isz c    = find_module(&graph, "c");
+    TEST_ASSERT_EQUAL_size_t(2, graph.modules.items[main].dependencies.count);
+    TEST_ASSERT_EQUAL_size_t(2, graph.modules.items[c].dependents.count);
+    TEST_ASSERT_NULL(graph.modules.items[main].interface);
+    build_graph_destroy(&graph);
+
+    graph = (BuildGraph){0};
+    run_build(&graph, main_path, true, built);
+    TEST_ASSERT_EQUAL_STRING("", built);
+    build_graph_destroy(&graph);
+
+    // The interface of c stays the same.
+    write_source(dir, "c", "module c\n@export\nfn c() u32 {\n    return 2\n}\n");
+    graph = (BuildGraph){0};
+    run_build(&graph, main_path, true, built);
+    TEST_ASSERT_EQUAL_STRING("c", built);
+    build_graph_destroy(&graph);
+
+    // The interface of a changes, so its importer d is built again.
+    write_source(dir, "a",
+                 "module a\nimport c\n@export\nfn a() u32 {\n}\n"
+                 "@export\nfn e() u32 {\n}\n");
+    graph = (BuildGraph){0};
+    run_build(&graph, main_path, true, built);
+    TEST_ASSERT_EQUAL_STRING("ad", built);
+    build_graph_destroy(&graph);
+
+    // d is not compiled because b failed. The next build only compiles b, the
+    // stamp of d still matches because the interface of b is the same.
+    write_source(dir, "b", "module b\nimport c\nfail\n");
+    graph = (BuildGraph){0};
+    run_build(&graph, main_path, false, built);
+    TEST_ASSERT_EQUAL_STRING("b", built);
+    build_graph_destroy(&graph);
+    write_source(dir, "b", "module b\nimport c\n@export\nfn b() u32 {\n}\n");
+    graph = (BuildGraph){0};
+    run_build(&graph, main_path, true, built);
+    TEST_ASSERT_EQUAL_STRING("b", built);
+
+    remove_outputs(&graph);
+    build_graph_destroy(&graph);
+    rmdir(dir);
+}
+
+void test_build_rejects_invalid_graphs(void) {
+    char dir[] = "/tmp/thor-build-XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char main_path[256];
+    snprintf(main_path, sizeof(main_path), "%s/d.th", dir);
+    char const *inputs[] = {main_path};
+
+    write_source(dir, "a", "module a\nimport b\n");
+    write_source(dir, "b", "module b\nimport a\n");
+    write_source(dir, "d", "import a\n");
+    BuildGraph graph = {0};
+    TEST_ASSERT_FALSE(build_graph_scan(&graph, inputs, 1, "o"));
+    build_graph_destroy(&graph);
+
+    write_source(dir, "b", "module c\n");
+    graph = (BuildGraph){0};
+    TEST_ASSERT_FALSE(build_graph_scan(&graph, inputs, 1, "o"));
+    remove_outputs(&graph);
+    build_graph_destroy(&graph);
+    rmdir(dir);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_build_rebuilds_changes);
+    RUN_TEST(test_build_rejects_invalid_graphs);
+    return UNITY_END();
+}
@@ -0,0 +1,681 @@
+// mkdtemp, rmdir
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <llvm-c/Core.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "lexer.h"
+#include "llvm/cache.h"
+#include "llvm/codegen.h"
+#include "llvm/emit.h"
+#include "llvm/jit.h"
+#include "llvm/lto.h"
+#include "parser.h"
+#include "test_common.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) { string_pool_free_all(); }
+
+CodeGenerator setup_code_gen(char const *input) {
+    Lexer  l;
+    Parser p;
+    Module m = parse(&l, &p, input);
+    lexer_destroy(l);
+
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+    TEST_ASSERT_EQUAL_size_t(0, ma.errors.count);
+    return code_gen_create(p, m, ma);
+}
+
+void test_code_gen_functions(void) {
+    CodeGenerator cg = setup_code_gen("fn add(a u32, b u32) u32 {\n"
+                                      "c := 3\n"
+                                      "}\n"
+                                      "fn main() u32 {\n"
+                                      "x : u32 = 42\n"
+                                      "}\n");
+    TEST_ASSERT_TRUE(code_gen(&cg));
+
+    LLVMValueRef add = LLVMGetNamedFunction(cg.module, "add");
+    TEST_ASSERT_NOT_NULL(add);
+    TEST_ASSERT_EQUAL(2, LLVMCountParams(add));
+    TEST_ASSERT_NOT_NULL(LLVMGetNamedFunction(cg.module, "main"));
+
+    TEST_ASSERT_TRUE(code_gen_optimize(&cg, CODE_GEN_OPT_LEVEL_O2));
+
+    code_gen_destroy(cg);
+}
+
+void test_code_gen_all_opt_levels(void) {
+    CodeGenOptLevel levels[] = {CODE_GEN_OPT_LEVEL_O0, CODE_GEN_OPT_LEVEL_O1,
+                                CODE_GEN_OPT_LEVEL_O2, CODE_GEN_OPT_LEVEL_O3};
+    for (usz i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        CodeGenerator cg = setup_code_gen("fn main() u32 {\nx := 1\n}\n");
+        TEST_ASSERT_TRUE(code_gen(&cg));
+        TEST_ASSERT_TRUE(code_gen_optimize(&cg, levels[i]));
+        code_gen_destroy(cg);
+    }
+}
+
+void test_optimize_for_target(void) {
+    CodeGenerator cg = setup_code_gen("fn main() u32 {\nx := 1\n}\n");
+    EmitOptions   target = emit_options_default();
+    target.cpu           = "native";
+    cg.target            = &target;
+    TEST_ASSERT_TRUE(code_gen(&cg));
+    TEST_ASSERT_EQUAL_STRING("", LLVMGetTarget(cg.module));
+
+    LLVMTargetMachineRef tm;
+    TEST_ASSERT_TRUE(emit_target_machine_create(&target, &tm));
+    char             *triple = LLVMGetTargetMachineTriple(tm);
+    LLVMTargetDataRef data   = LLVMCreateTargetDataLayout(tm);
+    char             *layout = LLVMCopyStringRepOfTargetData(data);
+
+    // The passes ran with the triple and data layout of the target.
+    TEST_ASSERT_TRUE(code_gen_optimize(&cg, CODE_GEN_OPT_LEVEL_O2));
+    TEST_ASSERT_EQUAL_STRING(triple, LLVMGetTarget(cg.module));
+    TEST_ASSERT_EQUAL_STRING(layout, LLVMGetDataLayoutStr(cg.module));
+
+    // The shards inherit the target.
+    CodeGenShards shards = code_gen_shards(&cg, 1, CODE_GEN_OPT_LEVEL_O2);
+    TEST_ASSERT_TRUE(code_gen_shards_ok(&shards));
+    TEST_ASSERT_EQUAL_STRING(triple, LLVMGetTarget(shards.items[0].cg.module));
+    TEST_ASSERT_EQUAL_STRING(layout,
+                             LLVMGetDataLayoutStr(shards.items[0].cg.module));
+    code_gen_shards_destroy(shards);
+
+    LLVMDisposeMessage(layout);
+    LLVMDisposeTargetData(data);
+    LLVMDisposeMessage(triple);
+    LLVMDisposeTargetMachine(tm);
+    code_gen_destroy(cg);
+}
+
+// Adds the whole module to the JIT as one object.
+void jit_add_compiled(Jit *jit, LLVMModuleRef module) {
+    EmitOptions         options = emit_options_default();
+    LLVMMemoryBufferRef object;
+    TEST_ASSERT_TRUE(
+        emit_to_memory(module, &options, EMIT_FILE_TYPE_OBJECT, &object));
+    TEST_ASSERT_TRUE(jit_add_object(jit, object));
+}
+
+void test_jit_run(void) {
+    CodeGenerator cg = setup_code_gen("fn helper(a u32) u32 {\n"
+                                      "    b : u32 = 2\n"
+                                      "}\n"
+                                      "fn main() u32 {\n"
+                                      "    x := 1\n"
+                                      "}\n");
+    Module       *m      = &cg.thor_module;
+    CodeGenShards shards = code_gen_function_shards(
+        &cg, m->top_level_nodes.items, m->top_level_nodes.count,
+        CODE_GEN_OPT_LEVEL_O1);
+    TEST_ASSERT_TRUE(code_gen_shards_ok(&shards));
+
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    TEST_ASSERT_TRUE(jit_add_shards(&jit, &shards));
+    // The modules moved into the JIT.
+    TEST_ASSERT_NULL(shards.items[0].cg.module);
+
+    void *main_address;
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "main", &main_address));
+    u32 (*thor_main)(void) = (u32 (*)(void))(uptr)main_address;
+    TEST_ASSERT_EQUAL_UINT32(0, thor_main());
+
+    void *helper_address;
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "helper", &helper_address));
+    u32 (*helper)(u32) = (u32 (*)(u32))(uptr)helper_address;
+    TEST_ASSERT_EQUAL_UINT32(0, helper(5));
+
+    void *missing;
+    TEST_ASSERT_FALSE(jit_lookup(&jit, "missing", &missing));
+
+    jit_destroy(&jit);
+    code_gen_shards_destroy(shards);
+    code_gen_destroy(cg);
+}
+
+void test_emit_to_memory(void) {
+    CodeGenerator cg = setup_code_gen("fn main() u32 {\nx := 1\n}\n");
+    TEST_ASSERT_TRUE(code_gen(&cg));
+
+    EmitOptions options = emit_options_default();
+    options.cpu         = "native";
+    options.opt_level   = CODE_GEN_OPT_LEVEL_O2;
+
+    LLVMMemoryBufferRef object;
+    TEST_ASSERT_TRUE(
+        emit_to_memory(cg.module, &options, EMIT_FILE_TYPE_OBJECT, &object));
+    TEST_ASSERT_TRUE(LLVMGetBufferSize(object) > 0);
+    LLVMDisposeMemoryBuffer(object);
+
+    LLVMMemoryBufferRef assembly;
+    TEST_ASSERT_TRUE(
+        emit_to_memory(cg.module, &options, EMIT_FILE_TYPE_ASSEMBLY, &assembly));
+    char *text = to_cstr((str){.ptr = (char *)LLVMGetBufferStart(assembly),
+                               .len = LLVMGetBufferSize(assembly)});
+    TEST_ASSERT_NOT_NULL(strstr(text, "main"));
+    free(text);
+    LLVMDisposeMemoryBuffer(assembly);
+
+    code_gen_destroy(cg);
+}
+
+void test_code_gen_shards(void) {
+    char const *input = "fn a(x u32) u32 {\n    y := 1\n}\n"
+                        "fn b() u32 {\n    y : u32 = 2\n}\n"
+                        "fn c(x u32, y u32) u32 {\n    z := 3\n}\n"
+                        "fn main() u32 {\n    w := 4\n}\n";
+    CodeGenerator cg = setup_code_gen(input);
+
+    CodeGenShards shards = code_gen_shards(&cg, 3, CODE_GEN_OPT_LEVEL_O2);
+    TEST_ASSERT_EQUAL_size_t(3, shards.count);
+    TEST_ASSERT_TRUE(code_gen_shards_ok(&shards));
+
+    // Every function is defined in exactly one shard, unused declarations are
+    // removed by the optimisation.
+    char const *names[] = {"a", "b", "c", "main"};
+    for (usz i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        usz definitions = 0;
+        for (usz s = 0; s < shards.count; s++) {
+            LLVMValueRef fn =
+                LLVMGetNamedFunction(shards.items[s].cg.module, names[i]);
+            definitions += fn != NULL && !LLVMIsDeclaration(fn);
+        }
+        TEST_ASSERT_EQUAL_size_t(1, definitions);
+    }
+
+    TEST_ASSERT_TRUE(code_gen_link_shards(&cg, &shards));
+    for (usz i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        LLVMValueRef fn = LLVMGetNamedFunction(cg.module, names[i]);
+        TEST_ASSERT_NOT_NULL(fn);
+        TEST_ASSERT_FALSE(LLVMIsDeclaration(fn));
+    }
+
+    code_gen_shards_destroy(shards);
+    code_gen_destroy(cg);
+}
+
+usz code_gen_with_cache(char const *dir, char const *input,
+                        BitcodeCacheStats *stats) {
+    CodeGenerator cg = setup_code_gen(input);
+    BitcodeCache  cache;
+    TEST_ASSERT_TRUE(bitcode_cache_open(&cache, dir));
+    TEST_ASSERT_TRUE(code_gen_cached(&cg, &cache, CODE_GEN_OPT_LEVEL_O2, stats));
+    TEST_ASSERT_NOT_NULL(LLVMGetNamedFunction(cg.module, "main"));
+    TEST_ASSERT_FALSE(LLVMIsDeclaration(LLVMGetNamedFunction(cg.module, "main")));
+    bitcode_cache_close(&cache);
+    code_gen_destroy(cg);
+    return stats->hits + stats->misses;
+}
+
+// Overwrites every entry of the cache directory with contents, or removes the
+// entries if contents is NULL.
+void cache_entries_replace(char const *dir, char const *contents) {
+    DIR *entries = opendir(dir);
+    TEST_ASSERT_NOT_NULL(entries);
+    for (struct dirent *entry = readdir(entries); entry != NULL;
+         entry                = readdir(entries)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (contents == NULL) {
+            remove(path);
+            continue;
+        }
+        FILE *file = fopen(path, "wb");
+        TEST_ASSERT_NOT_NULL(file);
+        fputs(contents, file);
+        fclose(file);
+    }
+    closedir(entries);
+}
+
+void test_bitcode_cache(void) {
+    char dir[] = "/tmp/thor-cache-XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+
+    char const *input   = "fn a(x u32) u32 {\n    return x + 1\n}\n"
+                          "fn b() u32 {\n    return 2\n}\n"
+                          "fn main() u32 {\n    return 0\n}\n";
+    char const *changed = "fn a(x u32) u32 {\n    return x + 1\n}\n"
+                          "fn b() u32 {\n    return 3\n}\n"
+                          "fn main() u32 {\n    return 0\n}\n";
+    BitcodeCacheStats stats;
+
+    TEST_ASSERT_EQUAL_size_t(3, code_gen_with_cache(dir, input, &stats));
+    TEST_ASSERT_EQUAL_size_t(3, stats.misses);
+
+    TEST_ASSERT_EQUAL_size_t(3, code_gen_with_cache(dir, input, &stats));
+    TEST_ASSERT_EQUAL_size_t(3, stats.hits);
+
+    // Only the changed function is generated again.
+    TEST_ASSERT_EQUAL_size_t(3, code_gen_with_cache(dir, changed, &stats));
+    TEST_ASSERT_EQUAL_size_t(2, stats.hits);
+    TEST_ASSERT_EQUAL_size_t(1, stats.misses);
+
+    // Broken entries are misses and are written again.
+    cache_entries_replace(dir, "broken");
+    TEST_ASSERT_EQUAL_size_t(3, code_gen_with_cache(dir, changed, &stats));
+    TEST_ASSERT_EQUAL_size_t(3, stats.misses);
+    TEST_ASSERT_EQUAL_size_t(3, code_gen_with_cache(dir, changed, &stats));
+    TEST_ASSERT_EQUAL_size_t(3, stats.hits);
+
+    cache_entries_replace(dir, NULL);
+    rmdir(dir);
+}
+
+// A module that only defines `fn name() u32 { return value }`.
+LLVMModuleRef constant_module(LLVMContextRef context, char const *name,
+                              u32 value) {
+    LLVMModuleRef module = LLVMModuleCreateWithNameInContext(name, context);
+    LLVMTypeRef   i32    = LLVMInt32TypeInContext(context);
+    LLVMValueRef  function =
+        LLVMAddFunction(module, name, LLVMFunctionType(i32, NULL, 0, false));
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(context);
+    LLVMPositionBuilderAtEnd(
+        builder, LLVMAppendBasicBlockInContext(context, function, ""));
+    LLVMBuildRet(builder, LLVMConstInt(i32, value, false));
+    LLVMDisposeBuilder(builder);
+    return module;
+}
+
+u32 cached_constant(BitcodeCache *cache, LLVMContextRef context,
+                    CacheKey key) {
+    LLVMModuleRef module;
+    TEST_ASSERT_TRUE(bitcode_cache_load(cache, key, context, &module));
+    LLVMValueRef function = LLVMGetFirstFunction(module);
+    LLVMValueRef ret =
+        LLVMGetBasicBlockTerminator(LLVMGetFirstBasicBlock(function));
+    u32 value = (u32)LLVMConstIntGetZExtValue(LLVMGetOperand(ret, 0));
+    LLVMDisposeModule(module);
+    return value;
+}
+
+void test_bitcode_cache_entries(void) {
+    BitcodeCache cache;
+    TEST_ASSERT_TRUE(bitcode_cache_open(&cache, NULL));
+    LLVMContextRef context = LLVMContextCreate();
+    CacheKey       key     = {.hash = 42, .source_len = 10};
+
+    LLVMModuleRef first = constant_module(context, "f", 1);
+    TEST_ASSERT_TRUE(bitcode_cache_store(&cache, key, first));
+    TEST_ASSERT_EQUAL_UINT32(1, cached_constant(&cache, context, key));
+
+    // Storing the key again replaces the entry.
+    LLVMModuleRef second = constant_module(context, "f", 2);
+    TEST_ASSERT_TRUE(bitcode_cache_store(&cache, key, second));
+    TEST_ASSERT_EQUAL_UINT32(2, cached_constant(&cache, context, key));
+
+    // The same hash for a source of another length is a collision.
+    LLVMModuleRef collision;
+    CacheKey      other = {.hash = 42, .source_len = 11};
+    TEST_ASSERT_FALSE(bitcode_cache_load(&cache, other, context, &collision));
+
+    LLVMDisposeModule(first);
+    LLVMDisposeModule(second);
+    LLVMContextDispose(context);
+    bitcode_cache_close(&cache);
+}
+
+usz count_calls(LLVMValueRef function) {
+    usz calls = 0;
+    for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(function);
+         block != NULL; block = LLVMGetNextBasicBlock(block)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(block); inst != NULL;
+             inst = LLVMGetNextInstruction(inst)) {
+            calls += LLVMIsACallInst(inst) != NULL;
+        }
+    }
+    return calls;
+}
+
+void test_thin_lto(void) {
+    CodeGenerator cg = setup_code_gen("fn main() u32 {\n"
+                                      "    return twice(square(3)) + 1\n"
+                                      "}\n"
+                                      "fn square(a u32) u32 {\n"
+                                      "    return a * a\n"
+                                      "}\n"
+                                      "fn twice(a u32) u32 {\n"
+                                      "    return a + a\n"
+                                      "}\n");
+
+    LtoModules modules = {0};
+    TEST_ASSERT_TRUE(
+        lto_modules_generate(&cg, 3, CODE_GEN_OPT_LEVEL_O2, &modules));
+    TEST_ASSERT_EQUAL_size_t(3, modules.count);
+    TEST_ASSERT_EQUAL_size_t(1, modules.items[0].functions.count);
+    TEST_ASSERT_EQUAL_STRING("main", modules.items[0].functions.items[0].name);
+    TEST_ASSERT_EQUAL_size_t(2,
+                             modules.items[0].functions.items[0].callees.count);
+
+    // Only main calls functions of other modules.
+    LtoIndex index = lto_thin_link(&modules, CODE_GEN_OPT_LEVEL_O2);
+    TEST_ASSERT_EQUAL_size_t(2, index.imports[0].count);
+    TEST_ASSERT_EQUAL_size_t(0, index.imports[1].count);
+    TEST_ASSERT_EQUAL_size_t(0, index.imports[2].count);
+
+    LtoBackends backends =
+        lto_thin_backends(&modules, &index, CODE_GEN_OPT_LEVEL_O2);
+    TEST_ASSERT_TRUE(lto_backends_ok(&backends));
+
+    // The imports are inlined and not defined in the backend of main.
+    LLVMModuleRef main_module = backends.items[0].module;
+    TEST_ASSERT_EQUAL_size_t(
+        0, count_calls(LLVMGetNamedFunction(main_module, "main")));
+    LLVMValueRef square = LLVMGetNamedFunction(main_module, "square");
+    TEST_ASSERT_TRUE(square == NULL || LLVMIsDeclaration(square));
+
+    TEST_ASSERT_TRUE(lto_link_backends(&cg, &backends));
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    jit_add_compiled(&jit, cg.module);
+    void *main_address;
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "main", &main_address));
+    u32 (*thor_main)(void) = (u32 (*)(void))(uptr)main_address;
+    TEST_ASSERT_EQUAL_UINT32(19, thor_main());
+    jit_destroy(&jit);
+
+    lto_backends_destroy(backends);
+    lto_index_destroy(&index);
+    lto_modules_destroy(modules);
+    code_gen_destroy(cg);
+}
+
+void test_vectors(void) {
+    CodeGenerator cg = setup_code_gen(
+        "fn dot(a u32x4, b u32x4) u32 {\n"
+        "    p := a * b\n"
+        "    s := p + shuffle(p, p, 2, 3, 0, 1)\n"
+        "    return extract(s, 0) + extract(s, 1)\n"
+        "}\n"
+        "fn main() u32 {\n"
+        "    v := insert(u32x4(1), 3, 4) + 1\n"
+        "    return dot(v, u32x4(1, 2, 3, 4))\n"
+        "}\n");
+    TEST_ASSERT_TRUE(code_gen(&cg));
+    TEST_ASSERT_TRUE(code_gen_optimize(&cg, CODE_GEN_OPT_LEVEL_O2));
+
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    jit_add_compiled(&jit, cg.module);
+    void *main_address;
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "main", &main_address));
+    u32 (*thor_main)(void) = (u32 (*)(void))(uptr)main_address;
+    // (2, 2, 2, 5) . (1, 2, 3, 4)
+    TEST_ASSERT_EQUAL_UINT32(32, thor_main());
+
+    jit_destroy(&jit);
+    code_gen_destroy(cg);
+}
+
+void test_number_types(void) {
+    CodeGenerator cg = setup_code_gen(
+        "fn wrap(a u8, b i16) i16 {\n"
+        "    return a * 2 + b\n"
+        "}\n"
+        "fn big(a u32) u64 {\n"
+        "    return a * 8589934592\n"
+        "}\n"
+        "fn scale(a f32, b u16) f64 {\n"
+        "    v := f32x4(a) * 2 + b\n"
+        "    return extract(v, 3) + 0.25\n"
+        "}\n");
+    Module       *m      = &cg.thor_module;
+    CodeGenShards shards = code_gen_function_shards(
+        &cg, m->top_level_nodes.items, m->top_level_nodes.count,
+        CODE_GEN_OPT_LEVEL_O1);
+    TEST_ASSERT_TRUE(code_gen_shards_ok(&shards));
+
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    TEST_ASSERT_TRUE(jit_add_shards(&jit, &shards));
+    // The modules moved into the JIT.
+    TEST_ASSERT_NULL(shards.items[0].cg.module);
+    void *address;
+
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "wrap", &address));
+    i16 (*wrap)(u8, i16) = (i16 (*)(u8, i16))(uptr)address;
+    // u8 arithmetic wraps before the conversion to i16
+    TEST_ASSERT_EQUAL_INT(-1, wrap(128, -1));
+    TEST_ASSERT_EQUAL_INT(-3, wrap(2, -7));
+
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "big", &address));
+    u64 (*big)(u32) = (u64 (*)(u32))(uptr)address;
+    TEST_ASSERT_TRUE(big(3) == 3ull << 33);
+
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "scale", &address));
+    f64 (*scale)(f32, u16) = (f64 (*)(f32, u16))(uptr)address;
+    TEST_ASSERT_TRUE(scale(1.5f, 7) == 10.25);
+
+    jit_destroy(&jit);
+    code_gen_destroy(cg);
+}
+
+void test_function_attributes(void) {
+    CodeGenerator cg = setup_code_gen("@inline @pure fn twice(a u32) u32 {\n"
+                                      "    return a * 2\n"
+                                      "}\n"
+                                      "@fastcc @cold fn slow(a u32) u32 {\n"
+                                      "    return a + 1\n"
+                                      "}\n"
+                                      "fn main() u32 {\n"
+                                      "    return twice(slow(3))\n"
+                                      "}\n");
+    TEST_ASSERT_TRUE(code_gen(&cg));
+
+    LLVMValueRef twice = LLVMGetNamedFunction(cg.module, "twice");
+    LLVMValueRef slow  = LLVMGetNamedFunction(cg.module, "slow");
+    char const  *names[] = {"alwaysinline", "readnone", "nounwind"};
+    for (usz i = 0; i < 3; i++) {
+        TEST_ASSERT_NOT_NULL(LLVMGetEnumAttributeAtIndex(
+            twice, LLVMAttributeFunctionIndex,
+            LLVMGetEnumAttributeKindForName(names[i], strlen(names[i]))));
+    }
+    TEST_ASSERT_EQUAL(LLVMFastCallConv, LLVMGetFunctionCallConv(slow));
+
+    // The always inliner runs at O0 too, the fastcc call stays.
+    TEST_ASSERT_TRUE(code_gen_optimize(&cg, CODE_GEN_OPT_LEVEL_O0));
+    TEST_ASSERT_EQUAL_size_t(1, count_calls(LLVMGetNamedFunction(cg.module, "main")));
+
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    jit_add_compiled(&jit, cg.module);
+    void *main_address;
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "main", &main_address));
+    u32 (*thor_main)(void) = (u32 (*)(void))(uptr)main_address;
+    TEST_ASSERT_EQUAL_UINT32(8, thor_main());
+
+    jit_destroy(&jit);
+    code_gen_destroy(cg);
+}
+
+void test_loops(void) {
+    CodeGenerator cg = setup_code_gen("fn sum(n u32) u64 {\n"
+                                      "    s : u64 = 0\n"
+                                      "    #unroll(4) #vectorize(4)\n"
+                                      "    for i in 0..n {\n"
+                                      "        s = s + i\n"
+                                      "    }\n"
+                                      "    return s\n"
+                                      "}\n"
+                                      "fn halve(n i32) i32 {\n"
+                                      "    steps : i32 = 0\n"
+                                      "    while n > 1 {\n"
+                                      "        n = n * 1\n"
+                                      "        steps = steps + 1\n"
+                                      "        #parallel for j in 0..2 {\n"
+                                      "            k := j\n"
+                                      "        }\n"
+                                      "        n = n - 2\n"
+                                      "    }\n"
+                                      "    return steps\n"
+                                      "}\n");
+    TEST_ASSERT_TRUE(code_gen(&cg));
+
+    char *ir = LLVMPrintModuleToString(cg.module);
+    TEST_ASSERT_NOT_NULL(strstr(ir, "!\"llvm.loop.unroll.count\", i32 4"));
+    TEST_ASSERT_NOT_NULL(strstr(ir, "!\"llvm.loop.vectorize.width\", i32 4"));
+    TEST_ASSERT_NOT_NULL(strstr(ir, "!\"llvm.loop.vectorize.enable\", i1 true"));
+    LLVMDisposeMessage(ir);
+
+    TEST_ASSERT_TRUE(code_gen_optimize(&cg, CODE_GEN_OPT_LEVEL_O2));
+
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    jit_add_compiled(&jit, cg.module);
+    void *address;
+
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "sum", &address));
+    u64 (*sum)(u32) = (u64 (*)(u32))(uptr)address;
+    TEST_ASSERT_TRUE(sum(0) == 0);
+    TEST_ASSERT_TRUE(sum(101) == 5050);
+
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "halve", &address));
+    i32 (*halve)(i32) = (i32 (*)(i32))(uptr)address;
+    TEST_ASSERT_EQUAL_INT(0, halve(1));
+    TEST_ASSERT_EQUAL_INT(5, halve(10));
+
+    jit_destroy(&jit);
+    code_gen_destroy(cg);
+}
+
+void test_comptime(void) {
+    CodeGenerator cg = setup_code_gen("comptime squares := squaresum(4)\n"
+                                      "comptime lanes := u32x4(1, 2, 3, 4) * 3\n"
+                                      "comptime half : f32 = 0.5 * 3\n"
+                                      "@pure fn squaresum(n u32) u64 {\n"
+                                      "    s : u64 = 0\n"
+                                      "    for i in 0..n {\n"
+                                      "        s = s + i * i\n"
+                                      "    }\n"
+                                      "    return s\n"
+                                      "}\n"
+                                      "fn squaresof() u64 {\n"
+                                      "    return squares\n"
+                                      "}\n"
+                                      "fn lane() u32 {\n"
+                                      "    return extract(lanes, 2)\n"
+                                      "}\n"
+                                      "fn halfof() f32 {\n"
+                                      "    return half\n"
+                                      "}\n");
+    TEST_ASSERT_TRUE(code_gen(&cg));
+
+    char *ir = LLVMPrintModuleToString(cg.module);
+    TEST_ASSERT_NOT_NULL(strstr(
+        ir, "private unnamed_addr constant <4 x i32> <i32 3, i32 6, i32 9, "
+            "i32 12>"));
+    TEST_ASSERT_NOT_NULL(strstr(ir, "private unnamed_addr constant i64 14"));
+    LLVMDisposeMessage(ir);
+
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    jit_add_compiled(&jit, cg.module);
+    void *address;
+
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "squaresof", &address));
+    TEST_ASSERT_TRUE(((u64 (*)(void))(uptr)address)() == 14);
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "lane", &address));
+    TEST_ASSERT_EQUAL_UINT32(9, ((u32 (*)(void))(uptr)address)());
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "halfof", &address));
+    TEST_ASSERT_TRUE(((f32 (*)(void))(uptr)address)() == 1.5f);
+
+    jit_destroy(&jit);
+    code_gen_destroy(cg);
+}
+
+void test_arenas(void) {
+    CodeGenerator cg = setup_code_gen("fn spacing() u64 {\n"
+                                      "    a := arena(64)\n"
+                                      "    first := alloc(a, 10)\n"
+                                      "    second := alloc(a, 20)\n"
+                                      "    done := release(a)\n"
+                                      "    return second - first\n"
+                                      "}\n"
+                                      "fn reuse() bool {\n"
+                                      "    a := arena(64)\n"
+                                      "    first := alloc(a, 48)\n"
+                                      "    big := alloc(a, 1000)\n"
+                                      "    second := alloc(a, 32)\n"
+                                      "    a = reset(a)\n"
+                                      "    again := alloc(a, 8)\n"
+                                      "    done := release(a)\n"
+                                      "    return again == second\n"
+                                      "}\n"
+                                      "fn empty() u64 {\n"
+                                      "    a := arena(64)\n"
+                                      "    first := alloc(a, 0)\n"
+                                      "    done := release(a)\n"
+                                      "    return first\n"
+                                      "}\n"
+                                      "fn released() u64 {\n"
+                                      "    a := arena(64)\n"
+                                      "    a = release(a)\n"
+                                      "    a = reset(a)\n"
+                                      "    return alloc(a, 8)\n"
+                                      "}\n");
+    TEST_ASSERT_TRUE(code_gen(&cg));
+
+    // Only allocations that do not fit call the runtime.
+    LLVMValueRef slow = LLVMGetNamedFunction(cg.module, "thor_arena_alloc_slow");
+    TEST_ASSERT_NOT_NULL(slow);
+    TEST_ASSERT_TRUE(LLVMIsDeclaration(slow));
+    char *ir = LLVMPrintModuleToString(cg.module);
+    TEST_ASSERT_NOT_NULL(strstr(ir, "!\"branch_weights\", i32 2000, i32 1"));
+    LLVMDisposeMessage(ir);
+
+    TEST_ASSERT_TRUE(code_gen_optimize(&cg, CODE_GEN_OPT_LEVEL_O2));
+
+    Jit jit;
+    TEST_ASSERT_TRUE(jit_create(&jit));
+    jit_add_compiled(&jit, cg.module);
+    void *address;
+
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "spacing", &address));
+    TEST_ASSERT_TRUE(((u64 (*)(void))(uptr)address)() == 16);
+    // The large allocation gets its own block, the block of the second
+    // allocation is kept by the reset.
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "reuse", &address));
+    TEST_ASSERT_TRUE(((bool (*)(void))(uptr)address)());
+    // A new arena has no block, size 0 takes the slow path too.
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "empty", &address));
+    TEST_ASSERT_TRUE(((u64 (*)(void))(uptr)address)() != 0);
+    TEST_ASSERT_TRUE(jit_lookup(&jit, "released", &address));
+    TEST_ASSERT_TRUE(((u64 (*)(void))(uptr)address)() == 0);
+
+    jit_destroy(&jit);
+    code_gen_destroy(cg);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_code_gen_functions);
+    RUN_TEST(test_code_gen_all_opt_levels);
+    RUN_TEST(test_optimize_for_target);
+    RUN_TEST(test_jit_run);
+    RUN_TEST(test_emit_to_memory);
+    RUN_TEST(test_code_gen_shards);
+    RUN_TEST(test_bitcode_cache);
+    RUN_TEST(test_bitcode_cache_entries);
+    RUN_TEST(test_thin_lto);
+    RUN_TEST(test_vectors);
+    RUN_TEST(test_number_types);
+    RUN_TEST(test_function_attributes);
+    RUN_TEST(test_loops);
+    RUN_TEST(test_comptime);
+    RUN_TEST(test_arenas);
+    return UNITY_END();
+}
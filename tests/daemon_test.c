@@ -0,0 +1,134 @@
+// mkdtemp, fork, nanosleep
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+#include "daemon.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// The exit code tells the test what the daemon received.
+int echo_handler(int argc, char **argv, void *data) {
+    char const *cwd = data;
+    char        actual[4096];
+    if (getcwd(actual, sizeof(actual)) == NULL || strcmp(actual, cwd) != 0) {
+        return 100;
+    }
+    return argc * 10 + atoi(argv[argc - 1]);
+}
+
+int socket_connect(char const *path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(
+        0, connect(fd, (struct sockaddr *)&address, sizeof(address)));
+    return fd;
+}
+
+// Sends a compile request header with the std fds as a client would, the
+// header is laid out as kind, argc and payload size.
+i32 send_raw_header(char const *path, u32 argc, u32 size) {
+    int fd = socket_connect(path);
+    u32 header[3] = {0, argc, size};
+    union {
+        char           bytes[CMSG_SPACE(sizeof(int) * 3)];
+        struct cmsghdr align;
+    } control;
+    struct iovec  iov = {.iov_base = header, .iov_len = sizeof(header)};
+    struct msghdr msg = {.msg_iov        = &iov,
+                         .msg_iovlen     = 1,
+                         .msg_control    = control.bytes,
+                         .msg_controllen = sizeof(control.bytes)};
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level     = SOL_SOCKET;
+    cmsg->cmsg_type      = SCM_RIGHTS;
+    cmsg->cmsg_len       = CMSG_LEN(sizeof(int) * 3);
+    memcpy(CMSG_DATA(cmsg), (int[]){0, 1, 2}, sizeof(int) * 3);
+    TEST_ASSERT_TRUE(sendmsg(fd, &msg, 0) == sizeof(header));
+
+    i32 exit_code = 0;
+    TEST_ASSERT_TRUE(recv(fd, &exit_code, sizeof(exit_code), MSG_WAITALL) ==
+                     sizeof(exit_code));
+    close(fd);
+    return exit_code;
+}
+
+void test_daemon_requests(void) {
+    char dir[] = "/tmp/thor-daemon-XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char socket[64];
+    snprintf(socket, sizeof(socket), "%s/socket", dir);
+
+    int exit_code = 0;
+    TEST_ASSERT_FALSE(daemon_request(socket, 1, (char *[]){"thorc"},
+                                     &exit_code));
+
+    pid_t daemon = fork();
+    TEST_ASSERT_TRUE(daemon >= 0);
+    if (daemon == 0) {
+        // The handler runs in the directory of the client.
+        char cwd[4096];
+        if (getcwd(cwd, sizeof(cwd)) == NULL) {
+            _exit(2);
+        }
+        if (chdir("/") != 0) {
+            _exit(2);
+        }
+        _exit(daemon_serve(socket, echo_handler, cwd) ? 0 : 1);
+    }
+
+    // Waits until the daemon listens
+    bool listening = false;
+    for (int i = 0; i < 500 && !listening; i++) {
+        listening = access(socket, F_OK) == 0;
+        nanosleep(&(struct timespec){.tv_nsec = 10000000}, NULL);
+    }
+    TEST_ASSERT_TRUE(listening);
+
+    TEST_ASSERT_TRUE(daemon_request(socket, 2, (char *[]){"thorc", "7"},
+                                    &exit_code));
+    TEST_ASSERT_EQUAL_INT(27, exit_code);
+    TEST_ASSERT_TRUE(daemon_request(
+        socket, 4, (char *[]){"thorc", "-O2", "main.th", "3"}, &exit_code));
+    TEST_ASSERT_EQUAL_INT(43, exit_code);
+    TEST_ASSERT_FALSE(daemon_serve(socket, echo_handler, NULL));
+
+    // A client that stalls in its request is dropped, the next one is served.
+    int stalled = socket_connect(socket);
+    TEST_ASSERT_TRUE(send(stalled, "\0\0", 2, 0) == 2);
+    TEST_ASSERT_TRUE(daemon_request(socket, 2, (char *[]){"thorc", "5"},
+                                    &exit_code));
+    TEST_ASSERT_EQUAL_INT(25, exit_code);
+    close(stalled);
+
+    // Headers with more arguments than the payload can hold are rejected.
+    TEST_ASSERT_EQUAL_INT(1, send_raw_header(socket, 0xFFFFFFFF, 0));
+    TEST_ASSERT_EQUAL_INT(1, send_raw_header(socket, 3, 2));
+    TEST_ASSERT_TRUE(daemon_request(socket, 2, (char *[]){"thorc", "6"},
+                                    &exit_code));
+    TEST_ASSERT_EQUAL_INT(26, exit_code);
+
+    TEST_ASSERT_TRUE(daemon_stop(socket));
+    int status;
+    TEST_ASSERT_EQUAL_INT(daemon, waitpid(daemon, &status, 0));
+    TEST_ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    TEST_ASSERT_FALSE(access(socket, F_OK) == 0);
+    rmdir(dir);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_daemon_requests);
+    return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "da.h"
+#include "interface.h"
+#include "language.h"
+#include "lexer.h"
+#include "parser.h"
+#include "test_common.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) { string_pool_free_all(); }
+
+char *clone_cstr(char const *s) { return to_cstr((str){(char *)s, strlen(s)}); }
+
+InterfaceFunction function(char const *name, Type return_type,
+                           FunctionAttributes attributes, usz argument_count,
+                           Type const *argument_types) {
+    InterfaceFunction f = {
+        .name        = clone_cstr(name),
+        .return_type = return_type,
+        .attributes  = attributes,
+    };
+    for (usz i = 0; i < argument_count; i++) {
+        da_append(&f.argument_types, argument_types[i]);
+    }
+    return f;
+}
+
+ModuleInterface sample_interface(void) {
+    ModuleInterface interface = {.name = clone_cstr("math")};
+    Type            vector[]  = {{.type = BUILTIN_TYPE_F32, .lanes = 4},
+                                 {.type = BUILTIN_TYPE_F32}};
+    Type            scalar[]  = {{.type = BUILTIN_TYPE_U32}};
+    module_interface_add(
+        &interface, function("scale", vector[0],
+                             FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_EXPORT),
+                             2, vector));
+    module_interface_add(
+        &interface,
+        function("double", scalar[0],
+                 FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_EXPORT) |
+                     FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_PURE),
+                 1, scalar));
+    return interface;
+}
+
+void test_interface_round_trip(void) {
+    ModuleInterface interface = sample_interface();
+    str             bytes     = interface_serialize(&interface);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(INTERFACE_MAGIC, bytes.ptr, 3));
+    TEST_ASSERT_EQUAL_INT(INTERFACE_VERSION, bytes.ptr[3]);
+
+    ModuleInterface read;
+    TEST_ASSERT_TRUE(interface_deserialize(bytes, &read));
+    TEST_ASSERT_EQUAL_STRING("math", read.name);
+    TEST_ASSERT_EQUAL_size_t(2, read.functions.count);
+    // Sorted by name
+    InterfaceFunction *first = &read.functions.items[0];
+    TEST_ASSERT_EQUAL_STRING("double", first->name);
+    TEST_ASSERT_EQUAL(BUILTIN_TYPE_U32, first->return_type.type);
+    TEST_ASSERT_TRUE(first->attributes &
+                     FUNCTION_ATTRIBUTE_BIT(FUNCTION_ATTRIBUTE_PURE));
+    InterfaceFunction *second = &read.functions.items[1];
+    TEST_ASSERT_EQUAL_STRING("scale", second->name);
+    TEST_ASSERT_EQUAL_size_t(2, second->argument_types.count);
+    TEST_ASSERT_EQUAL_UINT32(4, second->argument_types.items[0].lanes);
+    TEST_ASSERT_EQUAL(BUILTIN_TYPE_F32, second->argument_types.items[1].type);
+
+    // The same interface gives the same bytes.
+    str again = interface_serialize(&read);
+    TEST_ASSERT_TRUE(str_equal(bytes, again));
+
+    str_destroy(again);
+    str_destroy(bytes);
+    module_interface_destroy(&read);
+    module_interface_destroy(&interface);
+}
+
+void test_interface_invalid(void) {
+    ModuleInterface interface = sample_interface();
+    str             bytes     = interface_serialize(&interface);
+    ModuleInterface read;
+
+    for (usz len = 0; len < bytes.len; len++) {
+        TEST_ASSERT_FALSE(
+            interface_deserialize((str){.ptr = bytes.ptr, .len = len}, &read));
+    }
+
+    char *changed = malloc(bytes.len + 1);
+    memcpy(changed, bytes.ptr, bytes.len);
+    changed[bytes.len] = 0;
+    // Trailing bytes
+    TEST_ASSERT_FALSE(interface_deserialize(
+        (str){.ptr = changed, .len = bytes.len + 1}, &read));
+    // Another version
+    changed[3] = INTERFACE_VERSION + 1;
+    TEST_ASSERT_FALSE(
+        interface_deserialize((str){.ptr = changed, .len = bytes.len}, &read));
+    // The last argument type is f32, 0 is no type
+    memcpy(changed, bytes.ptr, bytes.len);
+    changed[bytes.len - 2] = BUILTIN_TYPE_NONE;
+    TEST_ASSERT_FALSE(
+        interface_deserialize((str){.ptr = changed, .len = bytes.len}, &read));
+
+    free(changed);
+    str_destroy(bytes);
+    module_interface_destroy(&interface);
+}
+
+void test_interface_import(void) {
+    Lexer         l;
+    Parser        p;
+    Module        m  = parse(&l, &p,
+                             "module math\n"
+                             "@export @pure\n"
+                             "fn double(a u32) u32 {\n"
+                             "    return helper(a) * 2\n"
+                             "}\n"
+                             "@pure fn helper(a u32) u32 {\n"
+                             "    return a\n"
+                             "}\n");
+    ModuleAnalyse ma = analyse_module(&m, &p.tokens, p.input);
+    TEST_ASSERT_EQUAL_size_t(0, ma.errors.count);
+    TEST_ASSERT_FALSE(module_is_main(&m));
+
+    ModuleInterface exported = analyse_module_interface(&m, &ma);
+    TEST_ASSERT_EQUAL_STRING("math", exported.name);
+    TEST_ASSERT_EQUAL_size_t(1, exported.functions.count);
+    TEST_ASSERT_EQUAL_STRING("double", exported.functions.items[0].name);
+
+    AnalyseFunction *helper = analyse_find_function(&ma, ma.root_scope, "helper");
+    char            *name   = analyse_symbol_name(&m, helper);
+    TEST_ASSERT_EQUAL_STRING("math.helper", name);
+    free(name);
+
+    // The importer only sees the interface.
+    ModuleInterfaces imports = {0};
+    str              bytes   = interface_serialize(&exported);
+    ModuleInterface  read;
+    TEST_ASSERT_TRUE(interface_deserialize(bytes, &read));
+    da_append(&imports, read);
+    str_destroy(bytes);
+
+    Lexer         importer_l;
+    Parser        importer_p;
+    Module        importer    = parse(&importer_l, &importer_p,
+                                      "import math\n"
+                                      "fn main() u32 {\n"
+                                      "    return double(21)\n"
+                                      "}\n");
+    ModuleAnalyse importer_ma = analyse_module_with_imports(
+        &importer, &importer_p.tokens, importer_p.input, &imports, 0);
+    TEST_ASSERT_EQUAL_size_t(0, importer_ma.errors.count);
+    TEST_ASSERT_TRUE(module_is_main(&importer));
+
+    AnalyseFunction *imported =
+        analyse_find_function(&importer_ma, importer_ma.root_scope, "double");
+    TEST_ASSERT_NOT_NULL(imported);
+    TEST_ASSERT_EQUAL_STRING("math", imported->module);
+    TEST_ASSERT_EQUAL(ANALYSE_SYMBOL_KIND_IMPORTED_FUNCTION,
+                      importer_ma.symbols.items[imported->symbol].kind);
+    name = analyse_symbol_name(&importer, imported);
+    TEST_ASSERT_EQUAL_STRING("math.double", name);
+    free(name);
+    AnalyseFunction *main_function =
+        analyse_find_function(&importer_ma, importer_ma.root_scope, "main");
+    name = analyse_symbol_name(&importer, main_function);
+    TEST_ASSERT_EQUAL_STRING("main", name);
+    free(name);
+    free_module_analyse(&importer_ma);
+
+    // Without the interface the import and the call are errors.
+    importer_ma = analyse_module(&importer, &importer_p.tokens,
+                                 importer_p.input);
+    TEST_ASSERT_EQUAL_size_t(2, importer_ma.errors.count);
+    TEST_ASSERT_EQUAL(ANALYSE_ERROR_UNKNOWN_MODULE,
+                      importer_ma.errors.items[0].type);
+
+    free_module_analyse(&importer_ma);
+    module_destroy(importer);
+    parser_destroy(importer_p);
+    lexer_destroy(importer_l);
+    module_interfaces_destroy(&imports);
+    module_interface_destroy(&exported);
+    free_module_analyse(&ma);
+    module_destroy(m);
+    parser_destroy(p);
+    lexer_destroy(l);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_interface_round_trip);
+    RUN_TEST(test_interface_invalid);
+    RUN_TEST(test_interface_import);
+    return UNITY_END();
+}
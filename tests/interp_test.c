@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "bytecode/bytecode.h"
+#include "bytecode/interp.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "lexer.h"
+#include "parser.h"
+#include "test_common.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) { string_pool_free_all(); }
+
+typedef struct InterpSetup InterpSetup;
+struct InterpSetup {
+    Parser          p;
+    Module          m;
+    ModuleAnalyse   ma;
+    BytecodeProgram program;
+    Interp          interp;
+};
+
+void setup_interp(InterpSetup *out, char const *input) {
+    Lexer l;
+    out->m = parse(&l, &out->p, input);
+    lexer_destroy(l);
+
+    out->ma = analyse_module(&out->m, &out->p.tokens, out->p.input);
+    TEST_ASSERT_EQUAL_size_t(0, out->ma.errors.count);
+    TEST_ASSERT_TRUE(bytecode_compile(&out->m, &out->ma, &out->p.tokens,
+                                      out->p.input, &out->program));
+    interp_create(&out->interp, &out->program);
+}
+
+void destroy_interp(InterpSetup *setup) {
+    interp_destroy(&setup->interp);
+    bytecode_program_destroy(&setup->program);
+    free_module_analyse(&setup->ma);
+    module_destroy(setup->m);
+    parser_destroy(setup->p);
+}
+
+BytecodeSlot call(InterpSetup *setup, char const *name,
+                  BytecodeSlot const *args) {
+    Index function = bytecode_find_function(&setup->program, name);
+    TEST_ASSERT_TRUE(function != BYTECODE_NO_FUNCTION);
+    BytecodeSlot result[VECTOR_MAX_LANES] = {0};
+    TEST_ASSERT_TRUE(interp_call(&setup->interp, function, args, result));
+    return result[0];
+}
+
+void test_interp_functions(void) {
+    InterpSetup setup;
+    setup_interp(&setup, "fn helper(a u32) u32 {\n"
+                         "    b : u32 = 2\n"
+                         "}\n"
+                         "fn twice(a u32) u32 {\n"
+                         "    return a * 2\n"
+                         "}\n"
+                         "fn main() u32 {\n"
+                         "    return twice(twice(3)) + helper(1)\n"
+                         "}\n");
+    TEST_ASSERT_EQUAL_size_t(3, setup.program.functions.count);
+    TEST_ASSERT_TRUE(bytecode_find_function(&setup.program, "missing") ==
+                     BYTECODE_NO_FUNCTION);
+
+    BytecodeSlot args[] = {{.u = 5}};
+    TEST_ASSERT_TRUE(call(&setup, "helper", args).u == 0);
+    TEST_ASSERT_TRUE(call(&setup, "main", NULL).u == 12);
+
+    destroy_interp(&setup);
+}
+
+void test_interp_number_types(void) {
+    InterpSetup setup;
+    setup_interp(&setup, "fn wrap(a u8, b i16) i16 {\n"
+                         "    return a * 2 + b\n"
+                         "}\n"
+                         "fn less(a i8, b i8) bool {\n"
+                         "    return a < b\n"
+                         "}\n"
+                         "fn big(a u32) u64 {\n"
+                         "    return a * 8589934592\n"
+                         "}\n"
+                         "fn scale(a f32, b u16) f64 {\n"
+                         "    v := f32x4(a) * 2 + b\n"
+                         "    return extract(v, 3) + 0.25\n"
+                         "}\n");
+
+    // u8 arithmetic wraps before the conversion to i16
+    BytecodeSlot wrap_args[] = {{.u = 128}, {.i = -1}};
+    TEST_ASSERT_TRUE(call(&setup, "wrap", wrap_args).i == -1);
+    BytecodeSlot less_args[] = {{.i = -5}, {.i = 3}};
+    TEST_ASSERT_TRUE(call(&setup, "less", less_args).u == 1);
+    BytecodeSlot big_args[] = {{.u = 3}};
+    TEST_ASSERT_TRUE(call(&setup, "big", big_args).u == 3ull << 33);
+    BytecodeSlot scale_args[] = {{.f32 = 1.5f}, {.u = 7}};
+    TEST_ASSERT_TRUE(call(&setup, "scale", scale_args).f64 == 10.25);
+
+    destroy_interp(&setup);
+}
+
+void test_interp_loops(void) {
+    InterpSetup setup;
+    setup_interp(&setup, "fn sum(n u32) u64 {\n"
+                         "    s : u64 = 0\n"
+                         "    for i in 0..n {\n"
+                         "        s = s + i\n"
+                         "    }\n"
+                         "    return s\n"
+                         "}\n"
+                         "fn halve(n i32) i32 {\n"
+                         "    steps : i32 = 0\n"
+                         "    while n > 1 {\n"
+                         "        steps = steps + 1\n"
+                         "        n = n - 2\n"
+                         "    }\n"
+                         "    return steps\n"
+                         "}\n"
+                         "fn fib(n u32) u32 {\n"
+                         "    while n < 2 {\n"
+                         "        return n\n"
+                         "    }\n"
+                         "    return fib(n - 1) + fib(n - 2)\n"
+                         "}\n");
+
+    BytecodeSlot args[] = {{.u = 0}};
+    TEST_ASSERT_TRUE(call(&setup, "sum", args).u == 0);
+    args[0].u = 101;
+    TEST_ASSERT_TRUE(call(&setup, "sum", args).u == 5050);
+    args[0].i = 10;
+    TEST_ASSERT_TRUE(call(&setup, "halve", args).i == 5);
+    args[0].u = 20;
+    TEST_ASSERT_TRUE(call(&setup, "fib", args).u == 6765);
+
+    destroy_interp(&setup);
+}
+
+void test_interp_vectors(void) {
+    InterpSetup setup;
+    setup_interp(&setup, "comptime offset := u32x4(1, 2, 3, 4) * 3\n"
+                         "fn dot(a u32x4, b u32x4) u32 {\n"
+                         "    p := a * b\n"
+                         "    s := p + shuffle(p, p, 2, 3, 0, 1)\n"
+                         "    return extract(s, 0) + extract(s, 1)\n"
+                         "}\n"
+                         "fn scaled() u32x4 {\n"
+                         "    return offset * 2\n"
+                         "}\n"
+                         "fn main() u32 {\n"
+                         "    v := insert(u32x4(1), 3, 4) + 1\n"
+                         "    return dot(v, u32x4(1, 2, 3, 4)) + extract(offset, 2)\n"
+                         "}\n");
+
+    // (2, 2, 2, 5) . (1, 2, 3, 4) + 9
+    TEST_ASSERT_TRUE(call(&setup, "main", NULL).u == 41);
+
+    // Every lane of a vector result is returned.
+    BytecodeSlot lanes[4];
+    TEST_ASSERT_TRUE(interp_call(
+        &setup.interp, bytecode_find_function(&setup.program, "scaled"), NULL,
+        lanes));
+    TEST_ASSERT_TRUE(lanes[0].u == 6 && lanes[3].u == 24);
+
+    destroy_interp(&setup);
+}
+
+void test_interp_arenas(void) {
+    InterpSetup setup;
+    setup_interp(&setup, "fn spacing() u64 {\n"
+                         "    a := arena(64)\n"
+                         "    first := alloc(a, 10)\n"
+                         "    second := alloc(a, 20)\n"
+                         "    done := release(a)\n"
+                         "    return second - first\n"
+                         "}\n");
+
+    TEST_ASSERT_TRUE(call(&setup, "spacing", NULL).u == 16);
+
+    destroy_interp(&setup);
+}
+
+void test_interp_stack_overflow(void) {
+    InterpSetup setup;
+    setup_interp(&setup, "fn forever(n u32) u32 {\n"
+                         "    return forever(n + 1)\n"
+                         "}\n");
+
+    BytecodeSlot args[] = {{.u = 0}};
+    BytecodeSlot result;
+    TEST_ASSERT_FALSE(interp_call(&setup.interp,
+                                  bytecode_find_function(&setup.program,
+                                                         "forever"),
+                                  args, &result));
+
+    destroy_interp(&setup);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_interp_functions);
+    RUN_TEST(test_interp_number_types);
+    RUN_TEST(test_interp_loops);
+    RUN_TEST(test_interp_vectors);
+    RUN_TEST(test_interp_arenas);
+    RUN_TEST(test_interp_stack_overflow);
+    return UNITY_END();
+}
@@ -21,10 +21,9 @@ void expect_identifier(Lexer *l, Tokens *t, Index i, char const *expected) {
     str_destroy(expected_str);
 }
 
-void expect_integer(Tokens *t, Index i, int expected) {
+void expect_integer(Tokens *t, Index i, u64 expected) {
     TEST_ASSERT_EQUAL(TOKEN_TYPE_INTEGER, t->tokens[i].type);
-    TEST_ASSERT_EQUAL_INT(expected,
-                          extra_data_integer(t, t->tokens[i].extra_data));
+    TEST_ASSERT_TRUE(expected == extra_data_integer(t, t->tokens[i].extra_data));
 }
 
 void expect_type(Tokens *t, Index i, TokenType expected) {
@@ -58,6 +57,25 @@ void lexer_test_integer(void) {
     lexer_destroy(l);
 }
 
+void lexer_test_numbers(void) {
+    str    str = to_str("18446744073709551615 1.25 3. 18446744073709551616");
+    Lexer  l   = lexer_create(str, NULL);
+    Tokens t   = lexer_lex_tokens(&l);
+
+    TEST_ASSERT_EQUAL_size_t(7, t.len);
+    expect_integer(&t, 1, UINT64_MAX);
+    expect_type(&t, 2, TOKEN_TYPE_FLOAT);
+    TEST_ASSERT_TRUE(1.25 == extra_data_float(&t, t.tokens[2].extra_data));
+    // A dot without digits after it is no float
+    expect_integer(&t, 3, 3);
+    expect_type(&t, 4, TOKEN_TYPE_INVALID);
+    expect_type(&t, 5, TOKEN_TYPE_INTEGER_OUT_OF_RANGE);
+
+    str_destroy(str);
+    tokens_destroy(t);
+    lexer_destroy(l);
+}
+
 void lexer_test_var(void) {
     str    str = to_str("hello := 3\n");
     Lexer  l   = lexer_create(str, NULL);
@@ -115,12 +133,61 @@ void lexer_test_function_keyword(void) {
     lexer_destroy(l);
 }
 
+void lexer_test_operators(void) {
+    str    str = to_str("return a + 2 * b - c");
+    Lexer  l   = lexer_create(str, NULL);
+    Tokens t   = lexer_lex_tokens(&l);
+
+    TEST_ASSERT_EQUAL_size_t(10, t.len);
+    expect_type(&t, 1, TOKEN_TYPE_RETURN);
+    expect_identifier(&l, &t, 2, "a");
+    expect_type(&t, 3, TOKEN_TYPE_PLUS);
+    expect_integer(&t, 4, 2);
+    expect_type(&t, 5, TOKEN_TYPE_ASTERISK);
+    expect_identifier(&l, &t, 6, "b");
+    expect_type(&t, 7, TOKEN_TYPE_MINUS);
+    expect_identifier(&l, &t, 8, "c");
+
+    str_destroy(str);
+    tokens_destroy(t);
+    lexer_destroy(l);
+}
+
+void lexer_test_loops(void) {
+    str    str = to_str("#unroll(4) for i in 0..n {} while a <= b != c");
+    Lexer  l   = lexer_create(str, NULL);
+    Tokens t   = lexer_lex_tokens(&l);
+
+    TEST_ASSERT_EQUAL_size_t(21, t.len);
+    expect_type(&t, 1, TOKEN_TYPE_HASH);
+    expect_identifier(&l, &t, 2, "unroll");
+    expect_type(&t, 3, TOKEN_TYPE_LPAREN);
+    expect_integer(&t, 4, 4);
+    expect_type(&t, 5, TOKEN_TYPE_RPAREN);
+    expect_type(&t, 6, TOKEN_TYPE_FOR);
+    expect_identifier(&l, &t, 7, "i");
+    expect_type(&t, 8, TOKEN_TYPE_IN);
+    expect_integer(&t, 9, 0);
+    expect_type(&t, 10, TOKEN_TYPE_DOT_DOT);
+    expect_identifier(&l, &t, 11, "n");
+    expect_type(&t, 14, TOKEN_TYPE_WHILE);
+    expect_type(&t, 16, TOKEN_TYPE_LESS_EQUAL);
+    expect_type(&t, 18, TOKEN_TYPE_BANG_EQUAL);
+
+    str_destroy(str);
+    tokens_destroy(t);
+    lexer_destroy(l);
+}
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(lexer_test_identifier);
     RUN_TEST(lexer_test_integer);
+    RUN_TEST(lexer_test_numbers);
     RUN_TEST(lexer_test_var);
     RUN_TEST(lexer_test_function_keyword);
     RUN_TEST(lexer_test_all_tokens);
+    RUN_TEST(lexer_test_operators);
+    RUN_TEST(lexer_test_loops);
     return UNITY_END();
 }
@@ -77,9 +77,103 @@ void test_parser_function(void) {
     module_destroy(m);
 }
 
+void test_parser_function_attributes(void) {
+    Lexer             l   = setup_lexer("@inline @cold\nfn f() u32 {  }\n");
+    Tokens            t   = lexer_lex_tokens(&l);
+    Parser            p   = parser_create(t, str_clone(l.input));
+    ParseModuleResult mod = parser_parse_module(&p);
+    TEST_ASSERT_EQUAL(PARSE_RESULT_TYPE_OK, mod.type);
+
+    Module                m    = mod.data.ok;
+    Node                 *node = &m.nodes.items[m.top_level_nodes.items[0]];
+    FunctionPrototypeData fpd =
+        m.extra_data.items[node->data.lhs].data.function_prototype;
+    TEST_ASSERT_EQUAL_size_t(2, fpd.attributes.count);
+    TEST_ASSERT_EQUAL_size_t(2, fpd.attributes.items[0]);
+    TEST_ASSERT_EQUAL_size_t(4, fpd.attributes.items[1]);
+
+    parser_destroy(p);
+    lexer_destroy(l);
+    module_destroy(m);
+
+    // Attributes have to be followed by fn
+    l   = setup_lexer("@inline x := 1\n");
+    t   = lexer_lex_tokens(&l);
+    p   = parser_create(t, str_clone(l.input));
+    mod = parser_parse_module(&p);
+    TEST_ASSERT_EQUAL(PARSE_RESULT_TYPE_UNEXPECTED_TOKEN, mod.type);
+    TEST_ASSERT_EQUAL(TOKEN_TYPE_FN, mod.data.errors.unexpected_token.expected);
+
+    parser_destroy(p);
+    lexer_destroy(l);
+    module_destroy(p.cur_module);
+}
+
+void test_parser_loops(void) {
+    Lexer             l   = setup_lexer("fn f() u32 {\n"
+                                        "#unroll(2) #parallel for i in 0..4 {\n"
+                                        "}\n"
+                                        "}\n");
+    Tokens            t   = lexer_lex_tokens(&l);
+    Parser            p   = parser_create(t, str_clone(l.input));
+    ParseModuleResult mod = parser_parse_module(&p);
+    TEST_ASSERT_EQUAL(PARSE_RESULT_TYPE_OK, mod.type);
+
+    // 0: start, 1: end, 2: loop block, 3: for, 4: block, 5: function
+    Module m    = mod.data.ok;
+    Node  *node = &m.nodes.items[3];
+    TEST_ASSERT_EQUAL_size_t(NODE_TYPE_FOR, node->type);
+    TEST_ASSERT_EQUAL_size_t(2, node->data.rhs);
+    LoopData ld = m.extra_data.items[node->data.lhs].data.loop;
+    TEST_ASSERT_EQUAL_size_t(0, ld.lhs);
+    TEST_ASSERT_EQUAL_size_t(1, ld.rhs);
+    TEST_ASSERT_EQUAL_size_t(2, ld.hints.count);
+    TEST_ASSERT_TRUE(ld.hints.items[0].argument != 0);
+    TEST_ASSERT_EQUAL_size_t(0, ld.hints.items[1].argument);
+
+    parser_destroy(p);
+    lexer_destroy(l);
+    module_destroy(m);
+
+    // Hints have to be followed by a loop
+    l   = setup_lexer("fn f() u32 {\n#unroll x := 1\n}\n");
+    t   = lexer_lex_tokens(&l);
+    p   = parser_create(t, str_clone(l.input));
+    mod = parser_parse_module(&p);
+    TEST_ASSERT_EQUAL(PARSE_RESULT_TYPE_EXPECTED_LOOP, mod.type);
+
+    parser_destroy(p);
+    lexer_destroy(l);
+    module_destroy(p.cur_module);
+}
+
+void test_parser_integer_out_of_range(void) {
+    Lexer l = setup_lexer("fn f() u32 {\nx := 18446744073709551616\n}\n");
+    Tokens            t   = lexer_lex_tokens(&l);
+    Parser            p   = parser_create(t, str_clone(l.input));
+    ParseModuleResult mod = parser_parse_module(&p);
+    TEST_ASSERT_EQUAL(PARSE_RESULT_TYPE_INTEGER_OUT_OF_RANGE, mod.type);
+
+    // The error is reported at the literal.
+    TEST_ASSERT_EQUAL_size_t(18, mod.data.errors.invalid_token.token.pos);
+    TEST_ASSERT_EQUAL_size_t(18, p.tokens.tokens[p.cur_token].pos);
+    str   err      = parse_error_str(mod.type, mod.data.errors);
+    char *err_cstr = to_cstr(err);
+    TEST_ASSERT_EQUAL_STRING("integer literal out of range", err_cstr);
+    free(err_cstr);
+    str_destroy(err);
+
+    parser_destroy(p);
+    lexer_destroy(l);
+    module_destroy(p.cur_module);
+}
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_parser_variable_decleration);
     RUN_TEST(test_parser_function);
+    RUN_TEST(test_parser_function_attributes);
+    RUN_TEST(test_parser_loops);
+    RUN_TEST(test_parser_integer_out_of_range);
     return UNITY_END();
 }
@@ -0,0 +1,63 @@
+#include <stdint.h>
+#include "thor_runtime.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_arena_alloc(void) {
+    ThorArena *arena = thor_arena_create(64);
+    TEST_ASSERT_NOT_NULL(arena);
+
+    // The first allocation allocates the first block, even with size 0.
+    void *empty = thor_arena_alloc(arena, 0);
+    TEST_ASSERT_NOT_NULL(empty);
+    TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)empty % THOR_ARENA_ALIGNMENT);
+    void *first = thor_arena_alloc(arena, 10);
+    TEST_ASSERT_TRUE(empty == first);
+    void *second = thor_arena_alloc(arena, 20);
+    TEST_ASSERT_EQUAL_UINT64(16, (uintptr_t)second - (uintptr_t)first);
+
+    // Larger than a block, it gets a block of its own.
+    TEST_ASSERT_NOT_NULL(thor_arena_alloc(arena, 1000));
+    void *third = thor_arena_alloc(arena, 16);
+    TEST_ASSERT_EQUAL_UINT64(32, (uintptr_t)third - (uintptr_t)second);
+
+    // A full block is followed by a new one.
+    TEST_ASSERT_NOT_NULL(thor_arena_alloc(arena, 48));
+    TEST_ASSERT_NOT_NULL(thor_arena_alloc(arena, 0));
+
+    TEST_ASSERT_NULL(thor_arena_release(arena));
+}
+
+void test_arena_reset(void) {
+    ThorArena *arena = thor_arena_create(0);
+    TEST_ASSERT_NOT_NULL(arena);
+    TEST_ASSERT_TRUE(arena == thor_arena_reset(arena));
+
+    void *first = thor_arena_alloc(arena, 32);
+    TEST_ASSERT_NOT_NULL(thor_arena_alloc(arena, 2 * THOR_ARENA_BLOCK_SIZE));
+    TEST_ASSERT_TRUE(arena == thor_arena_reset(arena));
+    TEST_ASSERT_TRUE(first == thor_arena_alloc(arena, 8));
+
+    TEST_ASSERT_NULL(thor_arena_release(arena));
+}
+
+// A released arena is NULL, and so is an arena that could not be created.
+void test_arena_null(void) {
+    TEST_ASSERT_NULL(thor_arena_alloc(NULL, 0));
+    TEST_ASSERT_NULL(thor_arena_alloc(NULL, 16));
+    TEST_ASSERT_NULL(thor_arena_alloc_slow(NULL, 16));
+    TEST_ASSERT_NULL(thor_arena_reset(NULL));
+    TEST_ASSERT_NULL(thor_arena_release(NULL));
+    TEST_ASSERT_NULL(thor_arena_create(SIZE_MAX));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_arena_alloc);
+    RUN_TEST(test_arena_reset);
+    RUN_TEST(test_arena_null);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ast.h"
+#include "code_analyse.h"
+#include "common.h"
+#include "flat_pass.h"
+#include "lexer.h"
+#include "node_column.h"
+#include "parser.h"
+#include "test_common.h"
+#include "simplify.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) { string_pool_free_all(); }
+
+typedef struct Simplified Simplified;
+struct Simplified {
+    Lexer         l;
+    Parser        p;
+    Module        m;
+    ModuleAnalyse ma;
+    SimplifyStats stats;
+};
+
+void simplified(Simplified *s, char const *input) {
+    s->m  = parse(&s->l, &s->p, input);
+    s->ma = analyse_module(&s->m, &s->p.tokens, s->p.input);
+    TEST_ASSERT_EQUAL_size_t(0, s->ma.errors.count);
+
+    s->stats = simplify_module(&s->m, &s->ma, &s->p.tokens);
+    TEST_ASSERT_TRUE(flat_module_is_ordered(&s->m));
+    TEST_ASSERT_EQUAL_size_t(s->m.nodes.count, s->ma.attributes.type.count);
+}
+
+void simplified_destroy(Simplified *s) {
+    free_module_analyse(&s->ma);
+    module_destroy(s->m);
+    parser_destroy(s->p);
+    lexer_destroy(s->l);
+}
+
+usz count_nodes(Module *m, NodeType type) {
+    usz count = 0;
+    for (usz i = 0; i < m->nodes.count; i++) {
+        count += m->nodes.items[i].type == type;
+    }
+    return count;
+}
+
+Node *return_expression(Module *m) {
+    for (usz i = 0; i < m->nodes.count; i++) {
+        if (m->nodes.items[i].type == NODE_TYPE_RETURN) {
+            return &m->nodes.items[m->nodes.items[i].data.rhs];
+        }
+    }
+    TEST_FAIL_MESSAGE("no return");
+    return NULL;
+}
+
+void test_simplify_folds_and_propagates(void) {
+    Simplified s;
+    simplified(&s, "fn main() u32 {\n"
+                   "x := 1 + 2 * 3\n"
+                   "y := (x - 1) * 2\n"
+                   "return y + 0\n"
+                   "}\n");
+
+    // Only the folded return value is left.
+    TEST_ASSERT_EQUAL_size_t(0, count_nodes(&s.m, NODE_TYPE_VARIABLE_DECLARATION));
+    TEST_ASSERT_EQUAL_size_t(0, count_nodes(&s.m, NODE_TYPE_BINARY_OPERATION));
+    TEST_ASSERT_EQUAL_size_t(0, count_nodes(&s.m, NODE_TYPE_IDENTIFIER));
+    TEST_ASSERT_EQUAL_size_t(2, s.stats.propagated);
+
+    Node *value = return_expression(&s.m);
+    TEST_ASSERT_EQUAL(NODE_TYPE_INTEGER_LITERAL, value->type);
+    TEST_ASSERT_EQUAL_INT(12, extra_data_integer(
+                                  &s.p.tokens,
+                                  s.p.tokens.tokens[value->main_token].extra_data));
+
+    simplified_destroy(&s);
+}
+
+void test_simplify_keeps_used_variables(void) {
+    Simplified s;
+    simplified(&s, "fn main(a u32) u32 {\n"
+                   "x := a + 1\n"
+                   "unused := x * 2\n"
+                   "return x\n"
+                   "y := 3\n"
+                   "}\n");
+
+    // x depends on an argument and is used, unused and everything after the
+    // return are removed.
+    TEST_ASSERT_EQUAL_size_t(1, count_nodes(&s.m, NODE_TYPE_VARIABLE_DECLARATION));
+    TEST_ASSERT_EQUAL_size_t(1, count_nodes(&s.m, NODE_TYPE_BINARY_OPERATION));
+    TEST_ASSERT_EQUAL(NODE_TYPE_IDENTIFIER, return_expression(&s.m)->type);
+
+    // The symbols still point at their nodes.
+    for (usz i = 0; i < s.m.nodes.count; i++) {
+        Index symbol = node_column_get(&s.ma.attributes.symbol, i);
+        if (s.m.nodes.items[i].type == NODE_TYPE_VARIABLE_DECLARATION) {
+            TEST_ASSERT_EQUAL_size_t(i, s.ma.symbols.items[symbol].node);
+        }
+    }
+
+    simplified_destroy(&s);
+}
+
+void test_simplify_keeps_assigned_variables(void) {
+    Simplified s;
+    simplified(&s, "fn main() u32 {\n"
+                   "x := 1\n"
+                   "for i in 0..4 {\n"
+                   "x = x * 2\n"
+                   "}\n"
+                   "return x\n"
+                   "}\n");
+
+    // x is assigned in the loop, so its initial value is not propagated.
+    TEST_ASSERT_EQUAL_size_t(1, count_nodes(&s.m, NODE_TYPE_VARIABLE_DECLARATION));
+    TEST_ASSERT_EQUAL_size_t(1, count_nodes(&s.m, NODE_TYPE_ASSIGNMENT));
+    TEST_ASSERT_EQUAL(NODE_TYPE_IDENTIFIER, return_expression(&s.m)->type);
+
+    simplified_destroy(&s);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_simplify_folds_and_propagates);
+    RUN_TEST(test_simplify_keeps_used_variables);
+    RUN_TEST(test_simplify_keeps_assigned_variables);
+    return UNITY_END();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+#include "lexer.h"
+#include "parser.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+// Lexes and parses input, aborts the test if it does not parse. The lexer and
+// parser are returned so the test can use and destroy them.
+static inline Module parse(Lexer *l, Parser *p, char const *input) {
+    str input_str = to_str(input);
+    *l            = lexer_create(input_str, NULL);
+    str_destroy(input_str);
+    Tokens            t   = lexer_lex_tokens(l);
+    *p                    = parser_create(t, str_clone(l->input));
+    ParseModuleResult mod = parser_parse_module(p);
+    if (mod.type != PARSE_RESULT_TYPE_OK) {
+        str err = parse_error_str(mod.type, mod.data.errors);
+        str_fprintln(stdout, err);
+        str_destroy(err);
+        TEST_ABORT();
+        abort();
+    }
+    return mod.data.ok;
+}
@@ -0,0 +1,127 @@
+// clock_gettime
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+
+// Measures how the thread pool scales with the worker count on two loads:
+// many small independent tasks, like the functions of a module, and a fork
+// join tree of tasks that wait on their children, which stresses stealing.
+
+#define BENCH_FLAT_TASKS   4096
+#define BENCH_FLAT_WORK    20000
+#define BENCH_TREE_DEPTH   34
+// Smaller subtrees run without tasks
+#define BENCH_TREE_CUTOFF  14
+#define BENCH_REPETITIONS  3
+
+f64 bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+typedef struct FlatTask FlatTask;
+struct FlatTask {
+    u64 seed;
+    u64 result;
+};
+
+void bench_flat_task(void *data) {
+    FlatTask *task = data;
+    u64       x    = task->seed;
+    for (usz i = 0; i < BENCH_FLAT_WORK; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    task->result = x;
+}
+
+void bench_flat(ThreadPool *pool) {
+    static FlatTask tasks[BENCH_FLAT_TASKS];
+    ThreadPoolGroup group = {0};
+    for (usz i = 0; i < BENCH_FLAT_TASKS; i++) {
+        tasks[i] = (FlatTask){.seed = i + 1};
+        thread_pool_submit(pool, &group, bench_flat_task, &tasks[i]);
+    }
+    thread_pool_wait(pool, &group);
+}
+
+typedef struct TreeTask TreeTask;
+struct TreeTask {
+    ThreadPool *pool;
+    u32         n;
+    u64         result;
+};
+
+u64 bench_fib(u32 n) { return n < 2 ? n : bench_fib(n - 1) + bench_fib(n - 2); }
+
+void bench_tree_task(void *data) {
+    TreeTask *task = data;
+    if (task->n < BENCH_TREE_CUTOFF) {
+        task->result = bench_fib(task->n);
+        return;
+    }
+
+    TreeTask *children = arena_alloc(thread_pool_arena(), sizeof(TreeTask) * 2);
+    children[0]        = (TreeTask){.pool = task->pool, .n = task->n - 1};
+    children[1]        = (TreeTask){.pool = task->pool, .n = task->n - 2};
+    ThreadPoolGroup group = {0};
+    thread_pool_submit(task->pool, &group, bench_tree_task, &children[1]);
+    // The first child runs here, like the owner would pop it anyway.
+    bench_tree_task(&children[0]);
+    thread_pool_wait(task->pool, &group);
+    task->result = children[0].result + children[1].result;
+}
+
+void bench_tree(ThreadPool *pool) {
+    TreeTask        root  = {.pool = pool, .n = BENCH_TREE_DEPTH};
+    ThreadPoolGroup group = {0};
+    thread_pool_submit(pool, &group, bench_tree_task, &root);
+    thread_pool_wait(pool, &group);
+}
+
+// The best of a few runs, in seconds.
+f64 bench_run(ThreadPool *pool, void (*load)(ThreadPool *pool)) {
+    f64 best = 0;
+    for (usz i = 0; i < BENCH_REPETITIONS; i++) {
+        f64 start   = bench_now();
+        load(pool);
+        f64 elapsed = bench_now() - start;
+        if (i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    usz  max   = cores > 0 ? (usz)cores : 1;
+
+    f64 flat_base = 0, tree_base = 0;
+    printf("workers    flat ms  speedup    tree ms  speedup\n");
+    for (usz workers = 1; workers <= max; workers *= 2) {
+        ThreadPool *pool = thread_pool_create(workers);
+        if (pool == NULL) {
+            fprintf(stderr, "could not start %zu workers\n", workers);
+            return 1;
+        }
+        f64 flat = bench_run(pool, bench_flat);
+        f64 tree = bench_run(pool, bench_tree);
+        thread_pool_destroy(pool);
+
+        if (workers == 1) {
+            flat_base = flat;
+            tree_base = tree;
+        }
+        printf("%7zu %10.2f %8.2f %10.2f %8.2f\n", workers, flat * 1e3,
+               flat_base / flat, tree * 1e3, tree_base / tree);
+        if (workers < max && workers * 2 > max) {
+            workers = max / 2;
+        }
+    }
+    return 0;
+}
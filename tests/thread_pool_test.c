@@ -0,0 +1,110 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "common.h"
+#include "unity.h"
+#include "unity_internals.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+typedef struct Counter Counter;
+struct Counter {
+    ThreadPool     *pool;
+    ThreadPoolGroup group;
+    _Atomic(usz)    count;
+};
+
+void count_task(void *data) {
+    Counter *counter = data;
+    atomic_fetch_add(&counter->count, 1);
+}
+
+// Submits ten follow up tasks to the same group from inside the pool.
+void spawn_task(void *data) {
+    Counter *counter = data;
+    for (usz i = 0; i < 10; i++) {
+        thread_pool_submit(counter->pool, &counter->group, count_task,
+                           counter);
+    }
+}
+
+void test_thread_pool_groups(void) {
+    Counter counter = {.pool = thread_pool_create(4)};
+    TEST_ASSERT_NOT_NULL(counter.pool);
+    TEST_ASSERT_EQUAL_size_t(4, thread_pool_worker_count(counter.pool));
+
+    for (usz i = 0; i < 1000; i++) {
+        thread_pool_submit(counter.pool, &counter.group, count_task, &counter);
+    }
+    thread_pool_wait(counter.pool, &counter.group);
+    TEST_ASSERT_EQUAL_size_t(1000, atomic_load(&counter.count));
+
+    for (usz i = 0; i < 100; i++) {
+        thread_pool_submit(counter.pool, &counter.group, spawn_task, &counter);
+    }
+    thread_pool_wait(counter.pool, &counter.group);
+    TEST_ASSERT_EQUAL_size_t(2000, atomic_load(&counter.count));
+
+    // Waiting on an empty group returns at once.
+    thread_pool_wait(counter.pool, &counter.group);
+    thread_pool_destroy(counter.pool);
+}
+
+typedef struct Fib Fib;
+struct Fib {
+    ThreadPool *pool;
+    u32         n;
+    u64         result;
+};
+
+// Waits on the tasks it submitted, which only works because a waiting worker
+// runs other tasks.
+void fib_task(void *data) {
+    Fib *fib = data;
+    if (fib->n < 2) {
+        fib->result = fib->n;
+        return;
+    }
+
+    Fib *children = arena_alloc(thread_pool_arena(), sizeof(Fib) * 2);
+    children[0]   = (Fib){.pool = fib->pool, .n = fib->n - 1};
+    children[1]   = (Fib){.pool = fib->pool, .n = fib->n - 2};
+    ThreadPoolGroup group = {0};
+    thread_pool_submit(fib->pool, &group, fib_task, &children[0]);
+    thread_pool_submit(fib->pool, &group, fib_task, &children[1]);
+    thread_pool_wait(fib->pool, &group);
+    fib->result = children[0].result + children[1].result;
+}
+
+void test_thread_pool_nested_waits(void) {
+    // A single worker has to run every task of the tree itself.
+    for (usz workers = 1; workers <= 4; workers *= 2) {
+        ThreadPool     *pool  = thread_pool_create(workers);
+        Fib             fib   = {.pool = pool, .n = 20};
+        ThreadPoolGroup group = {0};
+        thread_pool_submit(pool, &group, fib_task, &fib);
+        thread_pool_wait(pool, &group);
+        TEST_ASSERT_EQUAL_UINT64(6765, fib.result);
+        thread_pool_destroy(pool);
+    }
+}
+
+void test_thread_pool_global(void) {
+    TEST_ASSERT_NULL(thread_pool_arena());
+    ThreadPool *pool = thread_pool_global();
+    TEST_ASSERT_TRUE(pool == thread_pool_global());
+    TEST_ASSERT_TRUE(thread_pool_worker_count(pool) >= 1);
+
+    Counter counter = {.pool = pool};
+    thread_pool_submit(pool, &counter.group, spawn_task, &counter);
+    thread_pool_wait(pool, &counter.group);
+    TEST_ASSERT_EQUAL_size_t(10, atomic_load(&counter.count));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_thread_pool_groups);
+    RUN_TEST(test_thread_pool_nested_waits);
+    RUN_TEST(test_thread_pool_global);
+    return UNITY_END();
+}
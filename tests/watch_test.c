@@ -0,0 +1,65 @@
+// mkdtemp
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "common.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "watch.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void write_file(char const *dir, char const *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs("fn main() u32 {\n}\n", file);
+    fclose(file);
+}
+
+void test_watch_changes(void) {
+    char dir[] = "/tmp/thor-watch-XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+
+    Watcher watcher;
+    TEST_ASSERT_TRUE(watcher_create(&watcher));
+    TEST_ASSERT_TRUE(watcher_add(&watcher, dir, "th"));
+    TEST_ASSERT_TRUE(watcher_add(&watcher, dir, "thi"));
+    TEST_ASSERT_EQUAL_size_t(1, watcher.directories.count);
+    TEST_ASSERT_FALSE(watcher_add(&watcher, "/tmp/thor-watch-missing", "th"));
+
+    // The object is not watched, main.th is written twice.
+    write_file(dir, "main.o");
+    write_file(dir, "main.th");
+    write_file(dir, "main.th");
+    write_file(dir, "lib.thi");
+
+    WatchChanges changes = {0};
+    TEST_ASSERT_TRUE(watcher_wait(&watcher, &changes));
+    TEST_ASSERT_EQUAL_size_t(2, changes.count);
+    char expected[256];
+    snprintf(expected, sizeof(expected), "%s/main.th", dir);
+    TEST_ASSERT_EQUAL_STRING(expected, changes.items[0]);
+    snprintf(expected, sizeof(expected), "%s/lib.thi", dir);
+    TEST_ASSERT_EQUAL_STRING(expected, changes.items[1]);
+    watch_changes_destroy(&changes);
+    watcher_destroy(&watcher);
+
+    char path[256];
+    char const *names[] = {"main.o", "main.th", "lib.thi"};
+    for (usz i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        remove(path);
+    }
+    rmdir(dir);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_watch_changes);
+    return UNITY_END();
+}